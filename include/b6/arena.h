@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file arena.h
+ * @brief Allocator carving objects out of large chunks, released at once.
+ *
+ * An arena allocates objects of any size by bumping a pointer within chunks
+ * it gets from an underlying allocator. Objects cannot be released one by
+ * one: deallocating is a no-op, and all chunks are given back when the arena
+ * is finalized. This suits many small objects sharing the same lifetime,
+ * such as strings of a symbol table, which then cost neither a header nor a
+ * call to the underlying allocator each.
+ */
+
+#ifndef B6_ARENA_H_
+#define B6_ARENA_H_
+
+#include "allocator.h"
+
+/**
+ * @brief Alignment in bytes of objects allocated from arenas
+ */
+#define B6_ARENA_ALIGNMENT (2 * sizeof(void*))
+
+/**
+ * @brief Arena allocator
+ */
+struct b6_arena {
+	struct b6_allocator parent; /**< an arena is a kind of allocator */
+	struct b6_allocator *allocator; /**< underlying allocator */
+	unsigned long int chunk_size; /**< size in bytes of regular chunks */
+	struct b6_arena_chunk *chunks; /**< list of chunks, current first */
+	unsigned char *ptr; /**< next free byte of the current chunk */
+	unsigned char *end; /**< end of the current chunk */
+};
+
+/**
+ * @brief Chunk of an arena, followed by objects
+ */
+struct b6_arena_chunk {
+	struct b6_arena_chunk *next; /**< previous chunk */
+	void *pad; /**< aligns objects */
+};
+
+extern const struct b6_allocator_ops b6_arena_ops;
+
+/**
+ * @brief Initialize an arena.
+ * @param self specifies the arena.
+ * @param allocator specifies the allocator of chunks.
+ * @param chunk_size specifies the size of chunks. Objects larger than a
+ * quarter of it get a chunk of their own.
+ */
+static inline void b6_arena_initialize(struct b6_arena *self,
+				       struct b6_allocator *allocator,
+				       unsigned long int chunk_size)
+{
+	self->parent.ops = &b6_arena_ops;
+	self->allocator = allocator;
+	self->chunk_size = chunk_size;
+	self->chunks = NULL;
+	self->ptr = NULL;
+	self->end = NULL;
+}
+
+/**
+ * @brief Release every object of an arena.
+ * @param self specifies the arena, which can be used again afterwards.
+ */
+extern void b6_arena_finalize(struct b6_arena *self);
+
+/**
+ * @brief Allocate an object from an arena.
+ * @param self specifies the arena.
+ * @param size specifies the size in bytes of the object.
+ * @return a pointer to the object aligned on B6_ARENA_ALIGNMENT bytes.
+ * @return NULL when out of memory.
+ */
+static inline void *b6_arena_get(struct b6_arena *self, unsigned long int size)
+{
+	return b6_allocate(&self->parent, size);
+}
+
+#endif /* B6_ARENA_H_ */
@@ -13,6 +13,7 @@
 
 #include "assert.h"
 #include "allocator.h"
+#include "refs.h"
 
 /**
  * @brief An array is a sequence of items which can be accessed randomly.
@@ -29,6 +30,16 @@ struct b6_array {
 	unsigned char *buffer; /**< pointer to the items */
 };
 
+/**
+ * @brief Growth in percent of the capacity of arrays when they are expanded.
+ *
+ * It is 100 by default, i.e. capacity doubles, and can be changed with the
+ * `--b6-array-growth` flag, from 1 to 1000. Lower values waste less memory at
+ * the expense of more frequent reallocations. Values out of range set
+ * directly are clamped.
+ */
+extern unsigned int b6_array_growth;
+
 /**
  * @brief Initialize an array.
  *
@@ -210,4 +221,70 @@ static inline unsigned long int b6_array_reduce(struct b6_array *self,
 	return n;
 }
 
+/**
+ * @brief Maximum number of lookups a batch search runs in lockstep
+ */
+#define B6_ARRAY_BATCH 8
+
+/**
+ * @brief Look several keys up at once in a sorted array.
+ *
+ * Up to B6_ARRAY_BATCH binary searches run in lockstep. Each one halves its
+ * interval in turn and asks the processor to prefetch the next item it will
+ * compare, so that cache misses of distinct searches overlap.
+ *
+ * @pre Items of the array must be sorted with regard to cmp.
+ * @param self specifies the array.
+ * @param cmp specifies the function comparing an item (first argument) with a
+ * key (second argument), returning a negative value, zero or a positive value
+ * if the item is less than, equal to or greater than the key respectively.
+ * @param keys specifies the opaque keys to pass to cmp.
+ * @param n specifies the number of keys.
+ * @param items specifies where to store a pointer to the item equal to each
+ * key, or NULL if there is none.
+ */
+static inline void b6_array_search_batch(const struct b6_array *self,
+					 b6_compare_t cmp, void *const *keys,
+					 unsigned long int n, void **items)
+{
+	unsigned long int base[B6_ARRAY_BATCH], len[B6_ARRAY_BATCH];
+	unsigned long int index[B6_ARRAY_BATCH], next = 0, done = 0;
+	unsigned long int size = self->itemsize;
+	unsigned int i, k = n < B6_ARRAY_BATCH ? n : B6_ARRAY_BATCH;
+
+	for (i = 0; i < k; i += 1) {
+		base[i] = 0;
+		len[i] = self->length;
+		index[i] = next++;
+	}
+
+	while (done < n)
+		for (i = 0; i < k; i += 1) {
+			unsigned long int half = len[i] / 2;
+			unsigned char *item;
+			if (index[i] >= n)
+				continue;
+			if (len[i]) {
+				item = self->buffer + (base[i] + half) * size;
+				if (cmp(item, keys[index[i]]) < 0) {
+					base[i] += half + 1;
+					len[i] -= half + 1;
+				} else
+					len[i] = half;
+				b6_prefetch(self->buffer +
+					    (base[i] + len[i] / 2) * size);
+				continue;
+			}
+			item = self->buffer + base[i] * size;
+			if (base[i] >= self->length ||
+			    cmp(item, keys[index[i]]))
+				item = NULL;
+			items[index[i]] = item;
+			done += 1;
+			base[i] = 0;
+			len[i] = self->length;
+			index[i] = next++;
+		}
+}
+
 #endif /* B6_ARRAY_H_ */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file art.h
+ * @brief Adaptive radix trie of strings.
+ *
+ * An adaptive radix trie indexes strings byte after byte. Inner nodes come in
+ * four sizes, holding up to 4, 16, 48 or 256 children, and grow or shrink as
+ * children are added or removed, so that sparse and dense levels are both
+ * compact. Chains of nodes with a single child are collapsed into a prefix of
+ * the node below them.
+ *
+ * Finding a string costs O(k) for a string of k bytes, whatever the number of
+ * strings in the trie. Strings are kept sorted in lexicographic order: the
+ * trie can be traveled in order, or restricted to the strings starting with a
+ * given prefix.
+ *
+ * @code
+ * struct example {
+ *   struct b6_aref aref;
+ *   char name[16];
+ * };
+ *
+ * void list_pool_examples(struct b6_art *art)
+ * {
+ *   struct b6_art_iterator iter;
+ *   const struct b6_aref *aref;
+ *   b6_setup_art_iterator(&iter, art, "pool.");
+ *   while ((aref = b6_get_next_art_iterator(&iter)))
+ *     puts(aref->key);
+ * }
+ * @endcode
+ */
+
+#ifndef B6_ART_H
+#define B6_ART_H
+
+#include "allocator.h"
+
+/**
+ * @brief Reference to an element of an adaptive radix trie
+ *
+ * The string must remain constant while the element is in a trie. Strings
+ * must be null-terminated: the terminating byte is indexed too, so that no
+ * string of a trie is a prefix of another one.
+ */
+struct b6_aref {
+	const char *key; /**< string indexing the element */
+	unsigned long int length; /**< length of the string */
+};
+
+/**
+ * @brief Adaptive radix trie
+ */
+struct b6_art {
+	void *root; /**< root node, or tagged pointer to a single element */
+	unsigned long int length; /**< number of elements */
+	struct b6_allocator *allocator; /**< allocator of nodes */
+};
+
+/**
+ * @brief Iterator over the elements of an adaptive radix trie
+ *
+ * Iterators return elements in lexicographic order. They find the successor
+ * of the last element they returned when asked the next one, so that this
+ * element can be removed from the trie in the meantime.
+ */
+struct b6_art_iterator {
+	const struct b6_art *art;
+	const char *prefix;
+	unsigned long int length;
+	const struct b6_aref *aref;
+	int started;
+};
+
+/**
+ * @brief Initialize an adaptive radix trie.
+ * @param self specifies the trie.
+ * @param allocator specifies the allocator of nodes.
+ */
+static inline void b6_art_initialize(struct b6_art *self,
+				     struct b6_allocator *allocator)
+{
+	self->root = NULL;
+	self->length = 0;
+	self->allocator = allocator;
+}
+
+/**
+ * @brief Release the nodes of an adaptive radix trie.
+ *
+ * Elements are left untouched. The trie is empty afterwards.
+ *
+ * @param self specifies the trie.
+ */
+extern void b6_art_finalize(struct b6_art *self);
+
+/**
+ * @brief Get the number of elements of an adaptive radix trie.
+ * @param self specifies the trie.
+ * @return the number of elements.
+ */
+static inline unsigned long int b6_art_length(const struct b6_art *self)
+{
+	return self->length;
+}
+
+/**
+ * @brief Add an element to an adaptive radix trie.
+ * @param self specifies the trie.
+ * @param aref specifies the element, whose key and length must be set.
+ * @return 0 for success.
+ * @return -1 if an element with the same key is already in the trie.
+ * @return -2 when out of memory, in which case the trie is left unchanged.
+ */
+extern int b6_art_insert(struct b6_art *self, struct b6_aref *aref);
+
+/**
+ * @brief Find an element of an adaptive radix trie.
+ * @param self specifies the trie.
+ * @param key specifies the null-terminated string to look up.
+ * @param length specifies the length of the string.
+ * @return the element.
+ * @return NULL if no element has such a key.
+ */
+extern struct b6_aref *b6_art_find(const struct b6_art *self, const char *key,
+				   unsigned long int length);
+
+/**
+ * @brief Remove an element from an adaptive radix trie.
+ *
+ * This function never fails: when nodes cannot be shrunk for want of memory,
+ * they stay larger than needed.
+ *
+ * @param self specifies the trie.
+ * @param key specifies the null-terminated key of the element to remove.
+ * @param length specifies the length of the key.
+ * @return the element removed.
+ * @return NULL if no element has such a key.
+ */
+extern struct b6_aref *b6_art_remove(struct b6_art *self, const char *key,
+				     unsigned long int length);
+
+/**
+ * @brief Initialize an iterator over the elements of an adaptive radix trie.
+ * @param self specifies the iterator.
+ * @param art specifies the trie.
+ * @param prefix specifies the string elements must start with, NULL or ""
+ * for all elements.
+ */
+extern void b6_setup_art_iterator(struct b6_art_iterator *self,
+				  const struct b6_art *art, const char *prefix);
+
+/**
+ * @brief Get the next element of an iteration.
+ * @complexity O(k) where k is the length of the key of the element.
+ * @param self specifies the iterator.
+ * @return the element.
+ * @return NULL when there are no more elements.
+ */
+extern const struct b6_aref *b6_get_next_art_iterator(
+	struct b6_art_iterator *self);
+
+#endif /* B6_ART_H */
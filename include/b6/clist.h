@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file clist.h
+ *
+ * @brief Doubly-linked list of array items linked by 32-bit indices
+ *
+ * Compact lists link items of a b6_array through a b6_cdref member, found at
+ * a fixed offset within items. References are 1-based indices of items in
+ * the array, so that they take half the size of pointers on 64-bit hosts and
+ * remain valid when the array gets reallocated. Index 0 designates the list
+ * itself, which plays the role of the head and tail sentinels.
+ *
+ * @code
+ * struct item {
+ *   struct b6_cdref cdref;
+ *   ...
+ * };
+ *
+ * struct b6_array items;
+ * struct b6_clist list;
+ *
+ * b6_array_initialize(&items, allocator, sizeof(struct item));
+ * b6_clist_initialize(&list, &items, b6_offset_of(struct item, cdref));
+ * b6_array_extend(&items, 1);
+ * b6_clist_add_last(&list, b6_array_length(&items));
+ * @endcode
+ */
+
+#ifndef B6_CLIST_H_
+#define B6_CLIST_H_
+
+#include "array.h"
+#include "refs.h"
+
+/**
+ * @brief Compact doubly-linked list
+ */
+struct b6_clist {
+	struct b6_cdref cdref; /**< sentinel, i.e. first and last indices */
+	const struct b6_array *array; /**< storage of items */
+	unsigned long int offset; /**< offset of the b6_cdref within items */
+};
+
+/**
+ * @brief Initialize a compact list
+ * @param list specifies the list.
+ * @param array specifies the array storing items.
+ * @param offset specifies the offset of the b6_cdref member within items.
+ */
+static inline void b6_clist_initialize(struct b6_clist *list,
+				       const struct b6_array *array,
+				       unsigned long int offset)
+{
+	list->cdref.ref[B6_NEXT] = list->cdref.ref[B6_PREV] = 0;
+	list->array = array;
+	list->offset = offset;
+}
+
+/**
+ * @brief Get the reference of an item or of the list itself
+ * @param list specifies the list.
+ * @param index specifies the 1-based index of the item or 0.
+ * @return a pointer to the reference, valid until the array is resized.
+ */
+static inline struct b6_cdref *b6_clist_cdref(const struct b6_clist *list,
+					      unsigned int index)
+{
+	if (!index)
+		return (struct b6_cdref *)&list->cdref;
+	b6_precond(index <= list->array->length);
+	return (struct b6_cdref *)(list->array->buffer + list->offset +
+				   (index - 1UL) * list->array->itemsize);
+}
+
+/**
+ * @brief Get the index of the item following or preceding another one
+ * @param list specifies the list.
+ * @param index specifies the index of the item, or 0 for the list itself.
+ * @param dir specifies B6_NEXT or B6_PREV.
+ * @return the index of the item found or 0 at either end of the list.
+ */
+static inline unsigned int b6_clist_walk(const struct b6_clist *list,
+					 unsigned int index, int dir)
+{
+	return b6_clist_cdref(list, index)->ref[dir];
+}
+
+/**
+ * @brief Get the index of the first item of a compact list
+ * @param list specifies the list.
+ * @return the index or 0 if the list is empty.
+ */
+static inline unsigned int b6_clist_first(const struct b6_clist *list)
+{
+	return list->cdref.ref[B6_NEXT];
+}
+
+/**
+ * @brief Get the index of the last item of a compact list
+ * @param list specifies the list.
+ * @return the index or 0 if the list is empty.
+ */
+static inline unsigned int b6_clist_last(const struct b6_clist *list)
+{
+	return list->cdref.ref[B6_PREV];
+}
+
+/**
+ * @brief Check if a compact list is empty
+ * @param list specifies the list.
+ * @return true if the list is empty.
+ */
+static inline int b6_clist_empty(const struct b6_clist *list)
+{
+	return !b6_clist_first(list);
+}
+
+/**
+ * @brief Insert an item before another one
+ * @complexity O(1)
+ * @param list specifies the list.
+ * @param next specifies the index of the item to insert before, 0 meaning
+ * the end of the list.
+ * @param index specifies the index of the item to insert.
+ * @return index
+ */
+static inline unsigned int b6_clist_add(struct b6_clist *list,
+					unsigned int next, unsigned int index)
+{
+	struct b6_cdref *n = b6_clist_cdref(list, next);
+	struct b6_cdref *i = b6_clist_cdref(list, index);
+	unsigned int prev = n->ref[B6_PREV];
+
+	b6_precond(index);
+	b6_clist_cdref(list, prev)->ref[B6_NEXT] = index;
+	n->ref[B6_PREV] = index;
+	i->ref[B6_PREV] = prev;
+	i->ref[B6_NEXT] = next;
+
+	return index;
+}
+
+/**
+ * @brief Remove an item from a compact list
+ * @complexity O(1)
+ * @param list specifies the list.
+ * @param index specifies the index of the item to remove.
+ * @return index
+ */
+static inline unsigned int b6_clist_del(struct b6_clist *list,
+					unsigned int index)
+{
+	struct b6_cdref *i = b6_clist_cdref(list, index);
+
+	b6_precond(index);
+	b6_clist_cdref(list, i->ref[B6_PREV])->ref[B6_NEXT] = i->ref[B6_NEXT];
+	b6_clist_cdref(list, i->ref[B6_NEXT])->ref[B6_PREV] = i->ref[B6_PREV];
+
+	return index;
+}
+
+/**
+ * @brief Insert an item at the beginning of a compact list
+ * @param list specifies the list.
+ * @param index specifies the index of the item.
+ * @return index
+ */
+static inline unsigned int b6_clist_add_first(struct b6_clist *list,
+					      unsigned int index)
+{
+	return b6_clist_add(list, b6_clist_first(list), index);
+}
+
+/**
+ * @brief Insert an item at the end of a compact list
+ * @param list specifies the list.
+ * @param index specifies the index of the item.
+ * @return index
+ */
+static inline unsigned int b6_clist_add_last(struct b6_clist *list,
+					     unsigned int index)
+{
+	return b6_clist_add(list, 0, index);
+}
+
+/**
+ * @brief Remove the first item of a compact list
+ * @pre The list is not empty.
+ * @param list specifies the list.
+ * @return the index of the item removed.
+ */
+static inline unsigned int b6_clist_del_first(struct b6_clist *list)
+{
+	return b6_clist_del(list, b6_clist_first(list));
+}
+
+/**
+ * @brief Remove the last item of a compact list
+ * @pre The list is not empty.
+ * @param list specifies the list.
+ * @return the index of the item removed.
+ */
+static inline unsigned int b6_clist_del_last(struct b6_clist *list)
+{
+	return b6_clist_del(list, b6_clist_last(list));
+}
+
+#endif /* B6_CLIST_H_ */
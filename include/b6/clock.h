@@ -313,12 +313,11 @@ static inline struct b6_named_clock *b6_lookup_named_clock(const char *name)
  */
 static inline struct b6_named_clock *b6_get_default_named_clock(void)
 {
-	struct b6_tref *tref = b6_tree_first(&b6_named_clock_registry.tree);
-	struct b6_entry *entry = b6_cast_of(tref, struct b6_entry, tref);
-	struct b6_named_clock *source = NULL;
-	if (tref != b6_tree_tail(&b6_named_clock_registry.tree))
-		source = b6_cast_of(entry, struct b6_named_clock, entry);
-	return source;
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+	b6_setup_registry_iterator(&iter, &b6_named_clock_registry);
+	entry = b6_get_next_registry_iterator(&iter);
+	return entry ? b6_cast_of(entry, struct b6_named_clock, entry) : NULL;
 }
 
 #endif /* B6_CLOCK_H_ */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file concurrent_registry.h
+ * @brief Registries looked up by many threads and seldom modified.
+ */
+
+#ifndef B6_CONCURRENT_REGISTRY_H
+#define B6_CONCURRENT_REGISTRY_H
+
+#include "b6/registry.h"
+#include "b6/epoch.h"
+#include "b6/spinlock.h"
+
+/**
+ * @internal
+ * @brief Slot of the index of a concurrent registry
+ *
+ * A slot is written at most twice while its index is published: once when an
+ * entry is stored, then once when the entry is replaced by a tombstone. Slots
+ * keep a copy of what lookups compare, so that readers never access entries,
+ * which writers may modify when registering them again.
+ */
+struct b6_concurrent_registry_slot {
+	unsigned long int hash; /**< hash value of the name of entry */
+	unsigned long int length; /**< length of the name of entry */
+	const char *name; /**< name of entry */
+	const struct b6_entry *entry; /**< NULL, entry or tombstone */
+};
+
+/**
+ * @internal
+ * @brief Open addressing index of a concurrent registry
+ */
+struct b6_concurrent_registry_index {
+	struct b6_sref sref; /**< links retired indexes */
+	struct b6_allocator *allocator; /**< allocator of this structure */
+	unsigned long int mask; /**< number of slots minus one */
+	unsigned long int used; /**< slots holding an entry or a tombstone */
+	unsigned long int length; /**< slots holding an entry */
+	struct b6_concurrent_registry_slot slots[];
+};
+
+/**
+ * @brief Registry allowing wait-free lookups from any thread
+ *
+ * Lookups never lock and probe a bounded number of slots of a hash index. The
+ * only data they write are the reader counters of an epoch, which are
+ * striped per thread (see epoch.h). Lookups are wait-free: entering the epoch
+ * is a single atomic increment and nothing is ever retried. Writers are
+ * serialized by a spinlock. They publish new entries with a single atomic
+ * store, and unpublish them by storing a tombstone in place. When the index
+ * becomes too full, they build a larger one, swap it in atomically and
+ * retire the former one, which is released once no reader can access it
+ * anymore (read-copy-update).
+ *
+ * @code
+ * struct b6_concurrent_registry registry;
+ *
+ * b6_setup_concurrent_registry(&registry, &b6_std_allocator);
+ * b6_register_concurrent(&registry, &example->entry, "example");
+ * ...
+ * entry = b6_lookup_concurrent_registry(&registry, "example");
+ * @endcode
+ *
+ * Memory of entries belongs to the caller: an entry unregistered while other
+ * threads may have looked it up must remain valid for as long as they use
+ * it.
+ *
+ * @see b6_unregister_concurrent
+ */
+struct b6_concurrent_registry {
+	struct b6_concurrent_registry_index *index; /**< published index */
+	struct b6_allocator *allocator; /**< allocator of indexes */
+	struct b6_spinlock lock; /**< serializes writers */
+	struct b6_epoch epoch; /**< defers the release of former indexes */
+};
+
+/**
+ * @internal
+ */
+extern const struct b6_entry b6_concurrent_registry_tombstone;
+
+/**
+ * @brief Initialize a concurrent registry.
+ * @param self specifies the registry.
+ * @param allocator specifies the allocator of the index of the registry.
+ */
+extern void b6_setup_concurrent_registry(struct b6_concurrent_registry *self,
+					 struct b6_allocator *allocator);
+
+/**
+ * @brief Release the memory of a concurrent registry.
+ * @pre No thread must be accessing the registry.
+ * @param self specifies the registry.
+ */
+extern void b6_finalize_concurrent_registry(
+	struct b6_concurrent_registry *self);
+
+/**
+ * @brief Add an entry to a concurrent registry given the hash value of its
+ * name.
+ * @param self specifies the registry to populate.
+ * @param entry specifies the entry to add.
+ * @param name specifies the name of the entry.
+ * @param hash specifies the hash value of name.
+ * @param length specifies the length of name.
+ * @return 0 for success.
+ * @return -1 if an entry has already been registered with the same name.
+ * @return -2 when out of memory.
+ * @see b6_compute_registry_hash
+ */
+extern int b6_register_concurrent_hashed(struct b6_concurrent_registry *self,
+					 struct b6_entry *entry,
+					 const char *name,
+					 unsigned long int hash,
+					 unsigned long int length);
+
+/**
+ * @brief Add an entry to a concurrent registry.
+ * @param self specifies the registry to populate.
+ * @param entry specifies the entry to add.
+ * @param name specifies the name of the entry.
+ * @return 0 for success.
+ * @return -1 if an entry has already been registered with the same name.
+ * @return -2 when out of memory.
+ */
+static inline int b6_register_concurrent(struct b6_concurrent_registry *self,
+					 struct b6_entry *entry,
+					 const char *name)
+{
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(name, &length);
+	return b6_register_concurrent_hashed(self, entry, name, hash, length);
+}
+
+/**
+ * @brief Remove an entry from a concurrent registry.
+ *
+ * This function does not allocate memory and thus cannot fail.
+ *
+ * A lookup running concurrently may still compare the name of the entry
+ * after this function has returned. The entry and its name must therefore
+ * remain valid for a grace period, i.e. until every lookup that started
+ * before the removal has returned, in addition to the time threads keep
+ * using the entry they looked up.
+ *
+ * @pre The entry to remove must be a member of the registry.
+ * @param self specifies the registry.
+ * @param entry specifies the entry to remove.
+ */
+extern void b6_unregister_concurrent(struct b6_concurrent_registry *self,
+				     struct b6_entry *entry);
+
+/**
+ * @internal
+ */
+static inline struct b6_entry *b6_search_concurrent_registry(
+	const struct b6_concurrent_registry_index *index, const char *name,
+	unsigned long int hash, unsigned long int length)
+{
+	unsigned long int i = hash;
+	for (;; i += 1) {
+		const struct b6_concurrent_registry_slot *slot =
+			&index->slots[i & index->mask];
+		const struct b6_entry *entry =
+			__atomic_load_n(&slot->entry, __ATOMIC_ACQUIRE);
+		const char *lhs, *rhs;
+		if (!entry)
+			return NULL;
+		if (slot->hash != hash || slot->length != length ||
+		    entry == &b6_concurrent_registry_tombstone)
+			continue;
+		for (lhs = slot->name, rhs = name; *lhs == *rhs; lhs += 1,
+		     rhs += 1)
+			if (!*lhs)
+				return (struct b6_entry *)entry;
+	}
+}
+
+/**
+ * @brief Find an entry of a concurrent registry by name given the hash value
+ * of the name.
+ *
+ * This function can be called from any thread at any time, without any
+ * lock. It is wait-free.
+ *
+ * @param self specifies the registry to search.
+ * @param name specifies the name of the entry to find.
+ * @param hash specifies the hash value of name.
+ * @param length specifies the length of name.
+ * @return a pointer to the entry.
+ * @return NULL if no entry with such a name was found.
+ * @see b6_compute_registry_hash
+ */
+static inline struct b6_entry *b6_lookup_concurrent_registry_hashed(
+	struct b6_concurrent_registry *self, const char *name,
+	unsigned long int hash, unsigned long int length)
+{
+	unsigned long int *e = b6_enter_epoch(&self->epoch);
+	const struct b6_concurrent_registry_index *index =
+		__atomic_load_n(&self->index, __ATOMIC_ACQUIRE);
+	struct b6_entry *entry = NULL;
+	if (index)
+		entry = b6_search_concurrent_registry(index, name, hash,
+						      length);
+	b6_leave_epoch(&self->epoch, e);
+	return entry;
+}
+
+/**
+ * @brief Find an entry of a concurrent registry by name.
+ * @param self specifies the registry to search.
+ * @param name specifies the name of the entry to find.
+ * @return a pointer to the entry.
+ * @return NULL if no entry with such a name was found.
+ */
+static inline struct b6_entry *b6_lookup_concurrent_registry(
+	struct b6_concurrent_registry *self, const char *name)
+{
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(name, &length);
+	return b6_lookup_concurrent_registry_hashed(self, name, hash, length);
+}
+
+/**
+ * @brief Get the number of entries of a concurrent registry.
+ * @param self specifies the registry.
+ * @return the number of entries at the time of the call.
+ */
+extern unsigned long int b6_concurrent_registry_length(
+	struct b6_concurrent_registry *self);
+
+#endif /* B6_CONCURRENT_REGISTRY_H */
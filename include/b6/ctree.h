@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file ctree.h
+ *
+ * @brief AVL tree of array items linked by 32-bit indices
+ *
+ * Compact trees are the b6_tree counterpart of compact lists (see clist.h):
+ * items of a b6_array are linked through a b6_ctref member by their 1-based
+ * indices, 0 designating the tree itself. The 2 most significant bits of the
+ * parent index hold the balance of the node, so that a tree can hold up to
+ * B6_CTREE_MAX items.
+ *
+ * @code
+ * struct item {
+ *   struct b6_ctref ctref;
+ *   unsigned int key;
+ * };
+ *
+ * unsigned int top, ref;
+ * int dir;
+ *
+ * b6_ctree_search(&tree, ref, top, dir) {
+ *   struct item *item = b6_array_get(&items, ref - 1);
+ *   if (item->key == key)
+ *     break;
+ *   dir = item->key < key ? B6_NEXT : B6_PREV;
+ * }
+ * if (!ref)
+ *   b6_ctree_add(&tree, top, dir, index_of_new_item);
+ * @endcode
+ */
+
+#ifndef B6_CTREE_H_
+#define B6_CTREE_H_
+
+#include "array.h"
+#include "refs.h"
+
+/**
+ * @brief Maximum number of items of a compact tree
+ */
+#define B6_CTREE_MAX ((1U << 30) - 1)
+
+/**
+ * @brief Compact AVL tree
+ */
+struct b6_ctree {
+	struct b6_ctref ctref; /**< sentinel, which left child is the root */
+	const struct b6_array *array; /**< storage of items */
+	unsigned long int offset; /**< offset of the b6_ctref within items */
+};
+
+/**
+ * @brief Initialize a compact tree
+ * @param tree specifies the tree.
+ * @param array specifies the array storing items.
+ * @param offset specifies the offset of the b6_ctref member within items.
+ */
+static inline void b6_ctree_initialize(struct b6_ctree *tree,
+				       const struct b6_array *array,
+				       unsigned long int offset)
+{
+	tree->ctref.ref[0] = tree->ctref.ref[1] = 0;
+	tree->ctref.top = 0;
+	tree->array = array;
+	tree->offset = offset;
+}
+
+/**
+ * @brief Get the reference of an item or of the tree itself
+ * @param tree specifies the tree.
+ * @param index specifies the 1-based index of the item or 0.
+ * @return a pointer to the reference, valid until the array is resized.
+ */
+static inline struct b6_ctref *b6_ctree_ctref(const struct b6_ctree *tree,
+					      unsigned int index)
+{
+	if (!index)
+		return (struct b6_ctref *)&tree->ctref;
+	b6_precond(index <= tree->array->length);
+	return (struct b6_ctref *)(tree->array->buffer + tree->offset +
+				   (index - 1UL) * tree->array->itemsize);
+}
+
+/**
+ * @brief Get the index of a child
+ * @param tree specifies the tree.
+ * @param index specifies the index of the parent, 0 for the sentinel.
+ * @param dir specifies B6_NEXT or B6_PREV.
+ * @return the index of the child or 0 if none.
+ */
+static inline unsigned int b6_ctree_child(const struct b6_ctree *tree,
+					  unsigned int index, int dir)
+{
+	return b6_ctree_ctref(tree, index)->ref[dir];
+}
+
+/**
+ * @brief Get the index of the parent of an item
+ * @param tree specifies the tree.
+ * @param index specifies the index of the item.
+ * @param dir specifies where to store the direction of the item from its
+ * parent (may be NULL).
+ * @return the index of the parent, 0 for the root.
+ */
+static inline unsigned int b6_ctree_parent(const struct b6_ctree *tree,
+					   unsigned int index, int *dir)
+{
+	unsigned int top = b6_ctree_ctref(tree, index)->top & B6_CTREE_MAX;
+	if (dir)
+		*dir = b6_ctree_child(tree, top, B6_NEXT) == index ?
+			B6_NEXT : B6_PREV;
+	return top;
+}
+
+/**
+ * @brief Get the index of the root of a tree
+ * @param tree specifies the tree.
+ * @return the index of the root or 0 if the tree is empty.
+ */
+static inline unsigned int b6_ctree_root(const struct b6_ctree *tree)
+{
+	return tree->ctref.ref[0];
+}
+
+/**
+ * @brief Check if a compact tree is empty
+ * @param tree specifies the tree.
+ * @return true if the tree is empty.
+ */
+static inline int b6_ctree_empty(const struct b6_ctree *tree)
+{
+	return !b6_ctree_root(tree);
+}
+
+/**
+ * @brief Travel a compact tree from its root downwards
+ *
+ * The body is executed for each item ref visited, and must set dir to the
+ * direction to follow next. Once done, top and dir tell where to insert an
+ * item when ref is 0.
+ */
+#define b6_ctree_search(tree, ref, top, dir)				\
+	for (top = 0, dir = 0;						\
+	     (ref = b6_ctree_child(tree, top, dir));			\
+	     top = ref)
+
+/**
+ * @brief Get the index of the item following or preceding another one
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param index specifies the index of the item, 0 to get the first (resp.
+ * last) item.
+ * @param dir specifies B6_NEXT or B6_PREV.
+ * @return the index found or 0 at either end of the tree.
+ */
+extern unsigned int b6_ctree_walk(const struct b6_ctree *tree,
+				  unsigned int index, int dir);
+
+/**
+ * @brief Get the index of the first item of a compact tree
+ * @param tree specifies the tree.
+ * @return the index or 0 if the tree is empty.
+ */
+static inline unsigned int b6_ctree_first(const struct b6_ctree *tree)
+{
+	return b6_ctree_walk(tree, 0, B6_NEXT);
+}
+
+/**
+ * @brief Get the index of the last item of a compact tree
+ * @param tree specifies the tree.
+ * @return the index or 0 if the tree is empty.
+ */
+static inline unsigned int b6_ctree_last(const struct b6_ctree *tree)
+{
+	return b6_ctree_walk(tree, 0, B6_PREV);
+}
+
+/**
+ * @brief Insert an item in a compact tree
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param top specifies the index of the parent, as found by b6_ctree_search.
+ * @param dir specifies the direction of the item from its parent.
+ * @param index specifies the index of the item, not above B6_CTREE_MAX.
+ * @return index
+ */
+extern unsigned int b6_ctree_add(struct b6_ctree *tree, unsigned int top,
+				 int dir, unsigned int index);
+
+/**
+ * @brief Remove an item from a compact tree
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param top specifies the index of the parent of the item.
+ * @param dir specifies the direction of the item from its parent.
+ * @return the index of the item removed.
+ * @see b6_ctree_parent
+ */
+extern unsigned int b6_ctree_del(struct b6_ctree *tree, unsigned int top,
+				 int dir);
+
+/**
+ * @brief Check the consistency of a compact tree
+ * @param tree specifies the tree.
+ * @return the height of the tree or a negative value if it is corrupted.
+ */
+extern int b6_ctree_check(const struct b6_ctree *tree);
+
+#endif /* B6_CTREE_H_ */
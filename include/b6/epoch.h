@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file epoch.h
+ * @brief Epoch-based deferred reclamation of shared objects.
+ */
+
+#ifndef B6_EPOCH_H_
+#define B6_EPOCH_H_
+
+#include "refs.h"
+#include "spinlock.h"
+
+/**
+ * @brief Number of reader counters of an epoch
+ *
+ * Threads count themselves as readers in one of these, chosen once per thread,
+ * so that threads reading concurrently do not contend on the same cache line
+ * as long as there are no more threads than stripes.
+ */
+#define B6_EPOCH_STRIPES 16
+
+/**
+ * @brief Readers of an epoch per epoch parity, for a subset of threads
+ */
+struct b6_epoch_stripe {
+	unsigned long int active[2];
+} __attribute__((aligned(64)));
+
+/**
+ * @internal
+ */
+extern __thread unsigned int __b6_epoch_thread;
+
+/**
+ * @internal
+ */
+extern unsigned int __b6_number_epoch_thread(void);
+
+/**
+ * @brief An epoch tracks which objects can be safely released while other
+ * threads may still be reading them.
+ *
+ * Readers enclose their accesses to shared objects between b6_enter_epoch and
+ * b6_leave_epoch. Writers first unlink objects so that no new reader can reach
+ * them, then hand them over to b6_retire_epoch_object. Objects are released
+ * once every reader which entered the epoch before they were retired has left.
+ *
+ * @code
+ * struct example {
+ *   struct b6_sref sref;
+ *   ...
+ * };
+ *
+ * static void release_example(struct b6_epoch *epoch, struct b6_sref *sref)
+ * {
+ *   free(b6_cast_of(sref, struct example, sref));
+ * }
+ *
+ * void read_example(struct b6_epoch *epoch, struct example **shared)
+ * {
+ *   unsigned long int *e = b6_enter_epoch(epoch);
+ *   struct example *ex = __atomic_load_n(shared, __ATOMIC_ACQUIRE);
+ *   ...
+ *   b6_leave_epoch(epoch, e);
+ * }
+ *
+ * void replace_example(struct b6_epoch *epoch, struct example **shared,
+ *                      struct example *ex)
+ * {
+ *   ex = __atomic_exchange_n(shared, ex, __ATOMIC_ACQ_REL);
+ *   b6_retire_epoch_object(epoch, &ex->sref);
+ * }
+ * @endcode
+ *
+ * Reclamation is performed opportunistically when objects are retired. It
+ * never waits for readers.
+ */
+struct b6_epoch {
+	unsigned long int epoch; /**< current epoch */
+	struct b6_sref *limbo[2]; /**< retired objects per epoch parity */
+	struct b6_spinlock lock; /**< serializes writers */
+	void (*release)(struct b6_epoch*, struct b6_sref*); /**< destructor */
+	struct b6_epoch_stripe stripes[B6_EPOCH_STRIPES]; /**< reader counters */
+};
+
+/**
+ * @internal
+ */
+static inline struct b6_epoch_stripe *__b6_epoch_stripe(struct b6_epoch *self)
+{
+	unsigned int thread = __b6_epoch_thread;
+	if (b6_unlikely(!thread))
+		thread = __b6_number_epoch_thread();
+	return &self->stripes[thread % B6_EPOCH_STRIPES];
+}
+
+/**
+ * @brief Initialize an epoch.
+ * @param self specifies the epoch.
+ * @param release specifies the function to call back to release objects once
+ * they cannot be reached anymore.
+ */
+static inline void b6_setup_epoch(struct b6_epoch *self,
+				  void (*release)(struct b6_epoch*,
+						  struct b6_sref*))
+{
+	unsigned int i;
+	self->epoch = 0;
+	for (i = 0; i < B6_EPOCH_STRIPES; i += 1)
+		self->stripes[i].active[0] = self->stripes[i].active[1] = 0;
+	self->limbo[0] = self->limbo[1] = NULL;
+	b6_reset_spinlock(&self->lock);
+	self->release = release;
+}
+
+/**
+ * @brief Start reading shared objects.
+ *
+ * The reader announces the epoch it observed by counting itself in the
+ * counter of its parity, in the stripe of the thread. This function is
+ * wait-free: the announcement is never checked again nor retried, as a reader
+ * observing a former epoch is counted in one of the two parities that
+ * reclamation waits for anyway.
+ *
+ * @param self specifies the epoch.
+ * @return a token to pass to b6_leave_epoch: the reader counter incremented,
+ * so that any thread may leave the epoch on behalf of the reader.
+ */
+static inline unsigned long int *b6_enter_epoch(struct b6_epoch *self)
+{
+	struct b6_epoch_stripe *stripe = __b6_epoch_stripe(self);
+	unsigned long int e = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&stripe->active[e & 1], 1, __ATOMIC_SEQ_CST);
+	return &stripe->active[e & 1];
+}
+
+/**
+ * @brief Stop reading shared objects.
+ *
+ * This may be called from another thread than the one which entered the
+ * epoch, e.g. when a snapshot is handed over.
+ *
+ * @param self specifies the epoch.
+ * @param e specifies the token b6_enter_epoch returned.
+ */
+static inline void b6_leave_epoch(struct b6_epoch *self, unsigned long int *e)
+{
+	b6_precond(e >= &self->stripes[0].active[0] &&
+		   e <= &self->stripes[B6_EPOCH_STRIPES - 1].active[1]);
+	__atomic_sub_fetch(e, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Defer the release of an object until no reader can access it.
+ * @pre The object must not be reachable by readers entering the epoch anymore.
+ * @param self specifies the epoch.
+ * @param sref specifies a reference the object lends for the time it waits.
+ */
+extern void b6_retire_epoch_object(struct b6_epoch *self,
+				   struct b6_sref *sref);
+
+/**
+ * @brief Release objects of elapsed epochs when possible.
+ * @param self specifies the epoch.
+ * @return true if every retired object has been released.
+ */
+extern int b6_reclaim_epoch(struct b6_epoch *self);
+
+/**
+ * @brief Release all retired objects.
+ * @pre No reader must be within the epoch.
+ * @param self specifies the epoch.
+ */
+extern void b6_flush_epoch(struct b6_epoch *self);
+
+#endif /* B6_EPOCH_H_ */
@@ -11,6 +11,7 @@
 #ifndef FLAGS_H
 #define FLAGS_H
 
+#include "b6/observer.h"
 #include "b6/registry.h"
 #include "b6/utils.h"
 
@@ -18,7 +19,13 @@
  * @brief Give access to a global variable via a command line flag.
  *
  * The following types are supported: `bool`, `short`, `ushort`, `int`, `uint`,
- * `long`, `ulong` and `string`.
+ * `long`, `ulong`, `string`, `size`, `duration` and `growth`.
+ *
+ * Sizes are numbers of bytes with an optional binary suffix among `K`, `M`,
+ * `G` and `T`, like `64K`, `2M` or `1GiB`. Durations are numbers of
+ * microseconds, as b6_get_clock_time returns, with an optional suffix among
+ * `us`, `ms`, `s`, `m` and `h`, like `500us` or `10ms`. Growth rates are
+ * percentages from 1 to B6_MAX_GROWTH.
  *
  * Flags can be defined like this:
  *
@@ -33,6 +40,9 @@
  *
  * Example: my_hitchhiker_guide --answer-to-life-the-universe-and-everything=42
  *
+ * Flags are registered by constructors at startup unless B6_STATIC_FLAGS is
+ * defined, in which case they are defined statically as b6_static_flag does.
+ *
  * @param _var specifies the variable.
  * @param _type specifies its type.
  */
@@ -56,6 +66,10 @@
  *
  * @see b6_flag
  */
+#ifdef B6_STATIC_FLAGS
+#define b6_flag_named(_var, _type, _name) \
+	b6_static_flag_named(_var, _type, _name)
+#else
 #define b6_flag_named(_var, _type, _name) \
 	static struct b6_flag flag_ ## _var; \
 	b6_ctor(b6_flag_initialize_ ## _var); \
@@ -68,30 +82,333 @@
 		(void) ((b6_flag_type_ ## _type*)0 == &_var); \
 	} \
 	static struct b6_flag flag_ ## _var
+#endif
+
+/**
+ * @brief Give access to a global variable via a command line flag defined at
+ * link time.
+ *
+ * Unlike b6_flag, no code runs at startup: the flag is a descriptor
+ * initialized at compile time, that the linker gathers with the others in a
+ * dedicated section of the program (ELF targets only). Flags are sorted by
+ * name and looked up by binary search, the first time command line flags are
+ * parsed.
+ *
+ * Static flags are not members of b6_flag_registry. They belong to the module
+ * calling b6_parse_command_line_flags, i.e. flags defined in a shared library
+ * are not seen by a program parsing its command line, except the ones of this
+ * library itself.
+ *
+ * @param _var specifies the variable.
+ * @param _type specifies its type.
+ * @see b6_flag
+ */
+#define b6_static_flag(_var, _type) b6_static_flag_named(_var, _type, #_var)
+
+/**
+ * @brief Give access to a global variable via a command line flag alias
+ * defined at link time.
+ * @param _var specifies the variable.
+ * @param _type specifies its type.
+ * @param _name specifies the name of the flag, a string literal.
+ * @see b6_static_flag
+ */
+#define b6_static_flag_named(_var, _type, _name) \
+	static struct b6_flag flag_ ## _var = { \
+		.entry = { .name = _name, .length = sizeof(_name) - 1, }, \
+		.ops = &b6_ ## _type ## _flag_ops, \
+		.ptr = (void *)(1 ? &_var : (b6_flag_type_ ## _type*)0), \
+	}; \
+	static struct b6_flag *b6_flag_ref_ ## _var \
+	__attribute__((section("b6_flags"), used, \
+		       aligned(sizeof(struct b6_flag *)))) = &flag_ ## _var
+
+/**
+ * @internal
+ */
+extern struct b6_flag *__start_b6_flags[]
+	__attribute__((weak, visibility("hidden")));
+
+/**
+ * @internal
+ */
+extern struct b6_flag *__stop_b6_flags[]
+	__attribute__((weak, visibility("hidden")));
+
+/**
+ * @brief Index flags defined at link time.
+ *
+ * This function sorts the descriptors of a section by name the first time
+ * it is called. It does not allocate memory. It may be called concurrently
+ * from any thread: sorting is serialized with runtime flag changes.
+ *
+ * @param begin specifies the first descriptor of the section.
+ * @param end specifies the end of the section.
+ */
+extern void b6_index_static_flags(struct b6_flag **begin, struct b6_flag **end);
+
+/**
+ * @internal
+ */
+extern int __b6_parse_command_line_flags(int argc, char *argv[], int strict);
 
 /**
  * @brief Parse command line flags.
  *
- * Command line arguments order is preserved. Flags are grouped and moved at the
- * beginning of the command line. Non-flags follow.
+ * Flags are grouped and moved at the beginning of the command line, in no
+ * particular order. Non-flags follow, in their original order. Parsing stops
+ * at a `--` argument. Arguments are parsed from left to right, so that a flag
+ * given several times takes its last value. This costs O(n) for n arguments.
+ *
+ * An argument `@path` names a response file holding flags, in the format
+ * b6_reload_flags parses, which are set as if they were given at this place of
+ * the command line. Such an argument counts as a flag: when strict parsing is
+ * requested, parsing fails if the file cannot be read or has a wrong line.
+ * Response files stay mapped in memory only if string flags point into them.
  *
  * @param argc specifies the number of arguments of the command line.
  * @param argv specifies the arguments of the command line.
  * @param strict specifies if the parsing should fail on unknown flags
  * @return the index of the first command line argument that is not a flag.
  * @return the negative index of the first flag that was not recognized (for
- * strict parsing)
+ * strict parsing), which is the last of the flags grouped.
+ */
+static inline int b6_parse_command_line_flags(int argc, char *argv[],
+					      int strict)
+{
+	b6_index_static_flags(__start_b6_flags, __stop_b6_flags);
+	return __b6_parse_command_line_flags(argc, argv, strict);
+}
+
+/**
+ * @internal
+ */
+extern int __b6_reload_flags(char *text);
+
+/**
+ * @brief Change flags at runtime from a configuration text.
+ *
+ * The text holds one flag per line, as `name=value` or `--name=value`.
+ * Boolean flags can omit their value. Blank lines and lines starting with `#`
+ * are ignored. Typically, the text is the contents of a configuration file,
+ * read again upon some signal, or a message of a control channel.
+ *
+ * Every value is checked before any flag is changed: either all flags of the
+ * text are changed, or none. Each value is stored atomically, so that threads
+ * reading a flag with b6_read_flag see either its former value or its new
+ * one. Then the flags version is increased once and observers are notified of
+ * each flag changed.
+ *
+ * @param text specifies the null-terminated text. The values of string flags
+ * are null-terminated in place and the flags point into the text afterwards,
+ * so it must remain valid as long as they do. The rest of the text is left
+ * untouched.
+ * @return 0 for success.
+ * @return the negative number of the first line naming an unknown flag or
+ * holding an invalid value.
+ */
+static inline int b6_reload_flags(char *text)
+{
+	b6_index_static_flags(__start_b6_flags, __stop_b6_flags);
+	return __b6_reload_flags(text);
+}
+
+/**
+ * @brief Configuration file mapped in memory
  */
-extern int b6_parse_command_line_flags(int argc, char *argv[], int strict);
+struct b6_flags_file {
+	char *text; /**< mapping, NULL if no string flag points into it */
+	unsigned long int size; /**< size in bytes of the mapping */
+};
+
+/**
+ * @internal
+ */
+extern int __b6_load_flags_file(struct b6_flags_file *self, const char *path,
+				unsigned long int *line);
+
+/**
+ * @brief Set flags from a configuration file.
+ *
+ * The file holds flags in the format b6_reload_flags parses. It is mapped in
+ * memory privately and parsed in place, rather than read into a buffer.
+ * Names and other values are parsed from small copies, and only the values of
+ * string flags get null-terminated in place: only the pages holding them are
+ * copied.
+ *
+ * The file is unmapped right away unless string flags point into it. In this
+ * case, it remains mapped until b6_release_flags_file is called, typically
+ * once another file has been loaded:
+ *
+ * @code
+ * struct b6_flags_file old = current;
+ * if (!b6_load_flags_file(&current, path, NULL))
+ *   b6_release_flags_file(&old);
+ * @endcode
+ *
+ * @param self specifies where to keep track of the mapping.
+ * @param path specifies the path of the file.
+ * @param line specifies where to store the number of the first wrong line,
+ * or NULL.
+ * @return 0 for success.
+ * @return -1 if the file cannot be read.
+ * @return -2 if a line names an unknown flag or holds an invalid value, in
+ * which case no flag is changed.
+ */
+static inline int b6_load_flags_file(struct b6_flags_file *self,
+				     const char *path, unsigned long int *line)
+{
+	b6_index_static_flags(__start_b6_flags, __stop_b6_flags);
+	return __b6_load_flags_file(self, path, line);
+}
+
+/**
+ * @brief Release the mapping of a configuration file.
+ *
+ * Nothing happens when string flags still point into the file. Otherwise, it
+ * is unmapped: threads must not use former values of string flags anymore.
+ *
+ * @param self specifies the file, which may have been unmapped already.
+ * @return 0 if the file is not mapped anymore.
+ * @return -1 if string flags still point into it.
+ */
+extern int b6_release_flags_file(struct b6_flags_file *self);
+
+/**
+ * @internal
+ */
+extern int __b6_flags_point_into(const char *begin, const char *end);
+
+/**
+ * @internal
+ */
+extern int __b6_parse_environment_flags(char *envp[], const char *prefix);
+
+/**
+ * @brief Set flags from environment variables.
+ *
+ * Variables whose name starts with a prefix set the flag named after the rest
+ * of their name in lower case: with the prefix `MY_`, `MY_POOL_SIZE=64K` sets
+ * the flag `pool_size`. Values are not copied: string flags point into the
+ * environment. Other variables are ignored.
+ *
+ * Like b6_reload_flags, either all flags are changed, or none.
+ *
+ * @param envp specifies the null-terminated array of environment variables,
+ * e.g. `environ`.
+ * @param prefix specifies the prefix of the variables setting flags.
+ * @return 0 for success.
+ * @return the negative index plus one of the first variable with the prefix
+ * naming an unknown flag or holding an invalid value.
+ */
+static inline int b6_parse_environment_flags(char *envp[], const char *prefix)
+{
+	b6_index_static_flags(__start_b6_flags, __stop_b6_flags);
+	return __b6_parse_environment_flags(envp, prefix);
+}
+
+/**
+ * @internal
+ */
+extern int __b6_set_flag(const char *name, const char *value);
+
+/**
+ * @brief Change a single flag at runtime.
+ * @param name specifies the name of the flag.
+ * @param value specifies its new value, which must remain valid as long as
+ * string flags point to it.
+ * @return 0 for success.
+ * @return -1 if no flag has such a name.
+ * @return -2 if the value is invalid.
+ * @see b6_reload_flags
+ */
+static inline int b6_set_flag(const char *name, const char *value)
+{
+	b6_index_static_flags(__start_b6_flags, __stop_b6_flags);
+	return __b6_set_flag(name, value);
+}
+
+/**
+ * @brief Read the variable of a flag that may be changed at runtime.
+ *
+ * This is a single relaxed load, as cheap as reading the variable directly on
+ * common architectures, but free from data races with b6_reload_flags.
+ *
+ * @param _var specifies the variable.
+ * @return the current value of the variable.
+ */
+#define b6_read_flag(_var) __atomic_load_n(&(_var), __ATOMIC_RELAXED)
+
+/**
+ * @brief Get the version of flags.
+ *
+ * The version is increased each time flags are changed at runtime. Code
+ * deriving state from several flags can compare versions to know whether this
+ * state is stale.
+ *
+ * @return the current version.
+ */
+extern unsigned long int b6_get_flags_version(void);
 
 struct b6_flag {
 	struct b6_entry entry;
 	const struct b6_flag_ops *ops;
 	void *ptr;
+	unsigned long int version; /**< version when last changed at runtime */
 };
 
 extern struct b6_registry b6_flag_registry;
 
+/**
+ * @brief Observer of flags changed at runtime
+ */
+struct b6_flag_observer {
+	struct b6_dref dref;
+	const struct b6_flag_observer_ops *ops;
+};
+
+/**
+ * @brief Callbacks of flag observers
+ */
+struct b6_flag_observer_ops {
+	/**
+	 * @brief Called for each flag changed, once its new value is visible.
+	 *
+	 * Callbacks run with the lock serializing runtime changes held: they
+	 * must not change flags themselves.
+	 */
+	void (*changed)(struct b6_flag_observer *self, struct b6_flag *flag);
+};
+
+/**
+ * @brief Initialize a flag observer.
+ * @param self specifies the observer.
+ * @param ops specifies its callbacks.
+ */
+static inline void b6_reset_flag_observer(struct b6_flag_observer *self,
+					  const struct b6_flag_observer_ops *ops)
+{
+	b6_reset_observer(&self->dref);
+	self->ops = ops;
+}
+
+/**
+ * @brief Get notified of flags changed at runtime.
+ * @param self specifies the observer.
+ */
+extern void b6_add_flag_observer(struct b6_flag_observer *self);
+
+/**
+ * @brief Stop being notified of flags changed at runtime.
+ * @param self specifies the observer.
+ */
+extern void b6_del_flag_observer(struct b6_flag_observer *self);
+
+/**
+ * @brief Maximum value of growth flags, in percent
+ */
+#define B6_MAX_GROWTH 1000
+
 struct b6_flag_ops {
 	int (*parse)(struct b6_flag*, const char*);
 };
@@ -108,6 +425,9 @@ b6_declare_flag_type(uint, unsigned);
 b6_declare_flag_type(long, long);
 b6_declare_flag_type(ulong, long unsigned);
 b6_declare_flag_type(string, const char*);
+b6_declare_flag_type(size, unsigned long int);
+b6_declare_flag_type(duration, unsigned long long int);
+b6_declare_flag_type(growth, unsigned int);
 
 #undef b6_declare_flag_type
 
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file frozen.h
+ *
+ * @brief Immutable search index of integer keys
+ *
+ * A frozen index is built once from a sorted sequence of keys, e.g. from the
+ * in-order traversal of a b6_tree, and then only queried. Keys are packed in
+ * a single array in Eytzinger (breadth-first) order: the children of the key
+ * at index i are at indices 2i and 2i+1. There are no pointers at all, the
+ * first levels of the implicit tree share a few cache lines and the nodes to
+ * visit next can be prefetched well ahead, as the 16 grand-grand-children of
+ * a node are contiguous.
+ *
+ * Queries report ranks, i.e. positions of keys within the sorted sequence, so
+ * that data associated with keys can be stored in a separate array in sorted
+ * order.
+ *
+ * The whole index lies in one contiguous image, which can be written to a
+ * file and mapped back later: b6_load_frozen then merely checks the image and
+ * points to it without copying it. Images are built aligned on
+ * B6_FROZEN_ALIGNMENT bytes, so that the 16 grand-grand-children of a node
+ * fill exactly two cache lines. Images loaded from elsewhere should be aligned
+ * the same way, e.g. mapped at the start of a file, or lookups touch a third
+ * line from time to time.
+ */
+
+#ifndef B6_FROZEN_H_
+#define B6_FROZEN_H_
+
+#include "allocator.h"
+#include "tree.h"
+#include "utils.h"
+
+/**
+ * @brief Magic number starting frozen index images
+ *
+ * Images are stored in the byte order of the host that built them. An image
+ * from a host with a different byte order is rejected as its magic number
+ * appears swapped.
+ */
+#define B6_FROZEN_MAGIC 0x62365f66726f7a6eULL
+
+/**
+ * @brief Alignment in bytes of the frozen index images built
+ */
+#define B6_FROZEN_ALIGNMENT 64
+
+/**
+ * @brief Header of a frozen index image
+ *
+ * The header is followed by n + 1 keys (the first one being unused), then by
+ * the n + 1 ranks of these keys.
+ */
+struct b6_frozen_header {
+	unsigned long long int magic; /**< B6_FROZEN_MAGIC */
+	unsigned long long int length; /**< number of keys n */
+	unsigned long long int reserved[6]; /**< pads keys to B6_FROZEN_ALIGNMENT */
+};
+
+/**
+ * @brief Frozen index
+ */
+struct b6_frozen {
+	const unsigned long long int *keys; /**< keys in Eytzinger order */
+	const unsigned int *ranks; /**< positions of keys in sorted order */
+	unsigned long int length; /**< number of keys */
+	void *image; /**< image to release, if any */
+};
+
+/**
+ * @brief Compute the size of the image of a frozen index
+ * @param length specifies the number of keys.
+ * @return the size in bytes.
+ */
+static inline unsigned long int b6_frozen_image_size(unsigned long int length)
+{
+	return sizeof(struct b6_frozen_header) +
+		(length + 1) * (sizeof(unsigned long long int) +
+				sizeof(unsigned int));
+}
+
+/**
+ * @brief Build a frozen index from a sorted array of keys
+ * @param self specifies the frozen index.
+ * @param allocator specifies the allocator of the image.
+ * @param keys specifies the keys in non-decreasing order.
+ * @param length specifies the number of keys.
+ * @return 0 for success
+ * @return -1 if there are too many keys
+ * @return -2 when out of memory
+ */
+extern int b6_freeze_array(struct b6_frozen *self,
+			   struct b6_allocator *allocator,
+			   const unsigned long long int *keys,
+			   unsigned long int length);
+
+/**
+ * @brief Build a frozen index from the elements of a tree
+ * @param self specifies the frozen index.
+ * @param allocator specifies the allocator of the image.
+ * @param tree specifies the tree.
+ * @param get_key specifies the function to call back to get the key of an
+ * element, which must be consistent with the order of the tree.
+ * @param arg specifies an opaque argument to pass to get_key.
+ * @return 0 for success
+ * @return -1 if there are too many keys
+ * @return -2 when out of memory
+ */
+extern int b6_freeze_tree(struct b6_frozen *self,
+			  struct b6_allocator *allocator,
+			  const struct b6_tree *tree,
+			  unsigned long long int (*get_key)(
+				  const struct b6_tref*, void*),
+			  void *arg);
+
+/**
+ * @brief Point to the image of a frozen index without copying it
+ * @param self specifies the frozen index.
+ * @param image specifies the image, which must be aligned on 8 bytes and
+ * should be aligned on B6_FROZEN_ALIGNMENT bytes.
+ * @param size specifies the size of the image in bytes.
+ * @return 0 for success
+ * @return -1 if the image is invalid
+ */
+extern int b6_load_frozen(struct b6_frozen *self, const void *image,
+			  unsigned long int size);
+
+/**
+ * @brief Release the image a frozen index built
+ * @param self specifies the frozen index.
+ * @param allocator specifies the allocator it was built with.
+ */
+static inline void b6_finalize_frozen(struct b6_frozen *self,
+				      struct b6_allocator *allocator)
+{
+	b6_deallocate(allocator, self->image);
+	self->image = NULL;
+}
+
+/**
+ * @brief Get the image of a frozen index
+ * @param self specifies the frozen index.
+ * @return a pointer to the b6_frozen_image_size(length) bytes of the image.
+ */
+static inline const void *b6_frozen_image(const struct b6_frozen *self)
+{
+	return (const struct b6_frozen_header *)self->keys - 1;
+}
+
+/**
+ * @internal
+ * @brief Find the index of the least key not less than a key
+ * @return the index in Eytzinger order or 0 if none.
+ */
+static inline unsigned long int __b6_frozen_search(
+	const struct b6_frozen *self, unsigned long long int key)
+{
+	unsigned long int i = 1;
+	while (i <= self->length) {
+		/* the 16 keys four levels down span two cache lines */
+		b6_prefetch(self->keys + 16 * i);
+		b6_prefetch(self->keys + 16 * i + 8);
+		i = 2 * i + (self->keys[i] < key);
+	}
+	return i >> __builtin_ffsl(~i);
+}
+
+/**
+ * @brief Find the rank of the least key not less than a key
+ * @complexity O(log(n))
+ * @param self specifies the frozen index.
+ * @param key specifies the key.
+ * @return the rank of the key found or the number of keys if none.
+ */
+static inline unsigned long int b6_frozen_lower_bound(
+	const struct b6_frozen *self, unsigned long long int key)
+{
+	unsigned long int i = __b6_frozen_search(self, key);
+	return i ? self->ranks[i] : self->length;
+}
+
+/**
+ * @brief Count the keys less than a key
+ * @complexity O(log(n))
+ * @param self specifies the frozen index.
+ * @param key specifies the key.
+ * @return the number of keys less than key.
+ */
+static inline unsigned long int b6_frozen_rank(const struct b6_frozen *self,
+					       unsigned long long int key)
+{
+	return b6_frozen_lower_bound(self, key);
+}
+
+/**
+ * @brief Find the rank of a key
+ * @complexity O(log(n))
+ * @param self specifies the frozen index.
+ * @param key specifies the key.
+ * @param rank specifies where to store the rank of the key.
+ * @return 0 if the key was found
+ * @return -1 otherwise
+ */
+static inline int b6_frozen_lookup(const struct b6_frozen *self,
+				   unsigned long long int key,
+				   unsigned long int *rank)
+{
+	unsigned long int i = __b6_frozen_search(self, key);
+	if (!i || self->keys[i] != key)
+		return -1;
+	*rank = self->ranks[i];
+	return 0;
+}
+
+#endif /* B6_FROZEN_H_ */
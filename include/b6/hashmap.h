@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file hashmap.h
+ *
+ * @brief Open addressing hash map of fixed-size entries
+ *
+ * Unlike b6_hashtable, a hash map stores its entries inline, in a single
+ * b6_array of slots, so that probing never chases pointers. Entries are plain
+ * blocks of bytes starting with their key, for instance:
+ *
+ * @code
+ * struct entry {
+ * 	unsigned long int key;
+ * 	double value;
+ * };
+ * @endcode
+ *
+ * A separate array holds one control byte per slot, telling whether the slot
+ * is empty, holds an entry or used to hold one (a tombstone). Full slots
+ * store the 7 lowest bits of the hash value of their key, the other bits
+ * select where probing starts. Control bytes are scanned by groups of
+ * B6_HASHMAP_GROUP: a single SIMD comparison tells which slots of a group may
+ * hold a key, so that keys are compared almost only on a match. Groups are
+ * 16 bytes wide with SSE2 and 32 bytes wide with AVX2. Other targets compare
+ * bytes one by one.
+ *
+ * Probing stops at the first group having an empty slot. Hence, an entry
+ * removed from such a group can be marked empty again: tombstones are left
+ * only in groups that are full. The map is rehashed once the number of
+ * entries and tombstones reaches B6_HASHMAP_MAX_LOAD of its capacity. Its
+ * capacity is doubled unless tombstones account for many of them.
+ *
+ * Pointers to entries remain valid until the next insertion.
+ *
+ * @see B6_HASHMAP_GENERATE for a type-safe version with inlined callbacks
+ */
+
+#ifndef B6_HASHMAP_H_
+#define B6_HASHMAP_H_
+
+#include "array.h"
+#include "refs.h"
+#include "utils.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define B6_HASHMAP_GROUP 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define B6_HASHMAP_GROUP 16
+#else
+/**
+ * @brief Number of control bytes probed at once
+ */
+#define B6_HASHMAP_GROUP 16
+#endif
+
+/**
+ * @brief Maximum number of entries and tombstones for a given capacity
+ *
+ * Probing a group of 16 slots finds an empty one with high probability up to
+ * 7/8 of occupancy, beyond which probe sequences quickly get longer.
+ */
+#define B6_HASHMAP_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+/**
+ * @internal
+ */
+enum { __B6_HASHMAP_EMPTY = 0x80, __B6_HASHMAP_DELETED = 0xfe };
+
+/**
+ * @brief Function telling whether an entry matches a key
+ * @return non-zero if the key of the entry is equal to key
+ */
+typedef int (*b6_match_t)(const void *entry, const void *key);
+
+/**
+ * @brief Hash map
+ */
+struct b6_hashmap {
+	struct b6_array ctrl; /**< control bytes of slots */
+	struct b6_array slots; /**< entries */
+	unsigned long int length; /**< number of entries */
+	unsigned long int growth; /**< empty slots usable before rehashing */
+	b6_hash_t hash; /**< hash function of keys */
+	b6_match_t match; /**< equality function of entries and keys */
+};
+
+/**
+ * @brief Initialize an empty hash map
+ *
+ * No memory is allocated until the first insertion.
+ *
+ * @param self specifies the hash map.
+ * @param allocator specifies the allocator of the arrays of the map.
+ * @param entrysize specifies the size in bytes of entries.
+ * @param hash specifies the hash function of keys, which is passed entries
+ * as well when rehashing.
+ * @param match specifies the function telling if an entry matches a key.
+ */
+static inline void b6_hashmap_initialize(struct b6_hashmap *self,
+					 struct b6_allocator *allocator,
+					 unsigned long int entrysize,
+					 b6_hash_t hash, b6_match_t match)
+{
+	b6_array_initialize(&self->ctrl, allocator, 1);
+	b6_array_initialize(&self->slots, allocator, entrysize);
+	self->length = 0;
+	self->growth = 0;
+	self->hash = hash;
+	self->match = match;
+}
+
+/**
+ * @brief Release the memory of a hash map
+ * @param self specifies the hash map.
+ */
+static inline void b6_hashmap_finalize(struct b6_hashmap *self)
+{
+	b6_array_finalize(&self->ctrl);
+	b6_array_finalize(&self->slots);
+}
+
+/**
+ * @brief Return the number of entries in a hash map
+ * @complexity O(1)
+ * @param self specifies the hash map.
+ */
+static inline unsigned long int b6_hashmap_length(const struct b6_hashmap *self)
+{
+	return self->length;
+}
+
+/**
+ * @internal
+ * @brief Return a bit mask of the control bytes of a group equal to byte
+ */
+static inline unsigned int __b6_hashmap_match(const unsigned char *ctrl,
+					      unsigned char byte)
+{
+#if defined(__AVX2__)
+	__m256i group = _mm256_loadu_si256((const __m256i *)ctrl);
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(group,
+						      _mm256_set1_epi8(byte)));
+#elif defined(__SSE2__)
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+#else
+	unsigned int mask = 0, i;
+	for (i = 0; i < B6_HASHMAP_GROUP; i += 1)
+		mask |= (ctrl[i] == byte) << i;
+	return mask;
+#endif
+}
+
+/**
+ * @internal
+ * @brief Return a bit mask of the empty or deleted slots of a group
+ */
+static inline unsigned int __b6_hashmap_free(const unsigned char *ctrl)
+{
+#if defined(__AVX2__)
+	return _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)ctrl));
+#elif defined(__SSE2__)
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+	unsigned int mask = 0, i;
+	for (i = 0; i < B6_HASHMAP_GROUP; i += 1)
+		mask |= (ctrl[i] >> 7) << i;
+	return mask;
+#endif
+}
+
+/**
+ * @internal
+ * @brief Find the entry matching a key given its hash value
+ *
+ * Callers passing a constant match function get it inlined.
+ */
+static inline __attribute__((always_inline)) void *__b6_hashmap_find(
+	const struct b6_hashmap *self, const void *key, unsigned long int hash,
+	b6_match_t match)
+{
+	const unsigned char *ctrl = self->ctrl.buffer;
+	unsigned long int mask = self->ctrl.length / B6_HASHMAP_GROUP - 1;
+	unsigned long int group = (hash >> 7) & mask, step = 0;
+	unsigned char tag = hash & 0x7f;
+
+	if (!self->ctrl.length)
+		return NULL;
+
+	for (;;) {
+		const unsigned char *bytes = ctrl + group * B6_HASHMAP_GROUP;
+		unsigned int bits = __b6_hashmap_match(bytes, tag);
+		for (; bits; bits &= bits - 1) {
+			unsigned long int index = group * B6_HASHMAP_GROUP +
+				__builtin_ctz(bits);
+			void *entry = self->slots.buffer +
+				index * self->slots.itemsize;
+			if (match(entry, key))
+				return entry;
+		}
+		if (__b6_hashmap_match(bytes, __B6_HASHMAP_EMPTY))
+			return NULL;
+		step += 1;
+		group = (group + step) & mask;
+	}
+}
+
+/**
+ * @internal
+ * @brief Reserve a slot for a key known to be missing
+ * @return the slot or NULL when out of memory
+ */
+extern void *__b6_hashmap_add(struct b6_hashmap *self, unsigned long int hash);
+
+/**
+ * @brief Search a hash map for the entry matching a key
+ * @complexity O(1) on average
+ * @param self specifies the hash map.
+ * @param key specifies the key.
+ * @return the entry or NULL if there is none.
+ */
+static inline void *b6_hashmap_find(const struct b6_hashmap *self,
+				    const void *key)
+{
+	return __b6_hashmap_find(self, key, self->hash(key), self->match);
+}
+
+/**
+ * @brief Insert the entry for a key unless it is already there
+ * @complexity O(1) amortized
+ * @param self specifies the hash map.
+ * @param key specifies the key.
+ * @param inserted specifies where to store whether the entry is new (may be
+ * NULL).
+ * @return the entry matching key. When new, it is left uninitialized and the
+ * caller must copy key to it before using the map again.
+ * @return NULL when out of memory
+ */
+static inline void *b6_hashmap_insert(struct b6_hashmap *self, const void *key,
+				      int *inserted)
+{
+	unsigned long int hash = self->hash(key);
+	void *entry = __b6_hashmap_find(self, key, hash, self->match);
+	if (inserted)
+		*inserted = !entry;
+	return entry ? entry : __b6_hashmap_add(self, hash);
+}
+
+/**
+ * @brief Remove an entry from a hash map
+ * @complexity O(1)
+ * @param self specifies the hash map.
+ * @param entry specifies an entry of the map.
+ */
+extern void b6_hashmap_erase(struct b6_hashmap *self, void *entry);
+
+/**
+ * @brief Return the first entry of a hash map in no particular order
+ * @param self specifies the hash map.
+ * @return NULL if the map is empty.
+ */
+extern void *b6_hashmap_first(const struct b6_hashmap *self);
+
+/**
+ * @brief Return the entry following another one in a hash map
+ *
+ * Entries can be erased while traveling the map, but not inserted.
+ *
+ * @param self specifies the hash map.
+ * @param entry specifies an entry of the map.
+ * @return NULL if entry is the last one.
+ */
+extern void *b6_hashmap_next(const struct b6_hashmap *self, const void *entry);
+
+/**
+ * @brief Generate a hash map API specialized for a type of entry
+ *
+ * Given:
+ *
+ * @code
+ * struct entry {
+ * 	unsigned long int key;
+ * 	double value;
+ * };
+ *
+ * #define hash_key(k) ((k) * 0x9e3779b97f4a7c15UL)
+ * #define equal_keys(a, b) ((a) == (b))
+ *
+ * B6_HASHMAP_GENERATE(entry_map, struct entry, key, hash_key, equal_keys);
+ * @endcode
+ *
+ * the following functions are available:
+ *
+ * @code
+ * void entry_map_initialize(struct b6_hashmap *map,
+ *                           struct b6_allocator *allocator);
+ * struct entry *entry_map_find(const struct b6_hashmap *map,
+ *                              unsigned long int key);
+ * struct entry *entry_map_insert(struct b6_hashmap *map,
+ *                                unsigned long int key, int *inserted);
+ * void entry_map_erase(struct b6_hashmap *map, struct entry *entry);
+ * struct entry *entry_map_first(const struct b6_hashmap *map);
+ * struct entry *entry_map_next(const struct b6_hashmap *map,
+ *                              struct entry *entry);
+ * @endcode
+ *
+ * entry_map_insert stores the key into new entries, leaving the remaining
+ * fields uninitialized. Hashing and comparisons are inlined.
+ *
+ * @param name prefix of the functions to generate
+ * @param type type of the entries, which must start with their key
+ * @param key name of the key field of type
+ * @param hash_fn function or macro returning the hash value of a key
+ * @param equal_fn function or macro returning non-zero if two keys are equal
+ */
+#define B6_HASHMAP_GENERATE(name, type, key, hash_fn, equal_fn)	\
+									\
+static inline unsigned long int name ## _hash(const void *k)		\
+{									\
+	return hash_fn(*(const __typeof(((type *)0)->key) *)k);		\
+}									\
+									\
+static inline int name ## _match(const void *entry, const void *k)	\
+{									\
+	return equal_fn(((const type *)entry)->key,			\
+			*(const __typeof(((type *)0)->key) *)k);	\
+}									\
+									\
+static inline void name ## _initialize(struct b6_hashmap *map,		\
+				       struct b6_allocator *allocator)	\
+{									\
+	b6_hashmap_initialize(map, allocator, sizeof(type),		\
+			      name ## _hash, name ## _match);		\
+}									\
+									\
+static inline type *name ## _find(const struct b6_hashmap *map,	\
+				  __typeof(((type *)0)->key) k)		\
+{									\
+	return __b6_hashmap_find(map, &k, hash_fn(k), name ## _match);	\
+}									\
+									\
+static inline type *name ## _insert(struct b6_hashmap *map,		\
+				    __typeof(((type *)0)->key) k,	\
+				    int *inserted)			\
+{									\
+	unsigned long int h = hash_fn(k);				\
+	type *e = __b6_hashmap_find(map, &k, h, name ## _match);	\
+	if (inserted)							\
+		*inserted = !e;						\
+	if (!e && (e = __b6_hashmap_add(map, h)))			\
+		e->key = k;						\
+	return e;							\
+}									\
+									\
+static inline void name ## _erase(struct b6_hashmap *map, type *e)	\
+{									\
+	b6_hashmap_erase(map, e);					\
+}									\
+									\
+static inline type *name ## _first(const struct b6_hashmap *map)	\
+{									\
+	return b6_hashmap_first(map);					\
+}									\
+									\
+static inline type *name ## _next(const struct b6_hashmap *map, type *e) \
+{									\
+	return b6_hashmap_next(map, e);					\
+}									\
+									\
+struct name ## _hack /* swallow the semicolon */
+
+#endif /* B6_HASHMAP_H_ */
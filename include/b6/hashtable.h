@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file hashtable.h
+ *
+ * @brief Intrusive hash table with incremental resizing
+ *
+ * Elements embed a b6_href that links them in the bucket matching the hash
+ * value of their key. Buckets are singly-linked chains which heads are kept
+ * in a b6_array. Hash values are stored within references so that they are
+ * never computed again and so that most mismatching elements are skipped
+ * without calling the equality function.
+ *
+ * The number of buckets is a power of two, doubled as soon as there are more
+ * elements than buckets. Rather than rehashing every element at once, the
+ * table then keeps its former buckets aside and moves B6_HASHTABLE_STEP of
+ * them to the new array at each insertion. Lookups check the former bucket of
+ * a key when it has not been moved yet, the new one otherwise. The new array
+ * is not even cleared up front: a new bucket is initialized when the former
+ * bucket it is split from gets moved. No operation is thus worse than O(1)
+ * besides memory allocation.
+ *
+ * Lookups and removals do not move buckets. Lookups can thus run concurrently
+ * as long as the table is not modified, and elements can be removed while
+ * traveling the table.
+ *
+ * @code
+ * struct item {
+ * 	struct b6_href href;
+ * 	unsigned long int key;
+ * };
+ *
+ * static unsigned long int hash_key(const void *key)
+ * {
+ * 	return *(const unsigned long int *)key * 0x9e3779b97f4a7c15UL;
+ * }
+ *
+ * static int equal_key(const struct b6_href *href, const void *key)
+ * {
+ * 	return b6_cast_of(href, struct item, href)->key ==
+ * 		*(const unsigned long int *)key;
+ * }
+ *
+ * b6_hashtable_initialize(&table, allocator, hash_key, equal_key);
+ * b6_hashtable_insert(&table, &item->href, &item->key);
+ * href = b6_hashtable_find(&table, &key);
+ * @endcode
+ *
+ * @see B6_HASHTABLE_GENERATE for a type-safe version with inlined callbacks
+ */
+
+#ifndef B6_HASHTABLE_H_
+#define B6_HASHTABLE_H_
+
+#include "array.h"
+#include "refs.h"
+#include "utils.h"
+
+/**
+ * @brief Number of former buckets moved per insertion
+ */
+#define B6_HASHTABLE_STEP 4
+
+/**
+ * @brief Initial number of buckets
+ */
+#define B6_HASHTABLE_MIN 8
+
+/**
+ * @brief Function telling whether an element matches a key
+ * @return non-zero if the key of the element is equal to key
+ */
+typedef int (*b6_equal_t)(const struct b6_href *href, const void *key);
+
+/**
+ * @brief Hash table
+ */
+struct b6_hashtable {
+	struct b6_array array[2]; /**< current buckets, then former ones */
+	unsigned long int moved; /**< former buckets already moved */
+	unsigned long int length; /**< number of elements */
+	b6_hash_t hash; /**< hash function of keys */
+	b6_equal_t equal; /**< equality function of elements and keys */
+};
+
+/**
+ * @brief Initialize an empty hash table
+ *
+ * No memory is allocated until the first insertion.
+ *
+ * @param self specifies the hash table.
+ * @param allocator specifies the allocator of bucket arrays.
+ * @param hash specifies the hash function of keys.
+ * @param equal specifies the function telling if an element matches a key.
+ */
+static inline void b6_hashtable_initialize(struct b6_hashtable *self,
+					   struct b6_allocator *allocator,
+					   b6_hash_t hash, b6_equal_t equal)
+{
+	b6_array_initialize(&self->array[0], allocator, sizeof(void*));
+	b6_array_initialize(&self->array[1], allocator, sizeof(void*));
+	self->moved = 0;
+	self->length = 0;
+	self->hash = hash;
+	self->equal = equal;
+}
+
+/**
+ * @brief Release the buckets of a hash table
+ *
+ * Elements are not referenced by the table anymore but are left untouched.
+ *
+ * @param self specifies the hash table.
+ */
+static inline void b6_hashtable_finalize(struct b6_hashtable *self)
+{
+	b6_array_finalize(&self->array[0]);
+	b6_array_finalize(&self->array[1]);
+}
+
+/**
+ * @brief Return the number of elements in a hash table
+ * @complexity O(1)
+ * @param self specifies the hash table.
+ */
+static inline unsigned long int b6_hashtable_length(
+	const struct b6_hashtable *self)
+{
+	return self->length;
+}
+
+/**
+ * @internal
+ * @brief Return the head of the bucket for a hash value, NULL if none
+ */
+static inline struct b6_href **__b6_hashtable_bucket(
+	const struct b6_hashtable *self, unsigned long int hash)
+{
+	const struct b6_array *array = &self->array[1];
+	unsigned long int index;
+	if (array->length) {
+		index = hash & (array->length - 1);
+		if (index >= self->moved)
+			return (struct b6_href **)array->buffer + index;
+	}
+	array = &self->array[0];
+	if (!array->length)
+		return NULL;
+	return (struct b6_href **)array->buffer + (hash & (array->length - 1));
+}
+
+/**
+ * @internal
+ * @brief Link an element which hash value is set up
+ * @return 0 for success or -1 when out of memory
+ */
+extern int __b6_hashtable_add(struct b6_hashtable *self, struct b6_href *href);
+
+/**
+ * @brief Search a hash table for the element matching a key
+ * @complexity O(1) on average
+ * @param self specifies the hash table.
+ * @param key specifies the key to pass to the callbacks.
+ * @return the reference of the element or NULL if there is none.
+ */
+static inline struct b6_href *b6_hashtable_find(const struct b6_hashtable *self,
+						const void *key)
+{
+	unsigned long int hash = self->hash(key);
+	struct b6_href **bucket = __b6_hashtable_bucket(self, hash);
+	struct b6_href *href;
+	if (!bucket)
+		return NULL;
+	for (href = *bucket; href; href = href->ref)
+		if (href->hash == hash && self->equal(href, key))
+			return href;
+	return NULL;
+}
+
+/**
+ * @brief Insert an element in a hash table unless its key is already there
+ * @complexity O(1) on average
+ * @param self specifies the hash table.
+ * @param href specifies the reference of the element to insert.
+ * @param key specifies the key of the element.
+ * @return href when inserted
+ * @return the reference of the element already matching key
+ * @return NULL when out of memory
+ */
+static inline struct b6_href *b6_hashtable_insert(struct b6_hashtable *self,
+						  struct b6_href *href,
+						  const void *key)
+{
+	unsigned long int hash = self->hash(key);
+	struct b6_href **bucket = __b6_hashtable_bucket(self, hash);
+	struct b6_href *ref;
+	if (bucket)
+		for (ref = *bucket; ref; ref = ref->ref)
+			if (ref->hash == hash && self->equal(ref, key))
+				return ref;
+	href->hash = hash;
+	return __b6_hashtable_add(self, href) ? NULL : href;
+}
+
+/**
+ * @brief Remove an element from a hash table
+ * @complexity O(1) on average
+ * @param self specifies the hash table.
+ * @param href specifies the reference of an element in the table.
+ */
+extern void b6_hashtable_remove(struct b6_hashtable *self,
+				struct b6_href *href);
+
+/**
+ * @brief Return the first element of a hash table in no particular order
+ * @complexity O(n / m) for m buckets
+ * @param self specifies the hash table.
+ * @return NULL if the table is empty.
+ */
+extern struct b6_href *b6_hashtable_first(const struct b6_hashtable *self);
+
+/**
+ * @brief Return the element following another one in a hash table
+ *
+ * Traveling the table with b6_hashtable_first and b6_hashtable_next visits
+ * every element once as long as the table is not modified. Elements can be
+ * removed while traveling, provided that the next one is fetched first.
+ *
+ * @param self specifies the hash table.
+ * @param href specifies the reference of an element in the table.
+ * @return NULL if href is the last element.
+ */
+extern struct b6_href *b6_hashtable_next(const struct b6_hashtable *self,
+					 const struct b6_href *href);
+
+/**
+ * @brief Generate a hash table API specialized for a type of element
+ *
+ * Given:
+ *
+ * @code
+ * struct item {
+ * 	struct b6_href href;
+ * 	const char *key;
+ * };
+ *
+ * #define hash_key(k) my_string_hash(k)
+ * #define equal_keys(a, b) !strcmp(a, b)
+ *
+ * B6_HASHTABLE_GENERATE(item_table, struct item, href, key, hash_key,
+ *                       equal_keys);
+ * @endcode
+ *
+ * the following functions are available:
+ *
+ * @code
+ * void item_table_initialize(struct b6_hashtable *table,
+ *                            struct b6_allocator *allocator);
+ * struct item *item_table_find(const struct b6_hashtable *table,
+ *                              const char *key);
+ * struct item *item_table_insert(struct b6_hashtable *table,
+ *                                struct item *item);
+ * void item_table_erase(struct b6_hashtable *table, struct item *item);
+ * struct item *item_table_first(const struct b6_hashtable *table);
+ * struct item *item_table_next(const struct b6_hashtable *table,
+ *                              struct item *item);
+ * @endcode
+ *
+ * Hashing and comparisons are inlined. item_table_insert returns the element
+ * already in the table with the same key if any, item if it was inserted or
+ * NULL when out of memory. Tables so generated have no callbacks: they must
+ * not be passed to b6_hashtable_find or b6_hashtable_insert, but remain
+ * regular b6_hashtable objects otherwise.
+ *
+ * @param name prefix of the functions to generate
+ * @param type type of the elements
+ * @param href name of the b6_href field of type
+ * @param key name of the key field of type
+ * @param hash_fn function or macro returning the hash value of a key
+ * @param equal_fn function or macro returning non-zero if two keys are equal
+ */
+#define B6_HASHTABLE_GENERATE(name, type, href, key, hash_fn, equal_fn)	\
+									\
+static inline void name ## _initialize(struct b6_hashtable *table,	\
+				       struct b6_allocator *allocator)	\
+{									\
+	b6_hashtable_initialize(table, allocator, NULL, NULL);		\
+}									\
+									\
+static inline type *name ## _entry(const struct b6_href *ref)		\
+{									\
+	return ref ? b6_cast_of(ref, type, href) : NULL;		\
+}									\
+									\
+static inline type *name ## _find(const struct b6_hashtable *table,	\
+				  __typeof(((type *)0)->key) k)		\
+{									\
+	unsigned long int h = hash_fn(k);				\
+	struct b6_href **bucket = __b6_hashtable_bucket(table, h);	\
+	struct b6_href *ref;						\
+	if (!bucket)							\
+		return NULL;						\
+	for (ref = *bucket; ref; ref = ref->ref)			\
+		if (ref->hash == h &&					\
+		    equal_fn(b6_cast_of(ref, type, href)->key, k))	\
+			return b6_cast_of(ref, type, href);		\
+	return NULL;							\
+}									\
+									\
+static inline type *name ## _insert(struct b6_hashtable *table, type *e) \
+{									\
+	unsigned long int h = hash_fn(e->key);				\
+	struct b6_href **bucket = __b6_hashtable_bucket(table, h);	\
+	struct b6_href *ref;						\
+	if (bucket)							\
+		for (ref = *bucket; ref; ref = ref->ref)		\
+			if (ref->hash == h &&				\
+			    equal_fn(b6_cast_of(ref, type, href)->key,	\
+				  e->key))				\
+				return b6_cast_of(ref, type, href);	\
+	e->href.hash = h;						\
+	return __b6_hashtable_add(table, &e->href) ? NULL : e;		\
+}									\
+									\
+static inline void name ## _erase(struct b6_hashtable *table, type *e)	\
+{									\
+	b6_hashtable_remove(table, &e->href);				\
+}									\
+									\
+static inline type *name ## _first(const struct b6_hashtable *table)	\
+{									\
+	return name ## _entry(b6_hashtable_first(table));		\
+}									\
+									\
+static inline type *name ## _next(const struct b6_hashtable *table,	\
+				  type *e)				\
+{									\
+	return name ## _entry(b6_hashtable_next(table, &e->href));	\
+}									\
+									\
+struct name ## _hack /* swallow the semicolon */
+
+#endif /* B6_HASHTABLE_H_ */
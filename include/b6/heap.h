@@ -14,6 +14,7 @@
 #include "b6/array.h"
 #include "b6/assert.h"
 #include "b6/refs.h"
+#include "b6/stats.h"
 #include "b6/utils.h"
 
 /**
@@ -28,6 +29,9 @@ struct b6_heap {
 	struct b6_array *array; /**< underlying array */
 	b6_compare_t compare; /**< items comparator */
 	void (*set_index)(void*, unsigned long int); /**< item index callback */
+#ifdef B6_STATS
+	struct b6_counters counters; /**< operation counters */
+#endif
 };
 
 
@@ -74,6 +78,7 @@ static inline void b6_heap_reset(struct b6_heap *self,
 	self->array = array;
 	self->compare = compare;
 	self->set_index = set_index;
+	__b6_reset_counters(__b6_counters_of(self));
 	b6_heap_do_make(self);
 }
 
@@ -189,4 +194,15 @@ static inline void b6_heap_extract(struct b6_heap *self,
 	b6_heap_pop(self);
 }
 
+/**
+ * @brief Snapshot the counters and the shape of a heap.
+ *
+ * Sifts count how many times items were swapped with their parent.
+ *
+ * @complexity O(log(n))
+ * @param self specifies the heap.
+ * @param stats specifies where to store the statistics.
+ */
+extern void b6_heap_stats(const struct b6_heap *self, struct b6_stats *stats);
+
 #endif /* B6_HEAP_H */
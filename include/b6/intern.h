@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file intern.h
+ * @brief Canonical copies of strings.
+ *
+ * Interning a string returns a pointer to a copy that is the same for every
+ * string with the same contents. Interned strings are then compared by
+ * comparing pointers, and their hash value and length come for free.
+ *
+ * @code
+ * struct b6_intern symbols;
+ *
+ * b6_intern_initialize(&symbols, &b6_std_allocator);
+ * a = b6_intern(&symbols, "metric.latency");
+ * b = b6_intern(&symbols, buffer_holding_metric_latency);
+ * b6_assert(a == b);
+ * @endcode
+ */
+
+#ifndef B6_INTERN_H
+#define B6_INTERN_H
+
+#include "b6/arena.h"
+#include "b6/registry.h"
+
+/**
+ * @brief Default size in bytes of the chunks holding interned strings
+ */
+#define B6_INTERN_CHUNK_SIZE 4096
+
+/**
+ * @brief Table of interned strings
+ *
+ * Strings are indexed by a hashed registry, which allocates its buckets from
+ * the allocator given at initialization. Their copies are allocated from an
+ * arena along with their registry entries, so that interning a new string
+ * seldom calls the allocator.
+ */
+struct b6_intern {
+	struct b6_registry registry; /**< entries indexed by string */
+	struct b6_arena arena; /**< storage of entries and strings */
+};
+
+/**
+ * @internal
+ */
+struct b6_interned {
+	struct b6_entry entry;
+	char name[];
+};
+
+/**
+ * @brief Initialize a table of interned strings.
+ * @param self specifies the table.
+ * @param allocator specifies the allocator of memory.
+ * @return 0 for success.
+ * @return -1 when out of memory.
+ */
+extern int b6_intern_initialize(struct b6_intern *self,
+				struct b6_allocator *allocator);
+
+/**
+ * @brief Release a table of interned strings.
+ *
+ * Pointers returned by the table become invalid.
+ *
+ * @param self specifies the table.
+ */
+extern void b6_intern_finalize(struct b6_intern *self);
+
+/**
+ * @brief Intern a string given its hash value.
+ * @param self specifies the table.
+ * @param s specifies the string.
+ * @param hash specifies the hash value of the string.
+ * @param length specifies the length of the string.
+ * @return the canonical copy of the string.
+ * @return NULL when out of memory.
+ * @see b6_compute_registry_hash
+ */
+extern const char *b6_intern_hashed(struct b6_intern *self, const char *s,
+				    unsigned long int hash,
+				    unsigned long int length);
+
+/**
+ * @brief Intern a string.
+ * @param self specifies the table.
+ * @param s specifies the string.
+ * @return the canonical copy of the string.
+ * @return NULL when out of memory.
+ */
+static inline const char *b6_intern(struct b6_intern *self, const char *s)
+{
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(s, &length);
+	return b6_intern_hashed(self, s, hash, length);
+}
+
+/**
+ * @brief Find the canonical copy of a string given its hash value.
+ * @param self specifies the table.
+ * @param s specifies the string.
+ * @param hash specifies the hash value of the string.
+ * @param length specifies the length of the string.
+ * @return the canonical copy of the string.
+ * @return NULL if the string has not been interned.
+ */
+static inline const char *b6_lookup_interned_hashed(struct b6_intern *self,
+						    const char *s,
+						    unsigned long int hash,
+						    unsigned long int length)
+{
+	const struct b6_entry *entry =
+		b6_lookup_registry_hashed(&self->registry, s, hash, length);
+	return entry ? entry->name : NULL;
+}
+
+/**
+ * @brief Find the canonical copy of a string.
+ * @param self specifies the table.
+ * @param s specifies the string.
+ * @return the canonical copy of the string.
+ * @return NULL if the string has not been interned.
+ */
+static inline const char *b6_lookup_interned(struct b6_intern *self,
+					     const char *s)
+{
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(s, &length);
+	return b6_lookup_interned_hashed(self, s, hash, length);
+}
+
+/**
+ * @brief Get the number of strings interned in a table.
+ * @param self specifies the table.
+ * @return the number of strings.
+ */
+static inline unsigned long int b6_intern_length(const struct b6_intern *self)
+{
+	return b6_hashtable_length(&self->registry.table);
+}
+
+/**
+ * @brief Get the hash value of an interned string.
+ * @param s specifies a string returned by a table of interned strings.
+ * @return the hash value computed by b6_compute_registry_hash.
+ */
+static inline unsigned long int b6_interned_hash(const char *s)
+{
+	return b6_cast_of(s, struct b6_interned, name)->entry.hash;
+}
+
+/**
+ * @brief Get the length of an interned string.
+ * @param s specifies a string returned by a table of interned strings.
+ * @return the length of the string, in constant time.
+ */
+static inline unsigned long int b6_interned_length(const char *s)
+{
+	return b6_cast_of(s, struct b6_interned, name)->entry.length;
+}
+
+#endif /* B6_INTERN_H */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file ktree.h
+ *
+ * @brief Trees of references holding integer keys
+ *
+ * Searching a regular tree requires reaching the element containing each
+ * reference visited to compare its key, which usually lies in another cache
+ * line. Keyed references embed the key next to the links so that traveling
+ * such trees only ever reads the references:
+ *
+ * @code
+ * struct timer {
+ *   struct b6_ktref ktref;
+ *   ...
+ * };
+ *
+ * struct b6_tree timers;
+ * struct timer *timer;
+ * struct b6_ktref *ktref;
+ *
+ * b6_ktree_initialize(&timers);
+ * timer->ktref.key = deadline;
+ * b6_ktree_insert(&timers, &timer->ktref);
+ * for (ktref = b6_ktree_lower_bound(&timers, now); ktref;
+ *      ktref = b6_ktree_next(&timers, ktref))
+ *   timer = b6_cast_of(ktref, struct timer, ktref);
+ * @endcode
+ *
+ * Keyed trees are AVL trees. As they are regular b6_tree objects, generic
+ * functions of tree.h apply to them as well.
+ */
+
+#ifndef B6_KTREE_H_
+#define B6_KTREE_H_
+
+#include "tree.h"
+
+/**
+ * @brief Tree reference holding an integer key
+ */
+struct b6_ktref {
+	struct b6_tref tref; /**< links */
+	unsigned long long int key; /**< key the tree is ordered by */
+};
+
+/**
+ * @internal
+ */
+#define __b6_ktree_compare(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+B6_TREE_GENERATE(__b6_ktree, struct b6_ktref, tref, key, __b6_ktree_compare);
+
+/**
+ * @brief Initialize a keyed tree
+ * @param tree specifies the tree.
+ */
+static inline void b6_ktree_initialize(struct b6_tree *tree)
+{
+	__b6_ktree_initialize(tree);
+}
+
+/**
+ * @brief Find a reference from its key
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param key specifies the key.
+ * @return the reference which key is equal to key or NULL if none.
+ */
+static inline struct b6_ktref *b6_ktree_find(const struct b6_tree *tree,
+					     unsigned long long int key)
+{
+	return __b6_ktree_find(tree, key);
+}
+
+/**
+ * @brief Insert a reference in a keyed tree
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param ktref specifies the reference with its key set.
+ * @return ktref if it was inserted.
+ * @return the reference already in the tree with the same key otherwise.
+ */
+static inline struct b6_ktref *b6_ktree_insert(struct b6_tree *tree,
+					       struct b6_ktref *ktref)
+{
+	return __b6_ktree_insert(tree, ktref);
+}
+
+/**
+ * @brief Remove a reference from a keyed tree
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param ktref specifies the reference, which must be in the tree.
+ */
+static inline void b6_ktree_erase(struct b6_tree *tree, struct b6_ktref *ktref)
+{
+	__b6_ktree_erase(tree, ktref);
+}
+
+/**
+ * @brief Find the reference with the least key not less than a key
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param key specifies the key.
+ * @return the reference found or NULL if none.
+ */
+static inline struct b6_ktref *b6_ktree_lower_bound(
+	const struct b6_tree *tree, unsigned long long int key)
+{
+	return __b6_ktree_lower_bound(tree, key);
+}
+
+/**
+ * @brief Find the reference with the least key greater than a key
+ * @complexity O(log(n))
+ * @param tree specifies the tree.
+ * @param key specifies the key.
+ * @return the reference found or NULL if none.
+ */
+static inline struct b6_ktref *b6_ktree_upper_bound(
+	const struct b6_tree *tree, unsigned long long int key)
+{
+	struct b6_tref *ref = b6_tree_root(tree), *res = NULL;
+	while (ref)
+		if (b6_cast_of(ref, struct b6_ktref, tref)->key > key) {
+			res = ref;
+			ref = ref->ref[B6_PREV];
+		} else
+			ref = ref->ref[B6_NEXT];
+	return __b6_ktree_entry(tree, res);
+}
+
+/**
+ * @brief Return the reference with the least key
+ * @param tree specifies the tree.
+ * @return the reference found or NULL if the tree is empty.
+ */
+static inline struct b6_ktref *b6_ktree_first(const struct b6_tree *tree)
+{
+	return __b6_ktree_first(tree);
+}
+
+/**
+ * @brief Return the reference with the greatest key
+ * @param tree specifies the tree.
+ * @return the reference found or NULL if the tree is empty.
+ */
+static inline struct b6_ktref *b6_ktree_last(const struct b6_tree *tree)
+{
+	return __b6_ktree_last(tree);
+}
+
+/**
+ * @brief Return the reference following another one in key order
+ * @param tree specifies the tree.
+ * @param ktref specifies the reference.
+ * @return the reference found or NULL if ktref has the greatest key.
+ */
+static inline struct b6_ktref *b6_ktree_next(const struct b6_tree *tree,
+					     struct b6_ktref *ktref)
+{
+	return __b6_ktree_next(tree, ktref);
+}
+
+/**
+ * @brief Return the reference preceding another one in key order
+ * @param tree specifies the tree.
+ * @param ktref specifies the reference.
+ * @return the reference found or NULL if ktref has the least key.
+ */
+static inline struct b6_ktref *b6_ktree_prev(const struct b6_tree *tree,
+					     struct b6_ktref *ktref)
+{
+	return __b6_ktree_prev(tree, ktref);
+}
+
+/**
+ * @brief Count the references which keys lie within [begin, end)
+ * @complexity O(log(n) + k)
+ * @param tree specifies the tree.
+ * @param begin specifies the least key of the range.
+ * @param end specifies the key following the greatest key of the range.
+ * @return the number of references found.
+ */
+static inline unsigned long int b6_ktree_count_range(
+	const struct b6_tree *tree, unsigned long long int begin,
+	unsigned long long int end)
+{
+	struct b6_ktref *ktref = b6_ktree_lower_bound(tree, begin);
+	unsigned long int count = 0;
+	while (ktref && ktref->key < end) {
+		count += 1;
+		ktref = b6_ktree_next(tree, ktref);
+	}
+	return count;
+}
+
+#endif /* B6_KTREE_H_ */
@@ -9,6 +9,7 @@
 #include "refs.h"
 #include "utils.h"
 #include "assert.h"
+#include "stats.h"
 
 /**
  * @defgroup list Doubly-linked list
@@ -30,6 +31,9 @@
  */
 struct b6_list {
 	struct b6_dref dref; /**< sentinel of the list */
+#ifdef B6_STATS
+	struct b6_counters counters; /**< operation counters */
+#endif
 };
 
 #define B6_LIST_INIT(list) { { { &(list).dref, &(list).dref } } }
@@ -53,6 +57,7 @@ static inline void b6_list_initialize(struct b6_list *list)
 
 	list->dref.ref[B6_NEXT] = &list->dref;
 	list->dref.ref[B6_PREV] = &list->dref;
+	__b6_reset_counters(__b6_counters_of(list));
 }
 
 /**
@@ -287,6 +292,18 @@ static inline void b6_list_move(struct b6_dref *from, struct b6_dref *to,
  */
 extern unsigned long int b6_list_length(const struct b6_list *list);
 
+/**
+ * @brief Remove every element of a list at once
+ * @ingroup list
+ * @complexity O(n)
+ * @param list pointer to the list to clear
+ * @param release function to call back for every element removed, after it
+ * has been unlinked, or NULL
+ * @param arg opaque data to pass to release
+ */
+extern void b6_list_clear(struct b6_list *list,
+			  void (*release)(struct b6_dref*, void*), void *arg);
+
 extern void __b6_list_msort(struct b6_list *list, b6_compare_t comp,
 			    unsigned long int length);
 
@@ -311,4 +328,14 @@ static inline void b6_list_msort(struct b6_list *list, b6_compare_t comp)
  */
 extern void b6_list_qsort(struct b6_list *list, b6_compare_t comp);
 
+/**
+ * @brief Snapshot the counters and the size of a list
+ * @ingroup list
+ * @complexity O(n)
+ * @param list pointer to the list
+ * @param stats where to store the statistics, which height and balance are
+ * left to zero
+ */
+extern void b6_list_stats(const struct b6_list *list, struct b6_stats *stats);
+
 #endif /* B6_LIST_H_ */
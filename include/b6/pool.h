@@ -47,11 +47,21 @@ struct b6_chunk {
 	unsigned int flag; /**< Whether this chunk is to be deleted. */
 };
 
+/**
+ * Base size in bytes of the chunks of pools initialized without an explicit
+ * chunk size (4096 by default).
+ *
+ * It can be changed with the `--b6-pool-chunk-size` flag, e.g. `64K`. Chunks
+ * are as large as this size doubled as many times as needed to hold an object.
+ */
+extern unsigned long int b6_pool_chunk_size;
+
 /**
  * Initialize a pool allocator.
  * @param pool specifies the pool to initialize.
  * @param size specifies the size of object this allocator will produce.
- * @param chunk_size specifies the size of memory chunk to allocate.
+ * @param chunk_size specifies the size of memory chunk to allocate, or 0 for
+ *        a size derived from b6_pool_chunk_size.
  * @param allocator specifies the allocator used for dynamically allocating
  *        chunks.
  */
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file ptree.h
+ *
+ * @brief Persistent AVL tree with snapshots for concurrent readers
+ *
+ * A persistent tree never modifies the nodes it is made of. Updates copy the
+ * path from the root to the node they change and link the copies to the
+ * subtrees left untouched, yielding a new version of the tree which shares
+ * most of its nodes with the previous one. The new root is then published
+ * atomically.
+ *
+ * A single writer thread updates the tree while any number of reader threads
+ * acquire snapshots: the root of the version published when the snapshot was
+ * acquired. Readers never lock and see every version as a whole. Acquiring a
+ * snapshot is wait-free (see epoch.h).
+ *
+ * Nodes are reference counted by the versions and the nodes referring to
+ * them. When a version gets replaced, its root is retired to an epoch (see
+ * epoch.h). Once no reader can hold it anymore, the root is released, and so
+ * are the nodes it was the last version to refer to. Reference counts are
+ * only ever touched by the writer.
+ */
+
+#ifndef B6_PTREE_H_
+#define B6_PTREE_H_
+
+#include "allocator.h"
+#include "epoch.h"
+#include "refs.h"
+
+/**
+ * @brief Maximum height of a persistent tree
+ *
+ * AVL trees are at most 1.44 times as high as perfectly balanced trees, so
+ * that this bound cannot be reached with a 64-bit address space.
+ */
+#define B6_PTREE_HEIGHT 96
+
+/**
+ * @brief Persistent tree node
+ */
+struct b6_pnode {
+	struct b6_sref sref; /**< link while the node waits for reclamation */
+	struct b6_pnode *ref[2]; /**< children */
+	void *key; /**< key the tree is ordered by */
+	void *value; /**< value associated with the key */
+	unsigned long int count; /**< number of references to this node */
+	unsigned long int version; /**< version the node was created by */
+	int height; /**< height of the subtree */
+};
+
+/**
+ * @brief Persistent tree
+ */
+struct b6_ptree {
+	struct b6_pnode *root; /**< root of the latest version */
+	unsigned long int version; /**< number of updates */
+	unsigned long int size; /**< number of keys in the latest version */
+	b6_compare_t compare; /**< keys comparator */
+	struct b6_allocator *allocator; /**< nodes allocator */
+	struct b6_sref *reserve; /**< nodes kept for the next updates */
+	unsigned long int spare; /**< number of nodes in reserve */
+	struct b6_epoch epoch; /**< readers tracker */
+};
+
+/**
+ * @brief Consistent view of a persistent tree
+ */
+struct b6_ptree_snapshot {
+	struct b6_ptree *tree; /**< tree the snapshot was taken from */
+	const struct b6_pnode *root; /**< root of the version */
+	unsigned long int *epoch; /**< epoch token */
+};
+
+/**
+ * @brief In-order iterator over a snapshot
+ */
+struct b6_ptree_iterator {
+	const struct b6_pnode *stack[B6_PTREE_HEIGHT]; /**< path to the node */
+	unsigned int depth; /**< number of nodes in stack */
+};
+
+/**
+ * @brief Initialize an empty persistent tree
+ * @param self specifies the tree.
+ * @param allocator specifies the allocator of nodes.
+ * @param compare specifies the function to call back to compare keys.
+ */
+extern void b6_ptree_initialize(struct b6_ptree *self,
+				struct b6_allocator *allocator,
+				b6_compare_t compare);
+
+/**
+ * @brief Release every node of every version of a persistent tree
+ * @pre No snapshot must be held anymore.
+ * @param self specifies the tree.
+ */
+extern void b6_ptree_finalize(struct b6_ptree *self);
+
+/**
+ * @brief Publish a new version where a key is associated with a value
+ * @pre Only one thread may update the tree at a time.
+ * @complexity O(log(n))
+ * @param self specifies the tree.
+ * @param key specifies the key.
+ * @param value specifies the value.
+ * @return 0 for success
+ * @return -1 if the key is already in the tree
+ * @return -2 when out of memory, in which case the tree is left unchanged
+ */
+extern int b6_ptree_insert(struct b6_ptree *self, void *key, void *value);
+
+/**
+ * @brief Publish a new version where a key is not in the tree anymore
+ * @pre Only one thread may update the tree at a time.
+ * @complexity O(log(n))
+ * @param self specifies the tree.
+ * @param key specifies the key.
+ * @param value specifies where to store the value associated with the key
+ * (may be NULL).
+ * @return 0 for success
+ * @return -1 if the key was not found
+ * @return -2 when out of memory, in which case the tree is left unchanged
+ */
+extern int b6_ptree_remove(struct b6_ptree *self, void *key, void **value);
+
+/**
+ * @brief Take a snapshot of the latest version of a persistent tree
+ *
+ * The version is guaranteed to be kept in memory until the snapshot is
+ * released. Snapshots should be short-lived as no version can be reclaimed
+ * while they are held.
+ *
+ * @param self specifies the snapshot.
+ * @param tree specifies the tree.
+ */
+static inline void b6_ptree_acquire(struct b6_ptree_snapshot *self,
+				    struct b6_ptree *tree)
+{
+	self->tree = tree;
+	self->epoch = b6_enter_epoch(&tree->epoch);
+	self->root = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Release a snapshot
+ * @param self specifies the snapshot.
+ */
+static inline void b6_ptree_release(struct b6_ptree_snapshot *self)
+{
+	b6_leave_epoch(&self->tree->epoch, self->epoch);
+}
+
+/**
+ * @brief Find the value associated with a key in a snapshot
+ * @complexity O(log(n))
+ * @param self specifies the snapshot.
+ * @param key specifies the key.
+ * @param value specifies where to store the value found (may be NULL).
+ * @return 0 if the key was found
+ * @return -1 otherwise
+ */
+static inline int b6_ptree_lookup(const struct b6_ptree_snapshot *self,
+				  void *key, void **value)
+{
+	const struct b6_pnode *node = self->root;
+	while (node) {
+		int res = self->tree->compare(node->key, key);
+		if (!res) {
+			if (value)
+				*value = node->value;
+			return 0;
+		}
+		node = node->ref[res < 0 ? B6_NEXT : B6_PREV];
+	}
+	return -1;
+}
+
+/**
+ * @brief Start traveling a snapshot in order
+ * @param self specifies the iterator.
+ * @param snapshot specifies the snapshot, which must be held for the time
+ * the iterator is used.
+ */
+static inline void b6_setup_ptree_iterator(
+	struct b6_ptree_iterator *self,
+	const struct b6_ptree_snapshot *snapshot)
+{
+	const struct b6_pnode *node = snapshot->root;
+	self->depth = 0;
+	for (; node; node = node->ref[B6_PREV])
+		self->stack[self->depth++] = node;
+}
+
+/**
+ * @brief Get the next node of the iteration
+ * @param self specifies the iterator.
+ * @return the node which key and value can be read.
+ * @return NULL when the iteration is over.
+ */
+static inline const struct b6_pnode *b6_get_next_ptree_iterator(
+	struct b6_ptree_iterator *self)
+{
+	const struct b6_pnode *curr, *node;
+	if (!self->depth)
+		return NULL;
+	curr = self->stack[--self->depth];
+	for (node = curr->ref[B6_NEXT]; node; node = node->ref[B6_PREV])
+		self->stack[self->depth++] = node;
+	return curr;
+}
+
+#endif /* B6_PTREE_H_ */
@@ -47,8 +47,8 @@
  * head and tail references that are placed before and after any reference
  * within the container respectively. It is illegal to dereference them.
  *
- * @see b6_sref, b6_dref, b6_tref
- * @see deque.h, list.h, vector.h, splay.h, tree.h
+ * @see b6_sref, b6_dref, b6_tref, b6_href
+ * @see deque.h, list.h, vector.h, splay.h, tree.h, hashtable.h
  */
 
 enum { B6_NEXT, B6_PREV };
@@ -108,6 +108,36 @@ struct b6_tref {
 	struct b6_tref *top; /**< pointer to parent reference */
 };
 
+/**
+ * @brief Hashed reference
+ * @see hashtable.h
+ */
+struct b6_href {
+	struct b6_href *ref; /**< pointer to the next reference in the bucket */
+	unsigned long int hash; /**< hash value of the element key */
+};
+
+/**
+ * @brief Compact double reference
+ *
+ * Compact references link elements stored in an array by their 1-based
+ * indices instead of pointers, 0 designating the container itself.
+ *
+ * @see clist.h
+ */
+struct b6_cdref {
+	unsigned int ref[2]; /**< indices of other elements */
+};
+
+/**
+ * @brief Compact triple reference
+ * @see ctree.h
+ */
+struct b6_ctref {
+	unsigned int ref[2]; /**< indices of children */
+	unsigned int top; /**< index of parent and 2-bit tag */
+};
+
 /**
  * @brief function for comparing two elements
  * @param l pointer to the left element
@@ -118,4 +148,11 @@ struct b6_tref {
  */
 typedef int (*b6_compare_t)(void *l, void *r);
 
+/**
+ * @brief function computing the hash value of a key
+ * @param key pointer to the key
+ * @return the hash value, which bits are all expected to be well mixed
+ */
+typedef unsigned long int (*b6_hash_t)(const void *key);
+
 #endif /* B6_REFS_H_ */
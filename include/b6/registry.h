@@ -11,8 +11,30 @@
 #ifndef B6_REGISTRY_H
 #define B6_REGISTRY_H
 
+#include "b6/art.h"
+#include "b6/hashtable.h"
 #include "b6/tree.h"
 
+struct b6_entry;
+
+/**
+ * @brief Perfect hash of the names of a frozen registry
+ *
+ * Entries are spread in buckets according to their hash. Each bucket has a
+ * seed, chosen when freezing so that the entries of all buckets land in
+ * distinct slots (compress, hash and displace). There are about 3% more slots
+ * than entries, so that the last buckets placed still find free slots
+ * quickly.
+ */
+struct b6_frozen_registry {
+	struct b6_allocator *allocator; /**< allocator of this structure */
+	unsigned long int length; /**< number of slots */
+	unsigned long int buckets; /**< number of buckets */
+	unsigned long int thawed; /**< entries registered since frozen */
+	unsigned int *seeds; /**< seed of each bucket */
+	struct b6_entry *slots[]; /**< entries at their perfect hash */
+};
+
 /**
  * @brief A registry stores named entries and allows quick lookups by name.
  *
@@ -40,7 +62,13 @@
  * @endcode
  */
 struct b6_registry {
-	struct b6_tree tree;
+	struct b6_tree tree; /**< entries ordered by hash and name */
+	struct b6_hashtable table; /**< entries hashed by name */
+	struct b6_art trie; /**< entries sorted by name */
+	struct b6_frozen_registry *frozen; /**< perfect hash, if any */
+	unsigned char hashed; /**< lookups go through table */
+	unsigned char ordered; /**< entries are kept in tree */
+	unsigned char prefixed; /**< entries are kept in trie */
 };
 
 /**
@@ -68,10 +96,17 @@ struct b6_registry {
  *   }
  * }
  * @endcode
+ *
+ * Registries keeping their entries ordered are traveled in the same order
+ * every time, whatever the order of registration. So are registries indexed
+ * by a trie, which are traveled in lexicographic order of names. Otherwise,
+ * the order depends on the history of the hash table.
  */
 struct b6_registry_iterator {
-	const struct b6_tree *tree;
+	const struct b6_registry *registry;
 	const struct b6_tref *tref;
+	const struct b6_href *href;
+	struct b6_art_iterator trie;
 };
 
 /**
@@ -79,15 +114,25 @@ struct b6_registry_iterator {
  */
 struct b6_entry {
 	struct b6_tref tref;
-	unsigned int hash;
-	const char *name;
+	struct b6_href href;
+	unsigned long int hash;
+	union {
+		struct b6_aref aref; /**< the name as indexed by tries */
+		struct {
+			const char *name;
+			unsigned long int length;
+		};
+	};
 };
 
 /**
  * @brief Define a registry.
  */
 #define B6_REGISTRY_DEFINE(registry) \
-	struct b6_registry registry = { B6_TREE_INIT(&b6_tree_rb_ops), }
+	struct b6_registry registry = { \
+		.tree = B6_TREE_INIT(&b6_tree_rb_ops), \
+		.ordered = 1, \
+	}
 
 /**
  * @brief Initialize a registry.
@@ -96,36 +141,144 @@ struct b6_entry {
 static inline void b6_setup_registry(struct b6_registry *self)
 {
 	b6_tree_initialize(&self->tree, &b6_tree_rb_ops);
+	self->frozen = NULL;
+	self->hashed = 0;
+	self->ordered = 1;
+	self->prefixed = 0;
 }
 
+/**
+ * @brief Look entries of a registry up through a hash table.
+ *
+ * Registries are binary search trees initially, which do not require any
+ * memory allocation, so that they can be populated from constructors. This
+ * function moves their entries to a hash table, making lookups O(1) on
+ * average. It can be called at any time, e.g. once the program has set up its
+ * allocator, but only once.
+ *
+ * @param self specifies the registry.
+ * @param allocator specifies the allocator of the buckets of the hash table.
+ * @param ordered specifies whether entries should remain in the tree too, so
+ * that registry iterators keep on traveling them in a stable order, at the
+ * expense of slower registrations. It has no effect if entries have already
+ * left the tree for a trie.
+ * @return 0 for success
+ * @return -1 when out of memory, in which case the registry is left unchanged
+ */
+extern int b6_hash_registry(struct b6_registry *self,
+			    struct b6_allocator *allocator, int ordered);
+
+/**
+ * @brief Index the entries of a registry by a trie of their names.
+ *
+ * Entries leave the tree for an adaptive radix trie, which keeps them in
+ * lexicographic order. The registry can then be traveled by prefix, e.g. to
+ * list every entry whose name starts with "pool.", without scanning all
+ * entries. Lookups go through the trie too, unless the registry is hashed.
+ * Like b6_hash_registry, this function can be called only once.
+ *
+ * @param self specifies the registry.
+ * @param allocator specifies the allocator of the nodes of the trie.
+ * @return 0 for success
+ * @return -1 when out of memory, in which case the registry is left unchanged
+ * @see b6_setup_registry_prefix_iterator
+ */
+extern int b6_trie_registry(struct b6_registry *self,
+			    struct b6_allocator *allocator);
+
+/**
+ * @brief Build a perfect hash of the names of a registry.
+ *
+ * Registries populated at startup and seldom modified afterwards can be
+ * frozen: looking a name up then takes a single probe and a single string
+ * comparison. The registry remains mutable. Entries registered later are
+ * found through the regular index, after the perfect hash has missed.
+ * Freezing again takes them into account.
+ *
+ * @complexity O(n) on average
+ * @param self specifies the registry.
+ * @param allocator specifies the allocator of the perfect hash.
+ * @return 0 for success
+ * @return -1 when out of memory
+ * @return -2 if no perfect hash could be found, which happens when two
+ * names share the same hash value
+ */
+extern int b6_freeze_registry(struct b6_registry *self,
+			      struct b6_allocator *allocator);
+
+/**
+ * @brief Release the perfect hash of a frozen registry.
+ * @param self specifies the registry.
+ */
+extern void b6_thaw_registry(struct b6_registry *self);
+
+/**
+ * @internal
+ */
+extern struct b6_entry *b6_search_frozen_registry(const struct b6_registry*,
+						  unsigned long int,
+						  unsigned long int,
+						  const char*);
+
 /**
  * @internal
  */
-extern struct b6_entry *b6_search_registry(struct b6_registry*, unsigned int,
+extern struct b6_entry *b6_search_registry(struct b6_registry*,
+					   unsigned long int, unsigned long int,
 					   const char*, struct b6_tref**, int*);
 
 /**
  * @internal
  */
-extern unsigned int b6_compute_registry_hash(const char*);
+extern struct b6_entry *b6_search_hashed_registry(const struct b6_registry*,
+						  unsigned long int,
+						  unsigned long int,
+						  const char*);
+
+/**
+ * @brief Compute the hash value of a name as registries do.
+ *
+ * Callers looking the same name up repeatedly can compute its hash value once
+ * and then use b6_register_hashed or b6_lookup_registry_hashed.
+ *
+ * @param name specifies the name.
+ * @param length specifies where to store the length of the name.
+ * @return the hash value.
+ */
+extern unsigned long int b6_compute_registry_hash(const char *name,
+						  unsigned long int *length);
+
+/**
+ * @brief Add an entry to a registry given the hash value of its name.
+ * @param self specifies the registry to populate.
+ * @param entry specifies the entry to add.
+ * @param name specifies the name of the entry.
+ * @param hash specifies the hash value of name.
+ * @param length specifies the length of name.
+ * @return 0 for success.
+ * @return -1 if an entry has already been registered with the same name.
+ * @return -2 when out of memory.
+ * @see b6_compute_registry_hash
+ */
+extern int b6_register_hashed(struct b6_registry *self,
+			      struct b6_entry *entry, const char *name,
+			      unsigned long int hash, unsigned long int length);
 
 /**
  * @brief Add an entry to a registry.
  * @param self specifies the registry to populate.
  * @param entry specifies the entry to add.
  * @param name specifies the name of the entry.
+ * @return 0 for success.
+ * @return -1 if an entry has already been registered with the same name.
+ * @return -2 when out of memory.
  */
 static inline int b6_register(struct b6_registry *self, struct b6_entry *entry,
 			      const char *name)
 {
-	struct b6_tref *top;
-	int dir;
-	entry->hash = b6_compute_registry_hash(name);
-	entry->name = name;
-	if (b6_search_registry(self, entry->hash, entry->name, &top, &dir))
-		return -1;
-	b6_tree_add(&self->tree, top, dir, &entry->tref);
-	return 0;
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(name, &length);
+	return b6_register_hashed(self, entry, name, hash, length);
 }
 
 /**
@@ -134,12 +287,37 @@ static inline int b6_register(struct b6_registry *self, struct b6_entry *entry,
  * @param self specifies the registry.
  * @param entry specifies the entry to remove.
  */
-static inline void b6_unregister(struct b6_registry *self,
-				 struct b6_entry *entry)
+extern void b6_unregister(struct b6_registry *self, struct b6_entry *entry);
+
+/**
+ * @brief Find a registry entry by name given the hash value of the name.
+ * @param self specifies the registry to search.
+ * @param name specifies the name of the entry to find.
+ * @param hash specifies the hash value of name.
+ * @param length specifies the length of name.
+ * @return a pointer to the entry.
+ * @return NULL if no entry with such a name was found.
+ * @see b6_compute_registry_hash
+ */
+static inline struct b6_entry *b6_lookup_registry_hashed(
+	struct b6_registry *self, const char *name, unsigned long int hash,
+	unsigned long int length)
 {
+	struct b6_entry *entry;
+	struct b6_tref *top;
 	int dir;
-	struct b6_tref *top = b6_tree_parent(&entry->tref, &dir);
-	b6_tree_del(&self->tree, top, dir);
+	if (self->frozen) {
+		entry = b6_search_frozen_registry(self, hash, length, name);
+		if (entry || !self->frozen->thawed)
+			return entry;
+	}
+	if (self->hashed)
+		return b6_search_hashed_registry(self, hash, length, name);
+	if (self->prefixed) {
+		struct b6_aref *aref = b6_art_find(&self->trie, name, length);
+		return aref ? b6_cast_of(aref, struct b6_entry, aref) : NULL;
+	}
+	return b6_search_registry(self, hash, length, name, &top, &dir);
 }
 
 /**
@@ -152,10 +330,9 @@ static inline void b6_unregister(struct b6_registry *self,
 static inline struct b6_entry *b6_lookup_registry(struct b6_registry *self,
 						  const char *name)
 {
-	struct b6_tref *top;
-	int dir;
-	return b6_search_registry(self, b6_compute_registry_hash(name), name,
-				  &top, &dir);
+	unsigned long int length;
+	unsigned long int hash = b6_compute_registry_hash(name, &length);
+	return b6_lookup_registry_hashed(self, name, hash, length);
 }
 
 /**
@@ -166,8 +343,39 @@ static inline struct b6_entry *b6_lookup_registry(struct b6_registry *self,
 static inline void b6_setup_registry_iterator(struct b6_registry_iterator *self,
 					      const struct b6_registry *reg)
 {
-	self->tree = &reg->tree;
-	self->tref = b6_tree_first(&reg->tree);
+	self->registry = reg;
+	self->tref = NULL;
+	self->href = NULL;
+	self->trie.art = NULL;
+	if (reg->ordered)
+		self->tref = b6_tree_first(&reg->tree);
+	else if (reg->prefixed)
+		b6_setup_art_iterator(&self->trie, &reg->trie, NULL);
+	else
+		self->href = b6_hashtable_first(&reg->table);
+}
+
+/**
+ * @brief Initialize an iterator over the entries whose name starts with a
+ * given prefix.
+ *
+ * Entries are traveled in lexicographic order of names.
+ *
+ * @pre The registry must be indexed by a trie.
+ * @param self specifies the iterator.
+ * @param reg specifies the registry to travel.
+ * @param prefix specifies the prefix.
+ * @see b6_trie_registry
+ */
+static inline void b6_setup_registry_prefix_iterator(
+	struct b6_registry_iterator *self, const struct b6_registry *reg,
+	const char *prefix)
+{
+	b6_precond(reg->prefixed);
+	self->registry = reg;
+	self->tref = NULL;
+	self->href = NULL;
+	b6_setup_art_iterator(&self->trie, &reg->trie, prefix);
 }
 
 /**
@@ -179,10 +387,20 @@ static inline void b6_setup_registry_iterator(struct b6_registry_iterator *self,
 static inline const struct b6_entry *b6_get_next_registry_iterator(
 	struct b6_registry_iterator *self)
 {
+	const struct b6_tree *tree = &self->registry->tree;
 	struct b6_entry *entry = NULL;
-	if (self->tref != b6_tree_tail(self->tree)) {
+	if (self->href) {
+		entry = b6_cast_of(self->href, struct b6_entry, href);
+		self->href = b6_hashtable_next(&self->registry->table,
+					       self->href);
+	} else if (self->tref && self->tref != b6_tree_tail(tree)) {
 		entry = b6_cast_of(self->tref, struct b6_entry, tref);
-		self->tref = b6_tree_walk(self->tree, self->tref, B6_NEXT);
+		self->tref = b6_tree_walk(tree, self->tref, B6_NEXT);
+	} else if (self->trie.art) {
+		const struct b6_aref *aref =
+			b6_get_next_art_iterator(&self->trie);
+		if (aref)
+			entry = b6_cast_of(aref, struct b6_entry, aref);
 	}
 	return entry;
 }
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file rope.h
+ *
+ * @brief Sequence of items supporting edits in the middle
+ *
+ * A rope stores a sequence of fixed-size items in leaves holding a few of
+ * them contiguously. Leaves are linked in a splay tree ordered by position:
+ * each leaf records the number of items in its subtree so that the leaf
+ * holding the item at a given index can be found without any key. Accessing,
+ * inserting or erasing items at any index, as well as splitting or
+ * concatenating ropes, are O(log(n)) amortized, plus the cost of moving the
+ * items within the leaves involved.
+ *
+ * As splay trees move recently accessed leaves to the root, traveling a rope
+ * in order with b6_rope_at is O(1) amortized per leaf.
+ *
+ * Leaves are allocated from a pool which object size decides how many items
+ * fit in a leaf. Ropes split from or concatenated with each other must share
+ * the same pool and item size.
+ *
+ * @code
+ * struct b6_pool pool;
+ * struct b6_rope rope;
+ *
+ * b6_pool_initialize(&pool, allocator, B6_ROPE_LEAF_SIZE(1, 256), 0);
+ * b6_rope_initialize(&rope, &pool, 1);
+ * b6_rope_insert(&rope, 0, "world", 5);
+ * b6_rope_insert(&rope, 0, "hello ", 6);
+ * ...
+ * b6_rope_finalize(&rope);
+ * b6_pool_finalize(&pool);
+ * @endcode
+ */
+
+#ifndef B6_ROPE_H_
+#define B6_ROPE_H_
+
+#include "pool.h"
+#include "splay.h"
+
+/**
+ * @brief Leaf of a rope
+ *
+ * Items are stored right after the leaf header.
+ */
+struct b6_rope_leaf {
+	struct b6_dref dref; /**< links within the splay tree */
+	unsigned long int size; /**< number of items in the subtree */
+	unsigned long int length; /**< number of items in the leaf */
+};
+
+/**
+ * @brief Size of pool objects for leaves holding up to n items
+ * @param itemsize specifies the size in bytes of an item.
+ * @param n specifies the maximum number of items per leaf.
+ */
+#define B6_ROPE_LEAF_SIZE(itemsize, n) \
+	(sizeof(struct b6_rope_leaf) + (itemsize) * (n))
+
+/**
+ * @brief Rope
+ */
+struct b6_rope {
+	struct b6_splay splay; /**< leaves ordered by position */
+	struct b6_pool *pool; /**< allocator of leaves */
+	unsigned int itemsize; /**< size in bytes of an item */
+	unsigned long int capacity; /**< maximum number of items per leaf */
+};
+
+/**
+ * @brief Initialize an empty rope
+ * @param self specifies the rope.
+ * @param pool specifies the pool to allocate leaves from.
+ * @param itemsize specifies the size in bytes of an item.
+ * @return 0 for success
+ * @return -1 if itemsize is zero or objects of the pool cannot hold an item
+ */
+extern int b6_rope_initialize(struct b6_rope *self, struct b6_pool *pool,
+			      unsigned int itemsize);
+
+/**
+ * @brief Give every leaf of a rope back to its pool
+ * @complexity O(n)
+ * @param self specifies the rope, which is left empty.
+ */
+extern void b6_rope_finalize(struct b6_rope *self);
+
+/**
+ * @brief Return the number of items in a rope
+ * @complexity O(1)
+ * @param self specifies the rope.
+ */
+static inline unsigned long int b6_rope_length(const struct b6_rope *self)
+{
+	const struct b6_dref *root = b6_splay_root(&self->splay);
+	return root ? b6_cast_of(root, struct b6_rope_leaf, dref)->size : 0UL;
+}
+
+/**
+ * @brief Access the item at a given index
+ * @complexity O(log(n)) amortized
+ * @param self specifies the rope.
+ * @param index specifies the index of the item (first is 0).
+ * @param count specifies where to store how many items are contiguous in
+ * memory from the one returned (may be NULL).
+ * @return a pointer to the item, which remains valid until the rope is
+ * modified.
+ * @return NULL if index is out of the bounds of the rope.
+ */
+extern void *b6_rope_at(struct b6_rope *self, unsigned long int index,
+			unsigned long int *count);
+
+/**
+ * @brief Insert items at a given index
+ * @complexity O(log(n) + m) amortized for m items
+ * @param self specifies the rope.
+ * @param index specifies where to insert the items, up to the length of the
+ * rope to append them.
+ * @param items specifies the items to copy in the rope.
+ * @param n specifies the number of items.
+ * @return 0 for success
+ * @return -1 if index is greater than the length of the rope
+ * @return -2 when out of memory, in which case the rope is left unchanged
+ */
+extern int b6_rope_insert(struct b6_rope *self, unsigned long int index,
+			  const void *items, unsigned long int n);
+
+/**
+ * @brief Remove a range of items
+ * @complexity O(log(n)) amortized plus the number of leaves released
+ * @param self specifies the rope.
+ * @param index specifies the index of the first item to remove.
+ * @param n specifies the number of items to remove.
+ * @return the number of items actually removed, less than n when the range
+ * goes past the end of the rope.
+ */
+extern unsigned long int b6_rope_erase(struct b6_rope *self,
+				       unsigned long int index,
+				       unsigned long int n);
+
+/**
+ * @brief Move the items from a given index on to another rope
+ * @complexity O(log(n)) amortized
+ * @pre other is empty and shares the pool and item size of self.
+ * @param self specifies the rope to split.
+ * @param index specifies the index of the first item to move.
+ * @param other specifies the rope to move the items to.
+ * @return 0 for success
+ * @return -1 if index is greater than the length of the rope
+ * @return -2 when out of memory
+ */
+extern int b6_rope_split(struct b6_rope *self, unsigned long int index,
+			 struct b6_rope *other);
+
+/**
+ * @brief Move every item of a rope to the end of another one
+ * @complexity O(log(n)) amortized
+ * @pre other shares the pool and item size of self.
+ * @param self specifies the rope to append the items to.
+ * @param other specifies the rope to take the items from, left empty.
+ */
+extern void b6_rope_concat(struct b6_rope *self, struct b6_rope *other);
+
+#endif /* B6_ROPE_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file skiplist.h
+ *
+ * @brief Concurrent skip list ordered map
+ *
+ * Skip lists are ordered linked lists where elements get randomly linked at
+ * several levels so that searching them is expected to run in O(log(n)).
+ *
+ * This implementation is the lazy skip list of Herlihy, Lev, Luchangco and
+ * Shavit. Lookups and iterations take no lock and never retry: they are
+ * wait-free, entering the epoch included (see epoch.h). Insertions and
+ * removals lock the predecessors of the element at each level it is linked
+ * to, so that concurrent updates in distinct parts of the map do not
+ * contend. An element is first marked as removed, then unlinked, then retired
+ * to an epoch (see epoch.h) which releases it to the allocator once no reader
+ * can access it anymore.
+ *
+ * Unlike other containers in this library, skip lists allocate their own
+ * nodes. The allocator must be safe to call from any thread.
+ */
+
+#ifndef B6_SKIPLIST_H_
+#define B6_SKIPLIST_H_
+
+#include "allocator.h"
+#include "epoch.h"
+#include "refs.h"
+#include "spinlock.h"
+
+/**
+ * @brief Maximum number of levels of a skip list node.
+ */
+#define B6_SKIPLIST_HEIGHT 24
+
+/**
+ * @brief Skip list node
+ */
+struct b6_skipnode {
+	struct b6_sref sref; /**< link while waiting for reclamation */
+	void *key; /**< key the map is ordered by */
+	void *value; /**< value associated with the key */
+	struct b6_spinlock lock; /**< serializes updates of next */
+	int marked; /**< true when removed */
+	int linked; /**< true when linked at every level */
+	unsigned int height; /**< number of levels */
+	struct b6_skipnode *next[]; /**< successors per level */
+};
+
+/**
+ * @brief Skip list
+ */
+struct b6_skiplist {
+	struct b6_skipnode *head; /**< sentinel linked at every level */
+	b6_compare_t compare; /**< keys comparator */
+	struct b6_allocator *allocator; /**< nodes allocator */
+	struct b6_epoch epoch; /**< readers tracker */
+};
+
+/**
+ * @brief Skip list iterator
+ *
+ * An iterator protects the nodes it travels from reclamation until it is
+ * finalized. It must not be used across updates of the skip list by the same
+ * thread.
+ */
+struct b6_skiplist_iterator {
+	struct b6_skiplist *list; /**< skip list to travel */
+	struct b6_skipnode *node; /**< current node */
+	unsigned long int *epoch; /**< epoch token */
+};
+
+/**
+ * @brief Initialize a skip list
+ * @param self specifies the skip list.
+ * @param allocator specifies the allocator of nodes.
+ * @param compare specifies the function to call back to compare keys.
+ * @return 0 for success
+ * @return -1 when out of memory
+ */
+extern int b6_skiplist_initialize(struct b6_skiplist *self,
+				  struct b6_allocator *allocator,
+				  b6_compare_t compare);
+
+/**
+ * @brief Release every node of a skip list
+ * @pre No other thread must access the skip list.
+ * @param self specifies the skip list.
+ */
+extern void b6_skiplist_finalize(struct b6_skiplist *self);
+
+/**
+ * @brief Find the value associated with a key
+ * @complexity O(log(n)) expected, wait-free
+ * @param self specifies the skip list.
+ * @param key specifies the key to look for.
+ * @param value specifies where to store the value found (may be NULL).
+ * @return 0 if the key was found
+ * @return -1 otherwise
+ */
+extern int b6_skiplist_lookup(struct b6_skiplist *self, void *key,
+			      void **value);
+
+/**
+ * @brief Associate a value with a new key
+ * @complexity O(log(n)) expected
+ * @param self specifies the skip list.
+ * @param key specifies the key.
+ * @param value specifies the value.
+ * @return 0 for success
+ * @return -1 if the key is already in the skip list
+ * @return -2 when out of memory
+ */
+extern int b6_skiplist_insert(struct b6_skiplist *self, void *key,
+			      void *value);
+
+/**
+ * @brief Remove a key from a skip list
+ * @complexity O(log(n)) expected
+ * @param self specifies the skip list.
+ * @param key specifies the key.
+ * @param value specifies where to store the value associated with the key
+ * (may be NULL).
+ * @return 0 for success
+ * @return -1 if the key was not found
+ */
+extern int b6_skiplist_remove(struct b6_skiplist *self, void *key,
+			      void **value);
+
+/**
+ * @brief Start traveling a skip list in order
+ * @param self specifies the iterator.
+ * @param list specifies the skip list.
+ */
+static inline void b6_setup_skiplist_iterator(
+	struct b6_skiplist_iterator *self, struct b6_skiplist *list)
+{
+	self->list = list;
+	self->epoch = b6_enter_epoch(&list->epoch);
+	self->node = list->head;
+}
+
+/**
+ * @brief Get the next node from the iteration
+ *
+ * Keys inserted or removed concurrently may or may not be reported. Keys are
+ * always reported in increasing order.
+ *
+ * @param self specifies the iterator.
+ * @return a pointer to the node which key and value can be read.
+ * @return NULL if the end of the skip list has been reached.
+ */
+static inline const struct b6_skipnode *b6_get_next_skiplist_iterator(
+	struct b6_skiplist_iterator *self)
+{
+	struct b6_skipnode *node = self->node;
+	if (node)
+		do node = __atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE);
+		while (node && __atomic_load_n(&node->marked, __ATOMIC_ACQUIRE));
+	return self->node = node;
+}
+
+/**
+ * @brief Stop traveling a skip list
+ * @param self specifies the iterator.
+ */
+static inline void b6_finalize_skiplist_iterator(
+	struct b6_skiplist_iterator *self)
+{
+	b6_leave_epoch(&self->list->epoch, self->epoch);
+}
+
+#endif /* B6_SKIPLIST_H_ */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file spinlock.h
+ * @brief Busy-waiting mutual exclusion.
+ */
+
+#ifndef B6_SPINLOCK_H_
+#define B6_SPINLOCK_H_
+
+/**
+ * @brief Hint the processor that the calling thread is busy waiting.
+ */
+static inline void b6_cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief A spinlock is a lock which makes threads busy wait until it is
+ * released.
+ *
+ * Spinlocks are suitable to protect very short critical sections only.
+ */
+struct b6_spinlock {
+	int locked; /**< non-zero when held */
+};
+
+#define B6_SPINLOCK_INIT { 0 }
+
+/**
+ * @brief Initialize a spinlock in the released state.
+ * @param self specifies the spinlock.
+ */
+static inline void b6_reset_spinlock(struct b6_spinlock *self)
+{
+	__atomic_store_n(&self->locked, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Try to acquire a spinlock without waiting.
+ * @param self specifies the spinlock.
+ * @return true if the spinlock was acquired.
+ */
+static inline int b6_try_spin_lock(struct b6_spinlock *self)
+{
+	return !__atomic_exchange_n(&self->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Acquire a spinlock.
+ * @param self specifies the spinlock.
+ */
+static inline void b6_spin_lock(struct b6_spinlock *self)
+{
+	while (!b6_try_spin_lock(self))
+		while (__atomic_load_n(&self->locked, __ATOMIC_RELAXED))
+			b6_cpu_relax();
+}
+
+/**
+ * @brief Release a spinlock.
+ * @param self specifies the spinlock.
+ */
+static inline void b6_spin_unlock(struct b6_spinlock *self)
+{
+	__atomic_store_n(&self->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* B6_SPINLOCK_H_ */
@@ -9,6 +9,7 @@
 #include "refs.h"
 #include "utils.h"
 #include "assert.h"
+#include "stats.h"
 
 /**
  * @file splay.h
@@ -33,6 +34,9 @@
  */
 struct b6_splay {
 	struct b6_dref dref; /**< sentinel */
+#ifdef B6_STATS
+	struct b6_counters counters; /**< operation counters */
+#endif
 };
 
 /**
@@ -40,6 +44,13 @@ struct b6_splay {
  */
 #define __b6_splay_root(splay) (splay)->dref.ref[0]
 
+/**
+ * @internal
+ */
+#define __b6_splay_cmp(_splay, _cmp, _ref, _arg)			\
+	(b6_count(_splay, comparisons, 1), b6_count(_splay, depth, 1),	\
+	 _cmp(_ref, _arg))
+
 /**
  * @internal
  */
@@ -72,6 +83,7 @@ static inline struct b6_dref *__b6_splay_from_thread(const struct b6_dref *dref)
 static inline void b6_splay_initialize(struct b6_splay *splay)
 {
 	__b6_splay_root(splay) = NULL;
+	__b6_reset_counters(__b6_counters_of(splay));
 }
 
 /**
@@ -113,7 +125,7 @@ static inline struct b6_dref *b6_splay_add_nothread(struct b6_splay *splay,
 						    int dir,
 						    struct b6_dref *ref)
 {
-	if (b6_splay_empty(splay)) {
+	if (!b6_splay_empty(splay)) {
 		struct b6_dref *top = b6_splay_root(splay);
 		int opp = b6_to_opposite(dir);
 		ref->ref[opp] = top;
@@ -158,29 +170,35 @@ static inline struct b6_dref *b6_splay_del_nothread(struct b6_splay *splay)
 
 #define b6_splay_search_nothread(_splay, _dir, _cmp, _arg)		\
 	( {								\
+		__label__ done;						\
 		struct b6_dref bak, *lnk[] = { &bak, &bak };		\
 		struct b6_dref *swp, *top = b6_splay_root(_splay);	\
 		int dir = B6_NEXT, opp = B6_PREV, res = 1, tmp;		\
 									\
+		b6_count(_splay, searches, 1);				\
 		if (b6_splay_empty(_splay))				\
 			goto done;					\
 									\
-		for (res = _cmp(top, _arg); res; top = top->ref[dir]) { \
+		for (res = __b6_splay_cmp(_splay, _cmp, top, _arg); res; \
+		     top = top->ref[dir]) {				\
 			opp = b6_to_direction(res);			\
 			dir = b6_to_opposite(opp);			\
 			if (!top->ref[dir])				\
 				break;					\
 									\
 			tmp = res;					\
-			res = _cmp(top->ref[dir], _arg);		\
+			res = __b6_splay_cmp(_splay, _cmp, top->ref[dir], \
+					     _arg);			\
 			if (res == tmp) {				\
 				swp = top->ref[dir];			\
 				top->ref[dir] = swp->ref[opp];		\
 				swp->ref[opp] = top;			\
+				b6_count(_splay, rotations, 1);		\
 				top = swp;				\
 				if (!top->ref[dir])			\
 					break;				\
-				res = _cmp(top->ref[dir], _arg);	\
+				res = __b6_splay_cmp(_splay, _cmp,	\
+						     top->ref[dir], _arg); \
 			}						\
 									\
 			lnk[opp]->ref[dir] = top;			\
@@ -356,21 +374,25 @@ done:
  */
 #define b6_splay_search(_splay, _dir, _cmp, _arg)			\
 	( {								\
+		__label__ done;						\
 		struct b6_dref bak, *lnk[] = { &bak, &bak };		\
 		struct b6_dref *swp, *top = b6_splay_root(_splay);	\
 		int dir = B6_NEXT, opp = B6_PREV, res = 1, tmp;		\
 									\
+		b6_count(_splay, searches, 1);				\
 		if (b6_splay_empty(_splay))				\
 			goto done;					\
 									\
-		for (res = _cmp(top, _arg); res; top = top->ref[dir]) { \
+		for (res = __b6_splay_cmp(_splay, _cmp, top, _arg); res; \
+		     top = top->ref[dir]) {				\
 			opp = b6_to_direction(res);			\
 			dir = b6_to_opposite(opp);			\
 			if (__b6_splay_is_thread(top->ref[dir]))	\
 				break;					\
 									\
 			tmp = res;					\
-			res = _cmp(top->ref[dir], _arg);		\
+			res = __b6_splay_cmp(_splay, _cmp, top->ref[dir], \
+					     _arg);			\
 			if (res == tmp) {				\
 				swp = top->ref[dir];			\
 				if (__b6_splay_is_thread(swp->ref[opp])) \
@@ -379,10 +401,12 @@ done:
 				else					\
 					top->ref[dir] = swp->ref[opp];	\
 				swp->ref[opp] = top;			\
+				b6_count(_splay, rotations, 1);		\
 				top = swp;				\
 				if (__b6_splay_is_thread(top->ref[dir])) \
 					break;				\
-				res = _cmp(top->ref[dir], _arg);	\
+				res = __b6_splay_cmp(_splay, _cmp,	\
+						     top->ref[dir], _arg); \
 			}						\
 									\
 			lnk[opp]->ref[dir] = top;			\
@@ -392,8 +416,11 @@ done:
 		if (__b6_splay_to_thread(lnk[opp]) != top->ref[opp])	\
 			lnk[opp]->ref[dir] = top->ref[opp];		\
 		else							\
-			lnk[opp]->ref[dir] = __b6_splay_to_thread(top); \
-		lnk[dir]->ref[opp] = top->ref[dir];			\
+			lnk[opp]->ref[dir] = __b6_splay_to_thread(top);	\
+		if (__b6_splay_to_thread(lnk[dir]) != top->ref[dir])	\
+			lnk[dir]->ref[opp] = top->ref[dir];		\
+		else							\
+			lnk[dir]->ref[opp] = __b6_splay_to_thread(top);	\
 		top->ref[B6_PREV] = bak.ref[B6_NEXT];			\
 		top->ref[B6_NEXT] = bak.ref[B6_PREV];			\
 									\
@@ -403,4 +430,303 @@ done:
 		res;							\
 	} )
 
+/**
+ * @internal
+ */
+#define __b6_splay_lookup(_splay, _cmp, _arg, _depth)			\
+	( {								\
+		struct b6_dref *__ref = b6_splay_root(_splay);		\
+		unsigned int __depth = 0;				\
+		int __res;						\
+									\
+		while (__ref && !__b6_splay_is_thread(__ref)) {		\
+			if (!(__res = _cmp(__ref, _arg)))		\
+				break;					\
+			__ref = __ref->ref[__res > 0 ? B6_PREV : B6_NEXT]; \
+			__depth += 1;					\
+		}							\
+		if (__ref && __b6_splay_is_thread(__ref))		\
+			__ref = NULL;					\
+		(_depth) = __depth;					\
+		__ref;							\
+	} )
+
+/**
+ * @brief Search a splay tree without modifying it
+ *
+ * This is a plain binary search: elements are not moved at all. As such, it
+ * can run concurrently with other lookups, e.g. under a read lock. It works
+ * with both threaded and non-threaded splay trees.
+ *
+ * @complexity O(depth of the element)
+ * @param _splay pointer to the splay tree
+ * @param _cmp function comparing a reference with _arg, as for b6_splay_search
+ * @param _arg opaque data to pass to _cmp
+ * @return the reference of the element found or NULL
+ */
+#define b6_splay_lookup(_splay, _cmp, _arg)				\
+	( {								\
+		unsigned int __b6_depth;				\
+		struct b6_dref *__b6_ref =				\
+			__b6_splay_lookup(_splay, _cmp, _arg, __b6_depth); \
+		(void)__b6_depth;					\
+		__b6_ref;						\
+	} )
+
+/**
+ * @brief Conditions under which b6_splay_find restructures a splay tree
+ *
+ * Splaying on every access rewrites links along the search path, even when
+ * the tree is already well-shaped for the workload. With a policy, elements
+ * are only moved to the root when found deep enough within the tree, or from
+ * time to time. Read-mostly workloads keep most of the adaptivity of splay
+ * trees with far fewer writes.
+ *
+ * Semi-splaying goes further: it performs a single rotation for each pair of
+ * steps going the same way and leaves the element half way up, which roughly
+ * halves the depth of the nodes along the path with half the rotations.
+ */
+struct b6_splay_policy {
+	unsigned int depth; /**< splay elements found at least this deep */
+	unsigned int period; /**< also splay one access out of period, or 0 */
+	unsigned int count; /**< accesses since last sampled splaying */
+	int semi; /**< semi-splay instead of splaying to the root */
+};
+
+/**
+ * @brief Set up a splaying policy
+ * @param self specifies the policy.
+ * @param depth specifies the depth from which elements found get splayed. 0
+ * makes the policy equivalent to splaying on every access.
+ * @param period specifies that one access out of period gets splayed
+ * whatever the depth, 0 disabling sampling.
+ */
+static inline void b6_setup_splay_policy(struct b6_splay_policy *self,
+					 unsigned int depth,
+					 unsigned int period)
+{
+	self->depth = depth;
+	self->period = period;
+	self->count = 0;
+	self->semi = 0;
+}
+
+/**
+ * @brief Set up a semi-splaying policy
+ * @see b6_setup_splay_policy
+ */
+static inline void b6_setup_semi_splay_policy(struct b6_splay_policy *self,
+					      unsigned int depth,
+					      unsigned int period)
+{
+	b6_setup_splay_policy(self, depth, period);
+	self->semi = 1;
+}
+
+/**
+ * @internal
+ */
+static inline int __b6_splay_should_splay(struct b6_splay_policy *self,
+					  unsigned int depth)
+{
+	if (depth >= self->depth)
+		return 1;
+	if (self->period && ++self->count >= self->period) {
+		self->count = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Maximum depth up to which b6_splay_find records its search path
+ */
+#define B6_SPLAY_PATH 64
+
+/**
+ * @internal
+ * @brief Splay or semi-splay the element at the end of a search path
+ * @param path holds the sentinel of the tree then each node from the root to
+ * the element.
+ * @param depth specifies the depth of the element.
+ * @param semi tells whether to semi-splay.
+ */
+extern void __b6_splay_raise(struct b6_dref **path, unsigned int depth,
+			     int semi);
+
+/**
+ * @internal
+ */
+#define __b6_splay_trace(_splay, _cmp, _arg, _path, _depth)		\
+	( {								\
+		struct b6_dref *__ref = b6_splay_root(_splay);		\
+		unsigned int __depth = 0;				\
+		int __res;						\
+									\
+		(_path)[0] = &(_splay)->dref;				\
+		while (__ref && !__b6_splay_is_thread(__ref)) {		\
+			if (__depth < B6_SPLAY_PATH)			\
+				(_path)[__depth + 1] = __ref;		\
+			if (!(__res = _cmp(__ref, _arg)))		\
+				break;					\
+			__ref = __ref->ref[__res > 0 ? B6_PREV : B6_NEXT]; \
+			__depth += 1;					\
+		}							\
+		if (__ref && __b6_splay_is_thread(__ref))		\
+			__ref = NULL;					\
+		(_depth) = __depth;					\
+		__ref;							\
+	} )
+
+/**
+ * @brief Find an element in a threaded splay tree, splaying it on condition
+ *
+ * Unlike b6_splay_search, the tree is left untouched when the element cannot
+ * be found, so that the result is not suitable for inserting an element.
+ *
+ * The tree is walked once: the search path is recorded on the way down and,
+ * when the policy fires, the element is splayed or semi-splayed bottom-up
+ * along it without comparing again. Elements deeper than B6_SPLAY_PATH are
+ * splayed with b6_splay_search instead, which walks the path a second time;
+ * splaying them makes such paths short-lived.
+ *
+ * @param _splay pointer to the splay tree
+ * @param _cmp function comparing a reference with _arg, as for b6_splay_search
+ * @param _arg opaque data to pass to _cmp
+ * @param _policy pointer to the splaying policy
+ * @return the reference of the element found or NULL
+ */
+#define b6_splay_find(_splay, _cmp, _arg, _policy)			\
+	( {								\
+		struct b6_dref *__b6_path[B6_SPLAY_PATH + 1];		\
+		unsigned int __b6_depth;				\
+		int __b6_dir;						\
+		struct b6_dref *__b6_ref = __b6_splay_trace(_splay, _cmp, \
+							    _arg, __b6_path, \
+							    __b6_depth); \
+		if (__b6_ref &&						\
+		    __b6_splay_should_splay(_policy, __b6_depth)) {	\
+			if (__b6_depth < B6_SPLAY_PATH)			\
+				__b6_splay_raise(__b6_path, __b6_depth,	\
+						 (_policy)->semi);	\
+			else						\
+				b6_splay_search(_splay, __b6_dir, _cmp,	\
+						_arg);			\
+		}							\
+		(void)__b6_dir;						\
+		__b6_ref;						\
+	} )
+
+/**
+ * @brief Find an element in a non-threaded splay tree, splaying it on
+ * condition
+ * @see b6_splay_find
+ */
+#define b6_splay_find_nothread(_splay, _cmp, _arg, _policy)		\
+	( {								\
+		struct b6_dref *__b6_path[B6_SPLAY_PATH + 1];		\
+		unsigned int __b6_depth;				\
+		int __b6_dir;						\
+		struct b6_dref *__b6_ref = __b6_splay_trace(_splay, _cmp, \
+							    _arg, __b6_path, \
+							    __b6_depth); \
+		if (__b6_ref &&						\
+		    __b6_splay_should_splay(_policy, __b6_depth)) {	\
+			if (__b6_depth < B6_SPLAY_PATH)			\
+				__b6_splay_raise(__b6_path, __b6_depth,	\
+						 (_policy)->semi);	\
+			else						\
+				b6_splay_search_nothread(_splay, __b6_dir, \
+							 _cmp, _arg);	\
+		}							\
+		(void)__b6_dir;						\
+		__b6_ref;						\
+	} )
+
+/**
+ * @brief Split a threaded splay tree at its root
+ *
+ * The elements on one side of the root are moved to another splay tree. To
+ * split at a key, search the key first so that the root is the element equal
+ * or next to it.
+ *
+ * @complexity O(log(n)) amortized
+ * @pre other is empty
+ * @param splay pointer to the splay tree
+ * @param dir B6_NEXT (resp. B6_PREV) to move the elements greater (resp.
+ * smaller) than the root
+ * @param other pointer to the splay tree receiving the elements
+ */
+extern void b6_splay_split(struct b6_splay *splay, int dir,
+			   struct b6_splay *other);
+
+/**
+ * @brief Concatenate two threaded splay trees
+ * @complexity O(log(n)) amortized
+ * @pre Every element of splay is smaller than every element of other
+ * @param splay pointer to the splay tree receiving the elements
+ * @param other pointer to the splay tree of greater elements, left empty
+ */
+extern void b6_splay_join(struct b6_splay *splay, struct b6_splay *other);
+
+/**
+ * @brief Split a non-threaded splay tree at its root
+ * @complexity O(1)
+ * @see b6_splay_split
+ */
+extern void b6_splay_split_nothread(struct b6_splay *splay, int dir,
+				    struct b6_splay *other);
+
+/**
+ * @brief Concatenate two non-threaded splay trees
+ * @complexity O(log(n)) amortized
+ * @see b6_splay_join
+ */
+extern void b6_splay_join_nothread(struct b6_splay *splay,
+				   struct b6_splay *other);
+
+/**
+ * @brief Remove every element of a splay tree at once
+ *
+ * Elements are released one after the other in order, after they have been
+ * unlinked so that the function to call back is allowed to release their
+ * memory. No auxiliary memory is used: left children are rotated up until
+ * the smallest remaining element is at the top. The splay tree is left empty.
+ * This function supports both threaded and non-threaded splay trees.
+ *
+ * @complexity O(n)
+ * @param splay pointer to the splay tree
+ * @param release function to call back for every element removed or NULL
+ * @param arg opaque data to pass to release
+ */
+extern void b6_splay_clear(struct b6_splay *splay,
+			   void (*release)(struct b6_dref*, void*), void *arg);
+
+/**
+ * @brief Snapshot the counters and the shape of a threaded splay tree
+ *
+ * The tree is traveled along its threads, without recursion nor auxiliary
+ * memory. The balance histogram is left empty.
+ *
+ * @complexity O(n)
+ * @param splay pointer to the splay tree
+ * @param stats where to store the statistics
+ */
+extern void b6_splay_stats(const struct b6_splay *splay,
+			   struct b6_stats *stats);
+
+/**
+ * @brief Snapshot the counters and the shape of a non-threaded splay tree
+ *
+ * The tree is traveled in the manner of Morris, which links the greatest
+ * element of each previous subtree back to its root for the time of the
+ * traversal. The balance histogram is left empty.
+ *
+ * @complexity O(n)
+ * @param splay pointer to the splay tree
+ * @param stats where to store the statistics
+ */
+extern void b6_splay_stats_nothread(struct b6_splay *splay,
+				    struct b6_stats *stats);
+
 #endif /* B6_SPLAY_H_ */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file stats.h
+ *
+ * @brief Operation counters and shape statistics of containers
+ *
+ * When B6_STATS is defined, trees, splay trees, heaps and lists embed
+ * counters of the operations they run, so as to tell how a given instance
+ * behaves. As it changes the layout of containers, B6_STATS must be defined
+ * alike when building the library and the code using it, for instance with:
+ *
+ * @code
+ * make EXTRA_CFLAGS="-O0 -g3 -DB6_STATS"
+ * @endcode
+ *
+ * Regardless of B6_STATS, the b6_*_stats functions of each container snapshot
+ * its shape into a struct b6_stats, along with the counters if any.
+ */
+
+#ifndef B6_STATS_H_
+#define B6_STATS_H_
+
+/**
+ * @brief Counters of the operations run on a container
+ */
+struct b6_counters {
+	unsigned long int searches; /**< searches started */
+	unsigned long int depth; /**< nodes visited by all searches */
+	unsigned long int comparisons; /**< calls to comparison functions */
+	unsigned long int rotations; /**< tree rotations */
+	unsigned long int sifts; /**< heap items moved one level */
+};
+
+/**
+ * @brief Number of buckets of the balance histogram on each side of zero
+ */
+#define B6_STATS_BALANCE 2
+
+/**
+ * @brief Snapshot of the counters and of the shape of a container
+ */
+struct b6_stats {
+	struct b6_counters counters; /**< zero unless B6_STATS is defined */
+	unsigned long int size; /**< number of elements */
+	unsigned long int height; /**< number of levels, 0 when empty */
+	/**
+	 * number of nodes per difference between the heights of their next
+	 * and previous subtrees, from -B6_STATS_BALANCE to B6_STATS_BALANCE,
+	 * greater differences being accounted in the extreme buckets
+	 */
+	unsigned long int balance[2 * B6_STATS_BALANCE + 1];
+};
+
+#ifdef B6_STATS
+
+/**
+ * @brief Add to a counter of a container
+ * @param self specifies the container.
+ * @param counter specifies the name of the counter.
+ * @param n specifies the amount to add.
+ */
+#define b6_count(self, counter, n) ((void)((self)->counters.counter += (n)))
+
+/**
+ * @internal
+ */
+#define __b6_counters_of(self) (&(self)->counters)
+
+#else
+
+#define b6_count(self, counter, n) ((void)0)
+
+#define __b6_counters_of(self) ((struct b6_counters *)0)
+
+#endif /* B6_STATS */
+
+/**
+ * @internal
+ */
+static inline void __b6_reset_counters(struct b6_counters *counters)
+{
+	if (counters) {
+		counters->searches = 0;
+		counters->depth = 0;
+		counters->comparisons = 0;
+		counters->rotations = 0;
+		counters->sifts = 0;
+	}
+}
+
+/**
+ * @internal
+ */
+static inline void __b6_setup_stats(struct b6_stats *stats,
+				    const struct b6_counters *counters)
+{
+	unsigned int i;
+	if (counters)
+		stats->counters = *counters;
+	else
+		__b6_reset_counters(&stats->counters);
+	stats->size = 0;
+	stats->height = 0;
+	for (i = 0; i < 2 * B6_STATS_BALANCE + 1; i += 1)
+		stats->balance[i] = 0;
+}
+
+/**
+ * @internal
+ */
+static inline void __b6_count_balance(struct b6_stats *stats, long int diff)
+{
+	if (diff < -B6_STATS_BALANCE)
+		diff = -B6_STATS_BALANCE;
+	else if (diff > B6_STATS_BALANCE)
+		diff = B6_STATS_BALANCE;
+	stats->balance[diff + B6_STATS_BALANCE] += 1;
+}
+
+#endif /* B6_STATS_H_ */
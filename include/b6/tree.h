@@ -6,7 +6,7 @@
 /**
  * @file tree.h
  *
- * @brief AVL and colored binary search tree container
+ * @brief AVL, weak AVL and colored binary search tree container
  */
 
 #ifndef B6_TREE_H_
@@ -15,6 +15,7 @@
 #include "refs.h"
 #include "utils.h"
 #include "assert.h"
+#include "stats.h"
 
 /**
  * @brief AVL/colored binary search tree data structure
@@ -22,6 +23,9 @@
 struct b6_tree {
 	struct b6_tref tref; /**< sentinel */
 	const struct b6_tree_ops *ops;
+#ifdef B6_STATS
+	struct b6_counters counters; /**< operation counters */
+#endif
 };
 
 #define B6_TREE_INIT(ops) { { { NULL, NULL }, 0 }, ops }
@@ -35,6 +39,37 @@ struct b6_tree_ops {
 
 extern const struct b6_tree_ops b6_tree_rb_ops;
 extern const struct b6_tree_ops b6_tree_avl_ops;
+extern const struct b6_tree_ops b6_tree_wavl_ops;
+
+/**
+ * @internal
+ */
+extern void __b6_tree_avl_add(struct b6_tref*, int, struct b6_tref*);
+
+/**
+ * @internal
+ */
+extern struct b6_tref *__b6_tree_avl_del(struct b6_tref*, int);
+
+/**
+ * @internal
+ */
+extern void __b6_tree_rb_add(struct b6_tref*, int, struct b6_tref*);
+
+/**
+ * @internal
+ */
+extern struct b6_tref *__b6_tree_rb_del(struct b6_tref*, int);
+
+/**
+ * @internal
+ */
+extern void __b6_tree_wavl_add(struct b6_tref*, int, struct b6_tref*);
+
+/**
+ * @internal
+ */
+extern struct b6_tref *__b6_tree_wavl_del(struct b6_tref*, int);
 
 /**
  * @brief Initialize the binary search tree
@@ -51,6 +86,7 @@ static inline void b6_tree_initialize(struct b6_tree *tree,
 	tree->tref.ref[1] = NULL;
 	tree->tref.top = NULL;
 	tree->ops = ops;
+	__b6_reset_counters(__b6_counters_of(tree));
 }
 
 /**
@@ -121,10 +157,23 @@ static inline struct b6_tref *b6_tree_root(const struct b6_tree *tree)
 	return b6_tree_child(top, dir);
 }
 
+/**
+ * @internal
+ *
+ * Counting does not modify the elements of a tree, so that it also applies
+ * to searches of constant trees.
+ */
+#define __b6_tree_cmp(_tree, _cmp, _ref, _key)				\
+	(b6_count((struct b6_tree *)(_tree), comparisons, 1),		\
+	 b6_count((struct b6_tree *)(_tree), depth, 1), _cmp(_ref, _key))
+
+/* the body of the loop compares once per iteration */
 #define b6_tree_search(tree, ref, top, dir)				\
 	b6_precond((tree) != NULL);					\
-	for (b6_tree_top(tree, &top, &dir);				\
-	     (ref = b6_tree_child(top, dir));				\
+	for (b6_tree_top(tree, &top, &dir), b6_count(tree, searches, 1); \
+	     (ref = b6_tree_child(top, dir)) &&				\
+		     (b6_count(tree, comparisons, 1),			\
+		      b6_count(tree, depth, 1), 1);			\
 	     top = ref)
 
 /**
@@ -171,6 +220,287 @@ static inline struct b6_tref *b6_tree_last(const struct b6_tree *tree)
 	return b6_tree_walk(tree, b6_tree_tail(tree), B6_PREV);
 }
 
+/**
+ * @brief Find the smallest element which is not less than a key
+ * @complexity O(log(n))
+ * @param tree pointer to the tree
+ * @param cmp function comparing the element of a reference (first argument)
+ * and the key (second argument), returning a negative value, zero or a
+ * positive value if the element is less than, equal to or greater than the
+ * key respectively
+ * @param key opaque key to pass to cmp
+ * @return the reference of the element found or tail if every element is less
+ * than the key
+ */
+static inline struct b6_tref *b6_tree_lower_bound(const struct b6_tree *tree,
+						  b6_compare_t cmp, void *key)
+{
+	struct b6_tref *ref = b6_tree_root(tree), *res = b6_tree_tail(tree);
+
+	b6_count((struct b6_tree *)tree, searches, 1);
+	while (ref)
+		if (__b6_tree_cmp(tree, cmp, ref, key) >= 0) {
+			res = ref;
+			ref = ref->ref[B6_PREV];
+		} else
+			ref = ref->ref[B6_NEXT];
+
+	return res;
+}
+
+/**
+ * @brief Find the smallest element which is greater than a key
+ * @complexity O(log(n))
+ * @param tree pointer to the tree
+ * @param cmp function comparing elements and keys
+ * @param key opaque key to pass to cmp
+ * @return the reference of the element found or tail if no element is greater
+ * than the key
+ * @see b6_tree_lower_bound
+ */
+static inline struct b6_tref *b6_tree_upper_bound(const struct b6_tree *tree,
+						  b6_compare_t cmp, void *key)
+{
+	struct b6_tref *ref = b6_tree_root(tree), *res = b6_tree_tail(tree);
+
+	b6_count((struct b6_tree *)tree, searches, 1);
+	while (ref)
+		if (__b6_tree_cmp(tree, cmp, ref, key) > 0) {
+			res = ref;
+			ref = ref->ref[B6_PREV];
+		} else
+			ref = ref->ref[B6_NEXT];
+
+	return res;
+}
+
+/**
+ * @brief Find the sequence of elements which are equal to a key
+ * @complexity O(log(n))
+ * @param tree pointer to the tree
+ * @param cmp function comparing elements and keys
+ * @param key opaque key to pass to cmp
+ * @param first where to store the reference of the first element equal to the
+ * key
+ * @param last where to store the reference of the first element greater than
+ * the key
+ * @see b6_tree_lower_bound
+ */
+static inline void b6_tree_equal_range(const struct b6_tree *tree,
+				       b6_compare_t cmp, void *key,
+				       struct b6_tref **first,
+				       struct b6_tref **last)
+{
+	*first = b6_tree_lower_bound(tree, cmp, key);
+	*last = b6_tree_upper_bound(tree, cmp, key);
+}
+
+/**
+ * @brief Number of references a range iterator prefetches ahead
+ */
+#define B6_TREE_RANGE_AHEAD 8
+
+/**
+ * @brief In-order iterator over a range of elements of a tree
+ *
+ * The iterator travels the tree some references ahead of the caller. Going
+ * down the right subtree of a reference reaches its successor through a
+ * spine of previous links, and the right subtrees hanging off this spine
+ * hold the elements that come next in order. The iterator asks the processor
+ * to prefetch their roots as soon as it knows them, then follows their own
+ * spines one level per step, prefetching every node on the way. These loads
+ * then overlap with the processing of the elements returned meanwhile instead
+ * of stalling the walk one node at a time.
+ *
+ * @code
+ * struct b6_tree_range range;
+ * struct b6_tref *first, *last, *ref;
+ * b6_tree_equal_range(tree, cmp, key, &first, &last);
+ * b6_setup_tree_range(&range, tree, first, last);
+ * while ((ref = b6_get_next_tree_range(&range)))
+ *   do_something(ref);
+ * @endcode
+ */
+struct b6_tree_range {
+	const struct b6_tree *tree; /**< tree to travel */
+	const struct b6_tref *end; /**< reference after the range */
+	struct b6_tref *last; /**< latest reference prefetched */
+	unsigned int head; /**< index of the next reference to return */
+	unsigned int count; /**< number of references ahead */
+	struct b6_tref *ahead[B6_TREE_RANGE_AHEAD]; /**< references ahead */
+	unsigned int next; /**< index of the next spine to replace */
+	struct b6_tref *spines[B6_TREE_RANGE_AHEAD]; /**< spines to follow */
+};
+
+/**
+ * @internal
+ */
+static inline void __b6_tree_range_fetch(struct b6_tree_range *range)
+{
+	unsigned int i;
+	struct b6_tref *prev = range->last, *ref;
+	if (prev == range->end)
+		return;
+	ref = b6_tree_walk(range->tree, prev, B6_NEXT);
+	range->last = ref;
+	if (ref == range->end)
+		return;
+	if (prev->ref[B6_NEXT]) {
+		/* the walk went down the left spine of the right subtree of
+		 * prev: the right subtrees of the spine come next in order,
+		 * and their roots are known already */
+		struct b6_tref *spine;
+		for (spine = ref; spine != prev;
+		     spine = b6_tree_parent(spine, NULL)) {
+			struct b6_tref *next = spine->ref[B6_NEXT];
+			if (!next)
+				continue;
+			b6_prefetch(next);
+			i = range->next % B6_TREE_RANGE_AHEAD;
+			range->spines[i] = next;
+			range->next += 1;
+		}
+	}
+	for (i = 0; i < B6_TREE_RANGE_AHEAD; i += 1) {
+		struct b6_tref *next = range->spines[i];
+		if (!next)
+			continue;
+		next = next->ref[B6_PREV];
+		if (next)
+			b6_prefetch(next);
+		range->spines[i] = next;
+	}
+	i = (range->head + range->count) % B6_TREE_RANGE_AHEAD;
+	range->ahead[i] = ref;
+	range->count += 1;
+}
+
+/**
+ * @brief Initialize a range iterator
+ * @param range pointer to the iterator
+ * @param tree pointer to the tree to travel
+ * @param first reference of the first element of the range
+ * @param end reference after the last element of the range (e.g. the tail of
+ * the tree)
+ */
+static inline void b6_setup_tree_range(struct b6_tree_range *range,
+				       const struct b6_tree *tree,
+				       struct b6_tref *first,
+				       const struct b6_tref *end)
+{
+	unsigned int i;
+	range->tree = tree;
+	range->end = end;
+	range->head = 0;
+	range->count = 0;
+	range->next = 0;
+	for (i = 0; i < B6_TREE_RANGE_AHEAD; i += 1)
+		range->spines[i] = NULL;
+	range->last = first;
+	if (first == end)
+		return;
+	range->ahead[0] = first;
+	range->count = 1;
+	while (range->count < B6_TREE_RANGE_AHEAD && range->last != end)
+		__b6_tree_range_fetch(range);
+}
+
+/**
+ * @brief Get the next reference of a range
+ * @param range pointer to the iterator
+ * @return the next reference or NULL when the end of the range was reached
+ */
+static inline struct b6_tref *b6_get_next_tree_range(
+	struct b6_tree_range *range)
+{
+	struct b6_tref *ref;
+	if (!range->count)
+		return NULL;
+	ref = range->ahead[range->head];
+	range->head = (range->head + 1) % B6_TREE_RANGE_AHEAD;
+	range->count -= 1;
+	__b6_tree_range_fetch(range);
+	return ref;
+}
+
+/**
+ * @brief Maximum number of lookups a batch search runs in lockstep
+ */
+#define B6_TREE_BATCH 8
+
+/**
+ * @brief Look several keys up at once
+ *
+ * Up to B6_TREE_BATCH lookups are traveling the tree in lockstep. Each one
+ * goes down one level in turn and asks the processor to prefetch the next node
+ * it will visit. As a result, the cache misses of distinct lookups overlap
+ * instead of serializing. As soon as a lookup completes, the next key takes
+ * its place (asynchronous memory access chaining).
+ *
+ * @complexity O(n log(N))
+ * @param tree pointer to the tree
+ * @param cmp function comparing elements and keys
+ * @param keys array of opaque keys to pass to cmp
+ * @param n number of keys
+ * @param refs array where to store the reference of the element equal to each
+ * key or NULL if there is none
+ * @see b6_tree_lower_bound
+ */
+static inline void b6_tree_search_batch(const struct b6_tree *tree,
+					b6_compare_t cmp, void *const *keys,
+					unsigned long int n,
+					struct b6_tref **refs)
+{
+	struct b6_tref *root = b6_tree_root(tree), *curr[B6_TREE_BATCH];
+	unsigned long int index[B6_TREE_BATCH], next = 0, done = 0;
+	unsigned int i, k = n < B6_TREE_BATCH ? n : B6_TREE_BATCH;
+
+	b6_count((struct b6_tree *)tree, searches, n);
+	for (i = 0; i < k; i += 1) {
+		curr[i] = root;
+		index[i] = next++;
+	}
+
+	while (done < n)
+		for (i = 0; i < k; i += 1) {
+			struct b6_tref *ref = curr[i];
+			int res;
+			if (index[i] >= n)
+				continue;
+			if (ref && (res = __b6_tree_cmp(tree, cmp, ref,
+							keys[index[i]]))) {
+				ref = ref->ref[res < 0 ? B6_NEXT : B6_PREV];
+				b6_prefetch(ref);
+				curr[i] = ref;
+				continue;
+			}
+			refs[index[i]] = ref;
+			done += 1;
+			curr[i] = root;
+			index[i] = next++;
+		}
+}
+
+#ifdef B6_STATS
+/**
+ * @internal
+ */
+extern __thread struct b6_counters *__b6_tree_counters;
+
+/**
+ * @internal
+ *
+ * Tree policies do not know which tree they balance: the counters to account
+ * rotations to are set for the time of an insertion or removal.
+ */
+static inline void __b6_tree_count_rotations(struct b6_tree *tree)
+{
+	__b6_tree_counters = tree ? &tree->counters : NULL;
+}
+#else
+#define __b6_tree_count_rotations(tree) ((void)0)
+#endif
+
 static inline struct b6_tref *b6_tree_add(struct b6_tree *tree,
 					  struct b6_tref *top, int dir,
 					  struct b6_tref *ref)
@@ -179,19 +509,49 @@ static inline struct b6_tref *b6_tree_add(struct b6_tree *tree,
 	b6_precond((unsigned int)dir < b6_card_of(top->ref));
 	b6_precond(!top->ref[dir]);
 	b6_precond(ref);
+	__b6_tree_count_rotations(tree);
 	tree->ops->add(top, dir, ref);
+	__b6_tree_count_rotations(NULL);
 	return ref;
 }
 
 static inline struct b6_tref *b6_tree_del(struct b6_tree *tree,
 					  struct b6_tref *top, int dir)
 {
+	struct b6_tref *ref;
 	b6_precond(top);
 	b6_precond((unsigned int)dir < b6_card_of(top->ref));
 	b6_precond(top->ref[dir]);
-	return tree->ops->del(top, dir);
+	__b6_tree_count_rotations(tree);
+	ref = tree->ops->del(top, dir);
+	__b6_tree_count_rotations(NULL);
+	return ref;
 }
 
+/**
+ * @brief Remove every element of a tree at once
+ *
+ * Elements are visited in post-order, that is, children before their parent,
+ * so that the function to call back is allowed to release the memory of the
+ * element. No rebalancing occurs and no auxiliary memory is used as the tree
+ * is traveled by means of parent references. The tree is left empty.
+ *
+ * @complexity O(n)
+ * @param tree pointer to the tree
+ * @param release function to call back for every element removed or NULL
+ * @param arg opaque data to pass to release
+ */
+extern void b6_tree_clear(struct b6_tree *tree,
+			  void (*release)(struct b6_tref*, void*), void *arg);
+
+/**
+ * @brief Snapshot the counters and the shape of a tree
+ * @complexity O(n)
+ * @param tree pointer to the tree
+ * @param stats where to store the statistics
+ */
+extern void b6_tree_stats(const struct b6_tree *tree, struct b6_stats *stats);
+
 static inline int b6_tree_check(const struct b6_tree *tree,
 				struct b6_tref **tref)
 {
@@ -200,4 +560,158 @@ static inline int b6_tree_check(const struct b6_tree *tree,
 	return tree->ops->chk(tree, tref);
 }
 
+/**
+ * @brief Generate a tree API specialized for a type of element
+ *
+ * The functions generated have the comparison of keys inlined and call the
+ * balance policy directly instead of through b6_tree::ops. Given:
+ *
+ * @code
+ * struct item {
+ *   struct b6_tref tref;
+ *   unsigned long int key;
+ * };
+ *
+ * #define compare_keys(a, b) ((a) < (b) ? -1 : (a) > (b))
+ *
+ * B6_TREE_GENERATE(item_tree, struct item, tref, key, compare_keys);
+ * @endcode
+ *
+ * the following functions are available:
+ *
+ * @code
+ * void item_tree_initialize(struct b6_tree *tree);
+ * struct item *item_tree_find(const struct b6_tree *tree,
+ *                             unsigned long int key);
+ * struct item *item_tree_lower_bound(const struct b6_tree *tree,
+ *                                    unsigned long int key);
+ * struct item *item_tree_insert(struct b6_tree *tree, struct item *item);
+ * void item_tree_erase(struct b6_tree *tree, struct item *item);
+ * struct item *item_tree_first(const struct b6_tree *tree);
+ * struct item *item_tree_last(const struct b6_tree *tree);
+ * struct item *item_tree_next(const struct b6_tree *tree, struct item *item);
+ * struct item *item_tree_prev(const struct b6_tree *tree, struct item *item);
+ * @endcode
+ *
+ * item_tree_insert returns the element already in the tree with the same key
+ * if any, or item otherwise. Functions returning elements return NULL when
+ * there is no such element. Trees so generated remain regular b6_tree objects
+ * which can be traveled or checked with the generic functions.
+ *
+ * @param name prefix of the functions to generate
+ * @param type type of the elements
+ * @param tref name of the b6_tref field of type
+ * @param key name of the key field of type
+ * @param cmp function or macro comparing two keys, returning a negative value,
+ * zero or a positive value if its first argument is less than, equal to or
+ * greater than its second argument respectively
+ *
+ * @see B6_TREE_GENERATE_POLICY to select another balance policy
+ */
+#define B6_TREE_GENERATE(name, type, tref, key, cmp)			\
+	B6_TREE_GENERATE_POLICY(name, avl, type, tref, key, cmp)
+
+/**
+ * @brief Generate a tree API specialized for a type of element and a balance
+ * policy
+ * @param name prefix of the functions to generate
+ * @param policy avl, rb or wavl
+ * @param type type of the elements
+ * @param tref name of the b6_tref field of type
+ * @param key name of the key field of type
+ * @param cmp function or macro comparing two keys
+ * @see B6_TREE_GENERATE
+ */
+#define B6_TREE_GENERATE_POLICY(name, policy, type, tref, key, cmp)	\
+									\
+static inline void name ## _initialize(struct b6_tree *tree)		\
+{									\
+	b6_tree_initialize(tree, &b6_tree_ ## policy ## _ops);		\
+}									\
+									\
+static inline type *name ## _entry(const struct b6_tree *tree,		\
+				   const struct b6_tref *ref)		\
+{									\
+	if (!ref || ref == b6_tree_head(tree))				\
+		return NULL;						\
+	return b6_cast_of(ref, type, tref);				\
+}									\
+									\
+static inline type *name ## _find(const struct b6_tree *tree,		\
+				  __typeof(((type *)0)->key) k)		\
+{									\
+	struct b6_tref *ref = b6_tree_root(tree);			\
+	b6_count((struct b6_tree *)tree, searches, 1);			\
+	while (ref) {							\
+		int res = __b6_tree_cmp(tree, cmp,			\
+					b6_cast_of(ref, type, tref)->key, k); \
+		if (!res)						\
+			return b6_cast_of(ref, type, tref);		\
+		ref = ref->ref[res < 0 ? B6_NEXT : B6_PREV];		\
+	}								\
+	return NULL;							\
+}									\
+									\
+static inline type *name ## _lower_bound(const struct b6_tree *tree,	\
+					 __typeof(((type *)0)->key) k)	\
+{									\
+	struct b6_tref *ref = b6_tree_root(tree), *res = NULL;		\
+	b6_count((struct b6_tree *)tree, searches, 1);			\
+	while (ref)							\
+		if (__b6_tree_cmp(tree, cmp,				\
+				  b6_cast_of(ref, type, tref)->key, k) >= 0) { \
+			res = ref;					\
+			ref = ref->ref[B6_PREV];			\
+		} else							\
+			ref = ref->ref[B6_NEXT];			\
+	return name ## _entry(tree, res);				\
+}									\
+									\
+static inline type *name ## _insert(struct b6_tree *tree, type *e)	\
+{									\
+	struct b6_tref *top, *ref;					\
+	int dir;							\
+	b6_tree_search(tree, ref, top, dir) {				\
+		int res = cmp(b6_cast_of(ref, type, tref)->key, e->key); \
+		if (!res)						\
+			return b6_cast_of(ref, type, tref);		\
+		dir = res < 0 ? B6_NEXT : B6_PREV;			\
+	}								\
+	__b6_tree_count_rotations(tree);				\
+	__b6_tree_ ## policy ## _add(top, dir, &e->tref);		\
+	__b6_tree_count_rotations(NULL);				\
+	return e;							\
+}									\
+									\
+static inline void name ## _erase(struct b6_tree *tree, type *e)	\
+{									\
+	int dir;							\
+	struct b6_tref *top = b6_tree_parent(&e->tref, &dir);		\
+	__b6_tree_count_rotations(tree);				\
+	__b6_tree_ ## policy ## _del(top, dir);				\
+	__b6_tree_count_rotations(NULL);				\
+}									\
+									\
+static inline type *name ## _first(const struct b6_tree *tree)		\
+{									\
+	return name ## _entry(tree, b6_tree_first(tree));		\
+}									\
+									\
+static inline type *name ## _last(const struct b6_tree *tree)		\
+{									\
+	return name ## _entry(tree, b6_tree_last(tree));		\
+}									\
+									\
+static inline type *name ## _next(const struct b6_tree *tree, type *e)	\
+{									\
+	return name ## _entry(tree, b6_tree_walk(tree, &e->tref, B6_NEXT)); \
+}									\
+									\
+static inline type *name ## _prev(const struct b6_tree *tree, type *e)	\
+{									\
+	return name ## _entry(tree, b6_tree_walk(tree, &e->tref, B6_PREV)); \
+}									\
+									\
+struct name ## _hack /* swallow the semicolon */
+
 #endif /* B6_TREE_H_ */
@@ -116,6 +116,20 @@
 #define b6_unlikely(x) x
 #endif
 
+/**
+ * @def b6_prefetch
+ * Hint the processor that the memory at some address is about to be read so
+ *        that it starts loading it into its cache.
+ * @param p specifies the address
+ * @note This feature is compiler dependent and might have no effect.
+ */
+
+#if (defined (__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__ >= 301))
+#define b6_prefetch(p) __builtin_prefetch(p)
+#else
+#define b6_prefetch(p) ((void)(p))
+#endif
+
 /**
  * Declare a local variable or a function parameter as not used.
  *
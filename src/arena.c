@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/arena.h"
+
+static struct b6_arena_chunk *add_chunk(struct b6_arena *self,
+					unsigned long int size)
+{
+	struct b6_arena_chunk *chunk;
+	chunk = b6_allocate(self->allocator, sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+	chunk->next = self->chunks;
+	self->chunks = chunk;
+	return chunk;
+}
+
+static void *allocate(struct b6_allocator *parent, unsigned long int size)
+{
+	struct b6_arena *self = b6_cast_of(parent, struct b6_arena, parent);
+	struct b6_arena_chunk *chunk, *current;
+	void *ptr;
+
+	size = (size + B6_ARENA_ALIGNMENT - 1) & ~(B6_ARENA_ALIGNMENT - 1);
+	if (size <= (unsigned long int)(self->end - self->ptr)) {
+		ptr = self->ptr;
+		self->ptr += size;
+		return ptr;
+	}
+
+	/* large objects do not waste what remains of the current chunk */
+	if (size > self->chunk_size / 4) {
+		current = self->chunks;
+		if (!(chunk = add_chunk(self, size)))
+			return NULL;
+		if (current) {
+			self->chunks = current;
+			chunk->next = current->next;
+			current->next = chunk;
+		}
+		return chunk + 1;
+	}
+
+	if (!(chunk = add_chunk(self, self->chunk_size)))
+		return NULL;
+	ptr = chunk + 1;
+	self->ptr = (unsigned char *)ptr + size;
+	self->end = (unsigned char *)ptr + self->chunk_size;
+	return ptr;
+}
+
+static void deallocate(struct b6_allocator *parent, void *ptr)
+{
+}
+
+const struct b6_allocator_ops b6_arena_ops = {
+	.allocate = allocate,
+	.deallocate = deallocate,
+};
+
+void b6_arena_finalize(struct b6_arena *self)
+{
+	while (self->chunks) {
+		struct b6_arena_chunk *chunk = self->chunks;
+		self->chunks = chunk->next;
+		b6_deallocate(self->allocator, chunk);
+	}
+	self->ptr = NULL;
+	self->end = NULL;
+}
@@ -5,6 +5,13 @@
 
 #include "b6/array.h"
 #include "b6/allocator.h"
+#include "b6/flags.h"
+
+/* referring to the flag ops weakly does not link flags parsing in */
+#pragma weak b6_growth_flag_ops
+
+unsigned int b6_array_growth = 100;
+b6_static_flag(b6_array_growth, growth);
 
 static int b6_array_resize(struct b6_array *self, unsigned long int capacity)
 {
@@ -21,13 +28,37 @@ static int b6_array_resize(struct b6_array *self, unsigned long int capacity)
 	return 0;
 }
 
+/* increase a capacity by growth percent, and at least by one item, or return
+ * 0 on overflow */
+static unsigned long int grow(unsigned long int capacity, unsigned int growth)
+{
+	unsigned long int delta;
+	if (growth == 100)
+		delta = capacity;
+	else if (capacity / 100 > ~0UL / growth)
+		return 0;
+	else
+		delta = capacity / 100 * growth + capacity % 100 * growth / 100;
+	if (!delta)
+		delta = 1;
+	if (capacity + delta < capacity)
+		return 0;
+	return capacity + delta;
+}
+
 int b6_array_expand(struct b6_array *self, unsigned long int n)
 {
+	unsigned int growth = b6_read_flag(b6_array_growth);
 	unsigned long int capacity;
-	for (capacity = self->capacity ? self->capacity * 2 : 2;
-	     n >= capacity - self->length; capacity *= 2)
-		if (capacity < self->capacity)
-			return 0;
+	if (growth < 1)
+		growth = 1;
+	else if (growth > B6_MAX_GROWTH)
+		growth = B6_MAX_GROWTH;
+	for (capacity = self->capacity ? grow(self->capacity, growth) : 2;
+	     capacity && n > capacity - self->length;
+	     capacity = grow(capacity, growth));
+	if (!capacity)
+		return -2;
 	return b6_array_resize(self, capacity);
 }
 
@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/art.h"
+#include "b6/utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Nodes
+ * -----
+ *
+ * Children are either nodes or elements. Pointers to elements are tagged with
+ * their least significant bit set.
+ *
+ * Nodes store up to B6_ART_PREFIX bytes of their prefix. Longer prefixes are
+ * skipped when looking keys up (optimistic search), and the whole key is
+ * compared once an element is reached. When the whole prefix is needed, it is
+ * read from the key of any element below the node, since they all share it.
+ *
+ * Keys include their terminating null byte. As no key is the prefix of
+ * another one, prefixes never include a null byte, and elements are always
+ * leaves.
+ */
+
+#define B6_ART_PREFIX 10
+
+enum { NODE4, NODE16, NODE48, NODE256 };
+
+struct node {
+	unsigned char type;
+	unsigned short int count;
+	unsigned int prefix_length;
+	unsigned char prefix[B6_ART_PREFIX];
+};
+
+struct node4 {
+	struct node node;
+	unsigned char keys[4];
+	void *children[4];
+};
+
+struct node16 {
+	struct node node;
+	unsigned char keys[16];
+	void *children[16];
+};
+
+struct node48 {
+	struct node node;
+	unsigned char index[256]; /* 1-based index in children, 0 if none */
+	void *children[48];
+};
+
+struct node256 {
+	struct node node;
+	void *children[256];
+};
+
+static int is_leaf(const void *ptr)
+{
+	return (unsigned long int)ptr & 1;
+}
+
+static struct b6_aref *leaf_of(const void *ptr)
+{
+	return (struct b6_aref *)((unsigned long int)ptr - 1);
+}
+
+static void *tag(const struct b6_aref *aref)
+{
+	return (void *)((unsigned long int)aref + 1);
+}
+
+static const unsigned char *key_of(const struct b6_aref *aref)
+{
+	return (const unsigned char *)aref->key;
+}
+
+static unsigned long int min_of(unsigned long int a, unsigned long int b)
+{
+	return a < b ? a : b;
+}
+
+static struct node *new_node(struct b6_art *self, int type)
+{
+	static const unsigned short int sizes[] = {
+		[NODE4] = sizeof(struct node4),
+		[NODE16] = sizeof(struct node16),
+		[NODE48] = sizeof(struct node48),
+		[NODE256] = sizeof(struct node256),
+	};
+	struct node *node = b6_allocate(self->allocator, sizes[type]);
+	if (!node)
+		return NULL;
+	__builtin_memset(node, 0, sizes[type]);
+	node->type = type;
+	return node;
+}
+
+static void copy_header(struct node *dst, const struct node *src)
+{
+	dst->count = src->count;
+	dst->prefix_length = src->prefix_length;
+	__builtin_memcpy(dst->prefix, src->prefix, B6_ART_PREFIX);
+}
+
+static void set_prefix(struct node *node, const unsigned char *prefix,
+		       unsigned long int length)
+{
+	node->prefix_length = length;
+	__builtin_memmove(node->prefix, prefix, min_of(length, B6_ART_PREFIX));
+}
+
+#if defined(__SSE2__)
+static unsigned int match16(const struct node16 *n, unsigned char byte)
+{
+	__m128i keys = _mm_loadu_si128((const __m128i *)n->keys);
+	__m128i cmp = _mm_cmpeq_epi8(keys, _mm_set1_epi8(byte));
+	return _mm_movemask_epi8(cmp) & ((1U << n->node.count) - 1);
+}
+
+/* keys are unsigned: flip their sign bits to compare them as signed bytes */
+static unsigned int above16(const struct node16 *n, unsigned char byte)
+{
+	__m128i bias = _mm_set1_epi8((char)0x80);
+	__m128i keys = _mm_xor_si128(
+		_mm_loadu_si128((const __m128i *)n->keys), bias);
+	__m128i cmp = _mm_cmpgt_epi8(keys,
+				     _mm_xor_si128(_mm_set1_epi8(byte), bias));
+	return _mm_movemask_epi8(cmp) & ((1U << n->node.count) - 1);
+}
+#else
+static unsigned int match16(const struct node16 *n, unsigned char byte)
+{
+	unsigned int i, bits = 0;
+	for (i = 0; i < n->node.count; i += 1)
+		bits |= (n->keys[i] == byte) << i;
+	return bits;
+}
+
+static unsigned int above16(const struct node16 *n, unsigned char byte)
+{
+	unsigned int i, bits = 0;
+	for (i = 0; i < n->node.count; i += 1)
+		bits |= (n->keys[i] > byte) << i;
+	return bits;
+}
+#endif
+
+static void **find_child(const struct node *node, unsigned char byte)
+{
+	unsigned int i, bits;
+	switch (node->type) {
+	case NODE4: {
+		struct node4 *n = (struct node4 *)node;
+		for (i = 0; i < node->count; i += 1)
+			if (n->keys[i] == byte)
+				return &n->children[i];
+		break;
+	}
+	case NODE16: {
+		struct node16 *n = (struct node16 *)node;
+		if ((bits = match16(n, byte)))
+			return &n->children[__builtin_ctz(bits)];
+		break;
+	}
+	case NODE48: {
+		struct node48 *n = (struct node48 *)node;
+		if ((i = n->index[byte]))
+			return &n->children[i - 1];
+		break;
+	}
+	default: {
+		struct node256 *n = (struct node256 *)node;
+		if (n->children[byte])
+			return &n->children[byte];
+	}
+	}
+	return NULL;
+}
+
+/* child with the smallest byte greater than byte */
+static void *next_child(const struct node *node, unsigned int byte)
+{
+	unsigned int i, bits;
+	switch (node->type) {
+	case NODE4: {
+		struct node4 *n = (struct node4 *)node;
+		for (i = 0; i < node->count; i += 1)
+			if (n->keys[i] > byte)
+				return n->children[i];
+		break;
+	}
+	case NODE16: {
+		struct node16 *n = (struct node16 *)node;
+		if ((bits = above16(n, byte)))
+			return n->children[__builtin_ctz(bits)];
+		break;
+	}
+	case NODE48: {
+		struct node48 *n = (struct node48 *)node;
+		for (i = byte + 1; i < 256; i += 1)
+			if (n->index[i])
+				return n->children[n->index[i] - 1];
+		break;
+	}
+	default: {
+		struct node256 *n = (struct node256 *)node;
+		for (i = byte + 1; i < 256; i += 1)
+			if (n->children[i])
+				return n->children[i];
+	}
+	}
+	return NULL;
+}
+
+static const struct b6_aref *minimum(const void *ptr)
+{
+	while (!is_leaf(ptr)) {
+		const struct node *node = ptr;
+		void **child;
+		if (node->type == NODE4)
+			ptr = ((struct node4 *)node)->children[0];
+		else if (node->type == NODE16)
+			ptr = ((struct node16 *)node)->children[0];
+		else if ((child = find_child(node, 0)))
+			ptr = *child;
+		else
+			ptr = next_child(node, 0);
+	}
+	return leaf_of(ptr);
+}
+
+/* compare a key with a string of n bytes, as the key would be sorted */
+static int compare(const struct b6_aref *aref, const unsigned char *key,
+		   unsigned long int n)
+{
+	const unsigned char *lhs = key_of(aref);
+	unsigned long int i, length = aref->length + 1;
+	for (i = 0; i < length && i < n; i += 1)
+		if (lhs[i] != key[i])
+			return lhs[i] < key[i] ? -1 : 1;
+	return length < n ? -1 : length > n;
+}
+
+/* number of bytes of the prefix of node matching the key at depth */
+static unsigned long int match_prefix(const struct node *node,
+				      const unsigned char *key,
+				      unsigned long int n,
+				      unsigned long int depth)
+{
+	const unsigned char *prefix = node->prefix;
+	unsigned long int i;
+	if (node->prefix_length > B6_ART_PREFIX)
+		prefix = key_of(minimum(node)) + depth;
+	for (i = 0; i < node->prefix_length && depth + i < n; i += 1)
+		if (prefix[i] != key[depth + i])
+			break;
+	return i;
+}
+
+static void add4(struct node4 *n, unsigned char byte, void *child)
+{
+	unsigned int i, j;
+	for (i = 0; i < n->node.count && n->keys[i] < byte; i += 1);
+	for (j = n->node.count; j > i; j -= 1) {
+		n->keys[j] = n->keys[j - 1];
+		n->children[j] = n->children[j - 1];
+	}
+	n->keys[i] = byte;
+	n->children[i] = child;
+	n->node.count += 1;
+}
+
+static void add16(struct node16 *n, unsigned char byte, void *child)
+{
+	unsigned int bits = above16(n, byte);
+	unsigned int i = bits ? __builtin_ctz(bits) : n->node.count, j;
+	for (j = n->node.count; j > i; j -= 1) {
+		n->keys[j] = n->keys[j - 1];
+		n->children[j] = n->children[j - 1];
+	}
+	n->keys[i] = byte;
+	n->children[i] = child;
+	n->node.count += 1;
+}
+
+static void add48(struct node48 *n, unsigned char byte, void *child)
+{
+	unsigned int i;
+	for (i = 0; n->children[i]; i += 1);
+	n->children[i] = child;
+	n->index[byte] = i + 1;
+	n->node.count += 1;
+}
+
+static void add256(struct node256 *n, unsigned char byte, void *child)
+{
+	n->children[byte] = child;
+	n->node.count += 1;
+}
+
+/* move the children of a node to a node of another type */
+static void move_children(struct node *dst, const struct node *src)
+{
+	unsigned int i, count = src->count;
+	dst->count = 0;
+	switch (src->type) {
+	case NODE4:
+	case NODE16: {
+		const unsigned char *keys = src->type == NODE4 ?
+			((struct node4 *)src)->keys :
+			((struct node16 *)src)->keys;
+		void * const *children = src->type == NODE4 ?
+			((struct node4 *)src)->children :
+			((struct node16 *)src)->children;
+		for (i = 0; i < count; i += 1)
+			if (dst->type == NODE4)
+				add4((struct node4 *)dst, keys[i], children[i]);
+			else if (dst->type == NODE16)
+				add16((struct node16 *)dst, keys[i],
+				      children[i]);
+			else
+				add48((struct node48 *)dst, keys[i],
+				      children[i]);
+		break;
+	}
+	case NODE48: {
+		const struct node48 *n = (const struct node48 *)src;
+		for (i = 0; i < 256; i += 1) {
+			if (!n->index[i])
+				continue;
+			if (dst->type == NODE16)
+				add16((struct node16 *)dst, i,
+				      n->children[n->index[i] - 1]);
+			else
+				add256((struct node256 *)dst, i,
+				       n->children[n->index[i] - 1]);
+		}
+		break;
+	}
+	default: {
+		const struct node256 *n = (const struct node256 *)src;
+		for (i = 0; i < 256; i += 1)
+			if (n->children[i])
+				add48((struct node48 *)dst, i, n->children[i]);
+	}
+	}
+}
+
+/* replace a node by a node of another type */
+static struct node *resize(struct b6_art *self, void **ref, int type)
+{
+	struct node *old = *ref, *node = new_node(self, type);
+	if (!node)
+		return NULL;
+	copy_header(node, old);
+	move_children(node, old);
+	*ref = node;
+	b6_deallocate(self->allocator, old);
+	return node;
+}
+
+static int add_child(struct b6_art *self, void **ref, unsigned char byte,
+		     void *child)
+{
+	static const unsigned short int capacities[] = {
+		[NODE4] = 4, [NODE16] = 16, [NODE48] = 48, [NODE256] = 256,
+	};
+	struct node *node = *ref;
+	if (node->count == capacities[node->type] &&
+	    !(node = resize(self, ref, node->type + 1)))
+		return -2;
+	switch (node->type) {
+	case NODE4:
+		add4((struct node4 *)node, byte, child);
+		break;
+	case NODE16:
+		add16((struct node16 *)node, byte, child);
+		break;
+	case NODE48:
+		add48((struct node48 *)node, byte, child);
+		break;
+	default:
+		add256((struct node256 *)node, byte, child);
+	}
+	return 0;
+}
+
+static int insert(struct b6_art *self, void **ref, struct b6_aref *aref,
+		  unsigned long int depth)
+{
+	const unsigned char *key = key_of(aref);
+	unsigned long int n = aref->length + 1, i;
+	struct node *node, *parent;
+	void **child;
+
+	if (!*ref) {
+		*ref = tag(aref);
+		return 0;
+	}
+
+	if (is_leaf(*ref)) {
+		const unsigned char *other = key_of(leaf_of(*ref));
+		for (i = depth; i < n && key[i] == other[i]; i += 1);
+		if (i == n)
+			return -1;
+		if (!(parent = new_node(self, NODE4)))
+			return -2;
+		set_prefix(parent, key + depth, i - depth);
+		add4((struct node4 *)parent, other[i], *ref);
+		add4((struct node4 *)parent, key[i], tag(aref));
+		*ref = parent;
+		return 0;
+	}
+
+	node = *ref;
+	if (node->prefix_length) {
+		i = match_prefix(node, key, n, depth);
+		if (i < node->prefix_length) {
+			const unsigned char *prefix = node->prefix;
+			if (node->prefix_length > B6_ART_PREFIX)
+				prefix = key_of(minimum(node)) + depth;
+			if (!(parent = new_node(self, NODE4)))
+				return -2;
+			set_prefix(parent, prefix, i);
+			add4((struct node4 *)parent, prefix[i], node);
+			add4((struct node4 *)parent, key[depth + i], tag(aref));
+			set_prefix(node, prefix + i + 1,
+				   node->prefix_length - i - 1);
+			*ref = parent;
+			return 0;
+		}
+		depth += node->prefix_length;
+	}
+
+	if ((child = find_child(node, key[depth])))
+		return insert(self, child, aref, depth + 1);
+	return add_child(self, ref, key[depth], tag(aref));
+}
+
+int b6_art_insert(struct b6_art *self, struct b6_aref *aref)
+{
+	int retval = insert(self, &self->root, aref, 0);
+	if (!retval)
+		self->length += 1;
+	return retval;
+}
+
+struct b6_aref *b6_art_find(const struct b6_art *self, const char *key,
+			    unsigned long int length)
+{
+	const unsigned char *k = (const unsigned char *)key;
+	unsigned long int depth = 0, n = length + 1, i;
+	const void *ptr = self->root;
+
+	while (ptr) {
+		const struct node *node = ptr;
+		void **child;
+		if (is_leaf(ptr))
+			return compare(leaf_of(ptr), k, n) ? NULL :
+				leaf_of(ptr);
+		for (i = 0; i < min_of(node->prefix_length, B6_ART_PREFIX);
+		     i += 1)
+			if (node->prefix[i] != k[depth + i])
+				return NULL;
+		depth += node->prefix_length;
+		if (depth >= n)
+			return NULL;
+		if (!(child = find_child(node, k[depth])))
+			return NULL;
+		ptr = *child;
+		depth += 1;
+	}
+	return NULL;
+}
+
+/* replace a node with a single child by this child */
+static void collapse(struct b6_art *self, void **ref)
+{
+	struct node *node = *ref;
+	unsigned char byte = 0;
+	void *last, **child;
+
+	if (node->type == NODE4) {
+		byte = ((struct node4 *)node)->keys[0];
+		last = ((struct node4 *)node)->children[0];
+	} else if (node->type == NODE16) {
+		byte = ((struct node16 *)node)->keys[0];
+		last = ((struct node16 *)node)->children[0];
+	} else {
+		for (; !(child = find_child(node, byte)); byte += 1);
+		last = *child;
+	}
+
+	/* concatenate the prefix of the node, the byte of its child and the
+	 * prefix of the child */
+	if (!is_leaf(last)) {
+		struct node *below = last;
+		unsigned char prefix[B6_ART_PREFIX];
+		unsigned long int l = min_of(node->prefix_length, B6_ART_PREFIX);
+		__builtin_memcpy(prefix, node->prefix, l);
+		if (l < B6_ART_PREFIX)
+			prefix[l++] = byte;
+		__builtin_memcpy(prefix + l, below->prefix,
+				 min_of(below->prefix_length, B6_ART_PREFIX - l));
+		__builtin_memcpy(below->prefix, prefix, B6_ART_PREFIX);
+		below->prefix_length += node->prefix_length + 1;
+	}
+	*ref = last;
+	b6_deallocate(self->allocator, node);
+}
+
+/* remove the child at byte from the node, shrinking it if possible */
+static void remove_child(struct b6_art *self, void **ref, unsigned char byte,
+			 void **child)
+{
+	static const unsigned short int thresholds[] = {
+		[NODE4] = 0, [NODE16] = 3, [NODE48] = 12, [NODE256] = 37,
+	};
+	struct node *node = *ref;
+	unsigned char *keys = NULL;
+	void **children = NULL;
+	unsigned int i;
+
+	if (node->type == NODE4) {
+		keys = ((struct node4 *)node)->keys;
+		children = ((struct node4 *)node)->children;
+	} else if (node->type == NODE16) {
+		keys = ((struct node16 *)node)->keys;
+		children = ((struct node16 *)node)->children;
+	} else if (node->type == NODE48)
+		((struct node48 *)node)->index[byte] = 0;
+	if (keys) {
+		for (i = child - children; i + 1 < node->count; i += 1) {
+			keys[i] = keys[i + 1];
+			children[i] = children[i + 1];
+		}
+	} else
+		*child = NULL;
+	node->count -= 1;
+
+	/* nodes that cannot shrink for want of memory may end up with a
+	 * single child too */
+	if (node->count == 1)
+		collapse(self, ref);
+	else if (node->count == thresholds[node->type])
+		resize(self, ref, node->type - 1);
+}
+
+struct b6_aref *b6_art_remove(struct b6_art *self, const char *key,
+			      unsigned long int length)
+{
+	const unsigned char *k = (const unsigned char *)key;
+	unsigned long int depth = 0, n = length + 1, i;
+	void **ref = &self->root, **child;
+	struct b6_aref *aref;
+
+	if (!*ref)
+		return NULL;
+	if (is_leaf(*ref)) {
+		aref = leaf_of(*ref);
+		if (compare(aref, k, n))
+			return NULL;
+		*ref = NULL;
+		self->length -= 1;
+		return aref;
+	}
+	for (;;) {
+		struct node *node = *ref;
+		for (i = 0; i < min_of(node->prefix_length, B6_ART_PREFIX);
+		     i += 1)
+			if (node->prefix[i] != k[depth + i])
+				return NULL;
+		depth += node->prefix_length;
+		if (depth >= n || !(child = find_child(node, k[depth])))
+			return NULL;
+		if (is_leaf(*child))
+			break;
+		ref = child;
+		depth += 1;
+	}
+	aref = leaf_of(*child);
+	if (compare(aref, k, n))
+		return NULL;
+	remove_child(self, ref, k[depth], child);
+	self->length -= 1;
+	return aref;
+}
+
+static void release(struct b6_art *self, void *ptr)
+{
+	const struct node *node = ptr;
+	unsigned int i;
+	if (!ptr || is_leaf(ptr))
+		return;
+	switch (node->type) {
+	case NODE4:
+		for (i = 0; i < node->count; i += 1)
+			release(self, ((struct node4 *)node)->children[i]);
+		break;
+	case NODE16:
+		for (i = 0; i < node->count; i += 1)
+			release(self, ((struct node16 *)node)->children[i]);
+		break;
+	case NODE48:
+		for (i = 0; i < 48; i += 1)
+			release(self, ((struct node48 *)node)->children[i]);
+		break;
+	default:
+		for (i = 0; i < 256; i += 1)
+			release(self, ((struct node256 *)node)->children[i]);
+	}
+	b6_deallocate(self->allocator, ptr);
+}
+
+void b6_art_finalize(struct b6_art *self)
+{
+	release(self, self->root);
+	self->root = NULL;
+	self->length = 0;
+}
+
+/* smallest element greater than (or equal to, unless strict) a string of n
+ * bytes */
+static const struct b6_aref *lower_bound(const void *ptr,
+					 const unsigned char *key,
+					 unsigned long int n,
+					 unsigned long int depth, int strict)
+{
+	const struct node *node = ptr;
+	const struct b6_aref *aref;
+	unsigned long int i;
+	void **child;
+
+	if (!ptr)
+		return NULL;
+	if (is_leaf(ptr)) {
+		int cmp = compare(leaf_of(ptr), key, n);
+		return cmp > 0 || (!strict && !cmp) ? leaf_of(ptr) : NULL;
+	}
+	if (node->prefix_length) {
+		const unsigned char *prefix = node->prefix;
+		if (node->prefix_length > B6_ART_PREFIX)
+			prefix = key_of(minimum(node)) + depth;
+		i = match_prefix(node, key, n, depth);
+		if (depth + i >= n)
+			return minimum(node);
+		if (i < node->prefix_length)
+			return prefix[i] > key[depth + i] ? minimum(node) : NULL;
+		depth += node->prefix_length;
+	}
+	if (depth >= n)
+		return minimum(node);
+	if ((child = find_child(node, key[depth])) &&
+	    (aref = lower_bound(*child, key, n, depth + 1, strict)))
+		return aref;
+	return (ptr = next_child(node, key[depth])) ? minimum(ptr) : NULL;
+}
+
+void b6_setup_art_iterator(struct b6_art_iterator *self,
+			   const struct b6_art *art, const char *prefix)
+{
+	self->art = art;
+	self->prefix = prefix ? prefix : "";
+	for (self->length = 0; self->prefix[self->length]; self->length += 1);
+	self->aref = NULL;
+	self->started = 0;
+}
+
+const struct b6_aref *b6_get_next_art_iterator(struct b6_art_iterator *self)
+{
+	const unsigned char *prefix = (const unsigned char *)self->prefix;
+	const struct b6_aref *aref;
+
+	if (!self->started) {
+		self->started = 1;
+		aref = lower_bound(self->art->root, prefix, self->length, 0, 0);
+	} else if (self->aref)
+		aref = lower_bound(self->art->root, key_of(self->aref),
+				   self->aref->length + 1, 0, 1);
+	else
+		return NULL;
+	if (aref && (aref->length < self->length ||
+		     __builtin_memcmp(aref->key, prefix, self->length)))
+		aref = NULL;
+	return self->aref = aref;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/concurrent_registry.h"
+
+/* minimum number of slots of an index */
+#define B6_CONCURRENT_REGISTRY_MIN 16
+
+const struct b6_entry b6_concurrent_registry_tombstone;
+
+static void release_index(struct b6_epoch *epoch, struct b6_sref *sref)
+{
+	struct b6_concurrent_registry_index *index =
+		b6_cast_of(sref, struct b6_concurrent_registry_index, sref);
+	b6_deallocate(index->allocator, index);
+}
+
+void b6_setup_concurrent_registry(struct b6_concurrent_registry *self,
+				  struct b6_allocator *allocator)
+{
+	self->index = NULL;
+	self->allocator = allocator;
+	b6_reset_spinlock(&self->lock);
+	b6_setup_epoch(&self->epoch, release_index);
+}
+
+void b6_finalize_concurrent_registry(struct b6_concurrent_registry *self)
+{
+	b6_flush_epoch(&self->epoch);
+	if (self->index)
+		b6_deallocate(self->allocator, self->index);
+	self->index = NULL;
+}
+
+/* publish an entry in the first free slot of its probe sequence */
+static void store(struct b6_concurrent_registry_index *index,
+		  const struct b6_entry *entry)
+{
+	unsigned long int i = entry->hash;
+	struct b6_concurrent_registry_slot *slot;
+	while ((slot = &index->slots[i & index->mask])->entry)
+		i += 1;
+	slot->hash = entry->hash;
+	slot->length = entry->length;
+	slot->name = entry->name;
+	__atomic_store_n(&slot->entry, entry, __ATOMIC_RELEASE);
+	index->used += 1;
+	index->length += 1;
+}
+
+/* copy live entries of the published index to a new one, without tombstones,
+ * and with room for n more entries */
+static struct b6_concurrent_registry_index *rebuild(
+	struct b6_concurrent_registry *self, unsigned long int n)
+{
+	struct b6_concurrent_registry_index *old = self->index, *index;
+	unsigned long int i, size = B6_CONCURRENT_REGISTRY_MIN;
+
+	if (old)
+		n += old->length;
+	/* keep the load below one quarter right after rebuilding */
+	while (size < 4 * n)
+		size *= 2;
+	index = b6_allocate(self->allocator,
+			    sizeof(*index) + size * sizeof(index->slots[0]));
+	if (!index)
+		return NULL;
+	index->allocator = self->allocator;
+	index->mask = size - 1;
+	index->used = 0;
+	index->length = 0;
+	for (i = 0; i < size; i += 1)
+		index->slots[i].entry = NULL;
+	if (old)
+		for (i = 0; i <= old->mask; i += 1) {
+			const struct b6_entry *entry = old->slots[i].entry;
+			if (entry && entry != &b6_concurrent_registry_tombstone)
+				store(index, entry);
+		}
+	return index;
+}
+
+int b6_register_concurrent_hashed(struct b6_concurrent_registry *self,
+				  struct b6_entry *entry, const char *name,
+				  unsigned long int hash,
+				  unsigned long int length)
+{
+	struct b6_concurrent_registry_index *index;
+	int retval = 0;
+
+	entry->hash = hash;
+	entry->length = length;
+	entry->name = name;
+	b6_spin_lock(&self->lock);
+	index = self->index;
+	if (index && b6_search_concurrent_registry(index, name, hash, length)) {
+		retval = -1;
+		goto unlock;
+	}
+	/* at most half of the slots are used so that probing terminates */
+	if (!index || 2 * (index->used + 1) > index->mask + 1) {
+		if (!(index = rebuild(self, 1))) {
+			retval = -2;
+			goto unlock;
+		}
+		store(index, entry);
+		index = __atomic_exchange_n(&self->index, index,
+					    __ATOMIC_ACQ_REL);
+		if (index)
+			b6_retire_epoch_object(&self->epoch, &index->sref);
+	} else
+		store(index, entry);
+unlock:
+	b6_spin_unlock(&self->lock);
+	return retval;
+}
+
+void b6_unregister_concurrent(struct b6_concurrent_registry *self,
+			      struct b6_entry *entry)
+{
+	struct b6_concurrent_registry_index *index;
+	unsigned long int i;
+
+	b6_spin_lock(&self->lock);
+	index = self->index;
+	b6_precond(index);
+	for (i = entry->hash; index->slots[i & index->mask].entry != entry;
+	     i += 1)
+		b6_precond(index->slots[i & index->mask].entry);
+	__atomic_store_n(&index->slots[i & index->mask].entry,
+			 &b6_concurrent_registry_tombstone, __ATOMIC_RELEASE);
+	index->length -= 1;
+	b6_spin_unlock(&self->lock);
+}
+
+unsigned long int b6_concurrent_registry_length(
+	struct b6_concurrent_registry *self)
+{
+	unsigned long int length;
+	b6_spin_lock(&self->lock);
+	length = self->index ? self->index->length : 0;
+	b6_spin_unlock(&self->lock);
+	return length;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/ctree.h"
+
+/*
+ * This is the AVL implementation of tree.c where pointers are replaced by
+ * indices. The sentinel has index 0, which is also the parent of the root.
+ * Hence, tests whether a node is the sentinel are written on nodes rather
+ * than on their parents.
+ */
+
+static inline struct b6_ctref *at(const struct b6_ctree *tree, unsigned int i)
+{
+	return b6_ctree_ctref(tree, i);
+}
+
+static inline int get_bal(const struct b6_ctref *ctref)
+{
+	return (int)(ctref->top >> 30) - 1;
+}
+
+static inline void set_bal(struct b6_ctref *ctref, int bal)
+{
+	ctref->top = (ctref->top & B6_CTREE_MAX) | ((unsigned int)(bal + 1) << 30);
+}
+
+static inline unsigned int get_top(const struct b6_ctref *ctref)
+{
+	return ctref->top & B6_CTREE_MAX;
+}
+
+static inline void set_top(struct b6_ctref *ctref, unsigned int top)
+{
+	ctref->top = (ctref->top & ~B6_CTREE_MAX) | top;
+}
+
+static inline void swp_tag_top(struct b6_ctref *a, struct b6_ctref *b)
+{
+	unsigned int top = a->top;
+	a->top = b->top;
+	b->top = top;
+}
+
+static inline int get_dir(const struct b6_ctree *tree, unsigned int top,
+			  unsigned int ref)
+{
+	return at(tree, top)->ref[B6_NEXT] == ref ? B6_NEXT : B6_PREV;
+}
+
+static inline int avl_weight(int direction)
+{
+	return direction == B6_PREV ? -1 : 1;
+}
+
+static void rotate(struct b6_ctree *tree, unsigned int r, int dir, int opp)
+{
+	struct b6_ctref *rr = at(tree, r);
+	unsigned int p = rr->ref[opp], t = get_top(rr);
+	struct b6_ctref *pp = at(tree, p);
+	unsigned int q = pp->ref[dir];
+	if (q)
+		set_top(at(tree, q), r);
+	rr->ref[opp] = q;
+	set_top(pp, t);
+	at(tree, t)->ref[get_dir(tree, t, r)] = p;
+	set_top(rr, p);
+	pp->ref[dir] = r;
+}
+
+static unsigned int remove(struct b6_ctree *tree, unsigned int *top, int *dir)
+{
+	unsigned int ref, child, tmp;
+	struct b6_ctref *rr, *cc;
+	int direction, opposite;
+
+	ref = at(tree, *top)->ref[*dir];
+	rr = at(tree, ref);
+
+	if (!rr->ref[B6_NEXT] || !rr->ref[B6_PREV]) {
+		child = rr->ref[!rr->ref[B6_NEXT] ? B6_PREV : B6_NEXT];
+		if (child)
+			set_top(at(tree, child), *top);
+		at(tree, *top)->ref[*dir] = child;
+		return ref;
+	}
+
+	direction = !(rr->top >> 30);
+	opposite = b6_to_opposite(direction);
+
+	child = rr->ref[opposite];
+	cc = at(tree, child);
+	if (!cc->ref[direction]) {
+		at(tree, *top)->ref[*dir] = child;
+		swp_tag_top(cc, rr);
+		cc->ref[direction] = rr->ref[direction];
+		set_top(at(tree, cc->ref[direction]), child);
+		*top = child;
+		*dir = opposite;
+		return ref;
+	}
+
+	do {
+		tmp = child;
+		child = cc->ref[direction];
+		cc = at(tree, child);
+	} while (cc->ref[direction]);
+	at(tree, *top)->ref[*dir] = child;
+	swp_tag_top(cc, rr);
+	at(tree, tmp)->ref[direction] = cc->ref[opposite];
+	if (cc->ref[opposite])
+		set_top(at(tree, cc->ref[opposite]), tmp);
+	cc->ref[direction] = rr->ref[direction];
+	set_top(at(tree, cc->ref[direction]), child);
+	cc->ref[opposite] = rr->ref[opposite];
+	set_top(at(tree, cc->ref[opposite]), child);
+	*top = tmp;
+	*dir = direction;
+	return ref;
+}
+
+static int rebalance(struct b6_ctree *tree, unsigned int r, int opp)
+{
+	struct b6_ctref *rr = at(tree, r);
+	unsigned int p = rr->ref[opp];
+	struct b6_ctref *pp = at(tree, p);
+	int change = get_bal(pp);
+	int dir = b6_to_opposite(opp);
+	int weight = avl_weight(dir);
+
+	if (change == weight) {
+		struct b6_ctref *qq = at(tree, pp->ref[dir]);
+		int bal = get_bal(qq);
+		set_bal(rr, -(((bal - weight) >> 1) & bal));
+		set_bal(pp, -(((bal + weight) >> 1) & bal));
+		set_bal(qq, 0);
+		rotate(tree, p, opp, dir);
+	} else {
+		set_bal(pp, change + weight);
+		set_bal(rr, -(change + weight));
+	}
+
+	rotate(tree, r, dir, opp);
+
+	return change;
+}
+
+unsigned int b6_ctree_add(struct b6_ctree *tree, unsigned int top, int dir,
+			  unsigned int index)
+{
+	struct b6_ctref *ref = at(tree, index);
+	unsigned int curr = index;
+
+	b6_precond(index && index <= B6_CTREE_MAX);
+	b6_precond(!at(tree, top)->ref[dir]);
+
+	at(tree, top)->ref[dir] = index;
+	ref->ref[B6_NEXT] = ref->ref[B6_PREV] = 0;
+	ref->top = top;
+	set_bal(ref, 0);
+
+	while ((curr = top)) {
+		struct b6_ctref *cc = at(tree, curr);
+		int old_bal = get_bal(cc), new_bal = old_bal + avl_weight(dir);
+
+		top = get_top(cc);
+
+		if (!new_bal) {
+			set_bal(cc, 0);
+			break;
+		}
+
+		if (old_bal) {
+			new_bal /= 2;
+			set_bal(cc, new_bal);
+			rebalance(tree, curr, b6_to_direction(new_bal));
+			break;
+		}
+
+		set_bal(cc, new_bal);
+		dir = get_dir(tree, top, curr);
+	}
+
+	return index;
+}
+
+unsigned int b6_ctree_del(struct b6_ctree *tree, unsigned int top, int dir)
+{
+	unsigned int curr, ret = remove(tree, &top, &dir);
+
+	while ((curr = top)) {
+		struct b6_ctref *cc = at(tree, curr);
+		int old_bal = get_bal(cc), new_bal = old_bal - avl_weight(dir);
+
+		top = get_top(cc);
+
+		if (!old_bal) {
+			set_bal(cc, new_bal);
+			break;
+		}
+
+		dir = get_dir(tree, top, curr);
+
+		new_bal /= 2;
+		set_bal(cc, new_bal);
+		if (new_bal && !rebalance(tree, curr, b6_to_direction(new_bal)))
+			break;
+	}
+
+	return ret;
+}
+
+unsigned int b6_ctree_walk(const struct b6_ctree *tree, unsigned int index,
+			   int dir)
+{
+	int opp = b6_to_opposite(dir);
+	unsigned int child = index ? at(tree, index)->ref[dir] :
+		b6_ctree_root(tree);
+
+	if (child) {
+		while ((index = at(tree, child)->ref[opp]))
+			child = index;
+		return child;
+	}
+
+	while (index) {
+		unsigned int top = get_top(at(tree, index));
+		int done = at(tree, top)->ref[dir] != index;
+		index = top;
+		if (done)
+			break;
+	}
+
+	return index;
+}
+
+static int check(const struct b6_ctree *tree, unsigned int index)
+{
+	const struct b6_ctref *ref = at(tree, index);
+	int h[2], dir;
+
+	for (dir = 0; dir < 2; dir += 1) {
+		unsigned int child = ref->ref[dir];
+		if (!child)
+			h[dir] = 0;
+		else if (get_top(at(tree, child)) != index ||
+			 (h[dir] = check(tree, child)) < 0)
+			return -1;
+	}
+
+	if (get_bal(ref) != h[B6_NEXT] - h[B6_PREV])
+		return -1;
+	if (h[B6_NEXT] - h[B6_PREV] > 1 || h[B6_PREV] - h[B6_NEXT] > 1)
+		return -1;
+
+	return 1 + (h[B6_NEXT] > h[B6_PREV] ? h[B6_NEXT] : h[B6_PREV]);
+}
+
+int b6_ctree_check(const struct b6_ctree *tree)
+{
+	unsigned int root = b6_ctree_root(tree);
+	return root ? check(tree, root) : 0;
+}
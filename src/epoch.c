@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/epoch.h"
+
+/*
+ * Epoch Advance
+ * -------------
+ *
+ * Objects retired while the epoch is e are kept in limbo[e & 1]. Readers which
+ * observed the epoch e are counted in active[e & 1] of their stripe, active[]
+ * below standing for the sum over all stripes. The epoch only advances to
+ * e + 1 once active[(e + 1) & 1] is zero, and limbo[(e + 1) & 1] is then
+ * released.
+ *
+ * An object retired during x is thus released when advancing to x + 2, after
+ * both parities were found zero once the object was retired. A reader which
+ * may reach the object counted itself before the object was unlinked, and so
+ * before both checks, whatever the epoch it observed: one of them sees it.
+ * Readers therefore need not check that the epoch they announced is still
+ * current. A reader that did not count itself before a check reads shared
+ * objects after the writer unlinked them: the full fence before checking
+ * orders the unlinking before the check, as the atomic increment of the
+ * reader orders its counting before its reads.
+ */
+
+__thread unsigned int __b6_epoch_thread;
+
+/* number threads from 1, the first time they enter an epoch */
+unsigned int __b6_number_epoch_thread(void)
+{
+	static unsigned int threads;
+	unsigned int thread;
+	do
+		thread = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+	while (!thread);
+	return __b6_epoch_thread = thread;
+}
+
+static void release_list(struct b6_epoch *self, struct b6_sref *sref)
+{
+	while (sref) {
+		struct b6_sref *next = sref->ref;
+		self->release(self, sref);
+		sref = next;
+	}
+}
+
+static int advance(struct b6_epoch *self)
+{
+	unsigned long int e = self->epoch + 1;
+	struct b6_sref *list;
+	unsigned int i;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for (i = 0; i < B6_EPOCH_STRIPES; i += 1)
+		if (__atomic_load_n(&self->stripes[i].active[e & 1],
+				    __ATOMIC_SEQ_CST))
+			return 0;
+	list = self->limbo[e & 1];
+	self->limbo[e & 1] = NULL;
+	__atomic_store_n(&self->epoch, e, __ATOMIC_SEQ_CST);
+	release_list(self, list);
+	return 1;
+}
+
+void b6_retire_epoch_object(struct b6_epoch *self, struct b6_sref *sref)
+{
+	unsigned long int e;
+	b6_spin_lock(&self->lock);
+	e = self->epoch;
+	sref->ref = self->limbo[e & 1];
+	self->limbo[e & 1] = sref;
+	advance(self);
+	b6_spin_unlock(&self->lock);
+}
+
+int b6_reclaim_epoch(struct b6_epoch *self)
+{
+	int retval = 0;
+	if (!b6_try_spin_lock(&self->lock))
+		return retval;
+	if (advance(self) && advance(self))
+		retval = !self->limbo[0] && !self->limbo[1];
+	b6_spin_unlock(&self->lock);
+	return retval;
+}
+
+void b6_flush_epoch(struct b6_epoch *self)
+{
+	b6_spin_lock(&self->lock);
+	release_list(self, self->limbo[0]);
+	release_list(self, self->limbo[1]);
+	self->limbo[0] = self->limbo[1] = NULL;
+	b6_spin_unlock(&self->lock);
+}
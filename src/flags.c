@@ -1,6 +1,7 @@
 #include "b6/flags.h"
 
 #include "b6/registry.h"
+#include "b6/spinlock.h"
 
 #define _STRCMP(_lhs, _rhs, _cnv) \
 	const char *__lhs = _lhs; \
@@ -125,38 +126,452 @@ static char *dash_to_underscore(char *s)
 
 B6_REGISTRY_DEFINE(b6_flag_registry);
 
+/* flags defined at link time, sorted by name */
+struct b6_flag_section {
+	struct b6_flag **flags;
+	unsigned long int count;
+};
+
+/* sections of the module parsing flags and of this library, which differ
+ * when the library is a shared object */
+static struct b6_flag_section b6_sections[2];
+
+/* runtime changes are serialized, observers attached and sections indexed,
+ * under this lock */
+static struct b6_spinlock b6_flag_lock = B6_SPINLOCK_INIT;
+
+/* sift a flag down a heap of flags ordered by name */
+static void sift_down(struct b6_flag **heap, unsigned long int i,
+		      unsigned long int n)
+{
+	struct b6_flag *flag = heap[i];
+	unsigned long int j;
+	while ((j = 2 * i + 1) < n) {
+		if (j + 1 < n && b6_strcmp(heap[j]->entry.name,
+					   heap[j + 1]->entry.name) < 0)
+			j += 1;
+		if (b6_strcmp(flag->entry.name, heap[j]->entry.name) >= 0)
+			break;
+		heap[i] = heap[j];
+		i = j;
+	}
+	heap[i] = flag;
+}
+
+/* in-place heap sort, so that indexing does not allocate memory */
+static void b6_index_flag_section(struct b6_flag_section *section,
+				  struct b6_flag **begin, struct b6_flag **end)
+{
+	unsigned long int i, n = end - begin;
+	if (section->flags == begin)
+		return;
+	for (i = n / 2; i--;)
+		sift_down(begin, i, n);
+	for (i = n; i-- > 1;) {
+		struct b6_flag *flag = begin[0];
+		begin[0] = begin[i];
+		begin[i] = flag;
+		sift_down(begin, 0, i);
+	}
+	section->flags = begin;
+	section->count = n;
+}
+
+/* sections are sorted once, by the first thread to get the lock, and only
+ * read afterwards by threads which took it since */
+void b6_index_static_flags(struct b6_flag **begin, struct b6_flag **end)
+{
+	b6_spin_lock(&b6_flag_lock);
+	b6_index_flag_section(&b6_sections[0], begin, end);
+	if (__start_b6_flags != begin)
+		b6_index_flag_section(&b6_sections[1], __start_b6_flags,
+				      __stop_b6_flags);
+	b6_spin_unlock(&b6_flag_lock);
+}
+
+static struct b6_flag *b6_lookup_flag_section(
+	const struct b6_flag_section *section, const char *name)
+{
+	unsigned long int lo = 0, hi = section->count;
+	while (lo < hi) {
+		unsigned long int mid = lo + (hi - lo) / 2;
+		struct b6_flag *flag = section->flags[mid];
+		int cmp = b6_strcmp(flag->entry.name, name);
+		if (!cmp)
+			return flag;
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+static struct b6_flag *b6_lookup_static_flag(const char *name)
+{
+	struct b6_flag *flag = b6_lookup_flag_section(&b6_sections[0], name);
+	if (!flag)
+		flag = b6_lookup_flag_section(&b6_sections[1], name);
+	return flag;
+}
+
 static struct b6_flag *b6_lookup_flag(const char *name)
 {
 	struct b6_entry *entry = b6_lookup_registry(&b6_flag_registry, name);
-	return entry ? b6_cast_of(entry, struct b6_flag, entry) : NULL;
+	if (entry)
+		return b6_cast_of(entry, struct b6_flag, entry);
+	return b6_lookup_static_flag(name);
+}
+
+/* tell whether an argument is a flag or a response file */
+static int b6_is_flag_argument(const char *arg)
+{
+	return (arg[0] == '-' && arg[1] == '-') || (arg[0] == '@' && arg[1]);
+}
+
+static int b6_parse_argument(char *arg)
+{
+	char *name = arg + 2;
+	char *value;
+	struct b6_flag *flag;
+	if (*arg == '@') {
+		struct b6_flags_file file;
+		return __b6_load_flags_file(&file, arg + 1, NULL);
+	}
+	if ((value = b6_strchr(name, '=')))
+		*value++ = '\0';
+	if (!(flag = b6_lookup_flag(name)) &&
+	    !(flag = b6_lookup_flag(dash_to_underscore(name))))
+		return -1;
+	b6_parse_flag(flag, value);
+	return 0;
 }
 
-int b6_parse_command_line_flags(int argc, char *argv[], int strict)
+int __b6_parse_command_line_flags(int argc, char *argv[], int strict)
 {
+	char *failed = NULL;
 	int argn, argf;
-	for (argn = argf = 1; argn < argc; argn += 1) {
-		char *name = argv[argn];
-		char *value;
-		struct b6_flag *flag;
-		int i;
-		if (*name++ != '-' || *name++ != '-')
-			continue;
-		if (*name == '\0')
+
+	/* parse flags in order, so that the last occurrence of a flag wins */
+	for (argn = 1; argn < argc; argn += 1) {
+		char *arg = argv[argn];
+		if (arg[0] == '-' && arg[1] == '-' && !arg[2])
+			break;
+		if (b6_is_flag_argument(arg) && b6_parse_argument(arg) &&
+		    strict) {
+			failed = arg;
+			argn += 1;
+			break;
+		}
+	}
+
+	/* group flags in a single pass from the end, which keeps non-flags in
+	 * order but not flags */
+	for (argf = argn; argn-- > 1;)
+		if (!b6_is_flag_argument(argv[argn])) {
+			char *arg = argv[argn];
+			argf -= 1;
+			argv[argn] = argv[argf];
+			argv[argf] = arg;
+		}
+
+	/* strip dashes, and move the flag that was not recognized last */
+	for (argn = 1; argn < argf; argn += 1) {
+		if (argv[argn] == failed) {
+			argv[argn] = argv[argf - 1];
+			argv[argf - 1] = failed;
+		}
+		if (*argv[argn] == '-')
+			argv[argn] += 2;
+	}
+
+	return failed ? -(argf - 1) : argf;
+}
+
+static B6_LIST_DEFINE(b6_flag_observers);
+static unsigned long int b6_flags_version;
+
+unsigned long int b6_get_flags_version(void)
+{
+	return __atomic_load_n(&b6_flags_version, __ATOMIC_ACQUIRE);
+}
+
+void b6_add_flag_observer(struct b6_flag_observer *self)
+{
+	b6_spin_lock(&b6_flag_lock);
+	b6_attach_observer(&b6_flag_observers, &self->dref);
+	b6_spin_unlock(&b6_flag_lock);
+}
+
+void b6_del_flag_observer(struct b6_flag_observer *self)
+{
+	b6_spin_lock(&b6_flag_lock);
+	b6_detach_observer(&self->dref);
+	b6_spin_unlock(&b6_flag_lock);
+}
+
+static void notify_flag_changed(struct b6_flag *flag)
+{
+	b6_notify_observers(&b6_flag_observers, b6_flag_observer, changed,
+			    flag);
+}
+
+/* notify observers of the flags changed at a given version */
+static void notify_flags_changed(unsigned long int version)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+	unsigned long int i, j;
+
+	b6_setup_registry_iterator(&iter, &b6_flag_registry);
+	while ((entry = b6_get_next_registry_iterator(&iter))) {
+		struct b6_flag *flag = b6_cast_of(entry, struct b6_flag, entry);
+		if (flag->version == version)
+			notify_flag_changed(flag);
+	}
+	for (i = 0; i < b6_card_of(b6_sections); i += 1)
+		for (j = 0; j < b6_sections[i].count; j += 1)
+			if (b6_sections[i].flags[j]->version == version)
+				notify_flag_changed(b6_sections[i].flags[j]);
+}
+
+static int b6_flag_points_into(const struct b6_flag *flag, const char *begin,
+				const char *end)
+{
+	const char *value;
+	if (flag->ops != &b6_string_flag_ops)
+		return 0;
+	value = b6_read_flag(*(const char **)flag->ptr);
+	return value >= begin && value < end;
+}
+
+int __b6_flags_point_into(const char *begin, const char *end)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+	unsigned long int i, j;
+
+	b6_setup_registry_iterator(&iter, &b6_flag_registry);
+	while ((entry = b6_get_next_registry_iterator(&iter)))
+		if (b6_flag_points_into(b6_cast_of(entry, struct b6_flag,
+						   entry), begin, end))
+			return 1;
+	for (i = 0; i < b6_card_of(b6_sections); i += 1)
+		for (j = 0; j < b6_sections[i].count; j += 1)
+			if (b6_flag_points_into(b6_sections[i].flags[j], begin,
+						end))
+				return 1;
+	return 0;
+}
+
+/* parse a value without changing the variable of the flag */
+static int b6_check_flag(struct b6_flag *flag, const char *value)
+{
+	struct b6_flag copy = *flag;
+	union { long long int ll; long int l; void *p; } scratch;
+	copy.ptr = &scratch;
+	return b6_parse_flag(&copy, value);
+}
+
+static void b6_commit_flag(struct b6_flag *flag, const char *value,
+			   unsigned long int version)
+{
+	b6_parse_flag(flag, value);
+	__atomic_store_n(&flag->version, version, __ATOMIC_RELAXED);
+}
+
+int __b6_set_flag(const char *name, const char *value)
+{
+	struct b6_flag *flag = b6_lookup_flag(name);
+	unsigned long int version;
+	if (!flag)
+		return -1;
+	if (b6_check_flag(flag, value))
+		return -2;
+	b6_spin_lock(&b6_flag_lock);
+	version = b6_flags_version + 1;
+	b6_commit_flag(flag, value, version);
+	__atomic_store_n(&b6_flags_version, version, __ATOMIC_RELEASE);
+	notify_flag_changed(flag);
+	b6_spin_unlock(&b6_flag_lock);
+	return 0;
+}
+
+struct b6_flag_line {
+	char *name;
+	char *name_end;
+	char *value; /* NULL if the line has no equal sign */
+	char *value_end;
+	unsigned long int number;
+};
+
+static int b6_isblank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* find the next line setting a flag, skipping blank lines and comments */
+static char *b6_next_flag_line(char *s, struct b6_flag_line *line)
+{
+	for (;;) {
+		while (b6_isblank(*s))
+			s += 1;
+		if (*s == '#')
+			while (*s && *s != '\n')
+				s += 1;
+		if (*s != '\n')
 			break;
-		for (i = argn; i > argf; i -= 1)
-			argv[i] = argv[i - 1];
-		argv[argf] = name;
-		if ((value = b6_strchr(name, '=')))
-			*value++ = '\0';
-		if ((flag = b6_lookup_flag(name)))
-			b6_parse_flag(flag, value);
-		else if ((flag = b6_lookup_flag(dash_to_underscore(name))))
-			b6_parse_flag(flag, value);
-		else if (strict)
-			return -argf;
-		argf += 1;
-	}
-	return argf;
+		s += 1;
+		line->number += 1;
+	}
+	if (!*s)
+		return NULL;
+	if (s[0] == '-' && s[1] == '-')
+		s += 2;
+	line->name = s;
+	while (*s && *s != '=' && *s != '\n' && !b6_isblank(*s))
+		s += 1;
+	line->name_end = s;
+	while (b6_isblank(*s))
+		s += 1;
+	line->value = line->value_end = NULL;
+	if (*s == '=') {
+		for (s += 1; b6_isblank(*s); s += 1);
+		line->value = s;
+		while (*s && *s != '\n')
+			s += 1;
+		for (line->value_end = s; line->value_end > line->value &&
+		     b6_isblank(line->value_end[-1]); line->value_end -= 1);
+	}
+	return s;
+}
+
+/* copy a part of a line into a buffer, null-terminated, if it fits */
+static char *b6_copy_flag_token(char *buf, unsigned long int size,
+				const char *begin, const char *end)
+{
+	unsigned long int i, n = end - begin;
+	if (n >= size)
+		return NULL;
+	for (i = 0; i < n; i += 1)
+		buf[i] = begin[i];
+	buf[n] = '\0';
+	return buf;
+}
+
+/* look the flag of a line up from a copy of its name */
+static struct b6_flag *b6_lookup_flag_line(const struct b6_flag_line *line)
+{
+	char name[128];
+	struct b6_flag *flag;
+	if (!b6_copy_flag_token(name, sizeof(name), line->name,
+				line->name_end))
+		return NULL;
+	if (!(flag = b6_lookup_flag(name)))
+		flag = b6_lookup_flag(dash_to_underscore(name));
+	return flag;
+}
+
+/* set the flag of a line, or only check its value if version is 0: string
+ * flags point into the text and get their value null-terminated there when
+ * set, other values are parsed from a copy */
+static int b6_apply_flag_line(struct b6_flag *flag,
+			      const struct b6_flag_line *line,
+			      unsigned long int version)
+{
+	char buf[128];
+	const char *value = line->value;
+	if (value && flag->ops == &b6_string_flag_ops) {
+		if (version)
+			*line->value_end = '\0';
+	} else if (value && !(value = b6_copy_flag_token(buf, sizeof(buf),
+							   line->value,
+							   line->value_end)))
+		return -1;
+	if (!version)
+		return b6_check_flag(flag, value);
+	b6_commit_flag(flag, value, version);
+	return 0;
+}
+
+int __b6_reload_flags(char *text)
+{
+	struct b6_flag_line line;
+	unsigned long int version;
+	char *s;
+
+	/* check every line without writing to the text, so that mapped files
+	 * are only copied where string values get null-terminated */
+	line.number = 1;
+	for (s = text; (s = b6_next_flag_line(s, &line));) {
+		struct b6_flag *flag;
+		if (*s && *s != '\n')
+			return -line.number;
+		if (!(flag = b6_lookup_flag_line(&line)) ||
+		    b6_apply_flag_line(flag, &line, 0))
+			return -line.number;
+	}
+
+	b6_spin_lock(&b6_flag_lock);
+	version = b6_flags_version + 1;
+	for (s = text; (s = b6_next_flag_line(s, &line));) {
+		/* terminating the value may overwrite the end of line */
+		int newline = *s == '\n';
+		b6_apply_flag_line(b6_lookup_flag_line(&line), &line, version);
+		s += newline;
+	}
+	__atomic_store_n(&b6_flags_version, version, __ATOMIC_RELEASE);
+	notify_flags_changed(version);
+	b6_spin_unlock(&b6_flag_lock);
+	return 0;
+}
+
+/* find the flag an environment variable refers to, if it has the prefix */
+static int b6_lookup_environment_flag(const char *var, const char *prefix,
+				      struct b6_flag **flag,
+				      const char **value)
+{
+	char name[128];
+	unsigned int i;
+	for (; *prefix; prefix += 1, var += 1)
+		if (*var != *prefix)
+			return 0;
+	for (i = 0; *var != '=' && *var; i += 1, var += 1) {
+		if (i == sizeof(name) - 1)
+			return -1;
+		name[i] = b6_tolower(*var);
+	}
+	if (!*var)
+		return -1;
+	name[i] = '\0';
+	*value = var + 1;
+	if (!(*flag = b6_lookup_flag(name)) || b6_check_flag(*flag, *value))
+		return -1;
+	return 1;
+}
+
+int __b6_parse_environment_flags(char *envp[], const char *prefix)
+{
+	struct b6_flag *flag;
+	const char *value;
+	unsigned long int version;
+	int i;
+
+	for (i = 0; envp[i]; i += 1)
+		if (b6_lookup_environment_flag(envp[i], prefix, &flag,
+					       &value) < 0)
+			return -(i + 1);
+
+	b6_spin_lock(&b6_flag_lock);
+	version = b6_flags_version + 1;
+	for (i = 0; envp[i]; i += 1)
+		if (b6_lookup_environment_flag(envp[i], prefix, &flag,
+					       &value) > 0)
+			b6_commit_flag(flag, value, version);
+	__atomic_store_n(&b6_flags_version, version, __ATOMIC_RELEASE);
+	notify_flags_changed(version);
+	b6_spin_unlock(&b6_flag_lock);
+	return 0;
 }
 
 #define INT_OPS(type) \
@@ -169,7 +584,7 @@ int b6_parse_command_line_flags(int argc, char *argv[], int strict)
 			return retval; \
 		if ((type)val != val) \
 			return -2; \
-		*(type*)flag->ptr = val; \
+		__atomic_store_n((type*)flag->ptr, val, __ATOMIC_RELAXED); \
 		return 0; \
 	} \
 	const struct b6_flag_ops b6_ ## type ## _flag_ops = { \
@@ -184,7 +599,8 @@ int b6_parse_command_line_flags(int argc, char *argv[], int strict)
 			return retval; \
 		if ((type)val != val) \
 			return -2; \
-		*(unsigned type*)flag->ptr = val; \
+		__atomic_store_n((unsigned type*)flag->ptr, val, \
+				 __ATOMIC_RELAXED); \
 		return 0; \
 	} \
 	const struct b6_flag_ops b6_u ## type ## _flag_ops = { \
@@ -195,6 +611,114 @@ INT_OPS(short);
 INT_OPS(int);
 INT_OPS(long);
 
+/* parse leading decimal digits, and point to what follows them */
+static int b6_strtoull_prefix(unsigned long long int *n, const char **s)
+{
+	unsigned long long int num = 0;
+	const char *str = *s;
+	if (*str < '0' || *str > '9')
+		return -1;
+	do {
+		unsigned int val = *str++ - '0';
+		if (num > (~0ULL - val) / 10)
+			return -2; /* overflow */
+		num = num * 10 + val;
+	} while (*str >= '0' && *str <= '9');
+	*n = num;
+	*s = str;
+	return 0;
+}
+
+/* multiply a number by a unit, checking for overflow */
+static int b6_scale(unsigned long long int *n, unsigned long long int unit)
+{
+	if (*n > ~0ULL / unit)
+		return -2;
+	*n *= unit;
+	return 0;
+}
+
+static int b6_parse_size_flag(struct b6_flag *flag, const char *value)
+{
+	static const char units[] = "kmgt";
+	unsigned long long int val, unit = 1;
+	const char *unit_ptr;
+	int retval;
+	if ((retval = b6_strtoull_prefix(&val, &value)))
+		return retval;
+	if (*value && (unit_ptr = b6_strchr(units, b6_tolower(*value)))) {
+		unit <<= 10 * (unit_ptr - units + 1);
+		value += 1;
+		if (*value == 'i')
+			value += 1;
+	}
+	if ((*value | 32) == 'b')
+		value += 1;
+	if (*value)
+		return -1;
+	if ((retval = b6_scale(&val, unit)))
+		return retval;
+	if ((b6_flag_type_size)val != val)
+		return -2;
+	__atomic_store_n((b6_flag_type_size*)flag->ptr, val, __ATOMIC_RELAXED);
+	return 0;
+}
+
+const struct b6_flag_ops b6_size_flag_ops = {
+	.parse = b6_parse_size_flag,
+};
+
+static int b6_parse_duration_flag(struct b6_flag *flag, const char *value)
+{
+	static const struct {
+		const char *suffix;
+		unsigned long long int unit;
+	} units[] = {
+		{ "", 1ULL },
+		{ "us", 1ULL },
+		{ "ms", 1000ULL },
+		{ "s", 1000000ULL },
+		{ "m", 60000000ULL },
+		{ "h", 3600000000ULL },
+	};
+	unsigned long long int val;
+	unsigned int i;
+	int retval;
+	if ((retval = b6_strtoull_prefix(&val, &value)))
+		return retval;
+	for (i = 0; i < b6_card_of(units); i += 1)
+		if (!b6_strcasecmp(value, units[i].suffix))
+			break;
+	if (i == b6_card_of(units))
+		return -1;
+	if ((retval = b6_scale(&val, units[i].unit)))
+		return retval;
+	__atomic_store_n((b6_flag_type_duration*)flag->ptr, val,
+			 __ATOMIC_RELAXED);
+	return 0;
+}
+
+const struct b6_flag_ops b6_duration_flag_ops = {
+	.parse = b6_parse_duration_flag,
+};
+
+static int b6_parse_growth_flag(struct b6_flag *flag, const char *value)
+{
+	long unsigned int val;
+	int retval = b6_strtoul(&val, value, 10);
+	if (retval)
+		return retval;
+	if (val < 1 || val > B6_MAX_GROWTH)
+		return -2;
+	__atomic_store_n((b6_flag_type_growth*)flag->ptr, val,
+			 __ATOMIC_RELAXED);
+	return 0;
+}
+
+const struct b6_flag_ops b6_growth_flag_ops = {
+	.parse = b6_parse_growth_flag,
+};
+
 static int b6_parse_bool_flag(struct b6_flag *flag, const char *value)
 {
 	int *ptr = flag->ptr;
@@ -204,7 +728,7 @@ static int b6_parse_bool_flag(struct b6_flag *flag, const char *value)
 	    !b6_strcasecmp(value, "on") ||
 	    !b6_strcasecmp(value, "yes") ||
 	    !b6_strcasecmp(value, "true")) {
-		*ptr = 1;
+		__atomic_store_n(ptr, 1, __ATOMIC_RELAXED);
 		return 0;
 	}
 	if (!b6_strcmp(value, "0") ||
@@ -212,7 +736,7 @@ static int b6_parse_bool_flag(struct b6_flag *flag, const char *value)
 	    !b6_strcasecmp(value, "off") ||
 	    !b6_strcasecmp(value, "no") ||
 	    !b6_strcasecmp(value, "false")) {
-		*ptr = 0;
+		__atomic_store_n(ptr, 0, __ATOMIC_RELAXED);
 		return 0;
 	}
 	return -1;
@@ -224,7 +748,7 @@ const struct b6_flag_ops b6_bool_flag_ops = {
 
 static int b6_parse_string_flag(struct b6_flag* flag, const char *value)
 {
-	*(const char**)flag->ptr = value;
+	__atomic_store_n((const char**)flag->ptr, value, __ATOMIC_RELAXED);
 	return 0;
 }
 
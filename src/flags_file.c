@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/flags.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int __b6_load_flags_file(struct b6_flags_file *self, const char *path,
+			 unsigned long int *line)
+{
+	struct stat st;
+	unsigned long int size, page;
+	char *text;
+	int fd, retval;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return -1;
+	}
+	if (!(size = st.st_size)) {
+		close(fd);
+		self->text = NULL;
+		self->size = 0;
+		return 0;
+	}
+	/* map the file over zeroed memory one page larger at least, so that
+	 * the text is null-terminated even when its size is a multiple of the
+	 * page size */
+	page = sysconf(_SC_PAGESIZE);
+	size = (size / page + 1) * page;
+	text = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (text == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+	if (mmap(text, st.st_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(text, size);
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	/* pages are private: parsing does not write to them but to
+	 * null-terminate values of string flags, so only the pages holding
+	 * such values get copied */
+	if ((retval = __b6_reload_flags(text))) {
+		munmap(text, size);
+		if (line)
+			*line = -retval;
+		return -2;
+	}
+	self->text = text;
+	self->size = size;
+	b6_release_flags_file(self);
+	return 0;
+}
+
+int b6_release_flags_file(struct b6_flags_file *self)
+{
+	if (!self->text)
+		return 0;
+	if (__b6_flags_point_into(self->text, self->text + self->size))
+		return -1;
+	munmap(self->text, self->size);
+	self->text = NULL;
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/frozen.h"
+
+/*
+ * Eytzinger Layout
+ * ----------------
+ *
+ * The implicit tree is complete: its root is at index 1 and the children of
+ * index i are at 2i and 2i+1. Traveling it in order while pulling keys from
+ * the sorted sequence places each key where a binary search expects it.
+ */
+struct builder {
+	unsigned long long int *keys;
+	unsigned int *ranks;
+	unsigned long int length;
+	unsigned long int rank;
+	unsigned long long int (*next)(struct builder*);
+	const unsigned long long int *array;
+	const struct b6_tree *tree;
+	const struct b6_tref *tref;
+	unsigned long long int (*get_key)(const struct b6_tref*, void*);
+	void *arg;
+};
+
+static void fill(struct builder *self, unsigned long int i)
+{
+	while (i <= self->length) {
+		fill(self, 2 * i);
+		self->keys[i] = self->next(self);
+		self->ranks[i] = self->rank++;
+		i = 2 * i + 1;
+	}
+}
+
+static int build(struct b6_frozen *self, struct b6_allocator *allocator,
+		 struct builder *builder)
+{
+	struct b6_frozen_header *header;
+	unsigned long int length = builder->length;
+	void *image;
+
+	if (length >= ~0U)
+		return -1;
+
+	/* allocators only guarantee the alignment of basic types */
+	if (!(image = b6_allocate(allocator, b6_frozen_image_size(length) +
+				  B6_FROZEN_ALIGNMENT - 1)))
+		return -2;
+	header = (struct b6_frozen_header *)
+		(((unsigned long int)image + B6_FROZEN_ALIGNMENT - 1) &
+		 ~(unsigned long int)(B6_FROZEN_ALIGNMENT - 1));
+
+	header->magic = B6_FROZEN_MAGIC;
+	header->length = length;
+	builder->keys = (unsigned long long int *)(header + 1);
+	builder->ranks = (unsigned int *)(builder->keys + length + 1);
+	builder->keys[0] = 0;
+	builder->ranks[0] = length;
+	builder->rank = 0;
+	fill(builder, 1);
+
+	self->keys = builder->keys;
+	self->ranks = builder->ranks;
+	self->length = length;
+	self->image = image;
+	return 0;
+}
+
+static unsigned long long int next_array_key(struct builder *self)
+{
+	return self->array[self->rank];
+}
+
+int b6_freeze_array(struct b6_frozen *self, struct b6_allocator *allocator,
+		    const unsigned long long int *keys,
+		    unsigned long int length)
+{
+	struct builder builder;
+	builder.length = length;
+	builder.next = next_array_key;
+	builder.array = keys;
+	return build(self, allocator, &builder);
+}
+
+static unsigned long long int next_tree_key(struct builder *self)
+{
+	self->tref = b6_tree_walk(self->tree, self->tref, B6_NEXT);
+	return self->get_key(self->tref, self->arg);
+}
+
+int b6_freeze_tree(struct b6_frozen *self, struct b6_allocator *allocator,
+		   const struct b6_tree *tree,
+		   unsigned long long int (*get_key)(const struct b6_tref*,
+						     void*),
+		   void *arg)
+{
+	struct builder builder;
+	const struct b6_tref *tref;
+
+	builder.length = 0;
+	for (tref = b6_tree_first(tree); tref != b6_tree_tail(tree);
+	     tref = b6_tree_walk(tree, tref, B6_NEXT))
+		builder.length += 1;
+
+	builder.next = next_tree_key;
+	builder.tree = tree;
+	builder.tref = b6_tree_head(tree);
+	builder.get_key = get_key;
+	builder.arg = arg;
+	return build(self, allocator, &builder);
+}
+
+int b6_load_frozen(struct b6_frozen *self, const void *image,
+		   unsigned long int size)
+{
+	const struct b6_frozen_header *header = image;
+	unsigned long int length;
+
+	if ((unsigned long int)image & 7)
+		return -1;
+
+	if (size < sizeof(*header) || header->magic != B6_FROZEN_MAGIC)
+		return -1;
+
+	length = header->length;
+	if (length >= ~0U || size < b6_frozen_image_size(length))
+		return -1;
+
+	self->keys = (const unsigned long long int *)(header + 1);
+	self->ranks = (const unsigned int *)(self->keys + length + 1);
+	self->length = length;
+	self->image = NULL;
+	return 0;
+}
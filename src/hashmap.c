@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/hashmap.h"
+
+static unsigned char *ctrl_of(const struct b6_hashmap *self)
+{
+	return self->ctrl.buffer;
+}
+
+static unsigned char *entry_at(const struct b6_hashmap *self,
+			       unsigned long int index)
+{
+	return self->slots.buffer + index * self->slots.itemsize;
+}
+
+static void copy_entry(unsigned char *dst, const unsigned char *src,
+		       unsigned long int size)
+{
+	while (size--)
+		*dst++ = *src++;
+}
+
+/* return the first empty or deleted slot on the probe sequence of a hash */
+static unsigned long int find_free(const struct b6_hashmap *self,
+				   unsigned long int hash)
+{
+	unsigned long int mask = self->ctrl.length / B6_HASHMAP_GROUP - 1;
+	unsigned long int group = (hash >> 7) & mask, step = 0;
+	unsigned int bits;
+
+	while (!(bits = __b6_hashmap_free(ctrl_of(self) +
+					  group * B6_HASHMAP_GROUP))) {
+		step += 1;
+		group = (group + step) & mask;
+	}
+	return group * B6_HASHMAP_GROUP + __builtin_ctz(bits);
+}
+
+/* move entries to new arrays of the same size if there are many tombstones,
+ * of twice the size otherwise */
+static int rehash(struct b6_hashmap *self)
+{
+	struct b6_hashmap copy = *self;
+	unsigned long int capacity = self->ctrl.length, index;
+	unsigned char *ctrl;
+
+	if (!capacity)
+		capacity = B6_HASHMAP_GROUP;
+	else if (self->length >= B6_HASHMAP_MAX_LOAD(capacity) / 2)
+		capacity *= 2;
+
+	b6_array_initialize(&copy.ctrl, self->ctrl.allocator, 1);
+	b6_array_initialize(&copy.slots, self->slots.allocator,
+			    self->slots.itemsize);
+	if (!(ctrl = b6_array_extend(&copy.ctrl, capacity)))
+		return -1;
+	if (!b6_array_extend(&copy.slots, capacity)) {
+		b6_array_finalize(&copy.ctrl);
+		return -1;
+	}
+	for (index = 0; index < capacity; index += 1)
+		ctrl[index] = __B6_HASHMAP_EMPTY;
+
+	for (index = 0; index < self->ctrl.length; index += 1) {
+		const unsigned char *entry = entry_at(self, index);
+		unsigned long int hash, slot;
+		if (ctrl_of(self)[index] & 0x80)
+			continue;
+		hash = self->hash(entry);
+		slot = find_free(&copy, hash);
+		ctrl[slot] = hash & 0x7f;
+		copy_entry(entry_at(&copy, slot), entry, self->slots.itemsize);
+	}
+
+	b6_hashmap_finalize(self);
+	copy.growth = B6_HASHMAP_MAX_LOAD(capacity) - self->length;
+	*self = copy;
+	return 0;
+}
+
+void *__b6_hashmap_add(struct b6_hashmap *self, unsigned long int hash)
+{
+	unsigned long int slot;
+
+	if (!self->growth && rehash(self))
+		return NULL;
+	slot = find_free(self, hash);
+	if (ctrl_of(self)[slot] == __B6_HASHMAP_EMPTY)
+		self->growth -= 1;
+	ctrl_of(self)[slot] = hash & 0x7f;
+	self->length += 1;
+	return entry_at(self, slot);
+}
+
+void b6_hashmap_erase(struct b6_hashmap *self, void *entry)
+{
+	unsigned long int index = ((unsigned char *)entry - self->slots.buffer) /
+		self->slots.itemsize;
+	unsigned char *group = ctrl_of(self) +
+		index / B6_HASHMAP_GROUP * B6_HASHMAP_GROUP;
+
+	/* no probe sequence goes past a group having an empty slot */
+	if (__b6_hashmap_match(group, __B6_HASHMAP_EMPTY)) {
+		ctrl_of(self)[index] = __B6_HASHMAP_EMPTY;
+		self->growth += 1;
+	} else
+		ctrl_of(self)[index] = __B6_HASHMAP_DELETED;
+	self->length -= 1;
+}
+
+static void *scan(const struct b6_hashmap *self, unsigned long int index)
+{
+	for (; index < self->ctrl.length; index += 1)
+		if (!(ctrl_of(self)[index] & 0x80))
+			return entry_at(self, index);
+	return NULL;
+}
+
+void *b6_hashmap_first(const struct b6_hashmap *self)
+{
+	return scan(self, 0);
+}
+
+void *b6_hashmap_next(const struct b6_hashmap *self, const void *entry)
+{
+	return scan(self, ((const unsigned char *)entry - self->slots.buffer) /
+		    self->slots.itemsize + 1);
+}
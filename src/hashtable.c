@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/hashtable.h"
+
+/* move a few former buckets to the current array, releasing it once empty */
+static void migrate(struct b6_hashtable *self)
+{
+	struct b6_array *former = &self->array[1];
+	struct b6_href **buckets = (struct b6_href **)self->array[0].buffer;
+	struct b6_href **old = (struct b6_href **)former->buffer;
+	unsigned long int mask = self->array[0].length - 1;
+	unsigned long int n = B6_HASHTABLE_STEP;
+
+	if (!former->length)
+		return;
+
+	for (; n && self->moved < former->length; n -= 1, self->moved += 1) {
+		struct b6_href *href, *next;
+		/* the two buckets the former one splits into */
+		buckets[self->moved] = NULL;
+		buckets[self->moved + former->length] = NULL;
+		for (href = old[self->moved]; href; href = next) {
+			struct b6_href **bucket = &buckets[href->hash & mask];
+			next = href->ref;
+			href->ref = *bucket;
+			*bucket = href;
+		}
+	}
+
+	if (self->moved < former->length)
+		return;
+	b6_array_finalize(former);
+	b6_array_initialize(former, self->array[0].allocator, sizeof(void*));
+	self->moved = 0;
+}
+
+static int grow(struct b6_hashtable *self)
+{
+	struct b6_array array;
+	struct b6_href **buckets;
+	unsigned long int length = self->array[0].length;
+
+	while (self->array[1].length)
+		migrate(self);
+
+	b6_array_initialize(&array, self->array[0].allocator, sizeof(void*));
+	buckets = b6_array_extend(&array, length ? 2 * length : B6_HASHTABLE_MIN);
+	if (!buckets)
+		return -1;
+
+	/* buckets are cleared when split from former ones */
+	if (!length)
+		for (; length < B6_HASHTABLE_MIN; length += 1)
+			buckets[length] = NULL;
+
+	b6_array_swap(&self->array[0], &self->array[1]);
+	b6_array_swap(&self->array[0], &array);
+	self->moved = 0;
+	return 0;
+}
+
+int __b6_hashtable_add(struct b6_hashtable *self, struct b6_href *href)
+{
+	struct b6_href **bucket;
+
+	if (self->length >= self->array[0].length && grow(self) &&
+	    !self->array[0].length)
+		return -1;
+	migrate(self);
+
+	bucket = __b6_hashtable_bucket(self, href->hash);
+	href->ref = *bucket;
+	*bucket = href;
+	self->length += 1;
+	return 0;
+}
+
+void b6_hashtable_remove(struct b6_hashtable *self, struct b6_href *href)
+{
+	struct b6_href **bucket = __b6_hashtable_bucket(self, href->hash);
+
+	while (*bucket != href)
+		bucket = &(*bucket)->ref;
+	*bucket = href->ref;
+	self->length -= 1;
+}
+
+/* find the first element from a bucket of the former or current array */
+static struct b6_href *scan(const struct b6_hashtable *self, int former,
+			    unsigned long int index)
+{
+	const struct b6_array *array = &self->array[1];
+	struct b6_href **buckets;
+
+	if (former) {
+		buckets = (struct b6_href **)array->buffer;
+		for (; index < array->length; index += 1)
+			if (buckets[index])
+				return buckets[index];
+		index = 0;
+	}
+
+	buckets = (struct b6_href **)self->array[0].buffer;
+	for (; index < self->array[0].length; index += 1) {
+		/* skip buckets not split from former ones yet */
+		if (array->length && (index & (array->length - 1)) >= self->moved)
+			continue;
+		if (buckets[index])
+			return buckets[index];
+	}
+	return NULL;
+}
+
+struct b6_href *b6_hashtable_first(const struct b6_hashtable *self)
+{
+	return scan(self, 1, self->moved);
+}
+
+struct b6_href *b6_hashtable_next(const struct b6_hashtable *self,
+				  const struct b6_href *href)
+{
+	const struct b6_array *array = &self->array[1];
+	unsigned long int index;
+
+	if (href->ref)
+		return href->ref;
+	if (array->length) {
+		index = href->hash & (array->length - 1);
+		if (index >= self->moved)
+			return scan(self, 1, index + 1);
+	}
+	return scan(self, 0, (href->hash & (self->array[0].length - 1)) + 1);
+}
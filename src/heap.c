@@ -5,6 +5,7 @@ static void b6_heap_xchg(struct b6_heap *self, void **buf,
 			 unsigned long int i, unsigned long int j)
 {
 	void *temp = buf[i];
+	b6_count(self, sifts, 1);
 	buf[i] = buf[j];
 	buf[j] = temp;
 }
@@ -21,6 +22,7 @@ static unsigned long int b6_heap_rise(struct b6_heap *self, void **buf,
 				      unsigned long int i)
 {
 	unsigned long int j = (i - 1) / 2;
+	b6_count(self, comparisons, 1);
 	return self->compare(buf[i], buf[j]) < 0 ? j : i;
 }
 
@@ -51,7 +53,7 @@ void b6_heap_do_boost(struct b6_heap *self, void **buf, unsigned long int i)
 		}
 }
 
-static unsigned long int b6_heap_dive(const struct b6_heap *self,
+static unsigned long int b6_heap_dive(struct b6_heap *self,
 				      void **buf, unsigned long int len,
 				      unsigned long int i)
 {
@@ -60,9 +62,13 @@ static unsigned long int b6_heap_dive(const struct b6_heap *self,
 	unsigned long int r = l + 1;
 	if (l >= len)
 		goto bail_out;
+	b6_count(self, comparisons, 1);
 	if (self->compare(buf[m], buf[l]) > 0)
 		m = l;
-	if (r < len && self->compare(buf[m], buf[r]) > 0)
+	if (r >= len)
+		goto bail_out;
+	b6_count(self, comparisons, 1);
+	if (self->compare(buf[m], buf[r]) > 0)
 		m = r;
 bail_out:
 	return m;
@@ -102,3 +108,12 @@ void b6_heap_do_make(struct b6_heap *self)
 				b6_heap_xchg(self, buf, i, j);
 		while (k--);
 }
+
+void b6_heap_stats(const struct b6_heap *self, struct b6_stats *stats)
+{
+	unsigned long int n;
+	__b6_setup_stats(stats, __b6_counters_of(self));
+	stats->size = b6_heap_length(self);
+	for (n = stats->size; n; n /= 2)
+		stats->height += 1;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/intern.h"
+
+int b6_intern_initialize(struct b6_intern *self,
+			 struct b6_allocator *allocator)
+{
+	b6_setup_registry(&self->registry);
+	if (b6_hash_registry(&self->registry, allocator, 0))
+		return -1;
+	b6_arena_initialize(&self->arena, allocator, B6_INTERN_CHUNK_SIZE);
+	return 0;
+}
+
+void b6_intern_finalize(struct b6_intern *self)
+{
+	b6_hashtable_finalize(&self->registry.table);
+	b6_arena_finalize(&self->arena);
+}
+
+const char *b6_intern_hashed(struct b6_intern *self, const char *s,
+			     unsigned long int hash, unsigned long int length)
+{
+	struct b6_interned *interned;
+	const char *name = b6_lookup_interned_hashed(self, s, hash, length);
+
+	if (name)
+		return name;
+	interned = b6_arena_get(&self->arena, sizeof(*interned) + length + 1);
+	if (!interned)
+		return NULL;
+	__builtin_memcpy(interned->name, s, length + 1);
+	/* on failure, the copy is lost until the arena is released */
+	if (b6_register_hashed(&self->registry, &interned->entry,
+			       interned->name, hash, length))
+		return NULL;
+	return interned->name;
+}
@@ -5,6 +5,9 @@
 
 #include "b6/list.h"
 
+#define compare(list, comp, lhs, rhs) \
+	(b6_count(list, comparisons, 1), comp(lhs, rhs))
+
 unsigned long int b6_list_length(const struct b6_list *list)
 {
 	unsigned long int length = 0;
@@ -17,6 +20,20 @@ unsigned long int b6_list_length(const struct b6_list *list)
 	return length;
 }
 
+void b6_list_clear(struct b6_list *list,
+		   void (*release)(struct b6_dref*, void*), void *arg)
+{
+	struct b6_dref *dref = b6_list_first(list);
+	struct b6_dref *tail = b6_list_tail(list);
+	b6_list_initialize(list);
+	if (release)
+		while (dref != tail) {
+			struct b6_dref *next = b6_list_walk(dref, B6_NEXT);
+			release(dref, arg);
+			dref = next;
+		}
+}
+
 void __b6_list_msort(struct b6_list *list, b6_compare_t comp,
 		     unsigned long int length)
 {
@@ -34,15 +51,19 @@ void __b6_list_msort(struct b6_list *list, b6_compare_t comp,
 	b6_list_move(b6_list_first(list), b6_list_last(list),
 		     b6_list_tail(&rlist));
 
-	if (llen > 1)
+	if (llen > 1) {
 		__b6_list_msort(&llist, comp, llen);
+		b6_count(list, comparisons, llist.counters.comparisons);
+	}
 
-	if (rlen > 1)
+	if (rlen > 1) {
 		__b6_list_msort(&rlist, comp, rlen);
+		b6_count(list, comparisons, rlist.counters.comparisons);
+	}
 
 	lref = b6_list_first(&llist);
 	rref = b6_list_first(&rlist);
-	if (comp(lref, rref) >= 0)
+	if (compare(list, comp, lref, rref) >= 0)
 		goto shift;
 
 merge:
@@ -54,7 +75,7 @@ merge:
 		b6_list_move(rref, b6_list_last(&rlist), b6_list_tail(list));
 		b6_list_move(lref, b6_list_last(&llist), b6_list_tail(list));
 		return;
-	} while (comp(dref, lref) >= 0);
+	} while (compare(list, comp, dref, lref) >= 0);
 	b6_list_move(rref, b6_list_walk(dref, B6_PREV), b6_list_tail(list));
 	rref = dref;
 
@@ -67,7 +88,7 @@ shift:
 		b6_list_move(lref, b6_list_last(&llist), b6_list_tail(list));
 		b6_list_move(rref, b6_list_last(&rlist), b6_list_tail(list));
 		return;
-	} while (comp(dref, rref) >= 0);
+	} while (compare(list, comp, dref, rref) >= 0);
 	b6_list_move(lref, b6_list_walk(dref, B6_PREV), b6_list_tail(list));
 	lref = dref;
 
@@ -83,7 +104,7 @@ void b6_list_qsort(struct b6_list *list, b6_compare_t comp)
 	do {
 		prev = next;
 		next = b6_list_walk(prev, B6_NEXT);
-		if (comp(dref, prev) >= 0)
+		if (compare(list, comp, dref, prev) >= 0)
 			continue;
 		if (pivot != prev) {
 			b6_list_del(prev);
@@ -109,6 +130,7 @@ void b6_list_qsort(struct b6_list *list, b6_compare_t comp)
 		B6_LIST_DEFINE(temp);
 		b6_list_move(dref, prev, b6_list_tail(&temp));
 		b6_list_qsort(&temp, comp);
+		b6_count(list, comparisons, temp.counters.comparisons);
 		b6_list_move(b6_list_first(&temp), b6_list_last(&temp), pivot);
 	}
 
@@ -118,7 +140,14 @@ void b6_list_qsort(struct b6_list *list, b6_compare_t comp)
 		B6_LIST_DEFINE(temp);
 		b6_list_move(next, dref, b6_list_tail(&temp));
 		b6_list_qsort(&temp, comp);
+		b6_count(list, comparisons, temp.counters.comparisons);
 		b6_list_move(b6_list_first(&temp), b6_list_last(&temp),
 			     b6_list_tail(list));
 	}
 }
+
+void b6_list_stats(const struct b6_list *list, struct b6_stats *stats)
+{
+	__b6_setup_stats(stats, __b6_counters_of(list));
+	stats->size = b6_list_length(list);
+}
@@ -4,6 +4,13 @@
  */
 
 #include "b6/pool.h"
+#include "b6/flags.h"
+
+/* referring to the flag ops weakly does not link flags parsing in */
+#pragma weak b6_size_flag_ops
+
+unsigned long int b6_pool_chunk_size = 4096;
+b6_static_flag(b6_pool_chunk_size, size);
 
 static void initialize_chunk(struct b6_pool *pool, struct b6_chunk *chunk)
 {
@@ -198,13 +205,19 @@ int b6_pool_initialize(struct b6_pool *pool, struct b6_allocator *allocator,
 	b6_assert(!(size % sizeof(struct b6_sref)));
 
 	/* calculate and/or check chunk_size */
-	b6_static_assert(sizeof(struct b6_chunk) < 4096 - sizeof(void*));
 	if (!chunk_size) {
-		for (chunk_size = 4096; chunk_size - sizeof(struct b6_chunk) -
-		     sizeof(void*) < size; chunk_size *= 2)
-			if (!chunk_size)
+		unsigned long int base = b6_read_flag(b6_pool_chunk_size);
+		if (!base)
+			base = 4096;
+		while (base < sizeof(struct b6_chunk) + sizeof(void*) + size) {
+			if (base > ~0UL / 2)
 				return -1;
-		chunk_size -= sizeof(void*);
+			base *= 2;
+		}
+		base -= sizeof(void*);
+		if ((unsigned)base != base)
+			return -1;
+		chunk_size = base;
 	} else if (chunk_size < sizeof(struct b6_chunk) ||
 		   chunk_size - sizeof(struct b6_chunk) < size)
 		return -1;
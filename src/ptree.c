@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/ptree.h"
+
+/*
+ * Persistent Tree Updates
+ * -----------------------
+ *
+ * Nodes created by the update in progress are tagged with the new version
+ * number and can be modified freely as no reader can reach them yet. Other
+ * nodes are copied before being modified. Nodes are taken from a reserve
+ * kept by the tree across updates and topped up beforehand to the height of
+ * the tree plus one, which is all an insertion ever copies since rotations
+ * then only move nodes of the path, plus two for a removal to rotate once.
+ * Removals rotating more than once allocate the nodes they lack on the way.
+ * Should it fail, the update is cancelled: the nodes it created are not
+ * reachable from the tree nor referenced yet, so they just go back to the
+ * reserve.
+ *
+ * Reference counts of the nodes of the new version are only computed when it
+ * is about to be published: each new node adds a reference to each of its
+ * children. The new root gets the reference of the tree, whereas the former
+ * root loses it once retired from the epoch.
+ */
+struct update {
+	struct b6_ptree *tree;
+	struct b6_sref *owned;
+	unsigned long int version;
+};
+
+static int setup_update(struct update *self, struct b6_ptree *tree)
+{
+	unsigned long int n = (tree->root ? tree->root->height : 0) + 3;
+	self->tree = tree;
+	self->owned = NULL;
+	self->version = tree->version + 1;
+	while (tree->spare < n) {
+		struct b6_pnode *node = b6_allocate(tree->allocator,
+						    sizeof(*node));
+		if (!node)
+			return -1;
+		node->sref.ref = tree->reserve;
+		tree->reserve = &node->sref;
+		tree->spare += 1;
+	}
+	return 0;
+}
+
+static void cancel_update(struct update *self)
+{
+	struct b6_ptree *tree = self->tree;
+	while (self->owned) {
+		struct b6_sref *sref = self->owned;
+		self->owned = sref->ref;
+		sref->ref = tree->reserve;
+		tree->reserve = sref;
+		tree->spare += 1;
+	}
+}
+
+static int get_height(const struct b6_pnode *node)
+{
+	return node ? node->height : 0;
+}
+
+static void fix_height(struct b6_pnode *node)
+{
+	int h1 = get_height(node->ref[B6_PREV]);
+	int h2 = get_height(node->ref[B6_NEXT]);
+	node->height = 1 + (h1 > h2 ? h1 : h2);
+}
+
+static struct b6_pnode *new_node(struct update *self, const void *key,
+				 const void *value, struct b6_pnode *prev,
+				 struct b6_pnode *next)
+{
+	struct b6_ptree *tree = self->tree;
+	struct b6_pnode *node;
+	if (tree->reserve) {
+		node = b6_cast_of(tree->reserve, struct b6_pnode, sref);
+		tree->reserve = tree->reserve->ref;
+		tree->spare -= 1;
+	} else if (!(node = b6_allocate(tree->allocator, sizeof(*node))))
+		return NULL;
+	node->sref.ref = self->owned;
+	self->owned = &node->sref;
+	node->key = (void *)key;
+	node->value = (void *)value;
+	node->ref[B6_PREV] = prev;
+	node->ref[B6_NEXT] = next;
+	node->count = 0;
+	node->version = self->version;
+	fix_height(node);
+	return node;
+}
+
+static struct b6_pnode *own(struct update *self, struct b6_pnode *node)
+{
+	if (node->version == self->version)
+		return node;
+	return new_node(self, node->key, node->value, node->ref[B6_PREV],
+			node->ref[B6_NEXT]);
+}
+
+/* raise the child of an owned node in direction dir, which must be owned */
+static struct b6_pnode *rotate(struct b6_pnode *node, int dir)
+{
+	int opp = b6_to_opposite(dir);
+	struct b6_pnode *top = node->ref[dir];
+	node->ref[dir] = top->ref[opp];
+	top->ref[opp] = node;
+	fix_height(node);
+	fix_height(top);
+	return top;
+}
+
+static struct b6_pnode *rebalance(struct update *self, struct b6_pnode *node)
+{
+	int bal = get_height(node->ref[B6_NEXT]) -
+		get_height(node->ref[B6_PREV]);
+	int dir, opp;
+	struct b6_pnode *child;
+
+	if (bal >= -1 && bal <= 1) {
+		fix_height(node);
+		return node;
+	}
+
+	dir = bal > 0 ? B6_NEXT : B6_PREV;
+	opp = b6_to_opposite(dir);
+	if (!(child = own(self, node->ref[dir])))
+		return NULL;
+	node->ref[dir] = child;
+	if (get_height(child->ref[opp]) > get_height(child->ref[dir])) {
+		if (!(child->ref[opp] = own(self, child->ref[opp])))
+			return NULL;
+		node->ref[dir] = rotate(child, opp);
+	}
+	return rotate(node, dir);
+}
+
+/* replace a child of node by the result of updating it, copying node first */
+static struct b6_pnode *relink(struct update *self, struct b6_pnode *node,
+			       int dir, struct b6_pnode *child, int *retval)
+{
+	struct b6_pnode *top;
+
+	if (*retval)
+		return node;
+
+	if ((top = own(self, node))) {
+		top->ref[dir] = child;
+		if ((top = rebalance(self, top)))
+			return top;
+	}
+
+	*retval = -2;
+	return node;
+}
+
+static struct b6_pnode *insert(struct update *self, struct b6_pnode *node,
+			       void *key, void *value, int *retval)
+{
+	int res, dir;
+	struct b6_pnode *child;
+
+	if (!node) {
+		if (!(node = new_node(self, key, value, NULL, NULL)))
+			*retval = -2;
+		return node;
+	}
+
+	if (!(res = self->tree->compare(node->key, key))) {
+		*retval = -1;
+		return node;
+	}
+
+	dir = res < 0 ? B6_NEXT : B6_PREV;
+	child = insert(self, node->ref[dir], key, value, retval);
+	return relink(self, node, dir, child, retval);
+}
+
+static struct b6_pnode *remove_first(struct update *self,
+				     struct b6_pnode *node,
+				     const struct b6_pnode **first,
+				     int *retval)
+{
+	struct b6_pnode *child;
+
+	if (!node->ref[B6_PREV]) {
+		*first = node;
+		return node->ref[B6_NEXT];
+	}
+
+	child = remove_first(self, node->ref[B6_PREV], first, retval);
+	return relink(self, node, B6_PREV, child, retval);
+}
+
+static struct b6_pnode *remove(struct update *self, struct b6_pnode *node,
+			       void *key, void **value, int *retval)
+{
+	int res, dir;
+	struct b6_pnode *child, *top;
+	const struct b6_pnode *first;
+
+	if (!node) {
+		*retval = -1;
+		return node;
+	}
+
+	if ((res = self->tree->compare(node->key, key))) {
+		dir = res < 0 ? B6_NEXT : B6_PREV;
+		child = remove(self, node->ref[dir], key, value, retval);
+		return relink(self, node, dir, child, retval);
+	}
+
+	if (value)
+		*value = node->value;
+
+	if (!node->ref[B6_PREV])
+		return node->ref[B6_NEXT];
+
+	if (!node->ref[B6_NEXT])
+		return node->ref[B6_PREV];
+
+	child = remove_first(self, node->ref[B6_NEXT], &first, retval);
+	if (*retval)
+		return node;
+	if ((top = new_node(self, first->key, first->value,
+			    node->ref[B6_PREV], child)) &&
+	    (top = rebalance(self, top)))
+		return top;
+	*retval = -2;
+	return node;
+}
+
+static void count_refs(struct update *self, struct b6_pnode *node)
+{
+	int dir;
+	for (dir = 0; dir < 2; dir += 1) {
+		struct b6_pnode *child = node->ref[dir];
+		if (!child)
+			continue;
+		child->count += 1;
+		if (child->version == self->version)
+			count_refs(self, child);
+	}
+}
+
+static void publish(struct update *self, struct b6_pnode *root)
+{
+	struct b6_ptree *tree = self->tree;
+	struct b6_pnode *old = tree->root;
+
+	if (root) {
+		if (root->version == self->version)
+			count_refs(self, root);
+		root->count += 1;
+	}
+	tree->version = self->version;
+	__atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+	if (old)
+		b6_retire_epoch_object(&tree->epoch, &old->sref);
+}
+
+static void put_node(struct b6_ptree *self, struct b6_pnode *node)
+{
+	while (node && !--node->count) {
+		struct b6_pnode *next = node->ref[B6_NEXT];
+		put_node(self, node->ref[B6_PREV]);
+		b6_deallocate(self->allocator, node);
+		node = next;
+	}
+}
+
+static void release_root(struct b6_epoch *epoch, struct b6_sref *sref)
+{
+	struct b6_ptree *self = b6_cast_of(epoch, struct b6_ptree, epoch);
+	put_node(self, b6_cast_of(sref, struct b6_pnode, sref));
+}
+
+void b6_ptree_initialize(struct b6_ptree *self, struct b6_allocator *allocator,
+			 b6_compare_t compare)
+{
+	self->root = NULL;
+	self->version = 0;
+	self->size = 0;
+	self->compare = compare;
+	self->allocator = allocator;
+	self->reserve = NULL;
+	self->spare = 0;
+	b6_setup_epoch(&self->epoch, release_root);
+}
+
+void b6_ptree_finalize(struct b6_ptree *self)
+{
+	b6_flush_epoch(&self->epoch);
+	put_node(self, self->root);
+	self->root = NULL;
+	while (self->reserve) {
+		struct b6_sref *next = self->reserve->ref;
+		b6_deallocate(self->allocator,
+			      b6_cast_of(self->reserve, struct b6_pnode, sref));
+		self->reserve = next;
+	}
+	self->spare = 0;
+}
+
+int b6_ptree_insert(struct b6_ptree *self, void *key, void *value)
+{
+	struct update update;
+	struct b6_pnode *root;
+	int retval = 0;
+
+	if (setup_update(&update, self))
+		return -2;
+
+	root = insert(&update, self->root, key, value, &retval);
+	if (retval) {
+		cancel_update(&update);
+		return retval;
+	}
+
+	publish(&update, root);
+	self->size += 1;
+	return 0;
+}
+
+int b6_ptree_remove(struct b6_ptree *self, void *key, void **value)
+{
+	struct update update;
+	struct b6_pnode *root;
+	int retval = 0;
+
+	if (setup_update(&update, self))
+		return -2;
+
+	root = remove(&update, self->root, key, value, &retval);
+	if (retval) {
+		cancel_update(&update);
+		return retval;
+	}
+
+	publish(&update, root);
+	self->size -= 1;
+	return 0;
+}
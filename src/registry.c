@@ -1,12 +1,77 @@
 #include "b6/registry.h"
 
-/* Bernstein hash */
-unsigned int b6_compute_registry_hash(const char *s)
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define B6_REGISTRY_BIG_ENDIAN
+#endif
+
+#define ONES ((unsigned long int)0x0101010101010101ULL)
+#define HIGHS ((unsigned long int)0x8080808080808080ULL)
+#define MULTIPLIER ((unsigned long int)0x9e3779b97f4a7c15ULL)
+
+/* average number of entries per bucket of frozen registries */
+#define B6_REGISTRY_BUCKET_SIZE 3
+
+/* frozen registries have one free slot every B6_REGISTRY_SLACK slots, so that
+ * buckets placed last, once most slots are taken, still find free ones within
+ * a few dozen tries instead of about n */
+#define B6_REGISTRY_SLACK 32
+
+/* number of seeds to try for each bucket before giving up */
+#define B6_REGISTRY_MAX_SEED (1U << 20)
+
+typedef unsigned long int __attribute__((may_alias)) word_t;
+
+static unsigned long int has_zero(unsigned long int word)
 {
-	unsigned int hash = 5381;
-	while (*s)
-		hash = (hash << 5) + hash + *s++; /* hash = hash * 33 + *s */
-	return hash;
+	return (word - ONES) & ~word & HIGHS;
+}
+
+/* length of a string, scanned one aligned word at a time so that reads never
+ * cross a page boundary */
+static unsigned long int __attribute__((no_sanitize_address))
+length_of(const char *s)
+{
+	const word_t *word;
+	const char *ptr = s;
+
+	for (; (unsigned long int)ptr % sizeof(*word); ptr += 1)
+		if (!*ptr)
+			return ptr - s;
+	for (word = (const word_t *)ptr; !has_zero(*word); word += 1);
+	for (ptr = (const char *)word; *ptr; ptr += 1);
+	return ptr - s;
+}
+
+static unsigned long int mix(unsigned long int hash, unsigned long int word)
+{
+	hash = (hash ^ word) * MULTIPLIER;
+	return hash ^ (hash >> (sizeof(hash) * 4));
+}
+
+/* word at a time hash, independent of the alignment of the string */
+unsigned long int b6_compute_registry_hash(const char *s,
+					   unsigned long int *length)
+{
+	unsigned long int n = length_of(s), hash = n, word;
+	const char *end = s + n - n % sizeof(word);
+
+	for (; s < end; s += sizeof(word)) {
+		__builtin_memcpy(&word, s, sizeof(word));
+		hash = mix(hash, word);
+	}
+	if (n % sizeof(word)) {
+		for (word = 0; *s; s += 1)
+#ifdef B6_REGISTRY_BIG_ENDIAN
+			word = (word << 8) | (unsigned char)*s;
+#else
+			word = (word >> 8) |
+				((unsigned long int)(unsigned char)*s <<
+				 (sizeof(word) * 8 - 8));
+#endif
+		hash = mix(hash, word);
+	}
+	*length = n;
+	return mix(hash, 0);
 }
 
 /* string compare */
@@ -24,8 +89,17 @@ static int b6_compare_registry_names(const char *lhs, const char *rhs)
 	}
 }
 
+static int b6_match_registry_entry(const struct b6_entry *entry,
+				   unsigned long int hash,
+				   unsigned long int length, const char *name)
+{
+	return entry->hash == hash && entry->length == length &&
+		!b6_compare_registry_names(entry->name, name);
+}
+
 struct b6_entry *b6_search_registry(struct b6_registry *self,
-				    unsigned int hash, const char *name,
+				    unsigned long int hash,
+				    unsigned long int length, const char *name,
 				    struct b6_tref **top, int *dir)
 {
 	struct b6_tref *ref;
@@ -36,7 +110,11 @@ struct b6_entry *b6_search_registry(struct b6_registry *self,
 		else if (entry->hash > hash)
 			*dir = B6_NEXT;
 		else {
-			int cmp = b6_compare_registry_names(entry->name, name);
+			int cmp = entry->length == length ? 0 :
+				entry->length < length ? -1 : 1;
+			if (!cmp)
+				cmp = b6_compare_registry_names(entry->name,
+								name);
 			*dir = cmp > 0 ? B6_PREV : B6_NEXT;
 			if (!cmp)
 				return entry;
@@ -44,3 +122,279 @@ struct b6_entry *b6_search_registry(struct b6_registry *self,
 	}
 	return NULL;
 }
+
+struct b6_entry *b6_search_hashed_registry(const struct b6_registry *self,
+					   unsigned long int hash,
+					   unsigned long int length,
+					   const char *name)
+{
+	struct b6_href **bucket = __b6_hashtable_bucket(&self->table, hash);
+	struct b6_href *href;
+	if (!bucket)
+		return NULL;
+	for (href = *bucket; href; href = href->ref) {
+		struct b6_entry *entry = b6_cast_of(href, struct b6_entry, href);
+		if (b6_match_registry_entry(entry, hash, length, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static unsigned long int slot_of(unsigned long int hash, unsigned int seed,
+				 unsigned long int length)
+{
+	unsigned long long int x = hash ^ (seed * 0x9e3779b97f4a7c15ULL);
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return x % length;
+}
+
+static struct b6_entry **frozen_slot(struct b6_frozen_registry *frozen,
+				     unsigned long int hash)
+{
+	unsigned int seed = frozen->seeds[hash % frozen->buckets];
+	return &frozen->slots[slot_of(hash, seed, frozen->length)];
+}
+
+struct b6_entry *b6_search_frozen_registry(const struct b6_registry *self,
+					   unsigned long int hash,
+					   unsigned long int length,
+					   const char *name)
+{
+	struct b6_entry *entry = *frozen_slot(self->frozen, hash);
+	if (entry && b6_match_registry_entry(entry, hash, length, name))
+		return entry;
+	return NULL;
+}
+
+int b6_register_hashed(struct b6_registry *self, struct b6_entry *entry,
+		       const char *name, unsigned long int hash,
+		       unsigned long int length)
+{
+	struct b6_tref *top = NULL;
+	int dir = 0;
+	entry->hash = hash;
+	entry->length = length;
+	entry->name = name;
+	if (self->hashed && b6_search_hashed_registry(self, entry->hash,
+						      entry->length, name))
+		return -1;
+	if (self->ordered && b6_search_registry(self, entry->hash,
+						entry->length, name, &top,
+						&dir))
+		return -1;
+	if (self->prefixed) {
+		int retval = b6_art_insert(&self->trie, &entry->aref);
+		if (retval)
+			return retval;
+	}
+	if (self->hashed) {
+		entry->href.hash = entry->hash;
+		if (__b6_hashtable_add(&self->table, &entry->href)) {
+			if (self->prefixed)
+				b6_art_remove(&self->trie, name, length);
+			return -2;
+		}
+	}
+	if (self->ordered)
+		b6_tree_add(&self->tree, top, dir, &entry->tref);
+	if (self->frozen)
+		self->frozen->thawed += 1;
+	return 0;
+}
+
+void b6_unregister(struct b6_registry *self, struct b6_entry *entry)
+{
+	if (self->frozen) {
+		struct b6_entry **slot = frozen_slot(self->frozen, entry->hash);
+		if (*slot == entry)
+			*slot = NULL;
+		else
+			self->frozen->thawed -= 1;
+	}
+	if (self->hashed)
+		b6_hashtable_remove(&self->table, &entry->href);
+	if (self->prefixed)
+		b6_art_remove(&self->trie, entry->name, entry->length);
+	if (self->ordered) {
+		int dir;
+		struct b6_tref *top = b6_tree_parent(&entry->tref, &dir);
+		b6_tree_del(&self->tree, top, dir);
+	}
+}
+
+int b6_hash_registry(struct b6_registry *self,
+		     struct b6_allocator *allocator, int ordered)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+
+	b6_precond(!self->hashed);
+	b6_hashtable_initialize(&self->table, allocator, NULL, NULL);
+	b6_setup_registry_iterator(&iter, self);
+	while ((entry = b6_get_next_registry_iterator(&iter))) {
+		struct b6_href *href = (struct b6_href *)&entry->href;
+		href->hash = entry->hash;
+		if (__b6_hashtable_add(&self->table, href)) {
+			b6_hashtable_finalize(&self->table);
+			return -1;
+		}
+	}
+	self->hashed = 1;
+	if (self->ordered && !ordered) {
+		self->ordered = 0;
+		b6_tree_initialize(&self->tree, &b6_tree_rb_ops);
+	}
+	return 0;
+}
+
+int b6_trie_registry(struct b6_registry *self, struct b6_allocator *allocator)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+
+	b6_precond(!self->prefixed);
+	b6_art_initialize(&self->trie, allocator);
+	b6_setup_registry_iterator(&iter, self);
+	while ((entry = b6_get_next_registry_iterator(&iter)))
+		if (b6_art_insert(&self->trie,
+				  (struct b6_aref *)&entry->aref)) {
+			b6_art_finalize(&self->trie);
+			return -1;
+		}
+	self->prefixed = 1;
+	if (self->ordered) {
+		self->ordered = 0;
+		b6_tree_initialize(&self->tree, &b6_tree_rb_ops);
+	}
+	return 0;
+}
+
+void b6_thaw_registry(struct b6_registry *self)
+{
+	if (self->frozen) {
+		b6_deallocate(self->frozen->allocator, self->frozen);
+		self->frozen = NULL;
+	}
+}
+
+/* try seeds until the entries of a bucket all land in distinct free slots */
+static int place_bucket(struct b6_frozen_registry *frozen,
+			struct b6_entry **entries,
+			const unsigned long int *hashes, unsigned long int n,
+			unsigned int *seed)
+{
+	unsigned long int i, j;
+
+	for (*seed = 0; *seed < B6_REGISTRY_MAX_SEED; *seed += 1) {
+		for (i = 0; i < n; i += 1) {
+			struct b6_entry **slot = &frozen->slots[
+				slot_of(hashes[i], *seed, frozen->length)];
+			if (*slot)
+				break;
+			*slot = entries[i];
+		}
+		if (i == n)
+			return 0;
+		/* undo the entries placed with this seed */
+		for (j = 0; j < i; j += 1)
+			frozen->slots[slot_of(hashes[j], *seed,
+					      frozen->length)] = NULL;
+	}
+	return -1;
+}
+
+int b6_freeze_registry(struct b6_registry *self,
+		       struct b6_allocator *allocator)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+	struct b6_frozen_registry *frozen;
+	struct b6_entry **entries, **sorted;
+	unsigned long int n = 0, m, b, i, max = 0, *hashes, *start, *order;
+
+	b6_thaw_registry(self);
+	b6_setup_registry_iterator(&iter, self);
+	while (b6_get_next_registry_iterator(&iter))
+		n += 1;
+	if (!n)
+		return 0;
+
+	m = n + n / (B6_REGISTRY_SLACK - 1) + 1;
+	b = n / B6_REGISTRY_BUCKET_SIZE + 1;
+	frozen = b6_allocate(allocator, sizeof(*frozen) +
+			     m * sizeof(frozen->slots[0]) +
+			     b * sizeof(frozen->seeds[0]));
+	if (!frozen)
+		return -1;
+	entries = b6_allocate(allocator, 2 * n * sizeof(*entries) +
+			      (n + 2 * b + 2) * sizeof(*hashes));
+	if (!entries) {
+		b6_deallocate(allocator, frozen);
+		return -1;
+	}
+	sorted = entries + n;
+	hashes = (unsigned long int *)(sorted + n);
+	start = hashes + n + 1;
+	order = start + b + 1;
+
+	frozen->allocator = allocator;
+	frozen->length = m;
+	frozen->buckets = b;
+	frozen->thawed = 0;
+	frozen->seeds = (unsigned int *)(frozen->slots + m);
+	for (i = 0; i < m; i += 1)
+		frozen->slots[i] = NULL;
+	for (i = 0; i < b; i += 1)
+		frozen->seeds[i] = 0;
+
+	/* sort entries by bucket, so that the hashes of a bucket are
+	 * contiguous when trying seeds */
+	for (i = 0; i <= b; i += 1)
+		start[i] = 0;
+	b6_setup_registry_iterator(&iter, self);
+	for (i = 0; (entry = b6_get_next_registry_iterator(&iter)); i += 1) {
+		entries[i] = (struct b6_entry *)entry;
+		start[entry->hash % b + 1] += 1;
+	}
+	for (i = 0; i < b; i += 1) {
+		if (start[i + 1] > max)
+			max = start[i + 1];
+		start[i + 1] += start[i];
+	}
+	for (i = 0; i < n; i += 1) {
+		unsigned long int k = entries[i]->hash % b;
+		sorted[start[k]++] = entries[i];
+	}
+	for (i = b; i; i -= 1)
+		start[i] = start[i - 1];
+	start[0] = 0;
+
+	/* order buckets by decreasing size, counting them in hashes first */
+	for (i = 0; i <= max; i += 1)
+		hashes[i] = 0;
+	for (i = 0; i < b; i += 1)
+		hashes[max - (start[i + 1] - start[i])] += 1;
+	for (i = 1; i <= max; i += 1)
+		hashes[i] += hashes[i - 1];
+	for (i = b; i--;)
+		order[--hashes[max - (start[i + 1] - start[i])]] = i;
+	for (i = 0; i < n; i += 1)
+		hashes[i] = sorted[i]->hash;
+
+	/* place larger buckets first, while there are many free slots */
+	for (i = 0; i < b && start[order[i] + 1] > start[order[i]]; i += 1) {
+		unsigned long int k = order[i];
+		if (place_bucket(frozen, sorted + start[k], hashes + start[k],
+				 start[k + 1] - start[k], &frozen->seeds[k])) {
+			b6_deallocate(allocator, entries);
+			b6_deallocate(allocator, frozen);
+			return -2;
+		}
+	}
+
+	b6_deallocate(allocator, entries);
+	self->frozen = frozen;
+	return 0;
+}
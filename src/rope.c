@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/rope.h"
+
+static struct b6_rope_leaf *to_leaf(const struct b6_dref *dref)
+{
+	return b6_cast_of(dref, struct b6_rope_leaf, dref);
+}
+
+static unsigned long int size_of(const struct b6_dref *dref)
+{
+	return dref ? to_leaf(dref)->size : 0UL;
+}
+
+static unsigned long int length_of(const struct b6_dref *dref)
+{
+	return to_leaf(dref)->length;
+}
+
+static void update_size(struct b6_dref *dref)
+{
+	to_leaf(dref)->size = size_of(dref->ref[B6_PREV]) + length_of(dref) +
+		size_of(dref->ref[B6_NEXT]);
+}
+
+static char *items_of(const struct b6_rope *self, const struct b6_dref *dref,
+		      unsigned long int index)
+{
+	return (char *)(to_leaf(dref) + 1) + index * self->itemsize;
+}
+
+static void move_items(char *dst, const char *src, unsigned long int size)
+{
+	if (dst < src)
+		while (size--)
+			*dst++ = *src++;
+	else
+		for (dst += size, src += size; size--; )
+			*--dst = *--src;
+}
+
+static struct b6_dref *get_root(const struct b6_rope *self)
+{
+	return b6_splay_root(&self->splay);
+}
+
+static void set_root(struct b6_rope *self, struct b6_dref *dref)
+{
+	__b6_splay_root(&self->splay) = dref;
+}
+
+/*
+ * Rope Splaying
+ * -------------
+ *
+ * Leaves are splayed top-down by position, the way Sleator does for size
+ * augmented splay trees: the nodes set aside in the left (resp. right) tree
+ * are linked along its right (resp. left) spine. Their sizes are corrected
+ * once the total size of each side is known, by walking the spines downwards.
+ *
+ * A position past the end of the rope reaches the last leaf, so that the
+ * offset returned is then greater or equal to its length.
+ */
+static int locate(const struct b6_dref *dref, unsigned long int *pos)
+{
+	unsigned long int size = size_of(dref->ref[B6_PREV]);
+	if (*pos < size)
+		return B6_PREV;
+	*pos -= size;
+	if (*pos < length_of(dref) || !dref->ref[B6_NEXT])
+		return -1;
+	*pos -= length_of(dref);
+	return B6_NEXT;
+}
+
+static struct b6_dref *splay_at(struct b6_dref *top, unsigned long int *pos)
+{
+	struct b6_dref bak, *lnk[2] = { &bak, &bak }, *ref, *tmp;
+	unsigned long int len[2] = { 0UL, 0UL }, off;
+	int dir, opp;
+
+	while ((dir = locate(top, pos)) >= 0) {
+		opp = b6_to_opposite(dir);
+		ref = top->ref[dir];
+		off = *pos;
+		if (locate(ref, &off) == dir) {
+			top->ref[dir] = ref->ref[opp];
+			ref->ref[opp] = top;
+			update_size(top);
+			top = ref;
+			*pos = off;
+		}
+		lnk[opp]->ref[dir] = top;
+		lnk[opp] = top;
+		len[opp] += size_of(top->ref[opp]) + length_of(top);
+		top = top->ref[dir];
+	}
+
+	len[B6_PREV] += size_of(top->ref[B6_PREV]);
+	len[B6_NEXT] += size_of(top->ref[B6_NEXT]);
+	to_leaf(top)->size = len[B6_PREV] + length_of(top) + len[B6_NEXT];
+
+	lnk[B6_PREV]->ref[B6_NEXT] = lnk[B6_NEXT]->ref[B6_PREV] = NULL;
+	for (tmp = bak.ref[B6_NEXT]; tmp; tmp = tmp->ref[B6_NEXT]) {
+		to_leaf(tmp)->size = len[B6_PREV];
+		len[B6_PREV] -= size_of(tmp->ref[B6_PREV]) + length_of(tmp);
+	}
+	for (tmp = bak.ref[B6_PREV]; tmp; tmp = tmp->ref[B6_PREV]) {
+		to_leaf(tmp)->size = len[B6_NEXT];
+		len[B6_NEXT] -= size_of(tmp->ref[B6_NEXT]) + length_of(tmp);
+	}
+
+	lnk[B6_PREV]->ref[B6_NEXT] = top->ref[B6_PREV];
+	lnk[B6_NEXT]->ref[B6_PREV] = top->ref[B6_NEXT];
+	top->ref[B6_PREV] = bak.ref[B6_NEXT];
+	top->ref[B6_NEXT] = bak.ref[B6_PREV];
+
+	return top;
+}
+
+/*
+ * Leaves needed by an update are taken from the pool beforehand, so that
+ * running out of memory leaves the rope untouched.
+ */
+static int reserve_leaves(struct b6_rope *self, struct b6_dref **reserve,
+			  unsigned long int n)
+{
+	*reserve = NULL;
+	while (n--) {
+		struct b6_rope_leaf *leaf = b6_pool_get(self->pool);
+		if (!leaf)
+			return -1;
+		leaf->dref.ref[B6_NEXT] = *reserve;
+		*reserve = &leaf->dref;
+	}
+	return 0;
+}
+
+static struct b6_dref *take_leaf(struct b6_dref **reserve)
+{
+	struct b6_dref *dref = *reserve;
+	*reserve = dref->ref[B6_NEXT];
+	dref->ref[B6_PREV] = dref->ref[B6_NEXT] = NULL;
+	to_leaf(dref)->size = to_leaf(dref)->length = 0UL;
+	return dref;
+}
+
+static void release_leaf(struct b6_dref *dref, void *pool)
+{
+	b6_pool_put(pool, to_leaf(dref));
+}
+
+static void release_leaves(struct b6_rope *self, struct b6_dref *reserve)
+{
+	while (reserve) {
+		struct b6_dref *next = reserve->ref[B6_NEXT];
+		release_leaf(reserve, self->pool);
+		reserve = next;
+	}
+}
+
+static void release_tree(struct b6_rope *self, struct b6_dref *dref)
+{
+	struct b6_splay splay;
+	__b6_splay_root(&splay) = dref;
+	b6_splay_clear(&splay, release_leaf, self->pool);
+}
+
+/*
+ * Cut the tree before position pos. The items of the leaf holding pos that
+ * come after it are moved to a leaf of the reserve, if any is needed. Returns
+ * the tree of the items from pos on, whereas *root is left with the others.
+ */
+static struct b6_dref *cut(struct b6_rope *self, struct b6_dref **root,
+			   unsigned long int pos, struct b6_dref **reserve)
+{
+	struct b6_dref *top, *ref;
+	unsigned long int len;
+
+	if (!*root)
+		return NULL;
+
+	*root = top = splay_at(*root, &pos);
+	len = length_of(top);
+	if (!pos) {
+		*root = top->ref[B6_PREV];
+		top->ref[B6_PREV] = NULL;
+		update_size(top);
+		return top;
+	}
+
+	ref = top->ref[B6_NEXT];
+	top->ref[B6_NEXT] = NULL;
+	if (pos < len) {
+		struct b6_dref *tmp = take_leaf(reserve);
+		move_items(items_of(self, tmp, 0), items_of(self, top, pos),
+			   (len - pos) * self->itemsize);
+		to_leaf(tmp)->length = len - pos;
+		to_leaf(top)->length = pos;
+		tmp->ref[B6_NEXT] = ref;
+		update_size(tmp);
+		ref = tmp;
+	}
+	update_size(top);
+	return ref;
+}
+
+/*
+ * Concatenate two trees. The last leaf of the first one becomes the root and
+ * takes in the items of the first leaf of the second one if they fit.
+ */
+static struct b6_dref *join(struct b6_rope *self, struct b6_dref *lhs,
+			    struct b6_dref *rhs)
+{
+	unsigned long int pos;
+
+	if (!lhs)
+		return rhs;
+	pos = size_of(lhs);
+	lhs = splay_at(lhs, &pos);
+	if (!rhs)
+		return lhs;
+	pos = 0;
+	rhs = splay_at(rhs, &pos);
+	if (length_of(lhs) + length_of(rhs) <= self->capacity) {
+		struct b6_dref *ref = rhs->ref[B6_NEXT];
+		move_items(items_of(self, lhs, length_of(lhs)),
+			   items_of(self, rhs, 0),
+			   length_of(rhs) * self->itemsize);
+		to_leaf(lhs)->length += length_of(rhs);
+		release_leaf(rhs, self->pool);
+		rhs = ref;
+	}
+	lhs->ref[B6_NEXT] = rhs;
+	update_size(lhs);
+	return lhs;
+}
+
+/*
+ * Append items to a tree which last leaf is the root, filling it up before
+ * adding new leaves from the reserve.
+ */
+static struct b6_dref *append(struct b6_rope *self, struct b6_dref *top,
+			      const char *items, unsigned long int n,
+			      struct b6_dref **reserve)
+{
+	while (n) {
+		unsigned long int len;
+		if (!top || length_of(top) == self->capacity) {
+			struct b6_dref *tmp = take_leaf(reserve);
+			tmp->ref[B6_PREV] = top;
+			top = tmp;
+		}
+		len = self->capacity - length_of(top);
+		if (len > n)
+			len = n;
+		move_items(items_of(self, top, length_of(top)), items,
+			   len * self->itemsize);
+		to_leaf(top)->length += len;
+		update_size(top);
+		items += len * self->itemsize;
+		n -= len;
+	}
+	return top;
+}
+
+int b6_rope_initialize(struct b6_rope *self, struct b6_pool *pool,
+		       unsigned int itemsize)
+{
+	if (!itemsize || pool->size < B6_ROPE_LEAF_SIZE(itemsize, 1))
+		return -1;
+	b6_splay_initialize(&self->splay);
+	self->pool = pool;
+	self->itemsize = itemsize;
+	self->capacity = (pool->size - sizeof(struct b6_rope_leaf)) / itemsize;
+	return 0;
+}
+
+void b6_rope_finalize(struct b6_rope *self)
+{
+	b6_splay_clear(&self->splay, release_leaf, self->pool);
+}
+
+void *b6_rope_at(struct b6_rope *self, unsigned long int index,
+		 unsigned long int *count)
+{
+	struct b6_dref *top;
+
+	if (index >= b6_rope_length(self))
+		return NULL;
+	set_root(self, top = splay_at(get_root(self), &index));
+	if (count)
+		*count = length_of(top) - index;
+	return items_of(self, top, index);
+}
+
+int b6_rope_insert(struct b6_rope *self, unsigned long int index,
+		   const void *items, unsigned long int n)
+{
+	struct b6_dref *top = get_root(self), *ref, *reserve;
+	unsigned long int pos = index;
+
+	if (index > b6_rope_length(self))
+		return -1;
+	if (!n)
+		return 0;
+
+	if (top) {
+		set_root(self, top = splay_at(top, &pos));
+		if (length_of(top) + n <= self->capacity) {
+			char *ptr = items_of(self, top, pos);
+			move_items(ptr + n * self->itemsize, ptr,
+				   (length_of(top) - pos) * self->itemsize);
+			move_items(ptr, items, n * self->itemsize);
+			to_leaf(top)->length += n;
+			to_leaf(top)->size += n;
+			return 0;
+		}
+	}
+
+	if (reserve_leaves(self, &reserve, (n - 1) / self->capacity + 2)) {
+		release_leaves(self, reserve);
+		return -2;
+	}
+	ref = cut(self, &top, index, &reserve);
+	if (top) {
+		pos = size_of(top);
+		top = splay_at(top, &pos);
+	}
+	top = append(self, top, items, n, &reserve);
+	set_root(self, join(self, top, ref));
+	release_leaves(self, reserve);
+	return 0;
+}
+
+unsigned long int b6_rope_erase(struct b6_rope *self, unsigned long int index,
+				unsigned long int n)
+{
+	struct b6_dref *top = get_root(self), *ref;
+	unsigned long int len, pos = index;
+
+	if (index >= b6_rope_length(self) || !n)
+		return 0UL;
+	if (n > b6_rope_length(self) - index)
+		n = b6_rope_length(self) - index;
+
+	top = splay_at(top, &pos);
+	len = length_of(top);
+	if (pos + n < len) {
+		char *ptr = items_of(self, top, pos);
+		move_items(ptr, ptr + n * self->itemsize,
+			   (len - pos - n) * self->itemsize);
+		to_leaf(top)->length -= n;
+		to_leaf(top)->size -= n;
+		set_root(self, top);
+		return n;
+	}
+
+	ref = top->ref[B6_NEXT];
+	top->ref[B6_NEXT] = NULL;
+	to_leaf(top)->length = pos;
+	if (ref && (pos = n - (len - pos))) {
+		ref = splay_at(ref, &pos);
+		release_tree(self, ref->ref[B6_PREV]);
+		ref->ref[B6_PREV] = NULL;
+		if (pos < length_of(ref)) {
+			len = length_of(ref) - pos;
+			move_items(items_of(self, ref, 0),
+				   items_of(self, ref, pos),
+				   len * self->itemsize);
+			to_leaf(ref)->length = len;
+			update_size(ref);
+		} else {
+			struct b6_dref *tmp = ref->ref[B6_NEXT];
+			release_leaf(ref, self->pool);
+			ref = tmp;
+		}
+	}
+	if (!length_of(top)) {
+		struct b6_dref *tmp = top->ref[B6_PREV];
+		release_leaf(top, self->pool);
+		top = tmp;
+	} else
+		update_size(top);
+
+	set_root(self, join(self, top, ref));
+	return n;
+}
+
+int b6_rope_split(struct b6_rope *self, unsigned long int index,
+		  struct b6_rope *other)
+{
+	struct b6_dref *top = get_root(self), *reserve;
+
+	b6_precond(!get_root(other));
+	b6_precond(other->pool == self->pool);
+	b6_precond(other->itemsize == self->itemsize);
+
+	if (index > b6_rope_length(self))
+		return -1;
+	if (reserve_leaves(self, &reserve, 1)) {
+		release_leaves(self, reserve);
+		return -2;
+	}
+	set_root(other, cut(self, &top, index, &reserve));
+	set_root(self, top);
+	release_leaves(self, reserve);
+	return 0;
+}
+
+void b6_rope_concat(struct b6_rope *self, struct b6_rope *other)
+{
+	b6_precond(other->pool == self->pool);
+	b6_precond(other->itemsize == self->itemsize);
+
+	set_root(self, join(self, get_root(self), get_root(other)));
+	__b6_splay_root(&other->splay) = NULL;
+}
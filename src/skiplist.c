@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2014, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/skiplist.h"
+
+static __thread unsigned long int random_state;
+
+/* xorshift generator seeded per thread */
+static unsigned int random_height(void)
+{
+	unsigned long int x = random_state;
+	if (b6_unlikely(!x))
+		x = (unsigned long int)&random_state | 1;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	random_state = x;
+	return 1 + __builtin_ctzl((x >> 1) | (1UL << (B6_SKIPLIST_HEIGHT - 1)));
+}
+
+static struct b6_skipnode *get_next(const struct b6_skipnode *node, int level)
+{
+	return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+}
+
+static int is_marked(const struct b6_skipnode *node)
+{
+	return __atomic_load_n(&node->marked, __ATOMIC_ACQUIRE);
+}
+
+static int is_linked(const struct b6_skipnode *node)
+{
+	return __atomic_load_n(&node->linked, __ATOMIC_ACQUIRE);
+}
+
+static struct b6_skipnode *new_node(struct b6_skiplist *self,
+				    unsigned int height)
+{
+	struct b6_skipnode *node = b6_allocate(self->allocator,
+		sizeof(*node) + height * sizeof(node->next[0]));
+	if (node) {
+		b6_reset_spinlock(&node->lock);
+		node->marked = 0;
+		node->linked = 0;
+		node->height = height;
+	}
+	return node;
+}
+
+static void release_node(struct b6_epoch *epoch, struct b6_sref *sref)
+{
+	struct b6_skiplist *self = b6_cast_of(epoch, struct b6_skiplist, epoch);
+	b6_deallocate(self->allocator,
+		      b6_cast_of(sref, struct b6_skipnode, sref));
+}
+
+int b6_skiplist_initialize(struct b6_skiplist *self,
+			   struct b6_allocator *allocator, b6_compare_t compare)
+{
+	int level;
+	self->allocator = allocator;
+	self->compare = compare;
+	if (!(self->head = new_node(self, B6_SKIPLIST_HEIGHT)))
+		return -1;
+	for (level = 0; level < B6_SKIPLIST_HEIGHT; level += 1)
+		self->head->next[level] = NULL;
+	self->head->linked = 1;
+	b6_setup_epoch(&self->epoch, release_node);
+	return 0;
+}
+
+void b6_skiplist_finalize(struct b6_skiplist *self)
+{
+	struct b6_skipnode *node = self->head;
+	b6_flush_epoch(&self->epoch);
+	while (node) {
+		struct b6_skipnode *next = node->next[0];
+		b6_deallocate(self->allocator, node);
+		node = next;
+	}
+	self->head = NULL;
+}
+
+/*
+ * Skip List Search
+ * ----------------
+ *
+ * The list is traveled from the highest level downwards. At each level, the
+ * node before the first node which key is not less than the key to find is
+ * recorded as the predecessor and the latter as the successor. The function
+ * returns the highest level where the key was found, or -1.
+ */
+static int find(const struct b6_skiplist *self, void *key,
+		struct b6_skipnode **preds, struct b6_skipnode **succs)
+{
+	struct b6_skipnode *pred = self->head;
+	int level, found = -1;
+
+	for (level = B6_SKIPLIST_HEIGHT; level--; ) {
+		struct b6_skipnode *curr = get_next(pred, level);
+		int cmp = 1;
+		while (curr && (cmp = self->compare(curr->key, key)) < 0) {
+			pred = curr;
+			curr = get_next(pred, level);
+		}
+		if (found < 0 && curr && !cmp)
+			found = level;
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+
+	return found;
+}
+
+int b6_skiplist_lookup(struct b6_skiplist *self, void *key, void **value)
+{
+	struct b6_skipnode *pred = self->head, *curr = NULL;
+	unsigned long int *e = b6_enter_epoch(&self->epoch);
+	int level, cmp = 1, retval = -1;
+
+	for (level = B6_SKIPLIST_HEIGHT; level-- && cmp; ) {
+		curr = get_next(pred, level);
+		while (curr && (cmp = self->compare(curr->key, key)) < 0) {
+			pred = curr;
+			curr = get_next(pred, level);
+		}
+	}
+
+	if (!cmp && is_linked(curr) && !is_marked(curr)) {
+		if (value)
+			*value = curr->value;
+		retval = 0;
+	}
+
+	b6_leave_epoch(&self->epoch, e);
+	return retval;
+}
+
+static void unlock_preds(struct b6_skipnode **preds, int highest)
+{
+	struct b6_skipnode *prev = NULL;
+	int level;
+
+	for (level = 0; level <= highest; level += 1)
+		if (preds[level] != prev)
+			b6_spin_unlock(&(prev = preds[level])->lock);
+}
+
+/*
+ * Lock the predecessors at the levels below height and check they still are
+ * linked to the expected successors. Returns the highest locked level, or -1
+ * when validation failed, in which case no predecessor is left locked.
+ */
+static int lock_preds(struct b6_skipnode **preds, struct b6_skipnode **succs,
+		      int height, int removal)
+{
+	struct b6_skipnode *prev = NULL;
+	int level, highest = -1;
+
+	for (level = 0; level < height; level += 1) {
+		struct b6_skipnode *pred = preds[level];
+		struct b6_skipnode *succ = succs[level];
+		if (pred != prev) {
+			b6_spin_lock(&pred->lock);
+			highest = level;
+			prev = pred;
+		}
+		if (is_marked(pred) || get_next(pred, level) != succ ||
+		    (!removal && succ && is_marked(succ))) {
+			unlock_preds(preds, highest);
+			return -1;
+		}
+	}
+
+	return highest;
+}
+
+int b6_skiplist_insert(struct b6_skiplist *self, void *key, void *value)
+{
+	struct b6_skipnode *preds[B6_SKIPLIST_HEIGHT];
+	struct b6_skipnode *succs[B6_SKIPLIST_HEIGHT];
+	struct b6_skipnode *node;
+	unsigned long int *e;
+	int level, height = random_height(), retval = 0;
+
+	if (!(node = new_node(self, height)))
+		return -2;
+	node->key = key;
+	node->value = value;
+
+	e = b6_enter_epoch(&self->epoch);
+	for (;;) {
+		int highest, found = find(self, key, preds, succs);
+
+		if (found >= 0) {
+			struct b6_skipnode *curr = succs[found];
+			if (is_marked(curr))
+				continue;
+			while (!is_linked(curr))
+				b6_cpu_relax();
+			retval = -1;
+			break;
+		}
+
+		if ((highest = lock_preds(preds, succs, height, 0)) < 0)
+			continue;
+
+		for (level = 0; level < height; level += 1)
+			node->next[level] = succs[level];
+		for (level = 0; level < height; level += 1)
+			__atomic_store_n(&preds[level]->next[level], node,
+					 __ATOMIC_RELEASE);
+		__atomic_store_n(&node->linked, 1, __ATOMIC_RELEASE);
+
+		unlock_preds(preds, highest);
+		node = NULL;
+		break;
+	}
+	b6_leave_epoch(&self->epoch, e);
+
+	b6_deallocate(self->allocator, node);
+	return retval;
+}
+
+static int can_remove(const struct b6_skipnode *node, int found)
+{
+	return is_linked(node) && node->height == found + 1 &&
+		!is_marked(node);
+}
+
+int b6_skiplist_remove(struct b6_skiplist *self, void *key, void **value)
+{
+	struct b6_skipnode *preds[B6_SKIPLIST_HEIGHT];
+	struct b6_skipnode *succs[B6_SKIPLIST_HEIGHT];
+	struct b6_skipnode *victim = NULL;
+	unsigned long int *e = b6_enter_epoch(&self->epoch);
+	int level, highest, retval = -1;
+
+	for (;;) {
+		int found = find(self, key, preds, succs);
+
+		if (!victim) {
+			if (found < 0 || !can_remove(succs[found], found))
+				break;
+			victim = succs[found];
+			b6_spin_lock(&victim->lock);
+			if (victim->marked) {
+				b6_spin_unlock(&victim->lock);
+				break;
+			}
+			__atomic_store_n(&victim->marked, 1, __ATOMIC_RELEASE);
+		}
+
+		for (level = 0; level < victim->height; level += 1)
+			succs[level] = victim;
+		if ((highest = lock_preds(preds, succs, victim->height, 1)) < 0)
+			continue;
+
+		for (level = victim->height; level--; )
+			__atomic_store_n(&preds[level]->next[level],
+					 victim->next[level], __ATOMIC_RELEASE);
+
+		b6_spin_unlock(&victim->lock);
+		unlock_preds(preds, highest);
+		if (value)
+			*value = victim->value;
+		retval = 0;
+		break;
+	}
+	b6_leave_epoch(&self->epoch, e);
+
+	if (!retval)
+		b6_retire_epoch_object(&self->epoch, &victim->sref);
+	return retval;
+}
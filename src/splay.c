@@ -69,3 +69,266 @@ struct b6_dref *__b6_splay_dive(struct b6_dref *ref, int dir)
 
 	return ref;
 }
+
+/* move ref above its parent top, which is a child of above */
+static void rotate(struct b6_dref *above, struct b6_dref *top,
+		   struct b6_dref *ref)
+{
+	int dir = top->ref[B6_NEXT] == ref ? B6_NEXT : B6_PREV;
+	int opp = b6_to_opposite(dir);
+	struct b6_dref *sub = ref->ref[opp];
+
+	if (__b6_splay_is_thread(sub))
+		top->ref[dir] = __b6_splay_to_thread(ref);
+	else
+		top->ref[dir] = sub;
+	ref->ref[opp] = top;
+	above->ref[above->ref[B6_NEXT] == top ? B6_NEXT : B6_PREV] = ref;
+}
+
+void __b6_splay_raise(struct b6_dref **path, unsigned int depth, int semi)
+{
+	unsigned int i = depth + 1;
+
+	while (i > 2) {
+		struct b6_dref *ref = path[i], *top = path[i - 1];
+		struct b6_dref *end = path[i - 2], *above = path[i - 3];
+		if ((end->ref[B6_NEXT] == top) == (top->ref[B6_NEXT] == ref)) {
+			rotate(above, end, top);
+			if (semi) {
+				path[i - 2] = top;
+				i -= 2;
+				continue;
+			}
+			rotate(above, top, ref);
+		} else {
+			rotate(end, top, ref);
+			rotate(above, end, ref);
+		}
+		path[i - 2] = ref;
+		i -= 2;
+	}
+
+	if (i == 2)
+		rotate(path[0], path[1], path[2]);
+}
+
+static struct b6_dref *get_child(const struct b6_dref *ref, int dir)
+{
+	struct b6_dref *child = ref->ref[dir];
+	return __b6_splay_is_thread(child) ? NULL : child;
+}
+
+void b6_splay_clear(struct b6_splay *splay,
+		    void (*release)(struct b6_dref*, void*), void *arg)
+{
+	struct b6_dref *ref = b6_splay_empty(splay) ? NULL : b6_splay_root(splay);
+
+	while (ref) {
+		struct b6_dref *tmp = get_child(ref, B6_PREV);
+		if (tmp) {
+			ref->ref[B6_PREV] = get_child(tmp, B6_NEXT);
+			tmp->ref[B6_NEXT] = ref;
+			ref = tmp;
+			continue;
+		}
+		tmp = get_child(ref, B6_NEXT);
+		if (release)
+			release(ref, arg);
+		ref = tmp;
+	}
+
+	__b6_splay_root(splay) = NULL;
+}
+
+/*
+ * Splay Tree Split and Join
+ * -------------------------
+ *
+ * Both operations splay the extreme elements they need to relink to the root
+ * by searching with a comparison that always points the same way, which
+ * keeps them O(log(n)) amortized.
+ *
+ * In threaded trees, the smallest (resp. greatest) element has a thread to
+ * the head of its tree as previous (resp. next) reference. When elements move
+ * from one tree to the other, these threads are fixed, as well as the thread
+ * between the elements on either side of the split or join point.
+ */
+#define splay_first(ref, arg) 1
+#define splay_last(ref, arg) -1
+
+static struct b6_dref *splay_end(struct b6_splay *splay, int dir)
+{
+	int res;
+	if (dir == B6_NEXT)
+		res = b6_splay_search(splay, dir, splay_last, NULL);
+	else
+		res = b6_splay_search(splay, dir, splay_first, NULL);
+	b6_unused(res);
+	return b6_splay_root(splay);
+}
+
+static struct b6_dref *splay_end_nothread(struct b6_splay *splay, int dir)
+{
+	int res;
+	if (dir == B6_NEXT)
+		res = b6_splay_search_nothread(splay, dir, splay_last, NULL);
+	else
+		res = b6_splay_search_nothread(splay, dir, splay_first, NULL);
+	b6_unused(res);
+	return b6_splay_root(splay);
+}
+
+static void set_end(struct b6_splay *splay, int dir, struct b6_dref *thread)
+{
+	splay_end(splay, dir)->ref[dir] = thread;
+}
+
+void b6_splay_split(struct b6_splay *splay, int dir, struct b6_splay *other)
+{
+	struct b6_dref *top = b6_splay_root(splay), *ref;
+	struct b6_dref *head = __b6_splay_to_thread(b6_splay_head(other));
+
+	b6_precond(b6_splay_empty(other));
+	__b6_splay_root(other) = NULL;
+
+	if (b6_splay_empty(splay) || __b6_splay_is_thread(ref = top->ref[dir]))
+		return;
+
+	top->ref[dir] = __b6_splay_to_thread(b6_splay_head(splay));
+	__b6_splay_root(other) = ref;
+	set_end(other, B6_PREV, head);
+	set_end(other, B6_NEXT, head);
+}
+
+void b6_splay_join(struct b6_splay *splay, struct b6_splay *other)
+{
+	struct b6_dref *head = __b6_splay_to_thread(b6_splay_head(splay));
+	struct b6_dref *top;
+
+	if (b6_splay_empty(other))
+		return;
+
+	if (b6_splay_empty(splay)) {
+		__b6_splay_root(splay) = b6_splay_root(other);
+		set_end(splay, B6_PREV, head);
+		set_end(splay, B6_NEXT, head);
+	} else {
+		top = splay_end(splay, B6_NEXT);
+		set_end(other, B6_NEXT, head);
+		set_end(other, B6_PREV, __b6_splay_to_thread(top));
+		top->ref[B6_NEXT] = b6_splay_root(other);
+	}
+
+	__b6_splay_root(other) = NULL;
+}
+
+void b6_splay_split_nothread(struct b6_splay *splay, int dir,
+			     struct b6_splay *other)
+{
+	struct b6_dref *top = b6_splay_root(splay);
+
+	b6_precond(b6_splay_empty(other));
+
+	if (b6_splay_empty(splay)) {
+		__b6_splay_root(other) = NULL;
+		return;
+	}
+
+	__b6_splay_root(other) = top->ref[dir];
+	top->ref[dir] = NULL;
+}
+
+void b6_splay_join_nothread(struct b6_splay *splay, struct b6_splay *other)
+{
+	if (b6_splay_empty(other))
+		return;
+
+	if (b6_splay_empty(splay))
+		__b6_splay_root(splay) = b6_splay_root(other);
+	else
+		splay_end_nothread(splay, B6_NEXT)->ref[B6_NEXT] =
+			b6_splay_root(other);
+
+	__b6_splay_root(other) = NULL;
+}
+
+/*
+ * Splay Tree Shape
+ * ----------------
+ *
+ * The depth of every element is tracked while traveling the tree in order.
+ * Going down adds one level per link followed. In threaded trees, climbing a
+ * thread from the greatest element of the previous subtree of some element
+ * back to the latter removes as many levels as there are links from this
+ * element down to its predecessor, which are counted again. Non-threaded
+ * trees are traveled the same way, but the threads are set up temporarily.
+ * Either way, every link is followed a bounded number of times.
+ */
+static void count_element(struct b6_stats *stats, unsigned long int depth)
+{
+	stats->size += 1;
+	if (stats->height < depth)
+		stats->height = depth;
+}
+
+void b6_splay_stats(const struct b6_splay *splay, struct b6_stats *stats)
+{
+	struct b6_dref *head = __b6_splay_to_thread(b6_splay_head(splay));
+	struct b6_dref *ref, *tmp;
+	unsigned long int depth;
+
+	__b6_setup_stats(stats, __b6_counters_of(splay));
+	if (b6_splay_empty(splay))
+		return;
+
+	for (ref = b6_splay_root(splay), depth = 1; get_child(ref, B6_PREV);
+	     ref = ref->ref[B6_PREV], depth += 1);
+	for (;;) {
+		count_element(stats, depth);
+		if ((tmp = get_child(ref, B6_NEXT))) {
+			for (ref = tmp, depth += 1; get_child(ref, B6_PREV);
+			     ref = ref->ref[B6_PREV], depth += 1);
+			continue;
+		}
+		if ((tmp = ref->ref[B6_NEXT]) == head)
+			break;
+		tmp = __b6_splay_from_thread(tmp);
+		for (ref = tmp->ref[B6_PREV]; ref != tmp;
+		     ref = __b6_splay_from_thread(ref->ref[B6_NEXT]))
+			depth -= 1;
+		ref = tmp;
+	}
+}
+
+void b6_splay_stats_nothread(struct b6_splay *splay, struct b6_stats *stats)
+{
+	struct b6_dref *ref = b6_splay_root(splay), *tmp;
+	unsigned long int depth = 1, n;
+
+	__b6_setup_stats(stats, __b6_counters_of(splay));
+
+	while (ref) {
+		if (!ref->ref[B6_PREV]) {
+			count_element(stats, depth);
+			ref = ref->ref[B6_NEXT];
+			depth += 1;
+			continue;
+		}
+		for (n = 1, tmp = ref->ref[B6_PREV];
+		     tmp->ref[B6_NEXT] && tmp->ref[B6_NEXT] != ref;
+		     tmp = tmp->ref[B6_NEXT])
+			n += 1;
+		if (!tmp->ref[B6_NEXT]) {
+			tmp->ref[B6_NEXT] = ref;
+			ref = ref->ref[B6_PREV];
+			depth += 1;
+			continue;
+		}
+		tmp->ref[B6_NEXT] = NULL;
+		depth -= n + 1;
+		count_element(stats, depth);
+		ref = ref->ref[B6_NEXT];
+		depth += 1;
+	}
+}
@@ -36,9 +36,17 @@ static inline void swp_tag_top(struct b6_tref *a, struct b6_tref *b)
 	b->top = top;
 }
 
+#ifdef B6_STATS
+__thread struct b6_counters *__b6_tree_counters;
+#endif
+
 static void rotate(struct b6_tref *r, int dir, int opp)
 {
 	struct b6_tref *p = r->ref[opp], *q = p->ref[dir], *t = get_top(r);
+#ifdef B6_STATS
+	if (__b6_tree_counters)
+		__b6_tree_counters->rotations += 1;
+#endif
 	if (p->ref[dir])
 		set_top(q, r);
 	r->ref[opp] = q;
@@ -208,7 +216,7 @@ static int rebalance_avl(struct b6_tref *r, int opp)
  * the insertion or when it has to be re-balanced as it will restore its
  * previous height.
  */
-static void b6_tree_avl_add(struct b6_tref *top, int dir, struct b6_tref *ref)
+void __b6_tree_avl_add(struct b6_tref *top, int dir, struct b6_tref *ref)
 {
 	insert(top, dir, ref);
 	set_avl_bal(ref, 0);
@@ -250,7 +258,7 @@ static void b6_tree_avl_add(struct b6_tref *top, int dir, struct b6_tref *ref)
  * the removal or when it had to be re-balanced and that operation did not
  * change its height.
  */
-static struct b6_tref *b6_tree_avl_del(struct b6_tref *top, int dir)
+struct b6_tref *__b6_tree_avl_del(struct b6_tref *top, int dir)
 {
 	struct b6_tref *ref, *ret = remove(&top, &dir);
 
@@ -340,8 +348,8 @@ int b6_tree_avl_chk(const struct b6_tree *tree, struct b6_tref **tref)
 }
 
 const struct b6_tree_ops b6_tree_avl_ops = {
-	.add = b6_tree_avl_add,
-	.del = b6_tree_avl_del,
+	.add = __b6_tree_avl_add,
+	.del = __b6_tree_avl_del,
 	.chk = b6_tree_avl_chk,
 };
 
@@ -417,7 +425,7 @@ static inline int is_red(const struct b6_tref *tref)
  *    /  \                                                /  \
  * A[b]  B[b]                                          D[?]  E[?]
  */
-static void b6_tree_rb_add(struct b6_tref *top, int dir, struct b6_tref *ref)
+void __b6_tree_rb_add(struct b6_tref *top, int dir, struct b6_tref *ref)
 {
 	struct b6_tref *elder = get_top(top);
 
@@ -508,7 +516,7 @@ static void b6_tree_rb_add(struct b6_tref *top, int dir, struct b6_tref *ref)
  * changed from red to black, balancing the node they lost during the
  * rotation.
  */
-static struct b6_tref *b6_tree_rb_del(struct b6_tref *top, int dir)
+struct b6_tref *__b6_tree_rb_del(struct b6_tref *top, int dir)
 {
 	struct b6_tref *ret = remove(&top, &dir);
 
@@ -630,11 +638,229 @@ static int b6_tree_rb_chk(const struct b6_tree *tree, struct b6_tref **tref)
 }
 
 const struct b6_tree_ops b6_tree_rb_ops = {
-	.add = b6_tree_rb_add,
-	.del = b6_tree_rb_del,
+	.add = __b6_tree_rb_add,
+	.del = __b6_tree_rb_del,
 	.chk = b6_tree_rb_chk,
 };
 
+static inline int get_wavl_parity(const struct b6_tref *tref)
+{
+	return tref ? get_tag(tref) & 1 : 1;
+}
+
+static inline void flip_wavl_rank(struct b6_tref *tref)
+{
+	set_tag(tref, get_tag(tref) ^ 1);
+}
+
+/* true when the rank difference between top and ref is even */
+static inline int is_wavl_even(const struct b6_tref *top,
+			       const struct b6_tref *ref)
+{
+	return get_wavl_parity(top) == get_wavl_parity(ref);
+}
+
+/*
+ * Weak AVL Tree Insertion
+ * -----------------------
+ *
+ * Every node has a rank, null nodes having rank -1. Rank differences between
+ * a node and its children are either 1 or 2 (1-children and 2-children), and
+ * leaves have rank 0. Only the parity of ranks is stored in the tag of nodes:
+ * as the rank difference is known to be in a range of two values wherever it
+ * is looked at, parities are enough to tell them apart.
+ *
+ * A new leaf of rank 0 may be a 0-child. While it is the case and its sibling
+ * is a 1-child, the parent is promoted and the problem moves one level up.
+ * Otherwise, the sibling is a 2-child and a single or double rotation ends the
+ * operation, exactly like in AVL trees. As a matter of fact, weak AVL trees
+ * without deletions are AVL trees.
+ *
+ * SR:       z(k)                x(k)
+ * ---      /    \              /    \
+ *       x(k)    s(k-2) ==> w(k-1)   z(k-1)
+ *      /    \                       /    \
+ *   w(k-1)  y(k-2)               y(k-2)  s(k-2)
+ *
+ * DR:       z(k)                   __y(k)__
+ * ---      /    \                 /        \
+ *       x(k)    s(k-2) ==>    x(k-1)       z(k-1)
+ *      /    \                /     \      /     \
+ *   w(k-2)  y(k-1)        w(k-2)   A     B     s(k-2)
+ *           /  \
+ *          A    B
+ */
+void __b6_tree_wavl_add(struct b6_tref *top, int dir, struct b6_tref *ref)
+{
+	insert(top, dir, ref);
+	set_tag(ref, 0);
+
+	while (get_top(top) && is_wavl_even(top, ref)) {
+		int opp = b6_to_opposite(dir);
+		struct b6_tref *sibling = top->ref[opp], *inner;
+
+		if (!is_wavl_even(top, sibling)) {
+			flip_wavl_rank(top);
+			ref = top;
+			top = get_top(ref);
+			dir = top->ref[B6_NEXT] == ref ? B6_NEXT : B6_PREV;
+			continue;
+		}
+
+		inner = ref->ref[opp];
+		if (!inner || is_wavl_even(ref, inner)) {
+			rotate(top, opp, dir);
+		} else {
+			rotate(ref, dir, opp);
+			rotate(top, opp, dir);
+			flip_wavl_rank(inner);
+			flip_wavl_rank(ref);
+		}
+		flip_wavl_rank(top);
+		break;
+	}
+}
+
+/*
+ * Weak AVL Tree Removal
+ * ---------------------
+ *
+ * Removing a leaf or a unary node increases the rank difference of the node
+ * taking its place by one. A node which becomes a leaf with two 2-children is
+ * first demoted. Then, while a node is a 3-child:
+ *
+ * 1] if its sibling is a 2-child, the parent is demoted,
+ *
+ * 2] if its sibling is a 1-child with two 2-children, both the parent and the
+ * sibling are demoted,
+ *
+ * and the problem moves one level up. Otherwise, the sibling y has a 1-child v
+ * or w and a rotation ends the operation:
+ *
+ * SR:       z(k)                     y(k)
+ * ---      /    \                   /    \
+ *     x(k-3)    y(k-1)    ==>   z(k-1)   v(k-2)
+ *               /    \          /    \
+ *              w     v(k-2) x(k-3)    w
+ *
+ * z is demoted once more should it be a leaf.
+ *
+ * DR:       z(k)                     __w(k)__
+ * ---      /    \                   /        \
+ *     x(k-3)    y(k-1)    ==>   z(k-2)       y(k-2)
+ *               /    \          /    \       /    \
+ *          w(k-2)    v(k-3) x(k-3)   A      B    v(k-3)
+ *          /  \
+ *         A    B
+ *
+ * There are at most two rotations, and the number of demotions is O(1)
+ * amortized.
+ */
+struct b6_tref *__b6_tree_wavl_del(struct b6_tref *top, int dir)
+{
+	struct b6_tref *ret = remove(&top, &dir);
+
+	if (!get_top(top))
+		return ret;
+
+	if (!top->ref[B6_NEXT] && !top->ref[B6_PREV]) {
+		b6_assert(get_wavl_parity(top));
+		flip_wavl_rank(top);
+		if (!get_top(get_top(top)))
+			return ret;
+		dir = get_top(top)->ref[B6_NEXT] == top ? B6_NEXT : B6_PREV;
+		top = get_top(top);
+	}
+
+	while (!is_wavl_even(top, top->ref[dir])) {
+		int opp = b6_to_opposite(dir);
+		struct b6_tref *sibling = top->ref[opp], *outer, *inner;
+
+		b6_assert(sibling);
+
+		if (!is_wavl_even(top, sibling)) {
+			outer = sibling->ref[opp];
+			inner = sibling->ref[dir];
+			if (!is_wavl_even(sibling, outer)) {
+				rotate(top, dir, opp);
+				flip_wavl_rank(sibling);
+				flip_wavl_rank(top);
+				if (!top->ref[B6_NEXT] && !top->ref[B6_PREV])
+					flip_wavl_rank(top);
+				break;
+			}
+			if (!is_wavl_even(sibling, inner)) {
+				rotate(sibling, opp, dir);
+				rotate(top, dir, opp);
+				flip_wavl_rank(sibling);
+				break;
+			}
+			flip_wavl_rank(sibling);
+		}
+
+		flip_wavl_rank(top);
+		if (!get_top(get_top(top)))
+			break;
+		dir = get_top(top)->ref[B6_NEXT] == top ? B6_NEXT : B6_PREV;
+		top = get_top(top);
+	}
+
+	return ret;
+}
+
+/*
+ * Weak AVL Tree Verification
+ * --------------------------
+ *
+ * The tree is traveled in depth first. The rank of each node is computed from
+ * both of its children and parities: they must agree. Leaves with two
+ * 2-children are rejected. The function returns the rank plus one.
+ */
+static int __b6_tree_wavl_chk(struct b6_tref **tref)
+{
+	struct b6_tref *curr = *tref;
+	int rank[2], dir;
+
+	for (dir = 0; dir < 2; dir += 1) {
+		struct b6_tref *child = b6_tree_child(curr, dir);
+		if (child) {
+			*tref = child;
+			if ((rank[dir] = __b6_tree_wavl_chk(tref)) < 0)
+				return -1;
+		} else
+			rank[dir] = 0;
+		rank[dir] += is_wavl_even(curr, child) ? 2 : 1;
+	}
+
+	*tref = curr;
+	if (rank[B6_NEXT] != rank[B6_PREV])
+		return -1;
+	if (!curr->ref[B6_NEXT] && !curr->ref[B6_PREV] && rank[B6_NEXT] != 1)
+		return -1;
+
+	return rank[B6_NEXT];
+}
+
+static int b6_tree_wavl_chk(const struct b6_tree *tree, struct b6_tref **tref)
+{
+	int retval = 0;
+	struct b6_tref *root = b6_tree_root(tree);
+
+	if (root)
+		retval = __b6_tree_wavl_chk(&root);
+
+	if (tref)
+		*tref = root;
+
+	return retval;
+}
+
+const struct b6_tree_ops b6_tree_wavl_ops = {
+	.add = __b6_tree_wavl_add,
+	.del = __b6_tree_wavl_del,
+	.chk = b6_tree_wavl_chk,
+};
+
 /*
  * AVL/Red-Black Tree Traveling
  * ----------------------------
@@ -667,3 +893,57 @@ struct b6_tref *__b6_tree_walk(const struct b6_tref *ref, int dir)
 
 	return (struct b6_tref *)ref;
 }
+
+/*
+ * AVL/Red-Black Tree Destruction
+ * ------------------------------
+ *
+ * From the current node, the tree is dived into until a leaf is found. This
+ * leaf is unlinked from its parent before it is released. Then, the operation
+ * goes on with the parent, which may have become a leaf in its turn. As links
+ * to released nodes are cleared, every node is visited twice at most.
+ */
+void b6_tree_clear(struct b6_tree *tree,
+		   void (*release)(struct b6_tref*, void*), void *arg)
+{
+	struct b6_tref *head = b6_tree_head(tree);
+	struct b6_tref *ref = b6_tree_root(tree);
+
+	while (ref && ref != head) {
+		struct b6_tref *top, *child;
+
+		if ((child = ref->ref[B6_PREV]) || (child = ref->ref[B6_NEXT])) {
+			ref = child;
+			continue;
+		}
+
+		top = get_top(ref);
+		top->ref[top->ref[B6_NEXT] == ref ? B6_NEXT : B6_PREV] = NULL;
+		if (release)
+			release(ref, arg);
+		ref = top;
+	}
+}
+
+/*
+ * As trees are balanced, their height is logarithmic and they can be traveled
+ * recursively.
+ */
+static unsigned long int get_shape(const struct b6_tref *ref,
+				   struct b6_stats *stats)
+{
+	unsigned long int prev, next;
+	if (!ref)
+		return 0;
+	prev = get_shape(ref->ref[B6_PREV], stats);
+	next = get_shape(ref->ref[B6_NEXT], stats);
+	__b6_count_balance(stats, (long int)next - (long int)prev);
+	stats->size += 1;
+	return 1 + (prev > next ? prev : next);
+}
+
+void b6_tree_stats(const struct b6_tree *tree, struct b6_stats *stats)
+{
+	__b6_setup_stats(stats, __b6_counters_of(tree));
+	stats->height = get_shape(b6_tree_root(tree), stats);
+}
@@ -0,0 +1,105 @@
+#include "test.h"
+
+#include "b6/array.h"
+
+#include <stdlib.h>
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *do_reallocate(struct b6_allocator *self, void *ptr,
+			   unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.reallocate = do_reallocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+static int compare_int(void *item, void *key)
+{
+	int l = *(int *)item;
+	int r = *(int *)key;
+	return l < r ? -1 : l > r;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int extend_and_reduce(void)
+{
+	struct b6_array array;
+	int *ptr, i;
+
+	b6_array_initialize(&array, &malloc_allocator, sizeof(int));
+	for (i = 0; i < 100; i += 1) {
+		if (!(ptr = b6_array_extend(&array, 1)))
+			return 0;
+		*ptr = i;
+	}
+	if (b6_array_length(&array) != 100)
+		return 0;
+	for (i = 0; i < 100; i += 1)
+		if (*(int *)b6_array_get(&array, i) != i)
+			return 0;
+	if (b6_array_reduce(&array, 1000) != 100)
+		return 0;
+	b6_array_finalize(&array);
+	return !b6_array_length(&array);
+}
+
+static int search_batch(void)
+{
+	struct b6_array array;
+	int i, *ptr, values[64];
+	void *keys[b6_card_of(values)], *items[b6_card_of(values)];
+	int retval = 1;
+
+	b6_array_initialize(&array, &malloc_allocator, sizeof(int));
+	if (!(ptr = b6_array_extend(&array, 32)))
+		return 0;
+	for (i = 0; i < 32; i += 1)
+		ptr[i] = i * 2;
+
+	for (i = 0; i < b6_card_of(values); i += 1) {
+		values[i] = (i * 7) % b6_card_of(values);
+		keys[i] = &values[i];
+	}
+
+	b6_array_search_batch(&array, compare_int, keys, b6_card_of(keys),
+			      items);
+
+	for (i = 0; i < b6_card_of(values); i += 1)
+		if (values[i] & 1)
+			retval &= !items[i];
+		else
+			retval &= items[i] == &ptr[values[i] / 2];
+
+	b6_array_finalize(&array);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(extend_and_reduce,);
+	test_exec(search_batch,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,266 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/art.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct item {
+	struct b6_aref aref;
+	char name[40];
+	int inside;
+};
+
+static struct item items[6000];
+static struct item *sorted[b6_card_of(items)];
+
+static int compare_items(const void *lhs, const void *rhs)
+{
+	return strcmp((*(const struct item **)lhs)->name,
+		      (*(const struct item **)rhs)->name);
+}
+
+/* names sharing short and long prefixes, with dense and sparse fan-outs */
+static void name_items(void)
+{
+	static const char *prefixes[] = {
+		"pool.", "sys.", "a rather long common prefix.", "",
+	};
+	unsigned int u;
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		const char *prefix = prefixes[u % b6_card_of(prefixes)];
+		if (u % 7 == 3)
+			snprintf(items[u].name, sizeof(items[u].name), "%s%c",
+				 prefix, 1 + (u / 7) % 255);
+		else
+			snprintf(items[u].name, sizeof(items[u].name),
+				 "%s%u.%x", prefix, u % 97, u);
+		items[u].aref.key = items[u].name;
+		items[u].aref.length = strlen(items[u].name);
+		items[u].inside = 0;
+		sorted[u] = &items[u];
+	}
+	qsort(sorted, b6_card_of(sorted), sizeof(sorted[0]), compare_items);
+}
+
+/* travel elements starting with prefix and compare with the sorted items */
+static int check_walk(const struct b6_art *art, const char *prefix)
+{
+	struct b6_art_iterator iter;
+	const struct b6_aref *aref;
+	unsigned long int u = 0, n = 0, length = strlen(prefix);
+
+	b6_setup_art_iterator(&iter, art, prefix);
+	for (;;) {
+		for (; u < b6_card_of(sorted); u += 1)
+			if (sorted[u]->inside &&
+			    !strncmp(sorted[u]->name, prefix, length))
+				break;
+		aref = b6_get_next_art_iterator(&iter);
+		if (u == b6_card_of(sorted))
+			break;
+		if (aref != &sorted[u]->aref)
+			return 0;
+		u += 1;
+		n += 1;
+	}
+	return !aref && !b6_get_next_art_iterator(&iter) &&
+		(*prefix || n == b6_art_length(art));
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int random_ops(void)
+{
+	struct b6_art art;
+	unsigned long int u, length = 0;
+	unsigned int seed = 0;
+	int retval = 0;
+
+	name_items();
+	b6_art_initialize(&art, &malloc_allocator);
+	for (u = 0; u < 200000; u += 1) {
+		struct item *item = &items[rand_r(&seed) % b6_card_of(items)];
+		struct b6_aref *aref = b6_art_find(&art, item->name,
+						   item->aref.length);
+		if (aref != (item->inside ? &item->aref : NULL))
+			goto bail_out;
+		if (rand_r(&seed) % 2) {
+			if (b6_art_insert(&art, &item->aref) !=
+			    (item->inside ? -1 : 0))
+				goto bail_out;
+			length += !item->inside;
+			item->inside = 1;
+		} else {
+			if (b6_art_remove(&art, item->name,
+					  item->aref.length) != aref)
+				goto bail_out;
+			length -= item->inside;
+			item->inside = 0;
+		}
+		if (b6_art_length(&art) != length)
+			goto bail_out;
+		if (!(u % 9973) && (!check_walk(&art, "") ||
+				    !check_walk(&art, "pool.")))
+			goto bail_out;
+	}
+	retval = check_walk(&art, "") && check_walk(&art, "pool.") &&
+		check_walk(&art, "sys.1") && check_walk(&art, "a rather") &&
+		check_walk(&art, "a rather long common prefix.4") &&
+		check_walk(&art, "zzz") && check_walk(&art, "\xff");
+bail_out:
+	b6_art_finalize(&art);
+	return retval;
+}
+
+/* fill then empty the trie so that every node grows and shrinks */
+static int grow_and_shrink(void)
+{
+	struct b6_art art;
+	unsigned long int u;
+	int retval = 0;
+
+	name_items();
+	b6_art_initialize(&art, &malloc_allocator);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		if (b6_art_insert(&art, &items[u].aref))
+			goto bail_out;
+		items[u].inside = 1;
+	}
+	if (!check_walk(&art, "") || !check_walk(&art, "sys."))
+		goto bail_out;
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		if (b6_art_remove(&art, items[u].name, items[u].aref.length) !=
+		    &items[u].aref)
+			goto bail_out;
+		items[u].inside = 0;
+		if (!(u % 997) && !check_walk(&art, ""))
+			goto bail_out;
+	}
+	retval = !art.root && !b6_art_length(&art);
+bail_out:
+	b6_art_finalize(&art);
+	return retval;
+}
+
+static int remove_while_walking(void)
+{
+	struct b6_art art;
+	struct b6_art_iterator iter;
+	const struct b6_aref *aref;
+	unsigned long int u;
+	int retval = 0;
+
+	name_items();
+	b6_art_initialize(&art, &malloc_allocator);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		if (b6_art_insert(&art, &items[u].aref))
+			goto bail_out;
+		items[u].inside = 1;
+	}
+	b6_setup_art_iterator(&iter, &art, "pool.");
+	while ((aref = b6_get_next_art_iterator(&iter))) {
+		struct item *item = b6_cast_of(aref, struct item, aref);
+		b6_art_remove(&art, aref->key, aref->length);
+		item->inside = 0;
+	}
+	retval = check_walk(&art, "") && check_walk(&art, "pool.") &&
+		b6_art_length(&art) == 3 * b6_card_of(items) / 4;
+bail_out:
+	b6_art_finalize(&art);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	struct b6_art art;
+	unsigned long int u;
+	unsigned int seed = 0;
+	int retval = 0;
+
+	name_items();
+	b6_art_initialize(&art, &malloc_allocator);
+	for (u = 0; u < 100000; u += 1) {
+		struct item *item = &items[rand_r(&seed) % b6_card_of(items)];
+		int failing = rand_r(&seed) % 4 == 0;
+		allocations = failing ? 0 : ~0UL;
+		if (rand_r(&seed) % 3) {
+			int r = b6_art_insert(&art, &item->aref);
+			if (r == 0)
+				item->inside = 1;
+			else if (r == -1 ? !item->inside : r != -2 || !failing)
+				goto bail_out;
+		} else if (b6_art_remove(&art, item->name, item->aref.length) !=
+			   (item->inside ? &item->aref : NULL))
+			goto bail_out;
+		else
+			item->inside = 0;
+		if (!(u % 997) && !check_walk(&art, ""))
+			goto bail_out;
+	}
+	retval = check_walk(&art, "") && check_walk(&art, "pool.");
+bail_out:
+	allocations = ~0UL;
+	b6_art_finalize(&art);
+	return retval;
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static void bench(void)
+{
+	struct b6_art art;
+	struct b6_art_iterator iter;
+	struct timespec t0;
+	unsigned long int u, found = 0;
+	unsigned int seed = 0;
+
+	name_items();
+	b6_art_initialize(&art, &malloc_allocator);
+	for (u = 0; u < b6_card_of(items); u += 1)
+		b6_art_insert(&art, &items[u].aref);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < 1 << 22; u += 1) {
+		struct item *item = &items[rand_r(&seed) % b6_card_of(items)];
+		found += !!b6_art_find(&art, item->name, item->aref.length);
+	}
+	printf("find     %6.1fns (%lu)\n", elapsed(&t0) * 1e9 / u, found);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0, found = 0; u < 1000; u += 1) {
+		b6_setup_art_iterator(&iter, &art, "sys.4");
+		while (b6_get_next_art_iterator(&iter))
+			found += 1;
+	}
+	printf("prefix   %6.1fns per element (%lu)\n",
+	       elapsed(&t0) * 1e9 / found, found / 1000);
+	b6_art_finalize(&art);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(random_ops,);
+	test_exec(grow_and_shrink,);
+	test_exec(remove_while_walking,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include "test.h"
+
+#include "b6/clist.h"
+#include "b6/ctree.h"
+
+#include <stdlib.h>
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *do_reallocate(struct b6_allocator *self, void *ptr,
+			   unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.reallocate = do_reallocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+struct item {
+	struct b6_cdref cdref;
+	struct b6_ctref ctref;
+	unsigned int key;
+};
+
+static struct item *get_item(const struct b6_array *array, unsigned int index)
+{
+	return b6_array_get(array, index - 1);
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int clist_operations(void)
+{
+	struct b6_array items;
+	struct b6_clist list;
+	unsigned int u, index;
+	int retval = 0;
+
+	b6_array_initialize(&items, &malloc_allocator, sizeof(struct item));
+	b6_clist_initialize(&list, &items, b6_offset_of(struct item, cdref));
+	if (!b6_clist_empty(&list) || b6_clist_first(&list))
+		goto bail_out;
+
+	/* items get added while the array keeps being reallocated */
+	for (u = 1; u <= 100; u += 1) {
+		struct item *item = b6_array_extend(&items, 1);
+		if (!item)
+			goto bail_out;
+		item->key = u;
+		if (u & 1)
+			b6_clist_add_last(&list, u);
+		else
+			b6_clist_add_first(&list, u);
+	}
+
+	for (u = 100, index = b6_clist_first(&list); index;
+	     index = b6_clist_walk(&list, index, B6_NEXT)) {
+		if (get_item(&items, index)->key != u)
+			goto bail_out;
+		u = u == 2 ? 1 : u & 1 ? u + 2 : u - 2;
+	}
+	if (u != 101)
+		goto bail_out;
+
+	if (b6_clist_del_first(&list) != 100 || b6_clist_del_last(&list) != 99)
+		goto bail_out;
+	for (u = 1; u < 99; u += 2)
+		b6_clist_del(&list, u);
+	for (u = 98, index = b6_clist_last(&list); index;
+	     index = b6_clist_walk(&list, index, B6_PREV), u -= 2)
+		if (index != 100 - u)
+			goto bail_out;
+	retval = !u;
+
+bail_out:
+	b6_array_finalize(&items);
+	return retval;
+}
+
+static unsigned int ctree_find(const struct b6_ctree *tree, unsigned int key,
+			       unsigned int *top, int *dir)
+{
+	unsigned int ref;
+	b6_ctree_search(tree, ref, *top, *dir) {
+		unsigned int k = get_item(tree->array, ref)->key;
+		if (k == key)
+			break;
+		*dir = k < key ? B6_NEXT : B6_PREV;
+	}
+	return ref;
+}
+
+static int ctree_operations(void)
+{
+	struct b6_array items;
+	struct b6_ctree tree;
+	unsigned int u, index, top, n = 2000;
+	int dir, retval = 0;
+
+	b6_array_initialize(&items, &malloc_allocator, sizeof(struct item));
+	b6_ctree_initialize(&tree, &items, b6_offset_of(struct item, ctref));
+	if (!b6_ctree_empty(&tree) || b6_ctree_first(&tree))
+		goto bail_out;
+
+	for (u = 1; u <= n; u += 1) {
+		struct item *item = b6_array_extend(&items, 1);
+		if (!item)
+			goto bail_out;
+		item->key = (u * 7919) % n;
+		if (ctree_find(&tree, item->key, &top, &dir))
+			goto bail_out;
+		b6_ctree_add(&tree, top, dir, u);
+		if (b6_ctree_check(&tree) < 0)
+			goto bail_out;
+	}
+
+	for (u = 0, index = b6_ctree_first(&tree); index;
+	     u += 1, index = b6_ctree_walk(&tree, index, B6_NEXT))
+		if (get_item(&items, index)->key != u)
+			goto bail_out;
+	if (u != n)
+		goto bail_out;
+
+	for (u = 0; u < n; u += 3) {
+		if (!(index = ctree_find(&tree, u, &top, &dir)))
+			goto bail_out;
+		top = b6_ctree_parent(&tree, index, &dir);
+		if (b6_ctree_del(&tree, top, dir) != index)
+			goto bail_out;
+		if (b6_ctree_check(&tree) < 0)
+			goto bail_out;
+	}
+
+	for (u = n, index = b6_ctree_last(&tree); index;
+	     index = b6_ctree_walk(&tree, index, B6_PREV)) {
+		do u -= 1; while (!(u % 3));
+		if (get_item(&items, index)->key != u)
+			goto bail_out;
+	}
+	retval = u == 1;
+
+bail_out:
+	b6_array_finalize(&items);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(clist_operations,);
+	test_exec(ctree_operations,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/concurrent_registry.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct item {
+	struct b6_entry entry;
+	char name[24];
+};
+
+/* even items stay registered, odd ones come and go */
+static struct item items[2000];
+
+static void name_items(void)
+{
+	unsigned int u;
+	for (u = 0; u < b6_card_of(items); u += 1)
+		snprintf(items[u].name, sizeof(items[u].name), "item.%u", u);
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int single_thread(void)
+{
+	struct b6_concurrent_registry registry;
+	struct item dup;
+	char name[32];
+	unsigned int u, round;
+	int retval = 0;
+
+	name_items();
+	b6_setup_concurrent_registry(&registry, &malloc_allocator);
+	if (b6_lookup_concurrent_registry(&registry, items[0].name))
+		goto bail_out;
+	for (u = 0; u < b6_card_of(items); u += 1)
+		if (b6_register_concurrent(&registry, &items[u].entry,
+					   items[u].name))
+			goto bail_out;
+	if (b6_register_concurrent(&registry, &dup.entry, items[7].name) != -1)
+		goto bail_out;
+	/* tombstones must not make the index grow forever */
+	for (round = 0; round < 50; round += 1) {
+		for (u = 1; u < b6_card_of(items); u += 2)
+			b6_unregister_concurrent(&registry, &items[u].entry);
+		for (u = 1; u < b6_card_of(items); u += 2)
+			if (b6_register_concurrent(&registry, &items[u].entry,
+						   items[u].name))
+				goto bail_out;
+	}
+	if (registry.index->mask + 1 > 8 * b6_card_of(items))
+		goto bail_out;
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		strcpy(name, items[u].name);
+		if (b6_lookup_concurrent_registry(&registry, name) !=
+		    &items[u].entry)
+			goto bail_out;
+		strcat(name, "x");
+		if (b6_lookup_concurrent_registry(&registry, name))
+			goto bail_out;
+	}
+	for (u = 0; u < b6_card_of(items); u += 2)
+		b6_unregister_concurrent(&registry, &items[u].entry);
+	for (u = 0; u < b6_card_of(items); u += 1)
+		if (!b6_lookup_concurrent_registry(&registry, items[u].name) !=
+		    !(u % 2))
+			goto bail_out;
+	retval = b6_concurrent_registry_length(&registry) ==
+		b6_card_of(items) / 2;
+bail_out:
+	b6_finalize_concurrent_registry(&registry);
+	return retval;
+}
+
+static struct b6_concurrent_registry shared;
+static int done;
+static unsigned long int lookups;
+
+static void *reader(void *arg)
+{
+	unsigned long int n = 0, errors = 0;
+	unsigned int u = 0;
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+		struct b6_entry *entry;
+		u = (u + 7) % b6_card_of(items);
+		entry = b6_lookup_concurrent_registry(&shared, items[u].name);
+		if (u % 2)
+			errors += entry && entry != &items[u].entry;
+		else
+			errors += entry != &items[u].entry;
+		n += 1;
+	}
+	__atomic_add_fetch(&lookups, n, __ATOMIC_RELAXED);
+	return (void *)errors;
+}
+
+static int concurrent_readers(void)
+{
+	pthread_t threads[4];
+	unsigned int u, round, t;
+	int retval = 1;
+
+	name_items();
+	b6_setup_concurrent_registry(&shared, &malloc_allocator);
+	for (u = 0; u < b6_card_of(items); u += 2)
+		if (b6_register_concurrent(&shared, &items[u].entry,
+					   items[u].name))
+			return 0;
+	done = 0;
+	for (t = 0; t < b6_card_of(threads); t += 1)
+		if (pthread_create(&threads[t], NULL, reader, NULL))
+			return 0;
+	for (round = 0; round < 200; round += 1) {
+		for (u = 1; u < b6_card_of(items); u += 2)
+			if (b6_register_concurrent(&shared, &items[u].entry,
+						   items[u].name))
+				retval = 0;
+		for (u = 1; u < b6_card_of(items); u += 2)
+			b6_unregister_concurrent(&shared, &items[u].entry);
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (t = 0; t < b6_card_of(threads); t += 1) {
+		void *errors;
+		pthread_join(threads[t], &errors);
+		if (errors)
+			retval = 0;
+	}
+	b6_finalize_concurrent_registry(&shared);
+	return retval && lookups;
+}
+
+static int out_of_memory(void)
+{
+	struct b6_concurrent_registry registry;
+	unsigned int u;
+	int retval = 0;
+
+	name_items();
+	b6_setup_concurrent_registry(&registry, &malloc_allocator);
+	allocations = 0;
+	if (b6_register_concurrent(&registry, &items[0].entry,
+				   items[0].name) != -2 ||
+	    b6_lookup_concurrent_registry(&registry, items[0].name))
+		goto bail_out;
+	allocations = 1;
+	for (u = 0; u < b6_card_of(items); u += 1)
+		if (b6_register_concurrent(&registry, &items[u].entry,
+					   items[u].name))
+			break;
+	if (u == b6_card_of(items) ||
+	    b6_lookup_concurrent_registry(&registry, items[u].name) ||
+	    b6_concurrent_registry_length(&registry) != u)
+		goto bail_out;
+	/* unregistering never allocates */
+	while (u--)
+		b6_unregister_concurrent(&registry, &items[u].entry);
+	retval = !b6_concurrent_registry_length(&registry);
+bail_out:
+	allocations = ~0UL;
+	b6_finalize_concurrent_registry(&registry);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(single_thread,);
+	test_exec(concurrent_readers,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,340 @@
+#include "test.h"
+
+#include "b6/flags.h"
+#include "b6/array.h"
+#include "b6/pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int ctor_int = 0;
+b6_flag(ctor_int, int);
+
+static const char *static_string = NULL;
+b6_static_flag(static_string, string);
+
+static int static_bool = 0;
+b6_static_flag_named(static_bool, bool, "enable-thing");
+
+static long int static_long = 0;
+b6_static_flag(static_long, long);
+
+static unsigned long int static_size = 0;
+b6_static_flag(static_size, size);
+
+static unsigned long long int static_duration = 0;
+b6_static_flag(static_duration, duration);
+
+#define MANY(n) \
+	static unsigned int many_ ## n = 0; \
+	b6_static_flag(many_ ## n, uint)
+
+MANY(0); MANY(1); MANY(2); MANY(3); MANY(4); MANY(5); MANY(6); MANY(7);
+MANY(8); MANY(9); MANY(10); MANY(11); MANY(12); MANY(13); MANY(14); MANY(15);
+MANY(16); MANY(17); MANY(18); MANY(19); MANY(20); MANY(21); MANY(22);
+MANY(24); MANY(25); MANY(26); MANY(27); MANY(28); MANY(29);
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int static_flags(void)
+{
+	char a0[] = "prog", a1[] = "--ctor-int=42", a2[] = "file",
+	     a3[] = "--static-string=hello", a4[] = "--enable-thing",
+	     a5[] = "--static_long=-7", a6[] = "--many-17=17",
+	     a7[] = "--many_0=0x10", a8[] = "--many-22=22", a9[] = "--",
+	     a10[] = "--many-1=1";
+	char *argv[] = { a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, };
+	int argc = b6_card_of(argv);
+	int argf = b6_parse_command_line_flags(argc, argv, 1);
+
+	/* flags after "--" are left alone */
+	return argf == 8 && ctor_int == 42 && static_string &&
+		!strcmp(static_string, "hello") && static_bool == 1 &&
+		static_long == -7 && many_17 == 17 && many_0 == 16 &&
+		many_22 == 22 && many_1 == 0 && !strcmp(argv[8], "file");
+}
+
+static int unknown_static_flag(void)
+{
+	char a0[] = "prog", a1[] = "--many-2=2", a2[] = "--many-23=23",
+	     b1[] = "--many-3=3", b2[] = "--many-23=23";
+	char *argv[] = { a0, a1, a2, };
+	char *brgv[] = { a0, b1, b2, };
+
+	return b6_parse_command_line_flags(b6_card_of(argv), argv, 1) == -2 &&
+		many_2 == 2 &&
+		b6_parse_command_line_flags(b6_card_of(brgv), brgv, 0) == 3 &&
+		many_3 == 3;
+}
+
+static unsigned long int notified;
+static unsigned long int notified_version;
+
+static void on_changed(struct b6_flag_observer *self, struct b6_flag *flag)
+{
+	notified += 1;
+	if (flag->version != b6_get_flags_version())
+		notified_version = ~0UL;
+}
+
+static const struct b6_flag_observer_ops observer_ops = {
+	.changed = on_changed,
+};
+
+static int reload(void)
+{
+	char text[] =
+		"# tuning knobs\n"
+		"\n"
+		"  ctor_int = 7 \n"
+		"--enable-thing=off\n"
+		"many-5=5\r\n"
+		"static_string=a b c\n"
+		"static_long=-3";
+	char bad_value[] = "many-6=6\nmany-7=x\n";
+	char bad_name[] = "many-6=6\n\n# x\nunknown=1\n";
+	char junk[] = "many-6 6\n";
+	char single[] = "static-bool";
+	char orig[sizeof(text)];
+	struct b6_flag_observer observer;
+	unsigned long int version = b6_get_flags_version();
+
+	b6_reset_flag_observer(&observer, &observer_ops);
+	b6_add_flag_observer(&observer);
+	notified = notified_version = 0;
+	static_bool = 1;
+	memcpy(orig, text, sizeof(text));
+	if (b6_reload_flags(text) || b6_read_flag(ctor_int) != 7 ||
+	    b6_read_flag(static_bool) || b6_read_flag(many_5) != 5 ||
+	    strcmp(b6_read_flag(static_string), "a b c") ||
+	    b6_read_flag(static_long) != -3 ||
+	    b6_get_flags_version() != version + 1 || notified != 5 ||
+	    notified_version)
+		return 0;
+	/* only the string value got null-terminated */
+	orig[strstr(orig, "a b c") - orig + 5] = '\0';
+	if (memcmp(orig, text, sizeof(text)))
+		return 0;
+
+	/* nothing changes when a line is wrong */
+	if (b6_reload_flags(bad_value) != -2 || b6_reload_flags(bad_name) != -4 ||
+	    b6_reload_flags(junk) != -1 || many_6 ||
+	    strcmp(bad_value, "many-6=6\nmany-7=x\n") ||
+	    strcmp(bad_name, "many-6=6\n\n# x\nunknown=1\n") ||
+	    b6_get_flags_version() != version + 1 || notified != 5)
+		return 0;
+
+	if (b6_set_flag("many_8", "8") || b6_set_flag("many_8", "x") != -2 ||
+	    b6_set_flag(single, NULL) != -1 || b6_set_flag("enable-thing", NULL) ||
+	    many_8 != 8 || !static_bool || notified != 7 ||
+	    b6_get_flags_version() != version + 3)
+		return 0;
+
+	b6_del_flag_observer(&observer);
+	return !b6_set_flag("many_8", "9") && notified == 7;
+}
+
+static int units(void)
+{
+	static const struct {
+		const char *size;
+		unsigned long int bytes;
+	} sizes[] = {
+		{ "0", 0UL }, { "4096", 4096UL }, { "64K", 65536UL },
+		{ "64k", 65536UL }, { "2M", 2UL << 20 }, { "1GiB", 1UL << 30 },
+		{ "512B", 512UL },
+	};
+	static const struct {
+		const char *duration;
+		unsigned long long int us;
+	} durations[] = {
+		{ "7", 7ULL }, { "500us", 500ULL }, { "10ms", 10000ULL },
+		{ "3s", 3000000ULL }, { "2m", 120000000ULL },
+		{ "1h", 3600000000ULL },
+	};
+	unsigned int i;
+
+	for (i = 0; i < b6_card_of(sizes); i += 1)
+		if (b6_set_flag("static_size", sizes[i].size) ||
+		    b6_read_flag(static_size) != sizes[i].bytes)
+			return 0;
+	for (i = 0; i < b6_card_of(durations); i += 1)
+		if (b6_set_flag("static_duration", durations[i].duration) ||
+		    b6_read_flag(static_duration) != durations[i].us)
+			return 0;
+	if (b6_set_flag("static_size", "K") != -2 ||
+	    b6_set_flag("static_size", "12Q") != -2 ||
+	    b6_set_flag("static_size", "99999999999T") != -2 ||
+	    b6_set_flag("static_duration", "10 ms") != -2 ||
+	    b6_set_flag("static_duration", "1d") != -2 ||
+	    static_size != 512UL || static_duration != 3600000000ULL)
+		return 0;
+	return 1;
+}
+
+/* tunables of the library are flags too */
+static int tunables(void)
+{
+	struct b6_pool pool;
+	unsigned long int chunk_size = b6_pool_chunk_size;
+	int retval;
+
+	if (b6_set_flag("b6_pool_chunk_size", "64K") ||
+	    b6_pool_initialize(&pool, &b6_oom_allocator, 16, 0) ||
+	    pool.chunk_size != 65536 - sizeof(void*))
+		return 0;
+	/* chunks still grow to fit objects */
+	if (b6_set_flag("b6_pool_chunk_size", "16") ||
+	    b6_pool_initialize(&pool, &b6_oom_allocator, 100, 0) ||
+	    pool.chunk_size < sizeof(struct b6_chunk) + 100)
+		return 0;
+	retval = !b6_set_flag("b6_array_growth", "50") &&
+		b6_set_flag("b6_array_growth", "0") == -2 &&
+		b6_set_flag("b6_array_growth", "1001") == -2 &&
+		b6_array_growth == 50;
+	b6_pool_chunk_size = chunk_size;
+	b6_array_growth = 100;
+	return retval;
+}
+
+static int write_file(const char *path, const char *text, unsigned long int pad)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return -1;
+	for (; pad; pad -= 1)
+		fputc('#', file);
+	fputs(text, file);
+	return fclose(file);
+}
+
+static int files(void)
+{
+	char path[] = "/tmp/b6_flags_XXXXXX";
+	unsigned long int page = sysconf(_SC_PAGESIZE), line = 0;
+	const char text[] = "\nmany-24=24\nmany_25=25";
+	struct b6_flags_file strings, numbers;
+	int fd = mkstemp(path), retval = 0;
+
+	if (fd < 0)
+		return 0;
+	close(fd);
+	if (write_file(path, "many-24=24\nstatic_string=mapped\n", 0) ||
+	    b6_load_flags_file(&strings, path, NULL) || many_24 != 24 ||
+	    strcmp(static_string, "mapped") || !strings.text)
+		goto done;
+	/* no byte follows the text in the last page of the file */
+	if (write_file(path, text, page - sizeof(text) + 1) ||
+	    b6_load_flags_file(&numbers, path, &line) || many_25 != 25 ||
+	    numbers.text)
+		goto done;
+	/* failures keep track of the mapping loaded before */
+	numbers = strings;
+	if (write_file(path, "many-26=26\nmany-27=x\n", 0) ||
+	    b6_load_flags_file(&strings, path, &line) != -2 || line != 2 ||
+	    many_26 || strings.text != numbers.text)
+		goto done;
+	if (b6_load_flags_file(&strings, "/nonexistent/b6_flags", NULL) != -1 ||
+	    strings.text != numbers.text)
+		goto done;
+	/* the first file is released once its string is replaced */
+	if (b6_release_flags_file(&strings) != -1 ||
+	    b6_set_flag("static_string", "replaced") ||
+	    b6_release_flags_file(&strings) || strings.text)
+		goto done;
+	retval = 1;
+done:
+	unlink(path);
+	return retval;
+}
+
+static int response_files(void)
+{
+	char path[] = "/tmp/b6_flags_XXXXXX";
+	char a0[] = "prog", a1[] = "--many-28=1", a2[] = "first", a3[64],
+	     a4[] = "second", a5[] = "--many-29=29", b1[] = "@/nonexistent";
+	char *argv[] = { a0, a1, a2, a3, a4, a5, };
+	char *brgv[] = { a0, a2, b1, };
+	int fd = mkstemp(path), retval = 0;
+
+	if (fd < 0)
+		return 0;
+	close(fd);
+	snprintf(a3, sizeof(a3), "@%s", path);
+	if (write_file(path, "# generated\nmany-28=28\n", 0) ||
+	    b6_parse_command_line_flags(b6_card_of(argv), argv, 1) != 4 ||
+	    many_28 != 28 || many_29 != 29 || strcmp(argv[4], "first") ||
+	    strcmp(argv[5], "second"))
+		goto done;
+	retval = b6_parse_command_line_flags(b6_card_of(brgv), brgv, 1) == -1 &&
+		brgv[1] == b1 && brgv[2] == a2;
+done:
+	unlink(path);
+	return retval;
+}
+
+static int environment(void)
+{
+	char v0[] = "PATH=/bin", v1[] = "B6TEST_MANY_9=9",
+	     v2[] = "B6TEST_STATIC_SIZE=2M", v3[] = "B6TEST_UNKNOWN=1";
+	char *envp[] = { v0, v1, v2, NULL, NULL, };
+
+	if (b6_parse_environment_flags(envp, "B6TEST_") || many_9 != 9 ||
+	    static_size != 2UL << 20)
+		return 0;
+	envp[1] = v3;
+	return b6_parse_environment_flags(envp, "B6TEST_") == -2 &&
+		!strcmp(envp[1], "B6TEST_UNKNOWN=1");
+}
+
+/* grouping flags is linear in the number of arguments */
+static int many_arguments(void)
+{
+	enum { N = 200000 };
+	char flag[] = "--enable-thing", prog[] = "prog";
+	char (*names)[8] = malloc(N * sizeof(*names));
+	char **argv = malloc((2 * N + 1) * sizeof(*argv));
+	int i, retval = 0;
+
+	if (!names || !argv)
+		goto done;
+	argv[0] = prog;
+	for (i = 0; i < N; i += 1) {
+		snprintf(names[i], sizeof(names[i]), "%d", i);
+		argv[1 + 2 * i] = names[i];
+		argv[2 + 2 * i] = flag;
+	}
+	if (b6_parse_command_line_flags(2 * N + 1, argv, 1) != N + 1)
+		goto done;
+	for (i = 0; i < N; i += 1)
+		if (argv[1 + i] != flag + 2 || argv[N + 1 + i] != names[i])
+			goto done;
+	retval = 1;
+done:
+	free(argv);
+	free(names);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(static_flags,);
+	test_exec(unknown_static_flag,);
+	test_exec(reload,);
+	test_exec(units,);
+	test_exec(tunables,);
+	test_exec(files,);
+	test_exec(response_files,);
+	test_exec(environment,);
+	test_exec(many_arguments,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,244 @@
+#include "test.h"
+
+#include "b6/frozen.h"
+#include "b6/ktree.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+static unsigned long long int get_key(const struct b6_tref *tref, void *arg)
+{
+	return b6_cast_of(tref, struct b6_ktref, tref)->key;
+}
+
+/* compare every query with a linear scan of the sorted keys */
+static int check(const struct b6_frozen *frozen,
+		 const unsigned long long int *keys, unsigned long int n)
+{
+	unsigned long long int key;
+	unsigned long int rank = 0, r;
+
+	for (key = 0; key <= keys[n - 1] + 1; key += 1) {
+		int found;
+		while (rank < n && keys[rank] < key)
+			rank += 1;
+		found = rank < n && keys[rank] == key;
+		if (b6_frozen_lower_bound(frozen, key) != rank)
+			return 0;
+		if (b6_frozen_rank(frozen, key) != rank)
+			return 0;
+		if (b6_frozen_lookup(frozen, key, &r) != (found ? 0 : -1))
+			return 0;
+		if (found && r != rank)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int freeze_array(void)
+{
+	unsigned long long int keys[1000];
+	struct b6_frozen frozen;
+	unsigned long int n;
+	int retval = 1;
+
+	for (n = 0; n < b6_card_of(keys); n += 1)
+		keys[n] = 3 * n + (n & 1);
+
+	for (n = 1; n <= b6_card_of(keys) && retval; n += n < 40 ? 1 : 97) {
+		if (b6_freeze_array(&frozen, &malloc_allocator, keys, n))
+			return 0;
+		retval = !((unsigned long int)b6_frozen_image(&frozen) %
+			   B6_FROZEN_ALIGNMENT) && check(&frozen, keys, n);
+		b6_finalize_frozen(&frozen, &malloc_allocator);
+	}
+
+	return retval;
+}
+
+static int freeze_empty(void)
+{
+	struct b6_frozen frozen;
+	unsigned long int rank;
+	int retval;
+
+	if (b6_freeze_array(&frozen, &malloc_allocator, NULL, 0))
+		return 0;
+	retval = b6_frozen_lower_bound(&frozen, 42) == 0 &&
+		b6_frozen_lookup(&frozen, 42, &rank) == -1;
+	b6_finalize_frozen(&frozen, &malloc_allocator);
+	return retval;
+}
+
+static int freeze_tree(void)
+{
+	struct b6_ktref refs[777];
+	unsigned long long int keys[b6_card_of(refs)];
+	struct b6_tree tree;
+	struct b6_frozen frozen;
+	unsigned long int u;
+	int retval;
+
+	b6_ktree_initialize(&tree);
+	for (u = 0; u < b6_card_of(refs); u += 1) {
+		refs[u].key = 2 * ((u * 31) % b6_card_of(refs));
+		b6_ktree_insert(&tree, &refs[u]);
+		keys[u] = 2 * u;
+	}
+
+	if (b6_freeze_tree(&frozen, &malloc_allocator, &tree, get_key, NULL))
+		return 0;
+	retval = check(&frozen, keys, b6_card_of(keys));
+	b6_finalize_frozen(&frozen, &malloc_allocator);
+	return retval;
+}
+
+static int reload_mapped_image(void)
+{
+	unsigned long long int keys[500];
+	struct b6_frozen frozen, loaded;
+	char path[] = "/tmp/b6_frozen_XXXXXX";
+	unsigned long int n, size;
+	void *image;
+	int fd, retval = 0;
+
+	for (n = 0; n < b6_card_of(keys); n += 1)
+		keys[n] = 5 * n;
+	if (b6_freeze_array(&frozen, &malloc_allocator, keys, n))
+		return 0;
+	size = b6_frozen_image_size(n);
+
+	if ((fd = mkstemp(path)) < 0)
+		goto bail_out;
+	unlink(path);
+	if (write(fd, b6_frozen_image(&frozen), size) != size)
+		goto close_file;
+	image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (image == MAP_FAILED)
+		goto close_file;
+
+	retval = !b6_load_frozen(&loaded, image, size) &&
+		check(&loaded, keys, n) &&
+		b6_load_frozen(&loaded, image, size - 1) == -1;
+
+	munmap(image, size);
+close_file:
+	close(fd);
+bail_out:
+	b6_finalize_frozen(&frozen, &malloc_allocator);
+	return retval;
+}
+
+static int reject_foreign_image(void)
+{
+	unsigned long long int keys[] = { 1, 2, 3 };
+	struct b6_frozen frozen, loaded;
+	unsigned long int size = b6_frozen_image_size(b6_card_of(keys));
+	struct b6_frozen_header *header;
+	int retval;
+
+	if (b6_freeze_array(&frozen, &malloc_allocator, keys, b6_card_of(keys)))
+		return 0;
+	header = (struct b6_frozen_header *)b6_frozen_image(&frozen);
+	header->magic = __builtin_bswap64(header->magic);
+	retval = b6_load_frozen(&loaded, header, size) == -1;
+	b6_finalize_frozen(&frozen, &malloc_allocator);
+	return retval;
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static void bench(void)
+{
+	const unsigned long int n = 1 << 22, lookups = 1 << 24;
+	struct b6_ktref *refs = malloc(n * sizeof(*refs));
+	struct b6_tree tree;
+	struct b6_frozen frozen;
+	struct timespec t0;
+	unsigned long int u, hits, rank;
+	unsigned int seed;
+
+	if (!refs)
+		return;
+
+	b6_ktree_initialize(&tree);
+	for (u = 0; u < n; u += 1) {
+		refs[u].key = 2 * u;
+		b6_ktree_insert(&tree, &refs[u]);
+	}
+	if (b6_freeze_tree(&frozen, &malloc_allocator, &tree, get_key, NULL))
+		goto bail_out;
+
+	seed = 0;
+	hits = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		hits += !!b6_ktree_find(&tree, rand_r(&seed) % (2 * n));
+	printf("ktree   lookups/s=%.0f hits=%lu\n",
+	       lookups / elapsed(&t0), hits);
+
+	seed = 0;
+	hits = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		hits += !b6_frozen_lookup(&frozen, rand_r(&seed) % (2 * n),
+					  &rank);
+	printf("frozen  lookups/s=%.0f hits=%lu\n",
+	       lookups / elapsed(&t0), hits);
+
+	b6_finalize_frozen(&frozen, &malloc_allocator);
+bail_out:
+	free(refs);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(freeze_array,);
+	test_exec(freeze_empty,);
+	test_exec(freeze_tree,);
+	test_exec(reload_mapped_image,);
+	test_exec(reject_foreign_image,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,288 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/hashmap.h"
+#include "b6/tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct entry {
+	unsigned long int key;
+	unsigned long int value;
+};
+
+static unsigned long int hash_key(const void *key)
+{
+	return *(const unsigned long int *)key * 0x9e3779b97f4a7c15UL;
+}
+
+static int match_key(const void *entry, const void *key)
+{
+	return ((const struct entry *)entry)->key ==
+		*(const unsigned long int *)key;
+}
+
+#define hash_ulong(k) ((k) * 0x9e3779b97f4a7c15UL)
+#define equal_ulong(a, b) ((a) == (b))
+
+B6_HASHMAP_GENERATE(entry_map, struct entry, key, hash_ulong, equal_ulong);
+
+static int check_walk(const struct b6_hashmap *map)
+{
+	const struct entry *entry;
+	unsigned long int n = 0;
+
+	for (entry = b6_hashmap_first(map); entry;
+	     entry = b6_hashmap_next(map, entry)) {
+		if (entry->value != entry->key + 1)
+			return 0;
+		n += 1;
+	}
+	return n == b6_hashmap_length(map);
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int random_ops(void)
+{
+	enum { max = 5000 };
+	static int inside[max];
+	struct b6_hashmap map;
+	unsigned long int u, length = 0;
+	unsigned int seed = 0;
+	int retval = 0;
+
+	b6_hashmap_initialize(&map, &malloc_allocator, sizeof(struct entry),
+			      hash_key, match_key);
+	memset(inside, 0, sizeof(inside));
+
+	for (u = 0; u < 200000; u += 1) {
+		unsigned long int key = rand_r(&seed) % max;
+		struct entry *entry = b6_hashmap_find(&map, &key);
+		int inserted;
+		if (!entry != !inside[key])
+			goto bail_out;
+		if (entry && entry->value != key + 1)
+			goto bail_out;
+		if (rand_r(&seed) % 2) {
+			entry = b6_hashmap_insert(&map, &key, &inserted);
+			if (!entry || inserted == inside[key])
+				goto bail_out;
+			if (inserted) {
+				entry->key = key;
+				entry->value = key + 1;
+				length += 1;
+			}
+			inside[key] = 1;
+		} else if (entry) {
+			b6_hashmap_erase(&map, entry);
+			inside[key] = 0;
+			length -= 1;
+		}
+		if (b6_hashmap_length(&map) != length)
+			goto bail_out;
+		if (!(u % 9973) && !check_walk(&map))
+			goto bail_out;
+	}
+
+	retval = check_walk(&map);
+bail_out:
+	b6_hashmap_finalize(&map);
+	return retval;
+}
+
+/* a sliding window of keys must not make the map grow forever */
+static int churn(void)
+{
+	struct b6_hashmap map;
+	unsigned long int u, capacity = 0;
+	int retval = 0;
+
+	entry_map_initialize(&map, &malloc_allocator);
+	for (u = 0; u < 1000000; u += 1) {
+		struct entry *entry = entry_map_insert(&map, u, NULL);
+		if (!entry)
+			goto bail_out;
+		entry->value = u + 1;
+		if (u >= 1000) {
+			if (!(entry = entry_map_find(&map, u - 1000)))
+				goto bail_out;
+			entry_map_erase(&map, entry);
+		}
+		if (u == 10000)
+			capacity = map.ctrl.length;
+	}
+	retval = map.ctrl.length == capacity && b6_hashmap_length(&map) == 1000 &&
+		entry_map_find(&map, u - 1) && !entry_map_find(&map, u - 1001) &&
+		check_walk(&map);
+bail_out:
+	b6_hashmap_finalize(&map);
+	return retval;
+}
+
+static int erase_while_walking(void)
+{
+	struct b6_hashmap map;
+	struct entry *entry, *next;
+	unsigned long int u;
+	int retval = 0;
+
+	entry_map_initialize(&map, &malloc_allocator);
+	for (u = 0; u < 1000; u += 1) {
+		int inserted;
+		if (!(entry = entry_map_insert(&map, u, &inserted)) || !inserted)
+			goto bail_out;
+		entry->value = u + 1;
+	}
+	for (u = 0; u < 1000; u += 1) {
+		int inserted = 1;
+		if (entry_map_insert(&map, u, &inserted) !=
+		    entry_map_find(&map, u) || inserted)
+			goto bail_out;
+	}
+
+	for (entry = entry_map_first(&map); entry; entry = next) {
+		next = entry_map_next(&map, entry);
+		if (entry->key % 3)
+			entry_map_erase(&map, entry);
+	}
+
+	if (b6_hashmap_length(&map) != 334 || !check_walk(&map))
+		goto bail_out;
+	for (u = 0; u < 1000; u += 1)
+		if (!entry_map_find(&map, u) != !!(u % 3))
+			goto bail_out;
+	retval = 1;
+bail_out:
+	b6_hashmap_finalize(&map);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	struct b6_hashmap map;
+	struct entry *entry;
+	unsigned long int u;
+	int retval = 0;
+
+	entry_map_initialize(&map, &malloc_allocator);
+	allocations = 0;
+	if (entry_map_insert(&map, 0, NULL))
+		goto bail_out;
+
+	allocations = 2;
+	for (u = 0; u < B6_HASHMAP_MAX_LOAD(B6_HASHMAP_GROUP); u += 1) {
+		if (!(entry = entry_map_insert(&map, u, NULL)))
+			goto bail_out;
+		entry->value = u + 1;
+	}
+	if (entry_map_insert(&map, u, NULL) || b6_hashmap_length(&map) != u)
+		goto bail_out;
+
+	allocations = ~0UL;
+	if (!(entry = entry_map_insert(&map, u, NULL)))
+		goto bail_out;
+	entry->value = u + 1;
+	retval = check_walk(&map) && b6_hashmap_length(&map) == u + 1;
+bail_out:
+	allocations = ~0UL;
+	b6_hashmap_finalize(&map);
+	return retval;
+}
+
+struct node {
+	struct b6_tref tref;
+	unsigned long int key;
+	unsigned long int value;
+};
+
+#define compare_ulong(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+B6_TREE_GENERATE(node_tree, struct node, tref, key, compare_ulong);
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static unsigned long int key_of(unsigned long int u)
+{
+	return u * 2654435761UL;
+}
+
+/* insertions then random lookups of present keys */
+static void bench(unsigned long int n)
+{
+	struct node *nodes = malloc(n * sizeof(*nodes));
+	struct b6_hashmap map;
+	struct b6_tree tree;
+	struct timespec t0;
+	unsigned long int u, found;
+	unsigned int seed;
+	double t_add, t_find;
+
+	if (!nodes)
+		return;
+
+	node_tree_initialize(&tree);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < n; u += 1) {
+		nodes[u].key = key_of(u);
+		node_tree_insert(&tree, &nodes[u]);
+	}
+	t_add = elapsed(&t0);
+	seed = 0;
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < n; u += 1)
+		found += !!node_tree_find(&tree, key_of(rand_r(&seed) % n));
+	t_find = elapsed(&t0);
+	printf("%10lu tree     insert=%6.1fns find=%6.1fns (%lu)\n", n,
+	       t_add * 1e9 / n, t_find * 1e9 / n, found);
+	free(nodes);
+
+	entry_map_initialize(&map, &malloc_allocator);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < n; u += 1)
+		entry_map_insert(&map, key_of(u), NULL)->value = u;
+	t_add = elapsed(&t0);
+	seed = 0;
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < n; u += 1)
+		found += !!entry_map_find(&map, key_of(rand_r(&seed) % n));
+	t_find = elapsed(&t0);
+	printf("%10lu hashmap  insert=%6.1fns find=%6.1fns (%lu)\n", n,
+	       t_add * 1e9 / n, t_find * 1e9 / n, found);
+	b6_hashmap_finalize(&map);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		/* up to 10^7 entries by default, pass 8 for 10^8 (~6GB) */
+		int e, max = argc > 2 ? atoi(argv[2]) : 7;
+		unsigned long int n = 1000;
+		for (e = 3; e <= max; e += 1, n *= 10)
+			bench(n);
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(random_ops,);
+	test_exec(churn,);
+	test_exec(erase_while_walking,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,289 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/hashtable.h"
+#include "b6/tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct item {
+	struct b6_href href;
+	struct b6_tref tref;
+	unsigned long int key;
+	int mark;
+};
+
+static struct item items[4096];
+
+/* poor hash on purpose, so that buckets hold several elements */
+static unsigned long int hash_key(const void *key)
+{
+	return *(const unsigned long int *)key % 1000;
+}
+
+static int equal_key(const struct b6_href *href, const void *key)
+{
+	return b6_cast_of(href, struct item, href)->key ==
+		*(const unsigned long int *)key;
+}
+
+#define hash_ulong(k) ((k) * 0x9e3779b97f4a7c15UL >> 16)
+#define equal_ulong(a, b) ((a) == (b))
+#define compare_ulong(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+B6_HASHTABLE_GENERATE(item_table, struct item, href, key, hash_ulong,
+		      equal_ulong);
+
+B6_TREE_GENERATE(item_tree, struct item, tref, key, compare_ulong);
+
+/* check that every element is visited exactly once */
+static int check_walk(const struct b6_hashtable *table)
+{
+	struct b6_href *href;
+	unsigned long int n = 0;
+	unsigned int u;
+
+	for (u = 0; u < b6_card_of(items); u += 1)
+		items[u].mark = 0;
+	for (href = b6_hashtable_first(table); href;
+	     href = b6_hashtable_next(table, href)) {
+		struct item *item = b6_cast_of(href, struct item, href);
+		if (item->mark++)
+			return 0;
+		n += 1;
+	}
+	return n == b6_hashtable_length(table);
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int random_ops(void)
+{
+	static int inside[b6_card_of(items)];
+	struct b6_hashtable table;
+	unsigned long int u, length = 0;
+	unsigned int seed = 0;
+	int retval = 0;
+
+	b6_hashtable_initialize(&table, &malloc_allocator, hash_key, equal_key);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		items[u].key = u;
+		inside[u] = 0;
+	}
+
+	for (u = 0; u < 100000; u += 1) {
+		unsigned long int key = rand_r(&seed) % b6_card_of(items);
+		struct b6_href *href = b6_hashtable_find(&table, &key);
+		if (!href != !inside[key])
+			goto bail_out;
+		if (href && href != &items[key].href)
+			goto bail_out;
+		if (rand_r(&seed) % 3) {
+			struct b6_href *ref = b6_hashtable_insert(
+				&table, &items[key].href, &key);
+			if (ref != &items[key].href)
+				goto bail_out;
+			if (!inside[key])
+				length += 1;
+			inside[key] = 1;
+		} else if (href) {
+			b6_hashtable_remove(&table, href);
+			inside[key] = 0;
+			length -= 1;
+		}
+		if (b6_hashtable_length(&table) != length)
+			goto bail_out;
+		if (!(u % 997) && !check_walk(&table))
+			goto bail_out;
+	}
+
+	retval = check_walk(&table);
+bail_out:
+	b6_hashtable_finalize(&table);
+	return retval;
+}
+
+static int incremental_resize(void)
+{
+	struct b6_hashtable table;
+	unsigned long int u, buckets = 0, since = 0;
+	int retval = 0;
+
+	item_table_initialize(&table, &malloc_allocator);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		items[u].key = u * 7;
+		if (item_table_insert(&table, &items[u]) != &items[u])
+			goto bail_out;
+		if (table.array[0].length != buckets) {
+			/* grown: former buckets are moved over a few insertions */
+			if (table.array[0].length != (buckets ? 2 * buckets :
+						      B6_HASHTABLE_MIN) ||
+			    table.array[1].length != buckets)
+				goto bail_out;
+			buckets = table.array[0].length;
+			since = 0;
+		}
+		since += 1;
+		if (table.array[1].length &&
+		    table.moved != since * B6_HASHTABLE_STEP)
+			goto bail_out;
+		if (b6_hashtable_length(&table) > table.array[0].length)
+			goto bail_out;
+	}
+
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		struct item dup = { .key = u * 7 };
+		if (item_table_find(&table, u * 7) != &items[u] ||
+		    item_table_find(&table, u * 7 + 1) ||
+		    item_table_insert(&table, &dup) != &items[u])
+			goto bail_out;
+	}
+
+	retval = check_walk(&table);
+bail_out:
+	b6_hashtable_finalize(&table);
+	return retval;
+}
+
+static int erase_while_walking(void)
+{
+	struct b6_hashtable table;
+	struct item *item, *next;
+	unsigned long int u;
+	int retval = 0;
+
+	item_table_initialize(&table, &malloc_allocator);
+	for (u = 0; u < 600; u += 1) {
+		items[u].key = u;
+		if (!item_table_insert(&table, &items[u]))
+			goto bail_out;
+	}
+	/* former buckets are still being moved */
+	if (!table.array[1].length)
+		goto bail_out;
+
+	for (item = item_table_first(&table); item; item = next) {
+		next = item_table_next(&table, item);
+		if (item->key % 2)
+			item_table_erase(&table, item);
+	}
+
+	if (b6_hashtable_length(&table) != 300 || !check_walk(&table))
+		goto bail_out;
+	for (u = 0; u < 600; u += 1)
+		if (!!item_table_find(&table, u) == u % 2)
+			goto bail_out;
+	retval = 1;
+bail_out:
+	b6_hashtable_finalize(&table);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	struct b6_hashtable table;
+	unsigned long int u;
+	int retval = 0;
+
+	item_table_initialize(&table, &malloc_allocator);
+	items[0].key = 0;
+	allocations = 0;
+	if (item_table_insert(&table, &items[0]))
+		goto bail_out;
+
+	/* once there are buckets, insertions succeed without growing */
+	allocations = 1;
+	for (u = 0; u < 100; u += 1) {
+		items[u].key = u;
+		if (item_table_insert(&table, &items[u]) != &items[u])
+			goto bail_out;
+	}
+	if (table.array[0].length != B6_HASHTABLE_MIN)
+		goto bail_out;
+
+	allocations = ~0UL;
+	items[u].key = u;
+	if (item_table_insert(&table, &items[u]) != &items[u] ||
+	    table.array[0].length != 2 * B6_HASHTABLE_MIN)
+		goto bail_out;
+	retval = check_walk(&table);
+	for (u = 0; u <= 100; u += 1)
+		retval &= item_table_find(&table, u) == &items[u];
+bail_out:
+	allocations = ~0UL;
+	b6_hashtable_finalize(&table);
+	return retval;
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+/* random lookups of present keys */
+static void bench(void)
+{
+	const unsigned long int n = 1 << 20, lookups = 1 << 22;
+	struct item *array = malloc(n * sizeof(*array));
+	struct b6_hashtable table;
+	struct b6_tree tree;
+	struct timespec t0;
+	unsigned long int u, found;
+	unsigned int seed;
+
+	if (!array)
+		return;
+
+	item_table_initialize(&table, &malloc_allocator);
+	item_tree_initialize(&tree);
+	for (u = 0; u < n; u += 1) {
+		array[u].key = u * 2654435761UL;
+		item_table_insert(&table, &array[u]);
+		item_tree_insert(&tree, &array[u]);
+	}
+
+	seed = 0;
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		found += !!item_tree_find(&tree, (rand_r(&seed) % n) *
+					  2654435761UL);
+	printf("tree       lookups/s=%.0f (%lu)\n", u / elapsed(&t0), found);
+
+	seed = 0;
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		found += !!item_table_find(&table, (rand_r(&seed) % n) *
+					   2654435761UL);
+	printf("hashtable  lookups/s=%.0f (%lu)\n", u / elapsed(&t0), found);
+
+	b6_hashtable_finalize(&table);
+	free(array);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(random_ops,);
+	test_exec(incremental_resize,);
+	test_exec(erase_while_walking,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/intern.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *interned[5000];
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int same_pointer(void)
+{
+	struct b6_intern intern;
+	char name[64];
+	unsigned int u;
+	int retval = 0;
+
+	if (b6_intern_initialize(&intern, &malloc_allocator))
+		return 0;
+	for (u = 0; u < b6_card_of(interned); u += 1) {
+		snprintf(name, sizeof(name), "metric.%u", u);
+		if (b6_lookup_interned(&intern, name) ||
+		    !(interned[u] = b6_intern(&intern, name)) ||
+		    interned[u] == name || strcmp(interned[u], name) ||
+		    b6_interned_length(interned[u]) != strlen(name))
+			goto bail_out;
+	}
+	/* the same contents from another buffer gives the same pointer */
+	for (u = 0; u < b6_card_of(interned); u += 1) {
+		char *copy = malloc(64);
+		int ok;
+		snprintf(copy, 64, "metric.%u", u);
+		ok = b6_intern(&intern, copy) == interned[u] &&
+			b6_lookup_interned(&intern, copy) == interned[u];
+		free(copy);
+		if (!ok)
+			goto bail_out;
+	}
+	retval = b6_intern_length(&intern) == b6_card_of(interned) &&
+		!b6_lookup_interned(&intern, "metric.") &&
+		b6_intern(&intern, "") == b6_intern(&intern, "") &&
+		b6_interned_length(b6_intern(&intern, "")) == 0;
+bail_out:
+	b6_intern_finalize(&intern);
+	return retval;
+}
+
+static int precomputed_hash(void)
+{
+	static const char *names[] = {
+		"scope.main", "scope.main.loop", "a", "a long enough name",
+	};
+	struct b6_intern intern;
+	unsigned int u;
+	int retval = 0;
+
+	if (b6_intern_initialize(&intern, &malloc_allocator))
+		return 0;
+	for (u = 0; u < b6_card_of(names); u += 1) {
+		unsigned long int length;
+		unsigned long int hash = b6_compute_registry_hash(names[u],
+								  &length);
+		const char *s;
+		if (b6_lookup_interned_hashed(&intern, names[u], hash, length))
+			goto bail_out;
+		s = b6_intern_hashed(&intern, names[u], hash, length);
+		if (!s || b6_interned_hash(s) != hash ||
+		    b6_interned_length(s) != length ||
+		    b6_intern(&intern, names[u]) != s ||
+		    b6_lookup_interned_hashed(&intern, names[u], hash,
+					      length) != s)
+			goto bail_out;
+	}
+	retval = b6_intern_length(&intern) == b6_card_of(names);
+bail_out:
+	b6_intern_finalize(&intern);
+	return retval;
+}
+
+/* long strings get chunks of their own */
+static int long_strings(void)
+{
+	struct b6_intern intern;
+	char *name = malloc(3 * B6_INTERN_CHUNK_SIZE);
+	const char *s, *t, *small;
+	int retval = 0;
+
+	if (!name)
+		return 0;
+	if (b6_intern_initialize(&intern, &malloc_allocator))
+		goto bail_out;
+	memset(name, 'x', 3 * B6_INTERN_CHUNK_SIZE - 1);
+	name[3 * B6_INTERN_CHUNK_SIZE - 1] = '\0';
+	small = b6_intern(&intern, "small");
+	s = b6_intern(&intern, name);
+	name[0] = 'y';
+	t = b6_intern(&intern, name);
+	retval = small && s && t && s != t && s[0] == 'x' && t[0] == 'y' &&
+		b6_interned_length(t) == 3 * B6_INTERN_CHUNK_SIZE - 1 &&
+		b6_intern(&intern, name) == t &&
+		b6_intern(&intern, "small") == small &&
+		/* still carved from the chunk of "small" */
+		b6_intern(&intern, "other") - small < B6_INTERN_CHUNK_SIZE;
+	b6_intern_finalize(&intern);
+bail_out:
+	free(name);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	struct b6_intern intern;
+	const char *s;
+	int retval = 0;
+
+	if (b6_intern_initialize(&intern, &malloc_allocator))
+		return 0;
+	allocations = 0;
+	if (b6_intern(&intern, "first") || b6_intern_length(&intern))
+		goto bail_out;
+	/* a chunk but no bucket */
+	allocations = 1;
+	if (b6_intern(&intern, "first") || b6_intern_length(&intern) ||
+	    b6_lookup_interned(&intern, "first"))
+		goto bail_out;
+	allocations = ~0UL;
+	if (!(s = b6_intern(&intern, "first")))
+		goto bail_out;
+	retval = b6_lookup_interned(&intern, "first") == s &&
+		b6_intern_length(&intern) == 1;
+bail_out:
+	allocations = ~0UL;
+	b6_intern_finalize(&intern);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(same_pointer,);
+	test_exec(precomputed_hash,);
+	test_exec(long_strings,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -293,6 +293,27 @@ static int walk()
 	return 1;
 }
 
+static void count_release(struct b6_dref *dref, void *arg)
+{
+	int *count = arg;
+	*count += 1;
+	dref->ref[B6_NEXT] = dref->ref[B6_PREV] = NULL;
+}
+
+static int clear()
+{
+	B6_LIST_DEFINE(list);
+	struct b6_dref dref[8];
+	int i, count = 0;
+
+	for (i = 0; i < b6_card_of(dref); i += 1)
+		b6_list_add_last(&list, &dref[i]);
+
+	b6_list_clear(&list, count_release, &count);
+
+	return count == b6_card_of(dref) && b6_list_empty(&list);
+}
+
 /*
  * generate with:
  egrep "^static int.*()" list.c | sed -e 's/(/,/g' -e 's/static int /\ttest(/g' -e 's/$/;/g'
@@ -320,6 +341,7 @@ int main(int argc, const char *argv[])
 	test_exec(del,);
 	/*test_exec(walk_on_bounds,);*/
 	test_exec(walk,);
+	test_exec(clear,);
 
 	test_exit();
 
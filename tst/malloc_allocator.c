@@ -0,0 +1,38 @@
+#include "malloc_allocator.h"
+
+#include <stdlib.h>
+
+unsigned long int allocations = ~0UL;
+
+/* allocations may be counted from concurrent threads */
+static int may_allocate(void)
+{
+	if (!__atomic_load_n(&allocations, __ATOMIC_RELAXED))
+		return 0;
+	__atomic_sub_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return may_allocate() ? malloc(size) : NULL;
+}
+
+static void *do_reallocate(struct b6_allocator *self, void *ptr,
+			   unsigned long int size)
+{
+	return may_allocate() ? realloc(ptr, size) : NULL;
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.reallocate = do_reallocate,
+	.deallocate = do_deallocate,
+};
+
+struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
@@ -0,0 +1,12 @@
+#ifndef MALLOC_ALLOCATOR_H_
+#define MALLOC_ALLOCATOR_H_
+
+#include "b6/allocator.h"
+
+/* allocator on top of malloc that fails once allocations drops to zero */
+extern struct b6_allocator malloc_allocator;
+
+/* number of allocations to let through, each one decrements it */
+extern unsigned long int allocations;
+
+#endif
@@ -0,0 +1,297 @@
+#include "test.h"
+
+#include "b6/ptree.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+static long int live_nodes;
+static long int budget = -1; /* allocations left before failing, or -1 */
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	void *ptr;
+	if (!budget)
+		return NULL;
+	if (budget > 0)
+		budget -= 1;
+	ptr = malloc(size);
+	if (ptr)
+		__atomic_add_fetch(&live_nodes, 1, __ATOMIC_RELAXED);
+	return ptr;
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	__atomic_sub_fetch(&live_nodes, 1, __ATOMIC_RELAXED);
+	free(ptr);
+}
+
+static const struct b6_allocator_ops counting_ops = {
+	.allocate = do_allocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator counting_allocator = { .ops = &counting_ops, };
+
+static int compare_keys(void *lhs, void *rhs)
+{
+	unsigned long int l = (unsigned long int)lhs;
+	unsigned long int r = (unsigned long int)rhs;
+	return l < r ? -1 : l > r;
+}
+
+/* returns the height of a balanced subtree, -1 otherwise */
+static int check_node(const struct b6_pnode *node)
+{
+	int h1, h2;
+	if (!node)
+		return 0;
+	if ((h1 = check_node(node->ref[B6_PREV])) < 0 ||
+	    (h2 = check_node(node->ref[B6_NEXT])) < 0)
+		return -1;
+	if (h1 - h2 > 1 || h2 - h1 > 1)
+		return -1;
+	if (node->height != 1 + (h1 > h2 ? h1 : h2))
+		return -1;
+	return node->height;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int insert_lookup_remove(void)
+{
+	struct b6_ptree tree;
+	struct b6_ptree_snapshot snap;
+	unsigned long int u;
+	void *value;
+	int retval = 0;
+
+	b6_ptree_initialize(&tree, &counting_allocator, compare_keys);
+
+	for (u = 0; u < 1000; u += 1)
+		if (b6_ptree_insert(&tree, (void *)(u * 7 % 1000),
+				    (void *)(u * 7 % 1000 + 1)))
+			goto bail_out;
+
+	if (b6_ptree_insert(&tree, (void *)42, NULL) != -1)
+		goto bail_out;
+
+	for (u = 0; u < 1000; u += 2)
+		if (b6_ptree_remove(&tree, (void *)u, &value) ||
+		    value != (void *)(u + 1))
+			goto bail_out;
+
+	if (b6_ptree_remove(&tree, (void *)0, NULL) != -1)
+		goto bail_out;
+
+	b6_ptree_acquire(&snap, &tree);
+	retval = check_node(snap.root) > 0 && tree.size == 500;
+	for (u = 0; u < 1000; u += 1) {
+		int found = !b6_ptree_lookup(&snap, (void *)u, &value);
+		if (found != (u & 1) || (found && value != (void *)(u + 1)))
+			retval = 0;
+	}
+	b6_ptree_release(&snap);
+
+bail_out:
+	b6_ptree_finalize(&tree);
+	return retval && !live_nodes;
+}
+
+static int snapshots_are_immutable(void)
+{
+	struct b6_ptree tree;
+	struct b6_ptree_snapshot old, new;
+	struct b6_ptree_iterator iter;
+	const struct b6_pnode *node;
+	unsigned long int u, n;
+	int retval = 1;
+
+	b6_ptree_initialize(&tree, &counting_allocator, compare_keys);
+	for (u = 0; u < 100; u += 1)
+		b6_ptree_insert(&tree, (void *)u, NULL);
+
+	b6_ptree_acquire(&old, &tree);
+	for (u = 0; u < 100; u += 3)
+		b6_ptree_remove(&tree, (void *)u, NULL);
+	for (u = 100; u < 200; u += 1)
+		b6_ptree_insert(&tree, (void *)u, NULL);
+	b6_ptree_acquire(&new, &tree);
+
+	b6_setup_ptree_iterator(&iter, &old);
+	for (n = 0; (node = b6_get_next_ptree_iterator(&iter)); n += 1)
+		retval &= node->key == (void *)n;
+	retval &= n == 100;
+
+	b6_setup_ptree_iterator(&iter, &new);
+	for (n = 0, u = 1; (node = b6_get_next_ptree_iterator(&iter));
+	     n += 1, u += (u < 100 && u % 3 == 2) ? 2 : 1)
+		retval &= node->key == (void *)u;
+	retval &= n == 66 + 100;
+	retval &= check_node(old.root) > 0 && check_node(new.root) > 0;
+
+	b6_ptree_release(&old);
+	b6_ptree_release(&new);
+
+	/* every version but the latest can now be reclaimed */
+	b6_reclaim_epoch(&tree.epoch);
+	b6_reclaim_epoch(&tree.epoch);
+	b6_ptree_acquire(&new, &tree);
+	b6_setup_ptree_iterator(&iter, &new);
+	for (n = 0; b6_get_next_ptree_iterator(&iter); n += 1);
+	b6_ptree_release(&new);
+	retval &= n + tree.spare == (unsigned long int)live_nodes;
+
+	b6_ptree_finalize(&tree);
+	return retval && !live_nodes;
+}
+
+/*
+ * Updates are retried with one more allocation allowed each time until they
+ * succeed: failed ones must leave the tree as it was.
+ */
+static int out_of_memory(void)
+{
+	struct b6_ptree tree;
+	struct b6_ptree_snapshot snap;
+	unsigned long int u, key;
+	int retval = 1, res;
+
+	b6_ptree_initialize(&tree, &counting_allocator, compare_keys);
+	for (u = 0; u < 2000; u += 1) {
+		key = u < 1000 ? u * 7 % 1000 : (u * 13 + 5) % 1000;
+		budget = 0;
+		while ((res = u < 1000 ?
+			b6_ptree_insert(&tree, (void *)key, (void *)key) :
+			b6_ptree_remove(&tree, (void *)key, NULL)) == -2) {
+			b6_ptree_acquire(&snap, &tree);
+			retval &= check_node(snap.root) >= 0;
+			retval &= tree.size == (u < 1000 ? u : 2000 - u);
+			retval &= !b6_ptree_lookup(&snap, (void *)key, NULL) ==
+				(u >= 1000);
+			b6_ptree_release(&snap);
+			budget += 1;
+		}
+		budget = -1;
+		retval &= !res;
+	}
+	retval &= !tree.size;
+
+	b6_ptree_finalize(&tree);
+	return retval && !live_nodes;
+}
+
+static void *release_snapshot(void *arg)
+{
+	b6_ptree_release(arg);
+	return NULL;
+}
+
+/* snapshots may be released by another thread than the one which took them */
+static int release_elsewhere(void)
+{
+	struct b6_ptree tree;
+	struct b6_ptree_snapshot snap;
+	pthread_t thread;
+	unsigned long int u;
+	int retval;
+
+	b6_ptree_initialize(&tree, &counting_allocator, compare_keys);
+	b6_ptree_insert(&tree, (void *)0, NULL);
+	b6_ptree_acquire(&snap, &tree);
+	for (u = 1; u < 10; u += 1)
+		b6_ptree_insert(&tree, (void *)u, NULL);
+	retval = !b6_reclaim_epoch(&tree.epoch);
+	pthread_create(&thread, NULL, release_snapshot, &snap);
+	pthread_join(thread, NULL);
+	b6_reclaim_epoch(&tree.epoch);
+	retval &= b6_reclaim_epoch(&tree.epoch);
+
+	b6_ptree_finalize(&tree);
+	return retval && !live_nodes;
+}
+
+struct reader {
+	pthread_t thread;
+	struct b6_ptree *tree;
+	int *stop;
+	int retval;
+};
+
+/*
+ * Readers check that every snapshot is ordered, balanced and that each value
+ * still matches its key while the writer keeps updating the tree.
+ */
+static void *reader_thread(void *arg)
+{
+	struct reader *r = arg;
+	r->retval = 1;
+	while (!__atomic_load_n(r->stop, __ATOMIC_ACQUIRE)) {
+		struct b6_ptree_snapshot snap;
+		struct b6_ptree_iterator iter;
+		const struct b6_pnode *node;
+		unsigned long int prev = 0;
+		b6_ptree_acquire(&snap, r->tree);
+		r->retval &= check_node(snap.root) >= 0;
+		b6_setup_ptree_iterator(&iter, &snap);
+		while ((node = b6_get_next_ptree_iterator(&iter))) {
+			unsigned long int key = (unsigned long int)node->key;
+			r->retval &= key > prev;
+			r->retval &= node->value == (void *)(3 * key);
+			prev = key;
+		}
+		b6_ptree_release(&snap);
+	}
+	return NULL;
+}
+
+static int concurrent_readers(void)
+{
+	struct b6_ptree tree;
+	struct reader readers[3];
+	int stop = 0;
+	unsigned long int u, i;
+	unsigned int seed = 0;
+	int retval = 1;
+
+	b6_ptree_initialize(&tree, &counting_allocator, compare_keys);
+	for (i = 0; i < b6_card_of(readers); i += 1) {
+		readers[i].tree = &tree;
+		readers[i].stop = &stop;
+		pthread_create(&readers[i].thread, NULL, reader_thread,
+			       &readers[i]);
+	}
+
+	for (u = 0; u < 100000; u += 1) {
+		unsigned long int key = 1 + rand_r(&seed) % 512;
+		if (b6_ptree_remove(&tree, (void *)key, NULL))
+			b6_ptree_insert(&tree, (void *)key, (void *)(3 * key));
+	}
+
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < b6_card_of(readers); i += 1) {
+		pthread_join(readers[i].thread, NULL);
+		retval &= readers[i].retval;
+	}
+
+	b6_ptree_finalize(&tree);
+	return retval && !live_nodes;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(insert_lookup_remove,);
+	test_exec(snapshots_are_immutable,);
+	test_exec(out_of_memory,);
+	test_exec(release_elsewhere,);
+	test_exec(concurrent_readers,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,405 @@
+#include "test.h"
+
+#include "b6/registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *do_reallocate(struct b6_allocator *self, void *ptr,
+			   unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.reallocate = do_reallocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+static void *fail_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return NULL;
+}
+
+static const struct b6_allocator_ops failing_ops = {
+	.allocate = fail_allocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator failing_allocator = { .ops = &failing_ops, };
+
+struct item {
+	struct b6_entry entry;
+	char name[24];
+	int seen;
+};
+
+static struct item items[3000];
+
+static void name_items(void)
+{
+	unsigned int u;
+	for (u = 0; u < b6_card_of(items); u += 1)
+		snprintf(items[u].name, sizeof(items[u].name), "item.%u%s", u,
+			 u % 2 ? "" : ".even");
+}
+
+static int register_items(struct b6_registry *registry)
+{
+	unsigned int u;
+	for (u = 0; u < b6_card_of(items); u += 1)
+		if (b6_register(registry, &items[u].entry, items[u].name))
+			return 0;
+	return 1;
+}
+
+/* look every item up and check names that are not registered */
+static int check_lookups(struct b6_registry *registry, int odd_only)
+{
+	char name[32];
+	unsigned int u;
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		struct b6_entry *entry;
+		strcpy(name, items[u].name);
+		entry = b6_lookup_registry(registry, name);
+		if (odd_only && !(u % 2)) {
+			if (entry)
+				return 0;
+		} else if (entry != &items[u].entry)
+			return 0;
+		strcat(name, "x");
+		if (b6_lookup_registry(registry, name))
+			return 0;
+		/* "item.<u>.eve" */
+		name[strlen(name) - 2] = '\0';
+		if (!(u % 2) && b6_lookup_registry(registry, name))
+			return 0;
+	}
+	return 1;
+}
+
+/* travel a registry and check every entry is seen once */
+static int check_walk(const struct b6_registry *registry, unsigned long int n,
+		      const struct b6_entry **first)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry;
+	unsigned int u;
+
+	for (u = 0; u < b6_card_of(items); u += 1)
+		items[u].seen = 0;
+	b6_setup_registry_iterator(&iter, registry);
+	*first = NULL;
+	while ((entry = b6_get_next_registry_iterator(&iter))) {
+		struct item *item = b6_cast_of(entry, struct item, entry);
+		if (item->seen++)
+			return 0;
+		if (!*first)
+			*first = entry;
+		n -= 1;
+	}
+	return !n;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int hash_is_aligned_agnostic(void)
+{
+	static const char *names[] = {
+		"", "a", "abcdefg", "abcdefgh", "abcdefghi", "pool.chunk_size",
+		"a rather long name spanning several words",
+	};
+	char buf[64 + 8];
+	unsigned int u, offset;
+
+	for (u = 0; u < b6_card_of(names); u += 1) {
+		unsigned long int len, ref_len;
+		unsigned long int ref = b6_compute_registry_hash(names[u],
+								 &ref_len);
+		if (ref_len != strlen(names[u]))
+			return 0;
+		for (offset = 0; offset < 8; offset += 1) {
+			strcpy(buf + offset, names[u]);
+			if (b6_compute_registry_hash(buf + offset, &len) != ref ||
+			    len != ref_len)
+				return 0;
+		}
+		/* a different last byte changes the hash */
+		if (ref_len) {
+			buf[ref_len - 1] ^= 1;
+			if (b6_compute_registry_hash(buf, &len) == ref)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static int tree_registry(void)
+{
+	B6_REGISTRY_DEFINE(registry);
+	const struct b6_entry *first;
+	struct item dup;
+	unsigned int u;
+
+	name_items();
+	if (!register_items(&registry) || !check_lookups(&registry, 0) ||
+	    !check_walk(&registry, b6_card_of(items), &first))
+		return 0;
+	if (b6_register(&registry, &dup.entry, items[0].name) != -1)
+		return 0;
+	for (u = 0; u < b6_card_of(items); u += 2)
+		b6_unregister(&registry, &items[u].entry);
+	return check_lookups(&registry, 1) &&
+		check_walk(&registry, b6_card_of(items) / 2, &first);
+}
+
+static int hashed_registry(int ordered)
+{
+	B6_REGISTRY_DEFINE(registry);
+	const struct b6_entry *tree_first, *first;
+	struct item dup;
+	unsigned int u;
+	int retval = 0;
+
+	name_items();
+	/* populate half of the items before hashing */
+	for (u = 0; u < b6_card_of(items) / 2; u += 1)
+		if (b6_register(&registry, &items[u].entry, items[u].name))
+			return 0;
+	if (!check_walk(&registry, u, &tree_first))
+		return 0;
+	if (b6_hash_registry(&registry, &malloc_allocator, ordered))
+		return 0;
+	if (!check_walk(&registry, u, &first))
+		goto bail_out;
+	if (ordered && first != tree_first)
+		goto bail_out;
+	for (; u < b6_card_of(items); u += 1)
+		if (b6_register(&registry, &items[u].entry, items[u].name))
+			goto bail_out;
+	if (!check_lookups(&registry, 0) ||
+	    !check_walk(&registry, b6_card_of(items), &first) ||
+	    b6_register(&registry, &dup.entry, items[1].name) != -1)
+		goto bail_out;
+	for (u = 0; u < b6_card_of(items); u += 2)
+		b6_unregister(&registry, &items[u].entry);
+	retval = check_lookups(&registry, 1) &&
+		check_walk(&registry, b6_card_of(items) / 2, &first);
+bail_out:
+	b6_hashtable_finalize(&registry.table);
+	return retval;
+}
+
+static int frozen_registry(int hashed)
+{
+	B6_REGISTRY_DEFINE(registry);
+	const struct b6_entry *first;
+	struct item extra;
+	unsigned int u, n;
+	int retval = 0;
+
+	name_items();
+	if (hashed && b6_hash_registry(&registry, &malloc_allocator, 0))
+		return 0;
+	if (b6_freeze_registry(&registry, &malloc_allocator) || registry.frozen)
+		goto bail_out;
+	if (!register_items(&registry) ||
+	    b6_freeze_registry(&registry, &malloc_allocator) ||
+	    !registry.frozen || !check_lookups(&registry, 0))
+		goto bail_out;
+
+	/* every entry has a slot, and few slots are free */
+	for (u = n = 0; u < registry.frozen->length; u += 1)
+		n += !!registry.frozen->slots[u];
+	if (n != b6_card_of(items) ||
+	    registry.frozen->length > b6_card_of(items) * 21 / 20)
+		goto bail_out;
+
+	strcpy(extra.name, "extra");
+	if (b6_register(&registry, &extra.entry, items[5].name) != -1 ||
+	    b6_register(&registry, &extra.entry, extra.name) ||
+	    b6_lookup_registry(&registry, "extra") != &extra.entry ||
+	    !check_lookups(&registry, 0))
+		goto bail_out;
+	b6_unregister(&registry, &extra.entry);
+	if (registry.frozen->thawed || b6_lookup_registry(&registry, "extra"))
+		goto bail_out;
+
+	for (u = 0; u < b6_card_of(items); u += 2)
+		b6_unregister(&registry, &items[u].entry);
+	if (!check_lookups(&registry, 1) ||
+	    b6_freeze_registry(&registry, &malloc_allocator) ||
+	    registry.frozen->length < b6_card_of(items) / 2 ||
+	    registry.frozen->length > b6_card_of(items) / 2 * 21 / 20 ||
+	    !check_lookups(&registry, 1))
+		goto bail_out;
+	retval = check_walk(&registry, b6_card_of(items) / 2, &first);
+bail_out:
+	b6_thaw_registry(&registry);
+	if (hashed)
+		b6_hashtable_finalize(&registry.table);
+	return retval;
+}
+
+/* travel entries by prefix and check they come in lexicographic order */
+static int check_prefix(const struct b6_registry *registry, const char *prefix,
+			int odd_only)
+{
+	struct b6_registry_iterator iter;
+	const struct b6_entry *entry, *last = NULL;
+	unsigned long int u, n = 0, expected = 0, length = strlen(prefix);
+
+	for (u = 0; u < b6_card_of(items); u += 1)
+		expected += !strncmp(items[u].name, prefix, length) &&
+			(!odd_only || u % 2);
+	b6_setup_registry_prefix_iterator(&iter, registry, prefix);
+	while ((entry = b6_get_next_registry_iterator(&iter))) {
+		if (strncmp(entry->name, prefix, length) ||
+		    (last && strcmp(last->name, entry->name) >= 0))
+			return 0;
+		last = entry;
+		n += 1;
+	}
+	return n == expected;
+}
+
+static int trie_registry(int hashed)
+{
+	B6_REGISTRY_DEFINE(registry);
+	const struct b6_entry *first;
+	struct item dup;
+	unsigned int u;
+	int retval = 0;
+
+	name_items();
+	for (u = 0; u < b6_card_of(items) / 2; u += 1)
+		if (b6_register(&registry, &items[u].entry, items[u].name))
+			return 0;
+	if (b6_trie_registry(&registry, &malloc_allocator))
+		return 0;
+	if (hashed && b6_hash_registry(&registry, &malloc_allocator, 1))
+		goto bail_out;
+	for (; u < b6_card_of(items); u += 1)
+		if (b6_register(&registry, &items[u].entry, items[u].name))
+			goto bail_out;
+	if (!check_lookups(&registry, 0) ||
+	    !check_walk(&registry, b6_card_of(items), &first) ||
+	    strcmp(first->name, "item.0.even") ||
+	    b6_register(&registry, &dup.entry, items[1].name) != -1 ||
+	    !check_prefix(&registry, "item.1", 0) ||
+	    !check_prefix(&registry, "item.29", 0) ||
+	    !check_prefix(&registry, "item.", 0) ||
+	    !check_prefix(&registry, "other", 0))
+		goto bail_out;
+	for (u = 0; u < b6_card_of(items); u += 2)
+		b6_unregister(&registry, &items[u].entry);
+	retval = check_lookups(&registry, 1) &&
+		check_walk(&registry, b6_card_of(items) / 2, &first) &&
+		check_prefix(&registry, "item.1", 1) &&
+		check_prefix(&registry, "", 1);
+bail_out:
+	b6_art_finalize(&registry.trie);
+	if (hashed)
+		b6_hashtable_finalize(&registry.table);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	B6_REGISTRY_DEFINE(registry);
+	const struct b6_entry *first;
+
+	name_items();
+	if (!register_items(&registry) ||
+	    b6_hash_registry(&registry, &failing_allocator, 0) != -1)
+		return 0;
+	if (b6_freeze_registry(&registry, &failing_allocator) != -1 ||
+	    b6_trie_registry(&registry, &failing_allocator) != -1)
+		return 0;
+	return !registry.hashed && !registry.frozen && !registry.prefixed &&
+		check_lookups(&registry, 0) &&
+		check_walk(&registry, b6_card_of(items), &first);
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static void bench_lookups(struct b6_registry *registry, const char *label)
+{
+	struct timespec t0;
+	unsigned long int u, found = 0;
+	unsigned int seed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < 1 << 22; u += 1) {
+		struct item *item = &items[rand_r(&seed) % b6_card_of(items)];
+		found += !!b6_lookup_registry(registry, item->name);
+	}
+	printf("%-8s lookups/s=%.0f (%lu)\n", label, u / elapsed(&t0), found);
+}
+
+static void bench(void)
+{
+	B6_REGISTRY_DEFINE(registry);
+	B6_REGISTRY_DEFINE(trie);
+
+	name_items();
+	register_items(&registry);
+	bench_lookups(&registry, "tree");
+	b6_hash_registry(&registry, &malloc_allocator, 0);
+	bench_lookups(&registry, "hashed");
+	b6_freeze_registry(&registry, &malloc_allocator);
+	bench_lookups(&registry, "frozen");
+	b6_thaw_registry(&registry);
+	b6_hashtable_finalize(&registry.table);
+
+	register_items(&trie);
+	b6_trie_registry(&trie, &malloc_allocator);
+	bench_lookups(&trie, "trie");
+	b6_art_finalize(&trie.trie);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(hash_is_aligned_agnostic,);
+	test_exec(tree_registry,);
+	test_exec(hashed_registry, 0);
+	test_exec(hashed_registry, 1);
+	test_exec(frozen_registry, 0);
+	test_exec(frozen_registry, 1);
+	test_exec(trie_registry, 0);
+	test_exec(trie_registry, 1);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
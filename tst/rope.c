@@ -0,0 +1,221 @@
+#include "malloc_allocator.h"
+#include "test.h"
+
+#include "b6/array.h"
+#include "b6/rope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* compare a rope with a flat copy of its items, leaf by leaf */
+static int check(struct b6_rope *rope, const char *items, unsigned long int n)
+{
+	unsigned long int index = 0, count;
+	const char *ptr;
+
+	if (b6_rope_length(rope) != n)
+		return 0;
+	while ((ptr = b6_rope_at(rope, index, &count))) {
+		if (!count || count > rope->capacity || index + count > n ||
+		    memcmp(ptr, items + index * rope->itemsize,
+			   count * rope->itemsize))
+			return 0;
+		index += count;
+	}
+	return index == n;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int random_edits(void)
+{
+	enum { max = 4096 };
+	static char ref[max], buf[max];
+	struct b6_pool pool;
+	struct b6_rope rope;
+	unsigned long int len = 0, u, index, n;
+	unsigned int seed = 0;
+	int retval = 0;
+
+	if (b6_pool_initialize(&pool, &malloc_allocator,
+			       B6_ROPE_LEAF_SIZE(1, 8), 0))
+		return 0;
+	if (b6_rope_initialize(&rope, &pool, 1) || rope.capacity < 8)
+		goto bail_out;
+
+	for (u = 0; u < 20000; u += 1) {
+		index = rand_r(&seed) % (len + 1);
+		n = rand_r(&seed) % 24;
+		if (rand_r(&seed) % 2 && len + n <= max) {
+			unsigned long int i;
+			for (i = 0; i < n; i += 1)
+				buf[i] = rand_r(&seed);
+			if (b6_rope_insert(&rope, index, buf, n))
+				goto bail_out;
+			memmove(ref + index + n, ref + index, len - index);
+			memcpy(ref + index, buf, n);
+			len += n;
+		} else {
+			unsigned long int m = len - index < n ? len - index : n;
+			if (b6_rope_erase(&rope, index, n) != m)
+				goto bail_out;
+			memmove(ref + index, ref + index + m, len - index - m);
+			len -= m;
+		}
+		if (!(u % 97) && !check(&rope, ref, len))
+			goto bail_out;
+	}
+
+	retval = check(&rope, ref, len) &&
+		b6_rope_insert(&rope, len + 1, buf, 1) == -1 &&
+		!b6_rope_at(&rope, len, NULL) &&
+		!b6_rope_erase(&rope, len, 1);
+bail_out:
+	b6_rope_finalize(&rope);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int split_concat(void)
+{
+	enum { max = 1000 };
+	int ref[max];
+	struct b6_pool pool;
+	struct b6_rope rope, other;
+	unsigned long int index;
+	int retval = 0;
+
+	if (b6_pool_initialize(&pool, &malloc_allocator,
+			       B6_ROPE_LEAF_SIZE(sizeof(int), 16), 0))
+		return 0;
+	if (b6_rope_initialize(&rope, &pool, sizeof(int)) ||
+	    b6_rope_initialize(&other, &pool, sizeof(int)))
+		goto bail_out;
+
+	for (index = 0; index < max; index += 1)
+		ref[index] = index;
+	for (index = 0; index < max; index += 100)
+		if (b6_rope_insert(&rope, index, ref + index, 100))
+			goto bail_out;
+
+	for (index = 0; index <= max; index += 37) {
+		if (b6_rope_split(&rope, index, &other) ||
+		    !check(&rope, (char *)ref, index) ||
+		    !check(&other, (char *)(ref + index), max - index))
+			goto bail_out;
+		b6_rope_concat(&rope, &other);
+		if (b6_rope_length(&other) || !check(&rope, (char *)ref, max))
+			goto bail_out;
+	}
+
+	if (b6_rope_split(&rope, max + 1, &other) != -1)
+		goto bail_out;
+
+	if (b6_rope_split(&rope, 0, &other) || b6_rope_length(&rope))
+		goto bail_out;
+	b6_rope_concat(&rope, &other);
+	retval = check(&rope, (char *)ref, max);
+bail_out:
+	b6_rope_finalize(&other);
+	b6_rope_finalize(&rope);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int out_of_memory(void)
+{
+	char ref[256];
+	struct b6_pool pool;
+	struct b6_rope rope;
+	unsigned long int u;
+	int retval = 0;
+
+	for (u = 0; u < sizeof(ref); u += 1)
+		ref[u] = u;
+	if (b6_pool_initialize(&pool, &malloc_allocator,
+			       B6_ROPE_LEAF_SIZE(1, 32),
+			       sizeof(struct b6_chunk) +
+			       2 * B6_ROPE_LEAF_SIZE(1, 32)))
+		return 0;
+	if (b6_rope_initialize(&rope, &pool, 1) ||
+	    b6_rope_insert(&rope, 0, ref, 64))
+		goto bail_out;
+
+	allocations = 0;
+	retval = b6_rope_insert(&rope, 10, ref, sizeof(ref)) == -2 &&
+		check(&rope, ref, 64);
+	allocations = ~0UL;
+bail_out:
+	b6_rope_finalize(&rope);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+/* random insertions of short strings in a growing sequence */
+static void bench(void)
+{
+	const unsigned long int edits = 1 << 17;
+	struct b6_pool pool;
+	struct b6_rope rope;
+	struct b6_array array;
+	struct timespec t0;
+	unsigned long int u, len;
+	unsigned int seed;
+
+	b6_array_initialize(&array, &malloc_allocator, 1);
+	seed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0, len = 0; u < edits; u += 1, len += 8) {
+		unsigned long int index = rand_r(&seed) % (len + 1);
+		char *ptr;
+		if (!b6_array_extend(&array, 8))
+			break;
+		ptr = b6_array_get(&array, index);
+		memmove(ptr + 8, ptr, len - index);
+		memcpy(ptr, "abcdefgh", 8);
+	}
+	printf("array  edits/s=%.0f\n", u / elapsed(&t0));
+	b6_array_finalize(&array);
+
+	b6_pool_initialize(&pool, &malloc_allocator,
+			   B6_ROPE_LEAF_SIZE(1, 1024), 0);
+	b6_rope_initialize(&rope, &pool, 1);
+	seed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0, len = 0; u < edits; u += 1, len += 8)
+		if (b6_rope_insert(&rope, rand_r(&seed) % (len + 1),
+				   "abcdefgh", 8))
+			break;
+	printf("rope   edits/s=%.0f\n", u / elapsed(&t0));
+	b6_rope_finalize(&rope);
+	b6_pool_finalize(&pool);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(random_edits,);
+	test_exec(split_concat,);
+	test_exec(out_of_memory,);
+	test_exit();
+
+	return 0;
+}
@@ -0,0 +1,333 @@
+#include "test.h"
+
+#include "b6/skiplist.h"
+#include "b6/tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+static int compare_keys(void *lhs, void *rhs)
+{
+	unsigned long int l = (unsigned long int)lhs;
+	unsigned long int r = (unsigned long int)rhs;
+	return l < r ? -1 : l > r;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int insert_lookup_remove(void)
+{
+	struct b6_skiplist list;
+	unsigned long int u;
+	void *value;
+	int retval = 0;
+
+	if (b6_skiplist_initialize(&list, &malloc_allocator, compare_keys))
+		return 0;
+
+	for (u = 0; u < 1000; u += 1)
+		if (b6_skiplist_insert(&list, (void*)(u * 7 % 1000),
+				       (void*)(u * 7 % 1000 + 1)))
+			goto bail_out;
+
+	if (b6_skiplist_insert(&list, (void*)42, NULL) != -1)
+		goto bail_out;
+
+	for (u = 0; u < 1000; u += 1)
+		if (b6_skiplist_lookup(&list, (void*)u, &value) ||
+		    value != (void*)(u + 1))
+			goto bail_out;
+
+	if (!b6_skiplist_lookup(&list, (void*)1000, NULL))
+		goto bail_out;
+
+	for (u = 0; u < 1000; u += 2)
+		if (b6_skiplist_remove(&list, (void*)u, &value) ||
+		    value != (void*)(u + 1))
+			goto bail_out;
+
+	for (u = 0; u < 1000; u += 1) {
+		int found = !b6_skiplist_lookup(&list, (void*)u, NULL);
+		if (found != (u & 1))
+			goto bail_out;
+	}
+
+	retval = b6_skiplist_remove(&list, (void*)0, NULL) == -1;
+bail_out:
+	b6_skiplist_finalize(&list);
+	return retval;
+}
+
+static int iterate_in_order(void)
+{
+	struct b6_skiplist list;
+	struct b6_skiplist_iterator iter;
+	const struct b6_skipnode *node;
+	unsigned long int u, prev = 0;
+	int retval = 1;
+
+	if (b6_skiplist_initialize(&list, &malloc_allocator, compare_keys))
+		return 0;
+
+	for (u = 0; u < 512; u += 1)
+		b6_skiplist_insert(&list, (void*)(1 + (u * 37) % 512), NULL);
+
+	u = 0;
+	b6_setup_skiplist_iterator(&iter, &list);
+	while ((node = b6_get_next_skiplist_iterator(&iter))) {
+		retval &= (unsigned long int)node->key == prev + 1;
+		prev = (unsigned long int)node->key;
+		u += 1;
+	}
+	b6_finalize_skiplist_iterator(&iter);
+
+	b6_skiplist_finalize(&list);
+	return retval && u == 512;
+}
+
+struct worker {
+	pthread_t thread;
+	struct b6_skiplist *list;
+	unsigned long int base;
+	int retval;
+};
+
+static void *concurrent_worker(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long int u, round;
+
+	w->retval = 1;
+	for (round = 0; round < 64; round += 1) {
+		for (u = 0; u < 256; u += 1)
+			if (b6_skiplist_insert(w->list, (void*)(w->base + u),
+					       (void*)u))
+				w->retval = 0;
+		for (u = 0; u < 256; u += 1)
+			if (b6_skiplist_lookup(w->list, (void*)(w->base + u),
+					       NULL))
+				w->retval = 0;
+		for (u = round & 1; u < 256; u += 2)
+			if (b6_skiplist_remove(w->list, (void*)(w->base + u),
+					       NULL))
+				w->retval = 0;
+		for (u = !(round & 1); u < 256; u += 2)
+			if (b6_skiplist_remove(w->list, (void*)(w->base + u),
+					       NULL))
+				w->retval = 0;
+	}
+	return NULL;
+}
+
+static int concurrent_updates(void)
+{
+	struct b6_skiplist list;
+	struct worker workers[4];
+	unsigned int i;
+	int retval = 1;
+
+	if (b6_skiplist_initialize(&list, &malloc_allocator, compare_keys))
+		return 0;
+
+	for (i = 0; i < b6_card_of(workers); i += 1) {
+		workers[i].list = &list;
+		workers[i].base = i * 1000 + 1;
+		pthread_create(&workers[i].thread, NULL, concurrent_worker,
+			       &workers[i]);
+	}
+	for (i = 0; i < b6_card_of(workers); i += 1) {
+		pthread_join(workers[i].thread, NULL);
+		retval &= workers[i].retval;
+	}
+
+	retval &= !list.head->next[0];
+	b6_skiplist_finalize(&list);
+	return retval;
+}
+
+/*
+ * Mixed read/write scalability benchmark: each thread performs lookups of
+ * random keys and, every tenth operation, inserts or removes one.
+ */
+
+struct bench_node {
+	struct b6_tref tref;
+	unsigned long int key;
+};
+
+struct bench {
+	const char *name;
+	int (*lookup)(struct bench*, unsigned long int);
+	void (*update)(struct bench*, unsigned long int);
+	struct b6_skiplist list;
+	struct b6_tree tree;
+	pthread_mutex_t mutex;
+	unsigned long int range;
+	volatile int stop;
+};
+
+static int skiplist_lookup(struct bench *b, unsigned long int key)
+{
+	return !b6_skiplist_lookup(&b->list, (void*)key, NULL);
+}
+
+static void skiplist_update(struct bench *b, unsigned long int key)
+{
+	if (b6_skiplist_remove(&b->list, (void*)key, NULL))
+		b6_skiplist_insert(&b->list, (void*)key, NULL);
+}
+
+static struct b6_tref *tree_find(struct b6_tree *tree, unsigned long int key,
+				 struct b6_tref **top, int *dir)
+{
+	struct b6_tref *ref;
+	b6_tree_search(tree, ref, *top, *dir) {
+		struct bench_node *n = b6_cast_of(ref, struct bench_node, tref);
+		if (n->key == key)
+			return ref;
+		*dir = n->key < key ? B6_NEXT : B6_PREV;
+	}
+	return NULL;
+}
+
+static int tree_lookup(struct bench *b, unsigned long int key)
+{
+	struct b6_tref *top;
+	int dir, found;
+	pthread_mutex_lock(&b->mutex);
+	found = !!tree_find(&b->tree, key, &top, &dir);
+	pthread_mutex_unlock(&b->mutex);
+	return found;
+}
+
+static void tree_update(struct bench *b, unsigned long int key)
+{
+	struct b6_tref *top, *ref;
+	struct bench_node *node = NULL;
+	int dir;
+	pthread_mutex_lock(&b->mutex);
+	if ((ref = tree_find(&b->tree, key, &top, &dir))) {
+		top = b6_tree_parent(ref, &dir);
+		node = b6_cast_of(b6_tree_del(&b->tree, top, dir),
+				  struct bench_node, tref);
+	} else if ((node = malloc(sizeof(*node)))) {
+		node->key = key;
+		b6_tree_add(&b->tree, top, dir, &node->tref);
+		node = NULL;
+	}
+	pthread_mutex_unlock(&b->mutex);
+	free(node);
+}
+
+struct bench_thread {
+	pthread_t thread;
+	struct bench *bench;
+	unsigned long int ops;
+};
+
+static void *bench_worker(void *arg)
+{
+	struct bench_thread *t = arg;
+	unsigned int seed = (unsigned long int)arg;
+	while (!t->bench->stop) {
+		unsigned long int key = 1 + rand_r(&seed) % t->bench->range;
+		if (t->ops % 10)
+			t->bench->lookup(t->bench, key);
+		else
+			t->bench->update(t->bench, key);
+		t->ops += 1;
+	}
+	return NULL;
+}
+
+static void run_bench(struct bench *b, unsigned int nthreads)
+{
+	struct bench_thread threads[nthreads];
+	struct timespec delay = { 1, 0 };
+	unsigned long int ops = 0;
+	unsigned int i;
+
+	b->stop = 0;
+	for (i = 0; i < nthreads; i += 1) {
+		threads[i].bench = b;
+		threads[i].ops = 0;
+		pthread_create(&threads[i].thread, NULL, bench_worker,
+			       &threads[i]);
+	}
+	nanosleep(&delay, NULL);
+	b->stop = 1;
+	for (i = 0; i < nthreads; i += 1) {
+		pthread_join(threads[i].thread, NULL);
+		ops += threads[i].ops;
+	}
+	printf("%-10s threads=%u ops/s=%lu\n", b->name, nthreads, ops);
+}
+
+static void bench(void)
+{
+	struct bench b;
+	unsigned long int u;
+	unsigned int n;
+
+	b.range = 1 << 16;
+	b6_skiplist_initialize(&b.list, &malloc_allocator, compare_keys);
+	b6_tree_initialize(&b.tree, &b6_tree_avl_ops);
+	pthread_mutex_init(&b.mutex, NULL);
+	for (u = 1; u <= b.range; u += 2) {
+		skiplist_update(&b, u);
+		tree_update(&b, u);
+	}
+
+	for (n = 1; n <= 8; n *= 2) {
+		b.name = "skiplist";
+		b.lookup = skiplist_lookup;
+		b.update = skiplist_update;
+		run_bench(&b, n);
+		b.name = "tree+mutex";
+		b.lookup = tree_lookup;
+		b.update = tree_update;
+		run_bench(&b, n);
+	}
+
+	b6_skiplist_finalize(&b.list);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(insert_lookup_remove,);
+	test_exec(iterate_in_order,);
+	test_exec(concurrent_updates,);
+	test_exit();
+
+	return 0;
+}
@@ -4,6 +4,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static int splay_cmp(const void *ref1, const void *ref2)
 {
@@ -20,6 +22,14 @@ static inline int do_search(struct b6_splay *splay, int *direction,
 	return res;
 }
 
+static inline int do_search_nothread(struct b6_splay *splay, int *direction,
+				     struct b6_dref *dref)
+{
+	int res;
+	res = b6_splay_search_nothread(splay, *direction, splay_cmp, dref);
+	return res;
+}
+
 
 static inline int do_add(struct b6_splay *splay, struct b6_dref *ref)
 {
@@ -50,14 +60,278 @@ static void do_dbg(struct b6_dref *ref)
 	}
 }
 
+static void count_release(struct b6_dref *ref, void *arg)
+{
+	unsigned *count = arg;
+	*count += 1;
+}
+
+static int find_with_policies(struct b6_splay *splay, struct node *nodes,
+			      unsigned n)
+{
+	struct b6_splay_policy never, always;
+	struct node key;
+	unsigned u;
+
+	b6_setup_splay_policy(&never, ~0U, 0);
+	b6_setup_splay_policy(&always, 0, 0);
+
+	for (u = 0; u < n; u += 1) {
+		struct b6_dref *root = b6_splay_root(splay);
+		key.val = nodes[u].val;
+		if (b6_splay_lookup(splay, splay_cmp, &key.dref) !=
+		    &nodes[u].dref)
+			return 0;
+		if (b6_splay_find(splay, splay_cmp, &key.dref, &never) !=
+		    &nodes[u].dref || b6_splay_root(splay) != root)
+			return 0;
+		if (b6_splay_find(splay, splay_cmp, &key.dref, &always) !=
+		    &nodes[u].dref || b6_splay_root(splay) != &nodes[u].dref)
+			return 0;
+	}
+
+	key.val = -1;
+	return !b6_splay_lookup(splay, splay_cmp, &key.dref) &&
+		!b6_splay_find(splay, splay_cmp, &key.dref, &always);
+}
+
+/* check a threaded splay tree holds values from first to last in order */
+static int check_range(const struct b6_splay *splay, int first, int last)
+{
+	struct b6_dref *ref;
+	int val;
+
+	for (val = first, ref = b6_splay_first(splay);
+	     ref != b6_splay_tail(splay);
+	     ref = b6_splay_walk(splay, ref, B6_NEXT))
+		if (b6_cast_of(ref, struct node, dref)->val != val++)
+			return 0;
+	if (val != last + 1)
+		return 0;
+
+	for (val = last, ref = b6_splay_last(splay);
+	     ref != b6_splay_head(splay);
+	     ref = b6_splay_walk(splay, ref, B6_PREV))
+		if (b6_cast_of(ref, struct node, dref)->val != val--)
+			return 0;
+	return val == first - 1;
+}
+
+static int count_in_order(const struct b6_dref *ref, int *next)
+{
+	if (!ref)
+		return 1;
+	if (!count_in_order(ref->ref[B6_PREV], next))
+		return 0;
+	if (b6_cast_of(ref, struct node, dref)->val != (*next)++)
+		return 0;
+	return count_in_order(ref->ref[B6_NEXT], next);
+}
+
+static int split_join(void)
+{
+	struct node nodes[64], key;
+	struct b6_splay splay, other;
+	unsigned u;
+	int k, dir, next;
+
+	for (k = 0; k < (int)b6_card_of(nodes); k += 7) {
+		b6_splay_initialize(&splay);
+		b6_splay_initialize(&other);
+		for (u = 0; u < b6_card_of(nodes); u += 1) {
+			nodes[u].val = (u * 37) % b6_card_of(nodes);
+			do_add(&splay, &nodes[u].dref);
+		}
+
+		key.val = k;
+		do_search(&splay, &dir, &key.dref);
+		b6_splay_split(&splay, B6_NEXT, &other);
+		if (!check_range(&splay, 0, k) ||
+		    !check_range(&other, k + 1, b6_card_of(nodes) - 1))
+			return 0;
+		b6_splay_join(&splay, &other);
+		if (!b6_splay_empty(&other) ||
+		    !check_range(&splay, 0, b6_card_of(nodes) - 1))
+			return 0;
+
+		do_search(&splay, &dir, &key.dref);
+		b6_splay_split(&splay, B6_PREV, &other);
+		if (!check_range(&other, 0, k - 1) ||
+		    !check_range(&splay, k, b6_card_of(nodes) - 1))
+			return 0;
+		b6_splay_join(&other, &splay);
+		if (!check_range(&other, 0, b6_card_of(nodes) - 1))
+			return 0;
+	}
+
+	for (k = 0; k < (int)b6_card_of(nodes); k += 5) {
+		b6_splay_initialize(&splay);
+		b6_splay_initialize(&other);
+		for (u = 0; u < b6_card_of(nodes); u += 1) {
+			nodes[u].val = (u * 37) % b6_card_of(nodes);
+			if (do_search_nothread(&splay, &dir, &nodes[u].dref))
+				b6_splay_add_nothread(&splay, dir,
+						      &nodes[u].dref);
+		}
+		key.val = k;
+		do_search_nothread(&splay, &dir, &key.dref);
+		b6_splay_split_nothread(&splay, B6_NEXT, &other);
+		next = 0;
+		if (!count_in_order(b6_splay_root(&splay), &next) ||
+		    next != k + 1)
+			return 0;
+		if (!count_in_order(b6_splay_root(&other), &next) ||
+		    next != (int)b6_card_of(nodes))
+			return 0;
+		b6_splay_join_nothread(&splay, &other);
+		next = 0;
+		if (!count_in_order(b6_splay_root(&splay), &next) ||
+		    next != (int)b6_card_of(nodes) || !b6_splay_empty(&other))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* degenerate trees: semi-splaying halves paths, deep paths fall back */
+static int semi_splay(void)
+{
+	struct node nodes[256], key;
+	struct b6_splay splay;
+	struct b6_splay_policy full, semi;
+	unsigned u, depth;
+	int dir, next, pass;
+
+	b6_setup_splay_policy(&full, 0, 0);
+	b6_setup_semi_splay_policy(&semi, 0, 0);
+
+	for (pass = 0; pass < 2; pass += 1) {
+		b6_splay_initialize(&splay);
+		for (u = 0; u < 64; u += 1) {
+			nodes[u].val = u;
+			do_add(&splay, &nodes[u].dref);
+		}
+		key.val = 0;
+		__b6_splay_lookup(&splay, splay_cmp, &key.dref, depth);
+		if (depth != 63)
+			return 0;
+		if (b6_splay_find(&splay, splay_cmp, &key.dref,
+				  pass ? &semi : &full) != &nodes[0].dref)
+			return 0;
+		__b6_splay_lookup(&splay, splay_cmp, &key.dref, depth);
+		if (depth != (pass ? 31 : 0) || !check_range(&splay, 0, 63))
+			return 0;
+	}
+
+	b6_splay_initialize(&splay);
+	for (u = 0; u < b6_card_of(nodes); u += 1) {
+		nodes[u].val = u;
+		do_add(&splay, &nodes[u].dref);
+	}
+	for (u = 0; u < b6_card_of(nodes); u += 1) {
+		key.val = (u * 37) % b6_card_of(nodes);
+		if (b6_splay_find(&splay, splay_cmp, &key.dref,
+				  u & 1 ? &semi : &full) !=
+		    &nodes[key.val].dref ||
+		    !check_range(&splay, 0, b6_card_of(nodes) - 1))
+			return 0;
+	}
+
+	b6_splay_initialize(&splay);
+	for (u = 0; u < b6_card_of(nodes); u += 1) {
+		nodes[u].val = u;
+		if (do_search_nothread(&splay, &dir, &nodes[u].dref))
+			b6_splay_add_nothread(&splay, dir, &nodes[u].dref);
+	}
+	for (u = 0; u < b6_card_of(nodes); u += 1) {
+		key.val = (u * 37) % b6_card_of(nodes);
+		if (b6_splay_find_nothread(&splay, splay_cmp, &key.dref,
+					   u & 1 ? &semi : &full) !=
+		    &nodes[key.val].dref)
+			return 0;
+		next = 0;
+		if (!count_in_order(b6_splay_root(&splay), &next) ||
+		    next != (int)b6_card_of(nodes))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Benchmark of splaying policies: lookups of keys drawn so that one tenth of
+ * the keys get nine tenths of the accesses. Splayings are counted as accesses
+ * that changed the root.
+ */
+static void bench(void)
+{
+	static const struct {
+		const char *name;
+		unsigned int depth, period;
+		int semi;
+	} modes[] = {
+		{ "always", 0, 0, 0 },
+		{ "depth>=24", 24, 0, 0 },
+		{ "depth>=32", 32, 0, 0 },
+		{ "sampled/16", ~0U, 16, 0 },
+		{ "depth>=32+1/64", 32, 64, 0 },
+		{ "semi", 0, 0, 1 },
+		{ "semi,depth>=24", 24, 0, 1 },
+		{ "never", ~0U, 0, 0 },
+	};
+	const unsigned n = 1 << 20, lookups = 1 << 23;
+	struct node *nodes = malloc(n * sizeof(*nodes)), key;
+	unsigned u, m;
+
+	if (!nodes)
+		return;
+
+	for (m = 0; m < b6_card_of(modes); m += 1) {
+		struct b6_splay splay;
+		struct b6_splay_policy policy;
+		struct timespec t0, t1;
+		unsigned long splays = 0;
+		unsigned seed = 0;
+
+		b6_splay_initialize(&splay);
+		for (u = 0; u < n; u += 1) {
+			nodes[u].val = (u * 7919) % n;
+			do_add(&splay, &nodes[u].dref);
+		}
+		b6_setup_splay_policy(&policy, modes[m].depth, modes[m].period);
+		policy.semi = modes[m].semi;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (u = 0; u < lookups; u += 1) {
+			struct b6_dref *root = b6_splay_root(&splay);
+			unsigned r = rand_r(&seed);
+			key.val = r % 10 ? r % (n / 10) : r % n;
+			b6_splay_find(&splay, splay_cmp, &key.dref, &policy);
+			splays += root != b6_splay_root(&splay);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		printf("%-16s lookups/s=%.0f splays=%lu\n", modes[m].name,
+		       lookups / ((t1.tv_sec - t0.tv_sec) +
+				  (t1.tv_nsec - t0.tv_nsec) * 1e-9), splays);
+	}
+
+	free(nodes);
+}
+
 int main(int argc, const char *argv[])
 {
+	unsigned count = 0;
 	int retval = 0;
 	struct node nodes[16];
 	struct b6_splay splay;
 	struct b6_dref *ref;
 	unsigned u;
 
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
 	b6_splay_initialize(&splay);
 
 	for (u = b6_card_of(nodes); u--;) {
@@ -87,5 +361,16 @@ int main(int argc, const char *argv[])
 	}
 	puts("");
 
+	if (!split_join() || !semi_splay())
+		retval = 1;
+
+	if (!find_with_policies(&splay, &nodes[4], b6_card_of(nodes) - 4))
+		retval = 1;
+
+	b6_splay_clear(&splay, count_release, &count);
+	printf("cleared %u\n", count);
+	if (count != b6_card_of(nodes) - 1 || !b6_splay_empty(&splay))
+		retval = 1;
+
 	return retval;
 }
@@ -0,0 +1,234 @@
+#include "test.h"
+
+#include "b6/heap.h"
+#include "b6/list.h"
+#include "b6/splay.h"
+#include "b6/tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct item {
+	struct b6_tref tref;
+	struct b6_dref dref;
+	int val;
+};
+
+static struct item items[1000];
+
+static void *do_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *do_reallocate(struct b6_allocator *self, void *ptr,
+			   unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void do_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct b6_allocator_ops malloc_ops = {
+	.allocate = do_allocate,
+	.reallocate = do_reallocate,
+	.deallocate = do_deallocate,
+};
+
+static struct b6_allocator malloc_allocator = { .ops = &malloc_ops, };
+
+static int splay_cmp(const struct b6_dref *dref, const struct item *key)
+{
+	const struct item *item = b6_cast_of(dref, struct item, dref);
+	return item->val < key->val ? -1 : item->val > key->val;
+}
+
+#ifdef B6_STATS
+static int tree_cmp(void *ref, void *key)
+{
+	return b6_cast_of(ref, struct item, tref)->val -
+		((const struct item *)key)->val;
+}
+#endif
+
+static int list_cmp(void *lhs, void *rhs)
+{
+	return b6_cast_of(lhs, struct item, dref)->val -
+		b6_cast_of(rhs, struct item, dref)->val;
+}
+
+static int heap_cmp(void *lhs, void *rhs)
+{
+	return ((const struct item *)lhs)->val - ((const struct item *)rhs)->val;
+}
+
+static unsigned long int sum_of(const struct b6_stats *stats)
+{
+	unsigned long int sum = 0;
+	unsigned int i;
+	for (i = 0; i < b6_card_of(stats->balance); i += 1)
+		sum += stats->balance[i];
+	return sum;
+}
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+static int tree_shape(void)
+{
+	struct b6_tree tree;
+	struct b6_stats stats;
+	struct b6_tref *top, *ref;
+	unsigned int u;
+	int dir;
+
+	b6_tree_initialize(&tree, &b6_tree_avl_ops);
+	b6_tree_stats(&tree, &stats);
+	if (stats.size || stats.height || sum_of(&stats))
+		return 0;
+
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		items[u].val = u;
+		b6_tree_search(&tree, ref, top, dir)
+			dir = B6_NEXT;
+		b6_tree_add(&tree, top, dir, &items[u].tref);
+	}
+	b6_tree_stats(&tree, &stats);
+	if (stats.size != b6_card_of(items) || stats.height < 10 ||
+	    stats.height > 14 || sum_of(&stats) != stats.size ||
+	    stats.balance[0] || stats.balance[4])
+		return 0;
+#ifdef B6_STATS
+	if (stats.counters.searches != b6_card_of(items) ||
+	    stats.counters.comparisons != stats.counters.depth ||
+	    stats.counters.comparisons < b6_card_of(items) ||
+	    !stats.counters.rotations ||
+	    stats.counters.rotations >= b6_card_of(items))
+		return 0;
+	u = stats.counters.comparisons;
+	b6_tree_lower_bound(&tree, tree_cmp, &items[1]);
+	b6_tree_stats(&tree, &stats);
+	if (stats.counters.searches != b6_card_of(items) + 1 ||
+	    stats.counters.comparisons <= u ||
+	    stats.counters.comparisons > u + stats.height)
+		return 0;
+#endif
+	return 1;
+}
+
+static int splay_shape(void)
+{
+	struct b6_splay splay;
+	struct b6_stats stats;
+	struct item key;
+	unsigned int u;
+	int d;
+
+	b6_splay_initialize(&splay);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		items[u].val = u;
+		if (b6_splay_search(&splay, d, splay_cmp, &items[u]))
+			b6_splay_add(&splay, d, &items[u].dref);
+	}
+	/* ascending insertions leave a chain */
+	b6_splay_stats(&splay, &stats);
+	if (stats.size != b6_card_of(items) ||
+	    stats.height != b6_card_of(items) || sum_of(&stats))
+		return 0;
+
+	key.val = 0;
+	if (b6_splay_search(&splay, d, splay_cmp, &key))
+		return 0;
+	b6_splay_stats(&splay, &stats);
+	if (stats.size != b6_card_of(items) ||
+	    stats.height > b6_card_of(items) / 2 + 2)
+		return 0;
+#ifdef B6_STATS
+	if (stats.counters.searches != b6_card_of(items) + 1 ||
+	    stats.counters.comparisons < b6_card_of(items) ||
+	    !stats.counters.rotations)
+		return 0;
+#endif
+
+	b6_splay_initialize(&splay);
+	for (u = 0; u < b6_card_of(items); u += 1) {
+		items[u].val = u * 7 % b6_card_of(items);
+		if (b6_splay_search_nothread(&splay, d, splay_cmp, &items[u]))
+			b6_splay_add_nothread(&splay, d, &items[u].dref);
+	}
+	b6_splay_stats_nothread(&splay, &stats);
+	if (stats.size != b6_card_of(items) || stats.height < 10 ||
+	    stats.height > b6_card_of(items))
+		return 0;
+	/* the tree must have been restored */
+	b6_splay_stats_nothread(&splay, &stats);
+	return stats.size == b6_card_of(items);
+}
+
+static int heap_shape(void)
+{
+	struct b6_array array;
+	struct b6_heap heap;
+	struct b6_stats stats;
+	unsigned int u;
+	int retval = 0;
+
+	b6_array_initialize(&array, &malloc_allocator, sizeof(void*));
+	for (u = 0; u < 100; u += 1) {
+		void **ptr = b6_array_extend(&array, 1);
+		if (!ptr)
+			goto bail_out;
+		items[u].val = 100 - u;
+		*ptr = &items[u];
+	}
+	b6_heap_reset(&heap, &array, heap_cmp, NULL);
+	b6_heap_stats(&heap, &stats);
+	retval = stats.size == 100 && stats.height == 7;
+#ifdef B6_STATS
+	retval &= stats.counters.sifts && stats.counters.comparisons;
+#endif
+bail_out:
+	b6_array_finalize(&array);
+	return retval;
+}
+
+static int list_shape(void)
+{
+	struct b6_list list;
+	struct b6_stats stats;
+	unsigned int u;
+
+	b6_list_initialize(&list);
+	for (u = 0; u < 100; u += 1) {
+		items[u].val = u * 37 % 100;
+		b6_list_add_last(&list, &items[u].dref);
+	}
+	b6_list_msort(&list, list_cmp);
+	b6_list_stats(&list, &stats);
+	if (stats.size != 100 || stats.height)
+		return 0;
+#ifdef B6_STATS
+	if (stats.counters.comparisons < 100 ||
+	    stats.counters.comparisons > 100 * 7)
+		return 0;
+#endif
+	return 1;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(always_fails,);
+	test_exec(tree_shape,);
+	test_exec(splay_shape,);
+	test_exec(heap_shape,);
+	test_exec(list_shape,);
+	test_exit();
+
+	return 0;
+}
@@ -5,6 +5,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -160,6 +162,160 @@ bail_out:
 	return retval;
 }
 
+static int compare_address(void *ref, void *key)
+{
+	struct node *n = b6_cast_of(ref, struct node, tref);
+	return (void *)n < key ? -1 : (void *)n > key;
+}
+
+static int bounds(void)
+{
+	struct node *n, nodes[16];
+	struct b6_tree tree;
+	struct b6_tref *first, *last;
+	unsigned int u;
+
+	b6_tree_initialize(&tree, &b6_tree_avl_ops);
+
+	for (u = b6_card_of(nodes), n = &nodes[0]; u--;
+	     do_add(&tree, &(n++)->tref));
+
+	for (u = 0; u < b6_card_of(nodes); u += 1) {
+		b6_tree_equal_range(&tree, compare_address, &nodes[u],
+				    &first, &last);
+		if (first != &nodes[u].tref)
+			return 0;
+		if (last != (u + 1 < b6_card_of(nodes) ?
+			     &nodes[u + 1].tref : b6_tree_tail(&tree)))
+			return 0;
+	}
+
+	return b6_tree_lower_bound(&tree, compare_address, (void *)~0UL) ==
+		b6_tree_tail(&tree) &&
+		b6_tree_upper_bound(&tree, compare_address, NULL) ==
+		&nodes[0].tref;
+}
+
+static int range(void)
+{
+	struct node *n, nodes[64];
+	struct b6_tree tree;
+	struct b6_tree_range range;
+	struct b6_tref *tref;
+	unsigned int u;
+
+	b6_tree_initialize(&tree, &b6_tree_rb_ops);
+
+	for (u = b6_card_of(nodes), n = &nodes[0]; u--;
+	     do_add(&tree, &(n++)->tref));
+
+	b6_setup_tree_range(&range, &tree, &nodes[3].tref, &nodes[60].tref);
+	for (u = 3; (tref = b6_get_next_tree_range(&range)); u += 1)
+		if (tref != &nodes[u].tref)
+			return 0;
+	if (u != 60)
+		return 0;
+
+	b6_setup_tree_range(&range, &tree, b6_tree_first(&tree),
+			    b6_tree_tail(&tree));
+	for (u = 0; (tref = b6_get_next_tree_range(&range)); u += 1)
+		if (tref != &nodes[u].tref)
+			return 0;
+
+	return u == b6_card_of(nodes);
+}
+
+static int search_batch(void)
+{
+	struct node *n, nodes[100], other;
+	struct b6_tree tree;
+	struct b6_tref *refs[b6_card_of(nodes) + 1];
+	void *keys[b6_card_of(nodes) + 1];
+	unsigned int u;
+
+	b6_tree_initialize(&tree, &b6_tree_avl_ops);
+
+	for (u = b6_card_of(nodes), n = &nodes[0]; u--;
+	     do_add(&tree, &(n++)->tref));
+
+	for (u = 0; u < b6_card_of(nodes); u += 1)
+		keys[u] = &nodes[(u * 13) % b6_card_of(nodes)];
+	keys[u] = &other;
+
+	b6_tree_search_batch(&tree, compare_address, keys, b6_card_of(keys),
+			     refs);
+
+	for (u = 0; u < b6_card_of(nodes); u += 1)
+		if (refs[u] != &nodes[(u * 13) % b6_card_of(nodes)].tref)
+			return 0;
+
+	return !refs[u];
+}
+
+static void count_release(struct b6_tref *tref, void *arg)
+{
+	struct node *n = b6_cast_of(tref, struct node, tref);
+	unsigned long int *count = arg;
+	if (!tref->ref[B6_PREV] && !tref->ref[B6_NEXT])
+		*count += 1;
+	n->dref.ref[B6_NEXT] = NULL;
+}
+
+static int clear_releases_every_node(void)
+{
+	struct node *n, nodes[100];
+	struct b6_tree tree;
+	unsigned long int count = 0;
+	unsigned int u;
+
+	b6_tree_initialize(&tree, &b6_tree_rb_ops);
+
+	for (u = b6_card_of(nodes), n = &nodes[0]; u--; n++) {
+		n->dref.ref[B6_NEXT] = &n->dref;
+		do_add(&tree, &n->tref);
+	}
+
+	b6_tree_clear(&tree, count_release, &count);
+
+	for (u = b6_card_of(nodes); u--; )
+		if (nodes[u].dref.ref[B6_NEXT])
+			return 0;
+
+	return count == b6_card_of(nodes) && b6_tree_empty(&tree);
+}
+
+static int get_height(const struct b6_tref *tref)
+{
+	int h1, h2;
+	if (!tref)
+		return 0;
+	h1 = get_height(tref->ref[B6_PREV]);
+	h2 = get_height(tref->ref[B6_NEXT]);
+	return 1 + (h1 > h2 ? h1 : h2);
+}
+
+static int wavl_without_removal_is_avl(void)
+{
+	struct node *n, avl_nodes[1000], wavl_nodes[b6_card_of(avl_nodes)];
+	struct b6_tree avl, wavl;
+	struct b6_tref *dbg;
+	unsigned int u;
+
+	b6_tree_initialize(&avl, &b6_tree_avl_ops);
+	b6_tree_initialize(&wavl, &b6_tree_wavl_ops);
+
+	for (u = b6_card_of(avl_nodes), n = &avl_nodes[0]; u--;
+	     do_add(&avl, &(n++)->tref));
+	for (u = b6_card_of(wavl_nodes), n = &wavl_nodes[0]; u--;
+	     do_add(&wavl, &(n++)->tref));
+
+	if (b6_tree_check(&wavl, &dbg) < 0)
+		return 0;
+
+	return get_height(b6_tree_root(&avl)) ==
+		get_height(b6_tree_root(&wavl));
+}
+
 static int thread_should_exit = 0;
 
 static void *endurance_thread(void *arg)
@@ -212,7 +368,11 @@ bail_out:
 
 static int endurance()
 {
-	void *args[] = { (void *)&b6_tree_avl_ops, (void *)&b6_tree_rb_ops };
+	void *args[] = {
+		(void *)&b6_tree_avl_ops,
+		(void *)&b6_tree_rb_ops,
+		(void *)&b6_tree_wavl_ops,
+	};
 	pthread_t threads[b6_card_of(args)];
 	void *retvals[b6_card_of(args)];
 	int i, retval;
@@ -232,8 +392,84 @@ static int endurance()
 	return retval;
 }
 
+struct item {
+	struct b6_tref tref;
+	unsigned long int key;
+	char pad[40];
+};
+
+static unsigned long int key_of(const struct b6_tref *tref)
+{
+	return b6_cast_of(tref, struct item, tref)->key;
+}
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+/* Keys are shuffled so that the in-order traversal does not follow the
+ * order of the items in memory, as in a tree filled over time. */
+static void bench(void)
+{
+	const unsigned long int n = 1 << 21;
+	struct item *items = malloc(n * sizeof(*items));
+	struct b6_tree tree;
+	unsigned long int u, sum = 0;
+	unsigned seed = 1;
+	int pass;
+
+	if (!items)
+		return;
+
+	for (u = 0; u < n; u += 1)
+		items[u].key = u;
+	for (u = n; u > 1; u -= 1) {
+		unsigned long int v = rand_r(&seed) % u, key = items[u - 1].key;
+		items[u - 1].key = items[v].key;
+		items[v].key = key;
+	}
+
+	b6_tree_initialize(&tree, &b6_tree_rb_ops);
+	for (u = 0; u < n; u += 1) {
+		struct b6_tref *top, *ref;
+		int dir;
+		b6_tree_search(&tree, ref, top, dir)
+			dir = key_of(ref) < items[u].key ? B6_NEXT : B6_PREV;
+		b6_tree_add(&tree, top, dir, &items[u].tref);
+	}
+
+	for (pass = 0; pass < 3; pass += 1) {
+		struct b6_tree_range range;
+		struct b6_tref *ref;
+		struct timespec t0, t1, t2;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (ref = b6_tree_first(&tree); ref != b6_tree_tail(&tree);
+		     ref = b6_tree_walk(&tree, ref, B6_NEXT))
+			sum += key_of(ref);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		b6_setup_tree_range(&range, &tree, b6_tree_first(&tree),
+				    b6_tree_tail(&tree));
+		while ((ref = b6_get_next_tree_range(&range)))
+			sum += key_of(ref);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		printf("walk=%.3fs range=%.3fs\n", elapsed(&t0, &t1),
+		       elapsed(&t1, &t2));
+	}
+
+	if (sum != (unsigned long int)pass * n * (n - 1))
+		printf("unexpected checksum %lu\n", sum);
+	free(items);
+}
+
 int main(int argc, const char *argv[])
 {
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
 	test_init();
 	test_exec(always_fails,);
 	test_exec(first_is_tail_when_empty,);
@@ -242,6 +478,11 @@ int main(int argc, const char *argv[])
 	test_exec(last_is_greatest,);
 	test_exec(walk_next,);
 	test_exec(walk_prev,);
+	test_exec(clear_releases_every_node,);
+	test_exec(bounds,);
+	test_exec(range,);
+	test_exec(search_batch,);
+	test_exec(wavl_without_removal_is_avl,);
 	test_exec(endurance,);
 	test_exit();
 
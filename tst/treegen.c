@@ -0,0 +1,229 @@
+#include "test.h"
+
+#include "b6/ktree.h"
+#include "b6/tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct item {
+	struct b6_tref tref;
+	unsigned long int key;
+};
+
+#define compare_keys(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+B6_TREE_GENERATE(item_avl, struct item, tref, key, compare_keys);
+B6_TREE_GENERATE_POLICY(item_rb, rb, struct item, tref, key, compare_keys);
+B6_TREE_GENERATE_POLICY(item_wavl, wavl, struct item, tref, key, compare_keys);
+
+static int always_fails(void)
+{
+	return 0;
+}
+
+#define define_tests(name)						\
+static int name ## _insert_find_erase(void)				\
+{									\
+	struct item items[512];						\
+	struct b6_tree tree;						\
+	struct b6_tref *dbg;						\
+	struct item dup, *e;						\
+	unsigned long int u;						\
+									\
+	name ## _initialize(&tree);					\
+	for (u = 0; u < b6_card_of(items); u += 1) {			\
+		items[u].key = u * 7 % b6_card_of(items);		\
+		if (name ## _insert(&tree, &items[u]) != &items[u])	\
+			return 0;					\
+		if (b6_tree_check(&tree, &dbg) < 0)			\
+			return 0;					\
+	}								\
+	dup.key = 42;							\
+	if (name ## _insert(&tree, &dup) != &items[6])			\
+		return 0;						\
+	for (u = 0; u < b6_card_of(items); u += 1)			\
+		if (!(e = name ## _find(&tree, u)) || e->key != u)	\
+			return 0;					\
+	if (name ## _find(&tree, b6_card_of(items)))			\
+		return 0;						\
+	for (u = 0; u < b6_card_of(items); u += 2) {			\
+		name ## _erase(&tree, &items[u]);			\
+		if (b6_tree_check(&tree, &dbg) < 0)			\
+			return 0;					\
+	}								\
+	for (u = 0; u < b6_card_of(items); u += 1)			\
+		if (!name ## _find(&tree, items[u].key) != !(u & 1))	\
+			return 0;					\
+	return 1;							\
+}									\
+									\
+static int name ## _walk_in_order(void)					\
+{									\
+	struct item items[64], *e;					\
+	struct b6_tree tree;						\
+	unsigned long int u;						\
+									\
+	name ## _initialize(&tree);					\
+	if (name ## _first(&tree) || name ## _last(&tree))		\
+		return 0;						\
+	for (u = 0; u < b6_card_of(items); u += 1) {			\
+		items[u].key = 2 * ((u * 5) % b6_card_of(items));	\
+		name ## _insert(&tree, &items[u]);			\
+	}								\
+	for (u = 0, e = name ## _first(&tree); e;			\
+	     u += 2, e = name ## _next(&tree, e))			\
+		if (e->key != u)					\
+			return 0;					\
+	if (u != 2 * b6_card_of(items))					\
+		return 0;						\
+	for (e = name ## _last(&tree); e; e = name ## _prev(&tree, e))	\
+		if (e->key != (u -= 2))					\
+			return 0;					\
+	if (u)								\
+		return 0;						\
+	if (!(e = name ## _lower_bound(&tree, 7)) || e->key != 8)	\
+		return 0;						\
+	if (!(e = name ## _lower_bound(&tree, 8)) || e->key != 8)	\
+		return 0;						\
+	return !name ## _lower_bound(&tree, 2 * b6_card_of(items));	\
+}
+
+define_tests(item_avl)
+define_tests(item_rb)
+define_tests(item_wavl)
+
+static int ktree_operations(void)
+{
+	struct b6_ktref refs[256], dup, *ktref;
+	struct b6_tree tree;
+	struct b6_tref *dbg;
+	unsigned long long int key;
+	unsigned int u;
+
+	b6_ktree_initialize(&tree);
+	for (u = 0; u < b6_card_of(refs); u += 1) {
+		refs[u].key = 3ULL * ((u * 11) % b6_card_of(refs)) + (1ULL << 40);
+		if (b6_ktree_insert(&tree, &refs[u]) != &refs[u])
+			return 0;
+	}
+	if (b6_tree_check(&tree, &dbg) < 0)
+		return 0;
+	dup.key = refs[0].key;
+	if (b6_ktree_insert(&tree, &dup) != &refs[0])
+		return 0;
+
+	for (u = 0, key = 1ULL << 40; u < b6_card_of(refs); u += 1, key += 3)
+		if (!(ktref = b6_ktree_find(&tree, key)) || ktref->key != key ||
+		    b6_ktree_find(&tree, key + 1))
+			return 0;
+
+	key = (1ULL << 40) + 30;
+	if (b6_ktree_lower_bound(&tree, key)->key != key ||
+	    b6_ktree_upper_bound(&tree, key)->key != key + 3 ||
+	    b6_ktree_lower_bound(&tree, key + 1)->key != key + 3)
+		return 0;
+	if (b6_ktree_count_range(&tree, key, key + 30) != 10)
+		return 0;
+	if (b6_ktree_upper_bound(&tree, b6_ktree_last(&tree)->key))
+		return 0;
+
+	for (u = 0; u < b6_card_of(refs); u += 2)
+		b6_ktree_erase(&tree, &refs[u]);
+	if (b6_tree_check(&tree, &dbg) < 0)
+		return 0;
+	for (u = 0, ktref = b6_ktree_first(&tree); ktref;
+	     ktref = b6_ktree_next(&tree, ktref))
+		u += 1;
+	return u == b6_card_of(refs) / 2;
+}
+
+/*
+ * Lookup benchmark comparing generated functions with the generic API where
+ * the comparison is an indirect call.
+ */
+
+static int compare_item(void *ref, void *key)
+{
+	struct item *e = b6_cast_of((struct b6_tref*)ref, struct item, tref);
+	unsigned long int k = *(unsigned long int*)key;
+	return compare_keys(e->key, k);
+}
+
+static struct b6_tref *generic_find(struct b6_tree *tree,
+				    int (*cmp)(void*, void*),
+				    unsigned long int key)
+{
+	struct b6_tref *ref = b6_tree_lower_bound(tree, cmp, &key);
+	if (ref == b6_tree_tail(tree) || cmp(ref, &key))
+		return NULL;
+	return ref;
+}
+
+static double elapsed(const struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static void bench(void)
+{
+	const unsigned long int n = 1 << 20, lookups = 1 << 24;
+	struct item *items = malloc(n * sizeof(*items));
+	int (*volatile cmp)(void*, void*) = compare_item;
+	struct b6_tree tree;
+	struct timespec t0;
+	unsigned long int u, hits;
+	unsigned int seed;
+
+	if (!items)
+		return;
+
+	item_avl_initialize(&tree);
+	for (u = 0; u < n; u += 1) {
+		items[u].key = u * 2;
+		item_avl_insert(&tree, &items[u]);
+	}
+
+	seed = 0;
+	hits = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		hits += !!item_avl_find(&tree, rand_r(&seed) % (2 * n));
+	printf("generated  lookups/s=%.0f hits=%lu\n",
+	       lookups / elapsed(&t0), hits);
+
+	seed = 0;
+	hits = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < lookups; u += 1)
+		hits += !!generic_find(&tree, cmp, rand_r(&seed) % (2 * n));
+	printf("generic    lookups/s=%.0f hits=%lu\n",
+	       lookups / elapsed(&t0), hits);
+
+	free(items);
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
+	test_init();
+	test_exec(always_fails,);
+	test_exec(item_avl_insert_find_erase,);
+	test_exec(item_avl_walk_in_order,);
+	test_exec(item_rb_insert_find_erase,);
+	test_exec(item_rb_walk_in_order,);
+	test_exec(item_wavl_insert_find_erase,);
+	test_exec(item_wavl_walk_in_order,);
+	test_exec(ktree_operations,);
+	test_exit();
+
+	return 0;
+}